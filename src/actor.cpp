@@ -0,0 +1,251 @@
+#include "actor.h"
+
+#include <stdexcept>
+#include <thread>
+#include <variant>
+#include <vector>
+#include "builtins.h"
+#include "collections.h"
+#include "eva.h"
+#include "persistent.h"
+
+using namespace std;
+
+namespace
+{
+    bool isImmutable(const EvalResult &value)
+    {
+        if (holds_alternative<int>(value) || holds_alternative<string>(value) || holds_alternative<bool>(value) ||
+            holds_alternative<Null>(value) || holds_alternative<RopeValue>(value) || holds_alternative<ChannelValue>(value))
+        {
+            return true;
+        }
+        auto immutable = true;
+        if (auto vector = get_if<VectorValue>(&value))
+        {
+            vector->vector->forEach([&immutable](const EvalResult &item)
+                                    { immutable = immutable && isImmutable(item); });
+            return immutable;
+        }
+        if (auto table = get_if<TableValue>(&value))
+        {
+            table->map->forEach([&immutable](const EvalResult &key, const EvalResult &item)
+                                { immutable = immutable && isImmutable(key) && isImmutable(item); });
+            return immutable;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Copy the parts of a value another interpreter could change
+     *
+     * @throw std::runtime_error if the value belongs to its interpreter
+     */
+    EvalResult isolate(const EvalResult &value)
+    {
+        if (auto list = get_if<ListValue>(&value))
+        {
+            vector<EvalResult> items;
+            items.reserve(list->list->size());
+            for (const auto &item : list->list->items)
+            {
+                items.push_back(isolate(item));
+            }
+            return List::create(std::move(items));
+        }
+        if (auto map = get_if<MapValue>(&value))
+        {
+            auto copy = HashMap::create();
+            map->map->forEach([&copy](const EvalResult &key, const EvalResult &item)
+                              { copy.map->assign(isolate(key), isolate(item)); });
+            return copy;
+        }
+        if (isImmutable(value))
+        {
+            return value;
+        }
+        throw runtime_error("Cannot send " + toString(value) + " to another interpreter");
+    }
+
+    /**
+     * @brief Wait a little longer on every attempt: spin first, then give the core away
+     */
+    void backoff(size_t attempt)
+    {
+        if (attempt < 64)
+        {
+            this_thread::yield();
+        }
+        else
+        {
+            this_thread::sleep_for(chrono::microseconds(attempt < 1024 ? 10 : 200));
+        }
+    }
+}
+
+Channel::Channel(size_t capacity)
+{
+    size_t size = 2;
+    while (size < capacity)
+    {
+        size *= 2;
+    }
+    cells = make_unique<Cell[]>(size);
+    for (size_t i = 0; i < size; ++i)
+    {
+        cells[i].sequence.store(i, memory_order_relaxed);
+    }
+    mask = size - 1;
+}
+
+void Channel::send(const EvalResult &value)
+{
+    auto copy = isolate(value);
+    for (size_t attempt = 0;; ++attempt)
+    {
+        if (closed)
+        {
+            throw runtime_error("send: channel is closed");
+        }
+        if (push(copy))
+        {
+            return;
+        }
+        backoff(attempt);
+    }
+}
+
+bool Channel::receive(EvalResult &value)
+{
+    for (size_t attempt = 0;; ++attempt)
+    {
+        if (tryReceive(value))
+        {
+            return true;
+        }
+        // Values sent before the channel was closed are still delivered
+        if (closed)
+        {
+            return tryReceive(value);
+        }
+        backoff(attempt);
+    }
+}
+
+bool Channel::trySend(const EvalResult &value)
+{
+    if (closed)
+    {
+        throw runtime_error("send: channel is closed");
+    }
+    auto copy = isolate(value);
+    return push(copy);
+}
+
+bool Channel::push(EvalResult &value)
+{
+    auto position = tail.load(memory_order_relaxed);
+    Cell *cell;
+    while (true)
+    {
+        cell = &cells[position & mask];
+        auto sequence = cell->sequence.load(memory_order_acquire);
+        auto distance = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+        if (distance == 0)
+        {
+            if (tail.compare_exchange_weak(position, position + 1, memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (distance < 0)
+        {
+            // The cell still holds the value sent one lap ago
+            return false;
+        }
+        else
+        {
+            position = tail.load(memory_order_relaxed);
+        }
+    }
+    cell->value = std::move(value);
+    cell->sequence.store(position + 1, memory_order_release);
+    return true;
+}
+
+bool Channel::tryReceive(EvalResult &value)
+{
+    auto position = head.load(memory_order_relaxed);
+    Cell *cell;
+    while (true)
+    {
+        cell = &cells[position & mask];
+        auto sequence = cell->sequence.load(memory_order_acquire);
+        auto distance = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+        if (distance == 0)
+        {
+            if (head.compare_exchange_weak(position, position + 1, memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (distance < 0)
+        {
+            return false;
+        }
+        else
+        {
+            position = head.load(memory_order_relaxed);
+        }
+    }
+    value = std::move(cell->value);
+    // The cell must not keep the value alive until it is reused
+    cell->value = Null{};
+    cell->sequence.store(position + mask + 1, memory_order_release);
+    return true;
+}
+
+void Channel::close()
+{
+    closed = true;
+}
+
+Actor::Actor(shared_ptr<const Expression> program, const EvalMap &bindings)
+{
+    auto variables = globalVariables();
+    for (const auto &[name, value] : bindings)
+    {
+        variables[name] = isolate(value);
+    }
+    thread = std::thread([this, program = std::move(program), variables = std::move(variables)]() mutable
+                         {
+                             try
+                             {
+                                 result = program->eval(make_shared<Environment>(std::move(variables)));
+                             }
+                             catch (...)
+                             {
+                                 error = current_exception();
+                             } });
+}
+
+Actor::~Actor()
+{
+    if (thread.joinable())
+    {
+        thread.join();
+    }
+}
+
+EvalResult Actor::join()
+{
+    if (thread.joinable())
+    {
+        thread.join();
+    }
+    if (error)
+    {
+        rethrow_exception(error);
+    }
+    return result;
+}
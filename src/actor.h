@@ -0,0 +1,148 @@
+#ifndef CPP_EVA_ACTOR_H
+#define CPP_EVA_ACTOR_H
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <thread>
+#include "eval_types.h"
+
+/**
+ * This class is used to pass values between interpreters running on different threads.
+ *
+ * A channel is a bounded lock-free queue: senders and receivers claim a cell with a compare-and-swap on the
+ * tail or the head of a ring of cells, and hand the value over through the sequence number of the cell. A
+ * full channel makes the sender wait and an empty one the receiver, so a fast stage of a pipeline cannot run
+ * ahead of a slow one by more than the capacity of the channel between them.
+ *
+ * Values are isolated when they are sent: lists and maps are copied, immutable values such as strings,
+ * ropes, vectors and tables of immutable values and channels are shared. Functions, classes, instances and
+ * generators belong to the interpreter that created them and cannot be sent.
+ */
+class Channel
+{
+public:
+    static auto create(size_t capacity)
+    {
+        return std::make_shared<Channel>(capacity);
+    }
+
+    /**
+     * @param capacity The number of values the channel holds, rounded up to a power of two
+     */
+    explicit Channel(size_t capacity);
+
+    Channel(const Channel &) = delete;
+    Channel &operator=(const Channel &) = delete;
+
+    /**
+     * @brief Send a copy of a value, waiting while the channel is full
+     *
+     * @throw std::runtime_error if the value cannot be sent or the channel is closed
+     */
+    void send(const EvalResult &value);
+
+    /**
+     * @brief Receive the oldest value, waiting while the channel is empty
+     *
+     * @param value Set to the value
+     *
+     * @return false once the channel is closed and every value sent before has been received
+     */
+    bool receive(EvalResult &value);
+
+    /**
+     * @brief Send a copy of a value if the channel is not full
+     *
+     * @return false if the channel is full
+     *
+     * @throw std::runtime_error if the value cannot be sent or the channel is closed
+     */
+    bool trySend(const EvalResult &value);
+
+    /**
+     * @brief Receive the oldest value if the channel is not empty
+     *
+     * @return false if the channel is empty
+     */
+    bool tryReceive(EvalResult &value);
+
+    /**
+     * @brief Close the channel once everything has been sent
+     *
+     * Receivers get the values sent before and are told the channel is closed afterwards.
+     */
+    void close();
+
+    [[nodiscard]] bool isClosed() const
+    {
+        return closed;
+    }
+
+    [[nodiscard]] size_t getCapacity() const
+    {
+        return mask + 1;
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        EvalResult value;
+    };
+
+    bool push(EvalResult &value);
+
+    // Head and tail are written by different threads, they are kept on cache lines of their own
+    std::unique_ptr<Cell[]> cells;
+    size_t mask;
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+    alignas(64) std::atomic<bool> closed{false};
+};
+
+/**
+ * This class is used to run a program in an interpreter of its own, on a thread of its own.
+ *
+ * The interpreter starts from the builtins and the bindings of the actor and shares nothing else with
+ * other interpreters, so actors never contend on a global environment. They talk through the channels
+ * they are given; a pipeline is a chain of actors with a channel between each of them.
+ */
+class Actor
+{
+public:
+    /**
+     * @brief Start running a program
+     *
+     * @param program The program, which may be run by several actors at once
+     * @param bindings Variables defined for the program, e.g. its channels; they are isolated like sent values
+     *
+     * @throw std::runtime_error if a binding cannot be sent
+     */
+    Actor(std::shared_ptr<const Expression> program, const EvalMap &bindings);
+
+    /**
+     * Waits for the program to finish: the channels the program waits on must be closed first.
+     */
+    ~Actor();
+
+    Actor(const Actor &) = delete;
+    Actor &operator=(const Actor &) = delete;
+
+    /**
+     * @brief Wait for the program to finish
+     *
+     * @return The result of the program
+     *
+     * @throw The error of the program
+     */
+    EvalResult join();
+
+private:
+    EvalResult result;
+    std::exception_ptr error;
+    std::thread thread;
+};
+
+#endif // CPP_EVA_ACTOR_H
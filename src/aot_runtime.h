@@ -0,0 +1,53 @@
+#ifndef CPP_EVA_AOT_RUNTIME_H
+#define CPP_EVA_AOT_RUNTIME_H
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <variant>
+#include "collections.h"
+#include "rope.h"
+#include "environment.h"
+#include "eval_types.h"
+#include "expressions.h"
+#include "governor.h"
+#include "jit.h"
+#include "sequence.h"
+
+/**
+ * Runtime support for C++ code generated by the Transpiler.
+ *
+ * Generated code is compiled into a shared object against this header and calls back into the interpreter
+ * for environments, function calls and safepoints, so it follows the semantics of the tree walker.
+ */
+
+/**
+ * This class is used to represent an expression compiled to native code ahead of time.
+ *
+ * Function definitions created by generated code use it as their body. It keeps the module that contains
+ * the code loaded for as long as the expression is alive.
+ */
+class CompiledExpression : public Expression
+{
+public:
+    using Function = EvalResult (*)(const std::shared_ptr<Environment> &env, const std::shared_ptr<const void> &module);
+
+    static auto create(Function function, std::shared_ptr<const void> module)
+    {
+        return std::make_unique<CompiledExpression>(function, std::move(module));
+    }
+
+    CompiledExpression(Function function, std::shared_ptr<const void> module)
+        : function(function), module(std::move(module)) {}
+
+    [[nodiscard]] EvalResult eval(std::shared_ptr<Environment> env) const override
+    {
+        return function(env, module);
+    }
+
+private:
+    Function function;
+    std::shared_ptr<const void> module;
+};
+
+#endif // CPP_EVA_AOT_RUNTIME_H
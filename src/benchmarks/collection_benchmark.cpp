@@ -0,0 +1,148 @@
+/**
+ * Benchmark of the native collection values.
+ *
+ * Runs the same scripts with lists and maps and with the class-instance emulation scripts used before
+ * collections existed: a linked list of Node instances, and an association list of Entry instances
+ * searched by key.
+ *
+ * With --json the runs are printed as a JSON array instead, with the processor counters of every script.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "json_report.h"
+#include "../eva.h"
+#include "../tests/expression_helpers.h"
+
+using namespace std;
+
+namespace
+{
+    template <typename Program>
+    double milliseconds(Eva &eva, int expected, PerfProfile &profile, Program program)
+    {
+        auto start = chrono::steady_clock::now();
+        auto result = eva.eval(program(), profile);
+        auto elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        if (!holds_alternative<int>(result) || get<int>(result) != expected)
+        {
+            abort();
+        }
+        return elapsed;
+    }
+
+    /**
+     * Build a sequence of `count` numbers and sum it in order.
+     */
+    ExpressionPtr nodeSequence(int count)
+    {
+        return beg(
+            cls("Node", NONE,
+                beg(def("constructor", args("self", "value", "next"),
+                        beg(setm(prop("self", "value"), id("value")),
+                            setm(prop("self", "next"), id("next")))))),
+            var("head", lit(0)),
+            floop(var("i", lit(count)), gt(id("i"), 0), dec(id("i")),
+                  set("head", newi("Node", vars(id("i"), id("head"))))),
+            var("sum", lit(0)),
+            var("node", id("head")),
+            floop(var("j", lit(0)), lt(id("j"), count), inc(id("j")),
+                  beg(set("sum", add(id("sum"), prop("node", "value"))),
+                      set("node", prop("node", "next")))),
+            id("sum"));
+    }
+
+    ExpressionPtr listSequence(int count)
+    {
+        return beg(
+            var("items", lst()),
+            floop(var("i", lit(1)), lte(id("i"), count), inc(id("i")),
+                  call("push", id("items"), id("i"))),
+            var("sum", lit(0)),
+            floop(var("j", lit(0)), lt(id("j"), count), inc(id("j")),
+                  set("sum", add(id("sum"), at(id("items"), id("j"))))),
+            id("sum"));
+    }
+
+    /**
+     * Store `count` keys and look every one of them up.
+     */
+    ExpressionPtr entryLookups(int count)
+    {
+        return beg(
+            cls("Entry", NONE,
+                beg(def("constructor", args("self", "key", "value", "next"),
+                        beg(setm(prop("self", "key"), id("key")),
+                            setm(prop("self", "value"), id("value")),
+                            setm(prop("self", "next"), id("next")))))),
+            var("entries", lit(0)),
+            floop(var("i", lit(0)), lt(id("i"), count), inc(id("i")),
+                  set("entries", newi("Entry", vars(mul(id("i"), 7), id("i"), id("entries"))))),
+            var("sum", lit(0)),
+            floop(var("j", lit(0)), lt(id("j"), count), inc(id("j")),
+                  beg(var("entry", id("entries")),
+                      loop(neq(prop("entry", "key"), mul(id("j"), 7)),
+                           set("entry", prop("entry", "next"))),
+                      set("sum", add(id("sum"), prop("entry", "value"))))),
+            id("sum"));
+    }
+
+    ExpressionPtr mapLookups(int count)
+    {
+        return beg(
+            var("entries", dict()),
+            floop(var("i", lit(0)), lt(id("i"), count), inc(id("i")),
+                  setat(id("entries"), mul(id("i"), 7), id("i"))),
+            var("sum", lit(0)),
+            floop(var("j", lit(0)), lt(id("j"), count), inc(id("j")),
+                  set("sum", add(id("sum"), at(id("entries"), mul(id("j"), 7))))),
+            id("sum"));
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Eva eva;
+    bool json = argc > 1 && strcmp(argv[1], "--json") == 0;
+    JsonReport report;
+    // The counters are opened before the first run, so it does not pay for the system calls
+    void(PerfCounters::thread());
+
+    if (!json)
+    {
+        printf("%8s | %24s | %24s\n", "elements", "sequence ms nodes/list", "lookup ms entries/map");
+    }
+    for (int count : {16, 128, 1024, 4096})
+    {
+        int sum = count * (count + 1) / 2;
+        int lookupSum = count * (count - 1) / 2;
+        PerfProfile nodesProfile, listProfile, entriesProfile, mapProfile;
+        double nodes = milliseconds(eva, sum, nodesProfile, [count]
+                                    { return nodeSequence(count); });
+        double list = milliseconds(eva, sum, listProfile, [count]
+                                   { return listSequence(count); });
+        double entries = milliseconds(eva, lookupSum, entriesProfile, [count]
+                                      { return entryLookups(count); });
+        double map = milliseconds(eva, lookupSum, mapProfile, [count]
+                                  { return mapLookups(count); });
+        if (json)
+        {
+            report.add("nodeSequence", count, nodes, nodesProfile.total);
+            report.add("listSequence", count, list, listProfile.total);
+            report.add("entryLookups", count, entries, entriesProfile.total);
+            report.add("mapLookups", count, map, mapProfile.total);
+        }
+        else
+        {
+            printf("%8d | %10.3f / %10.3f  | %10.3f / %10.3f\n", count, nodes, list, entries, map);
+        }
+    }
+    if (json)
+    {
+        report.print();
+    }
+    return 0;
+}
@@ -0,0 +1,168 @@
+/**
+ * Benchmark of the dispatch of the tree-walking interpreter.
+ *
+ * Runs the same scripts on the virtual expressions, on the expressions rewritten to superinstructions and
+ * on the tagged tree, which dispatches with a switch over a closed set of node kinds. The JIT is turned
+ * off, so the functions stay interpreted too.
+ *
+ * With --pairs the parent and child kinds of the nodes of the scripts are counted instead, the most
+ * frequent first: the shapes worth fusing. With --json the runs are printed as a JSON array, with the processor
+ * counters of every run.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../eva.h"
+#include "../jit.h"
+#include "../superinstructions.h"
+#include "../tagged_tree.h"
+#include "../tests/expression_helpers.h"
+#include "json_report.h"
+
+using namespace std;
+
+namespace
+{
+    struct Script
+    {
+        const char *name;
+        int expected;
+        function<ExpressionPtr()> build;
+    };
+
+    ExpressionPtr countingLoop()
+    {
+        return beg(
+            var("sum", lit(0)),
+            floop(var("i", lit(0)), lt(id("i"), 1000000), inc(id("i")),
+                  set("sum", add(id("sum"), mod(id("i"), 7)))),
+            id("sum"));
+    }
+
+    ExpressionPtr listIndexing()
+    {
+        return beg(
+            var("items", lst()),
+            floop(var("i", lit(0)), lt(id("i"), 1000), inc(id("i")),
+                  call("push", id("items"), id("i"))),
+            var("sum", lit(0)),
+            floop(var("round", lit(0)), lt(id("round"), 300), inc(id("round")),
+                  floop(var("j", lit(0)), lt(id("j"), 1000), inc(id("j")),
+                        set("sum", add(id("sum"), at(id("items"), id("j")))))),
+            divv(id("sum"), 300));
+    }
+
+    ExpressionPtr recursion()
+    {
+        return beg(
+            def("fib", args("n"),
+                iff(lt(id("n"), 2), id("n"), add(call("fib", sub(id("n"), 1)), call("fib", sub(id("n"), 2))))),
+            call("fib", 22));
+    }
+
+    ExpressionPtr countdown()
+    {
+        return beg(
+            var("n", lit(500000)),
+            var("steps", lit(0)),
+            loop(gt(id("n"), 0), beg(dec(id("n")), inc(id("steps")))),
+            id("steps"));
+    }
+
+    template <typename Run>
+    double milliseconds(const Script &script, PerfSample &counters, Run run)
+    {
+        const auto before = PerfCounters::thread().read();
+        auto start = chrono::steady_clock::now();
+        auto result = run();
+        auto elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        counters = PerfCounters::thread().read() - before;
+        if (!holds_alternative<int>(result) || get<int>(result) != script.expected)
+        {
+            abort();
+        }
+        return elapsed;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const vector<Script> scripts = {
+        {"counting loop", 2999997, countingLoop},
+        {"list indexing", 499500, listIndexing},
+        {"recursion", 17711, recursion},
+        {"countdown", 500000, countdown},
+    };
+
+    if (argc > 1 && strcmp(argv[1], "--pairs") == 0)
+    {
+        map<pair<string, string>, size_t> totals;
+        for (const auto &script : scripts)
+        {
+            for (const auto &pair : Superinstructions::countPairs(*script.build()))
+            {
+                totals[{pair.parent, pair.child}] += pair.count;
+            }
+        }
+        vector<std::pair<size_t, std::pair<string, string>>> sorted;
+        for (const auto &[kinds, count] : totals)
+        {
+            sorted.emplace_back(count, kinds);
+        }
+        sort(sorted.rbegin(), sorted.rend());
+        for (const auto &[count, kinds] : sorted)
+        {
+            printf("%6zu  %s > %s\n", count, kinds.first.c_str(), kinds.second.c_str());
+        }
+        return 0;
+    }
+
+    bool json = argc > 1 && strcmp(argv[1], "--json") == 0;
+    JsonReport report;
+    // The counters are opened before the first run, so it does not pay for the system calls
+    void(PerfCounters::thread());
+
+    Jit::setEnabled(false);
+    Eva eva;
+    if (!json)
+    {
+        printf("%14s | %10s | %10s | %10s\n", "script", "virtual ms", "fused ms", "switch ms");
+    }
+    for (const auto &script : scripts)
+    {
+        PerfSample plainCounters, fusedCounters, taggedCounters;
+        eva.setFusing(false);
+        double plain = milliseconds(script, plainCounters, [&]
+                                    { return eva.eval(script.build()); });
+        eva.setFusing(true);
+        double fused = milliseconds(script, fusedCounters, [&]
+                                    { return eva.eval(script.build()); });
+        // The tree is lowered from the same expressions, the lowering is not timed
+        auto tree = TaggedTree::compile(script.build());
+        double tagged = milliseconds(script, taggedCounters, [&]
+                                     { return eva.eval(*tree); });
+        if (json)
+        {
+            // The scripts have a fixed size, reported as 0
+            report.add(script.name + " (virtual)"s, 0, plain, plainCounters);
+            report.add(script.name + " (fused)"s, 0, fused, fusedCounters);
+            report.add(script.name + " (switch)"s, 0, tagged, taggedCounters);
+        }
+        else
+        {
+            printf("%14s | %10.2f | %10.2f | %10.2f\n", script.name, plain, fused, tagged);
+        }
+    }
+    if (json)
+    {
+        report.print();
+    }
+    return 0;
+}
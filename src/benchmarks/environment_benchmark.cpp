@@ -0,0 +1,180 @@
+/**
+ * Benchmark of the variable storage of environments.
+ *
+ * Compares VariableTable with the EvalMap that environments used before, for the scope sizes scripts
+ * typically create: heap bytes a scope holds once built, allocations needed to build it, and the latency
+ * of looking up one of its variables.
+ *
+ * With --json the lookups are printed as a JSON array instead, with the processor counters of every run.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+#include "../environment.h"
+#include "../variable_table.h"
+#include "json_report.h"
+
+using namespace std;
+
+namespace
+{
+    // Every allocation is preceded by its size, so the bytes still held by a scope can be counted
+    constexpr size_t header = alignof(max_align_t);
+
+    size_t liveBytes = 0;
+    size_t allocations = 0;
+
+    struct Footprint
+    {
+        size_t bytes;
+        size_t allocations;
+    };
+
+    vector<string> names(size_t count)
+    {
+        vector<string> result;
+        for (size_t i = 0; i < count; ++i)
+        {
+            result.push_back("variable" + to_string(i));
+        }
+        return result;
+    }
+
+    template <typename Scope, typename Build>
+    Footprint measure(Build build)
+    {
+        const auto before = liveBytes;
+        allocations = 0;
+        auto scope = new Scope();
+        build(*scope);
+        Footprint footprint{liveBytes - before, allocations};
+        delete scope;
+        return footprint;
+    }
+
+    constexpr size_t rounds = 10000000;
+
+    template <typename Find>
+    double lookupNanoseconds(const vector<string> &keys, PerfSample &counters, Find find)
+    {
+        size_t found = 0;
+        const auto before = PerfCounters::thread().read();
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0, key = 0; i < rounds; ++i)
+        {
+            found += find(keys[key]);
+            key = key + 1 == keys.size() ? 0 : key + 1;
+        }
+        auto elapsed = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+        counters = PerfCounters::thread().read() - before;
+        if (found != rounds)
+        {
+            abort();
+        }
+        return elapsed / rounds;
+    }
+}
+
+// The replacements are kept out of line: inlined into new and delete expressions, the header arithmetic would be
+// checked against the size of the object and free against the new expression
+[[gnu::noinline]] void *operator new(size_t size)
+{
+    auto block = static_cast<char *>(malloc(header + size));
+    if (!block)
+    {
+        throw bad_alloc();
+    }
+    memcpy(block, &size, sizeof(size));
+    liveBytes += size;
+    ++allocations;
+    return block + header;
+}
+
+[[gnu::noinline]] void operator delete(void *pointer) noexcept
+{
+    if (!pointer)
+    {
+        return;
+    }
+    auto block = static_cast<char *>(pointer) - header;
+    size_t size;
+    memcpy(&size, block, sizeof(size));
+    liveBytes -= size;
+    free(block);
+}
+
+void operator delete(void *pointer, size_t) noexcept
+{
+    operator delete(pointer);
+}
+
+int main(int argc, char **argv)
+{
+    bool json = argc > 1 && strcmp(argv[1], "--json") == 0;
+    JsonReport report;
+    // The counters are opened before the first run, so it does not pay for the system calls
+    void(PerfCounters::thread());
+
+    if (!json)
+    {
+        printf("%9s | %22s | %22s | %19s\n", "variables", "EvalMap bytes (allocs)", "table bytes (allocs)",
+               "lookup ns map/table");
+    }
+
+    for (size_t count : {0, 1, 2, 4, 6, 8, 16, 64})
+    {
+        auto keys = names(count);
+
+        auto map = measure<EvalMap>([&](EvalMap &scope)
+                                    {
+            for (const auto &key : keys)
+            {
+                scope.emplace(key, static_cast<int>(key.size()));
+            } });
+        auto table = measure<VariableTable>([&](VariableTable &scope)
+                                            {
+            for (const auto &key : keys)
+            {
+                scope.insert(key, static_cast<int>(key.size()));
+            } });
+
+        double mapLookup = 0;
+        double tableLookup = 0;
+        if (count > 0)
+        {
+            EvalMap scopeMap;
+            VariableTable scopeTable;
+            for (const auto &key : keys)
+            {
+                scopeMap.emplace(key, 0);
+                scopeTable.insert(key, 0);
+            }
+            PerfSample mapCounters, tableCounters;
+            mapLookup = lookupNanoseconds(keys, mapCounters, [&scopeMap](const string &key)
+                                          { return scopeMap.find(key) != scopeMap.end(); });
+            tableLookup = lookupNanoseconds(keys, tableCounters, [&scopeTable](const string &key)
+                                            { return scopeTable.find(key) != nullptr; });
+            if (json)
+            {
+                report.add("EvalMap lookups", static_cast<int>(count), mapLookup * rounds / 1e6, mapCounters);
+                report.add("VariableTable lookups", static_cast<int>(count), tableLookup * rounds / 1e6, tableCounters);
+            }
+        }
+
+        if (!json)
+        {
+                printf("%9zu | %14zu (%5zu) | %14zu (%5zu) | %8.2f / %8.2f\n", count, map.bytes, map.allocations,
+                   table.bytes, table.allocations, mapLookup, tableLookup);
+        }
+    }
+    if (json)
+    {
+        report.print();
+    }
+    return 0;
+}
@@ -0,0 +1,72 @@
+#ifndef CPP_EVA_JSON_REPORT_H
+#define CPP_EVA_JSON_REPORT_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "../perf_counters.h"
+
+/**
+ * This class is used to report the runs of a benchmark as a JSON array.
+ *
+ * Every run is an object with the name of the script, its size, the wall clock time and the counters of
+ * its evaluation; the counters the machine does not provide are null.
+ */
+class JsonReport
+{
+public:
+    void add(const std::string &script, int size, double milliseconds, const PerfSample &counters)
+    {
+        std::string run = "  {\"script\": " + quote(script) + ", \"size\": " + std::to_string(size) +
+                          ", \"ms\": " + std::to_string(milliseconds) + ", \"counters\": {";
+        for (size_t i = 0; i < perfEventCount; ++i)
+        {
+            const auto &count = counters.counts[i];
+            run += std::string(i ? ", " : "") + "\"" + perfEventName(static_cast<PerfEvent>(i)) + "\": " +
+                   (count ? std::to_string(*count) : "null");
+        }
+        runs.push_back(run + "}}");
+    }
+
+    void print() const
+    {
+        printf("[\n");
+        for (size_t i = 0; i < runs.size(); ++i)
+        {
+            printf("%s%s\n", runs[i].c_str(), i + 1 < runs.size() ? "," : "");
+        }
+        printf("]\n");
+    }
+
+private:
+    /**
+     * @brief Quote a string as a JSON string, escaping quotes, backslashes and control characters
+     */
+    static std::string quote(const std::string &text)
+    {
+        std::string quoted = "\"";
+        for (unsigned char c : text)
+        {
+            if (c == '"' || c == '\\')
+            {
+                quoted += '\\';
+                quoted += static_cast<char>(c);
+            }
+            else if (c < 0x20)
+            {
+                char escape[7];
+                snprintf(escape, sizeof(escape), "\\u%04x", c);
+                quoted += escape;
+            }
+            else
+            {
+                quoted += static_cast<char>(c);
+            }
+        }
+        return quoted + "\"";
+    }
+
+    std::vector<std::string> runs;
+};
+
+#endif // CPP_EVA_JSON_REPORT_H
@@ -0,0 +1,110 @@
+/**
+ * Benchmark of string concatenation.
+ *
+ * Builds strings from n appends of 10 characters with ropes and with copying std::string concatenation,
+ * which is what `+` on plain strings would do, and reports the time per append: constant for ropes,
+ * growing with n for copies. The last column runs the same loop as a script.
+ *
+ * With --json the runs are printed as a JSON array instead, with the processor counters of every run.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "../eva.h"
+#include "../rope.h"
+#include "../tests/expression_helpers.h"
+#include "json_report.h"
+
+using namespace std;
+
+namespace
+{
+    const string piece = "0123456789";
+
+    template <typename Build>
+    double nanosecondsPerAppend(int count, PerfSample &counters, Build build)
+    {
+        const auto before = PerfCounters::thread().read();
+        auto start = chrono::steady_clock::now();
+        auto size = build();
+        auto elapsed = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+        counters = PerfCounters::thread().read() - before;
+        if (size != piece.size() * count)
+        {
+            abort();
+        }
+        return elapsed / count;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Eva eva;
+    bool json = argc > 1 && strcmp(argv[1], "--json") == 0;
+    JsonReport report;
+    // The counters are opened before the first run, so it does not pay for the system calls
+    void(PerfCounters::thread());
+
+    if (!json)
+    {
+        printf("%9s | %12s | %12s | %12s\n", "appends", "copy ns", "rope ns", "script ns");
+    }
+    for (int count : {1000, 10000, 100000, 1000000})
+    {
+        PerfSample copyCounters, ropeCounters, scriptCounters;
+        double copy = 0;
+        if (count <= 100000)
+        {
+            copy = nanosecondsPerAppend(count, copyCounters, [count]
+                                        {
+                string text;
+                for (int i = 0; i < count; ++i)
+                {
+                    text = text + piece;
+                }
+                return text.size(); });
+        }
+        double rope = nanosecondsPerAppend(count, ropeCounters, [count]
+                                           {
+            EvalResult text = string();
+            for (int i = 0; i < count; ++i)
+            {
+                text = Rope::concat(text, piece);
+            }
+            return textOf(text)->size(); });
+        double script = nanosecondsPerAppend(count, scriptCounters, [&eva, count]
+                                             {
+            auto text = eva.eval(beg(
+                var("text", lit("")),
+                floop(var("i", lit(0)), lt(id("i"), count), inc(id("i")),
+                      set("text", add(id("text"), lit(piece)))),
+                id("text")));
+            return textOf(text)->size(); });
+
+        if (json)
+        {
+            if (copy > 0)
+            {
+                report.add("copy", count, copy * count / 1e6, copyCounters);
+            }
+            report.add("rope", count, rope * count / 1e6, ropeCounters);
+            report.add("script", count, script * count / 1e6, scriptCounters);
+        }
+        else if (copy > 0)
+        {
+            printf("%9d | %12.1f | %12.1f | %12.1f\n", count, copy, rope, script);
+        }
+        else
+        {
+            printf("%9d | %12s | %12.1f | %12.1f\n", count, "-", rope, script);
+        }
+    }
+    if (json)
+    {
+        report.print();
+    }
+    return 0;
+}
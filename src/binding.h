@@ -0,0 +1,348 @@
+#ifndef CPP_EVA_BINDING_H
+#define CPP_EVA_BINDING_H
+
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include "eval_types.h"
+#include "rope.h"
+
+/**
+ * Template machinery used to expose C++ functions to scripts as native functions.
+ *
+ * The arity and the parameter types are deduced from the signature of the bound callable and the
+ * conversions from and to EvalResult are instantiated for it at compile time. The generated callback
+ * calls the target directly: function pointers are stored in NativeFunction::target, functors and bound
+ * member functions in NativeFunction::state, so no std::function or virtual call is involved.
+ */
+namespace binding
+{
+    [[noreturn]] inline void throwArgumentMismatch(const NativeFunction &function, size_t index, const char *expected)
+    {
+        throw std::runtime_error("Function " + function.name + " expects argument " + std::to_string(index + 1) +
+                                 " to be " + expected);
+    }
+
+    /**
+     * This struct is used to convert values between C++ and EvalResult.
+     *
+     * Specializations provide from(), which extracts an argument, and to(), which wraps a return value.
+     */
+    template <typename T, typename = void>
+    struct Converter;
+
+    template <>
+    struct Converter<EvalResult>
+    {
+        static const EvalResult &from(const EvalResult &value, const NativeFunction &, size_t)
+        {
+            return value;
+        }
+
+        static EvalResult to(EvalResult value)
+        {
+            return value;
+        }
+    };
+
+    template <>
+    struct Converter<bool>
+    {
+        static bool from(const EvalResult &value, const NativeFunction &function, size_t index)
+        {
+            if (auto flag = std::get_if<bool>(&value))
+            {
+                return *flag;
+            }
+            throwArgumentMismatch(function, index, "bool");
+        }
+
+        static EvalResult to(bool value)
+        {
+            return value;
+        }
+    };
+
+    /**
+     * Integers of any width are represented as int, values that do not fit are rejected.
+     */
+    template <typename T>
+    struct Converter<T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>>>
+    {
+        static T from(const EvalResult &value, const NativeFunction &function, size_t index)
+        {
+            auto number = std::get_if<int>(&value);
+            if (!number || !fits(*number))
+            {
+                throwArgumentMismatch(function, index, "an int in range");
+            }
+            return static_cast<T>(*number);
+        }
+
+        static EvalResult to(T value)
+        {
+            if (!fits(value))
+            {
+                throw std::runtime_error("Native function returned an integer out of range");
+            }
+            return static_cast<int>(value);
+        }
+
+    private:
+        template <typename U>
+        static bool fits(U value)
+        {
+            if constexpr (std::is_signed_v<U> == std::is_signed_v<T>)
+            {
+                using Common = std::common_type_t<U, T>;
+                return static_cast<Common>(value) >= static_cast<Common>(std::numeric_limits<T>::min()) &&
+                       static_cast<Common>(value) <= static_cast<Common>(std::numeric_limits<T>::max()) &&
+                       static_cast<Common>(value) >= static_cast<Common>(std::numeric_limits<int>::min()) &&
+                       static_cast<Common>(value) <= static_cast<Common>(std::numeric_limits<int>::max());
+            }
+            else if constexpr (std::is_signed_v<U>)
+            {
+                return value >= 0 && static_cast<std::make_unsigned_t<U>>(value) <= std::numeric_limits<T>::max();
+            }
+            else
+            {
+                return value <= static_cast<std::make_unsigned_t<int>>(std::numeric_limits<int>::max()) &&
+                       static_cast<std::make_unsigned_t<int>>(value) <=
+                           static_cast<std::make_unsigned_t<T>>(std::numeric_limits<T>::max());
+            }
+        }
+    };
+
+    /**
+     * Ropes built by concatenation are flattened, so long strings convert like short ones.
+     */
+    template <>
+    struct Converter<std::string>
+    {
+        static std::string from(const EvalResult &value, const NativeFunction &function, size_t index)
+        {
+            if (auto str = textOf(value))
+            {
+                return *str;
+            }
+            throwArgumentMismatch(function, index, "string");
+        }
+
+        static EvalResult to(std::string value)
+        {
+            return value;
+        }
+    };
+
+    template <>
+    struct Converter<const char *>
+    {
+        static EvalResult to(const char *value)
+        {
+            return value ? EvalResult(std::string(value)) : EvalResult(Null{});
+        }
+    };
+
+    template <>
+    struct Converter<Null>
+    {
+        static Null from(const EvalResult &value, const NativeFunction &function, size_t index)
+        {
+            if (std::holds_alternative<Null>(value))
+            {
+                return Null{};
+            }
+            throwArgumentMismatch(function, index, "null");
+        }
+
+        static EvalResult to(Null)
+        {
+            return Null{};
+        }
+    };
+
+    /**
+     * This struct is used to deduce the signature of a callable.
+     *
+     * invoke() converts the arguments, calls the target and converts its result.
+     */
+    template <typename F>
+    struct Signature : Signature<decltype(&F::operator())>
+    {
+    };
+
+    template <typename R, typename... Args>
+    struct Signature<R (*)(Args...)>
+    {
+        static constexpr size_t arity = sizeof...(Args);
+
+        template <typename Call>
+        static EvalResult invoke(Call &&call, const NativeFunction &function, const EvalResult *args)
+        {
+            return invoke(std::forward<Call>(call), function, args, std::index_sequence_for<Args...>{});
+        }
+
+    private:
+        template <typename Call, size_t... I>
+        static EvalResult invoke(Call &&call, const NativeFunction &function, const EvalResult *args,
+                                 std::index_sequence<I...>)
+        {
+            if constexpr (std::is_void_v<R>)
+            {
+                call(Converter<std::decay_t<Args>>::from(args[I], function, I)...);
+                return Null{};
+            }
+            else
+            {
+                return Converter<std::decay_t<R>>::to(call(Converter<std::decay_t<Args>>::from(args[I], function, I)...));
+            }
+        }
+    };
+
+    template <typename R, typename... Args>
+    struct Signature<R (*)(Args...) noexcept> : Signature<R (*)(Args...)>
+    {
+    };
+
+    template <typename R, typename C, typename... Args>
+    struct Signature<R (C::*)(Args...)> : Signature<R (*)(Args...)>
+    {
+    };
+
+    template <typename R, typename C, typename... Args>
+    struct Signature<R (C::*)(Args...) const> : Signature<R (*)(Args...)>
+    {
+    };
+
+    template <typename R, typename C, typename... Args>
+    struct Signature<R (C::*)(Args...) noexcept> : Signature<R (*)(Args...)>
+    {
+    };
+
+    template <typename R, typename C, typename... Args>
+    struct Signature<R (C::*)(Args...) const noexcept> : Signature<R (*)(Args...)>
+    {
+    };
+
+    template <auto Function>
+    EvalResult callStatic(const NativeFunction &function, const EvalResult *args, size_t)
+    {
+        return Signature<decltype(Function)>::invoke(Function, function, args);
+    }
+
+    template <typename Pointer>
+    EvalResult callPointer(const NativeFunction &function, const EvalResult *args, size_t)
+    {
+        return Signature<Pointer>::invoke(reinterpret_cast<Pointer>(function.target), function, args);
+    }
+
+    template <typename F>
+    EvalResult callFunctor(const NativeFunction &function, const EvalResult *args, size_t)
+    {
+        auto &functor = *static_cast<F *>(const_cast<void *>(function.state.get()));
+        return Signature<F>::invoke(functor, function, args);
+    }
+
+    /**
+     * This struct is used to store a member function together with the object it is called on.
+     */
+    template <typename Method, typename Object>
+    struct BoundMethod
+    {
+        Method method;
+        std::shared_ptr<Object> object;
+    };
+
+    template <typename Method, typename Object>
+    EvalResult callMethod(const NativeFunction &function, const EvalResult *args, size_t)
+    {
+        const auto &bound = *static_cast<const BoundMethod<Method, Object> *>(function.state.get());
+        auto call = [&bound](auto &&...values) -> decltype(auto)
+        {
+            return ((*bound.object).*bound.method)(std::forward<decltype(values)>(values)...);
+        };
+        return Signature<Method>::invoke(call, function, args);
+    }
+
+    /**
+     * @brief Create a native function calling a function known at compile time
+     *
+     * The target is a template argument of the callback, so the call is direct and can be inlined.
+     *
+     * @param name The name of the function
+     *
+     * @return The native function
+     */
+    template <auto Function>
+    NativeFunction makeNative(std::string name)
+    {
+        return NativeFunction{std::move(name), Signature<decltype(Function)>::arity, &callStatic<Function>};
+    }
+
+    /**
+     * @brief Create a native function calling a function pointer or a functor
+     *
+     * Function pointers are stored in place, functors (e.g. capturing lambdas) are moved into the state
+     * of the native function and shared by its copies.
+     *
+     * @param name The name of the function
+     * @param function The callable
+     *
+     * @return The native function
+     */
+    template <typename Function>
+    NativeFunction makeNative(std::string name, Function &&function)
+    {
+        using F = std::decay_t<Function>;
+        if constexpr (std::is_pointer_v<F> && std::is_function_v<std::remove_pointer_t<F>>)
+        {
+            return NativeFunction{std::move(name), Signature<F>::arity, &callPointer<F>,
+                                  reinterpret_cast<void (*)()>(function)};
+        }
+        else
+        {
+            return NativeFunction{std::move(name), Signature<F>::arity, &callFunctor<F>, nullptr,
+                                  std::make_shared<F>(std::forward<Function>(function))};
+        }
+    }
+
+    /**
+     * @brief Create a native function calling a member function on an object
+     *
+     * @param name The name of the function
+     * @param method The member function
+     * @param object The object, shared with the caller
+     *
+     * @return The native function
+     */
+    template <typename Method, typename Object>
+    NativeFunction makeNative(std::string name, Method method, std::shared_ptr<Object> object)
+    {
+        static_assert(std::is_member_function_pointer_v<Method>, "method must be a member function pointer");
+        return NativeFunction{std::move(name), Signature<Method>::arity, &callMethod<Method, Object>, nullptr,
+                              std::make_shared<const BoundMethod<Method, Object>>(BoundMethod<Method, Object>{method, std::move(object)})};
+    }
+
+    /**
+     * @brief Create a native function calling a member function on an object owned by the caller
+     *
+     * The object must outlive the native function.
+     *
+     * @param name The name of the function
+     * @param method The member function
+     * @param object The object
+     *
+     * @return The native function
+     */
+    template <typename Method, typename Object>
+    NativeFunction makeNative(std::string name, Method method, Object *object)
+    {
+        return makeNative(std::move(name), method, std::shared_ptr<Object>(std::shared_ptr<Object>{}, object));
+    }
+}
+
+#endif // CPP_EVA_BINDING_H
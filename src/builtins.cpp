@@ -0,0 +1,573 @@
+#include "builtins.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <variant>
+#include <vector>
+#include "actor.h"
+#include "collections.h"
+#include "event_loop.h"
+#include "expressions.h"
+#include "generator.h"
+#include "parallel.h"
+#include "persistent.h"
+#include "rope.h"
+#include "sequence.h"
+
+using namespace std;
+
+namespace
+{
+    EvalResult print(const NativeFunction &, const EvalResult *args, size_t count)
+    {
+        string line;
+        for (size_t i = 0; i < count; ++i)
+        {
+            line += toString(args[i]);
+        }
+        cout << line << endl;
+        return Null{};
+    }
+
+    EvalResult readLine(const NativeFunction &, const EvalResult *, size_t)
+    {
+        string line;
+        if (!getline(cin, line))
+        {
+            return Null{};
+        }
+        return line;
+    }
+
+    EvalResult abs(const NativeFunction &, const EvalResult *args, size_t)
+    {
+        auto x = get<int>(args[0]);
+        // Like the arithmetic operators, the negation wraps: abs(INT_MIN) is INT_MIN
+        return x < 0 ? static_cast<int>(0u - static_cast<unsigned>(x)) : x;
+    }
+
+    EvalResult min(const NativeFunction &, const EvalResult *args, size_t)
+    {
+        return std::min(get<int>(args[0]), get<int>(args[1]));
+    }
+
+    EvalResult max(const NativeFunction &, const EvalResult *args, size_t)
+    {
+        return std::max(get<int>(args[0]), get<int>(args[1]));
+    }
+
+    EvalResult pow(const NativeFunction &, const EvalResult *args, size_t)
+    {
+        auto base = static_cast<unsigned>(get<int>(args[0]));
+        auto exponent = get<int>(args[1]);
+        if (exponent < 0)
+        {
+            throw runtime_error("pow: negative exponent");
+        }
+
+        // The products wrap at 32 bits like the arithmetic operators
+        unsigned result = 1;
+        while (exponent > 0)
+        {
+            if (exponent & 1)
+            {
+                result *= base;
+            }
+            base *= base;
+            exponent >>= 1;
+        }
+        return static_cast<int>(result);
+    }
+
+    EvalResult len(const NativeFunction &, const EvalResult *args, size_t)
+    {
+        if (auto list = get_if<ListValue>(&args[0]))
+        {
+            return static_cast<int>(list->list->size());
+        }
+        if (auto map = get_if<MapValue>(&args[0]))
+        {
+            return static_cast<int>(map->map->size());
+        }
+        if (auto vector = get_if<VectorValue>(&args[0]))
+        {
+            return static_cast<int>(vector->vector->size());
+        }
+        if (auto table = get_if<TableValue>(&args[0]))
+        {
+            return static_cast<int>(table->map->size());
+        }
+        if (auto rope = get_if<RopeValue>(&args[0]))
+        {
+            return static_cast<int>(rope->rope->size());
+        }
+        return static_cast<int>(get<string>(args[0]).size());
+    }
+
+    EvalResult push(const NativeFunction &, const EvalResult *args, size_t)
+    {
+        auto &list = *get<ListValue>(args[0]).list;
+        list.push(args[1]);
+        return static_cast<int>(list.size());
+    }
+
+    EvalResult pop(const NativeFunction &, const EvalResult *args, size_t)
+    {
+        auto &items = get<ListValue>(args[0]).list->items;
+        if (items.empty())
+        {
+            throw runtime_error("pop: empty list");
+        }
+        auto last = std::move(items.back());
+        items.pop_back();
+        return last;
+    }
+
+    EvalResult has(const NativeFunction &, const EvalResult *args, size_t)
+    {
+        if (auto table = get_if<TableValue>(&args[0]))
+        {
+            return table->map->find(args[1]) != nullptr;
+        }
+        return get<MapValue>(args[0]).map->find(args[1]) != nullptr;
+    }
+
+    EvalResult remove(const NativeFunction &, const EvalResult *args, size_t)
+    {
+        return get<MapValue>(args[0]).map->erase(args[1]);
+    }
+
+    EvalResult keys(const NativeFunction &, const EvalResult *args, size_t)
+    {
+        vector<EvalResult> result;
+        auto collect = [&result](const EvalResult &key, const EvalResult &)
+        { result.push_back(key); };
+        if (auto table = get_if<TableValue>(&args[0]))
+        {
+            table->map->forEach(collect);
+        }
+        else
+        {
+            get<MapValue>(args[0]).map->forEach(collect);
+        }
+        return List::create(std::move(result));
+    }
+
+    EvalResult makeVector(const NativeFunction &, const EvalResult *args, size_t count)
+    {
+        return PersistentVector::create(vector<EvalResult>(args, args + count));
+    }
+
+    EvalResult makeTable(const NativeFunction &, const EvalResult *args, size_t count)
+    {
+        if (count % 2 != 0)
+        {
+            throw runtime_error("table: expected keys and values");
+        }
+        auto result = PersistentMap::create();
+        for (size_t i = 0; i < count; i += 2)
+        {
+            result = result.map->assoc(args[i], args[i + 1]);
+        }
+        return result;
+    }
+
+    EvalResult assoc(const NativeFunction &, const EvalResult *args, size_t)
+    {
+        if (auto vector = get_if<VectorValue>(&args[0]))
+        {
+            return vector->vector->assoc(get<int>(args[1]), args[2]);
+        }
+        return get<TableValue>(args[0]).map->assoc(args[1], args[2]);
+    }
+
+    EvalResult dissoc(const NativeFunction &, const EvalResult *args, size_t)
+    {
+        return get<TableValue>(args[0]).map->dissoc(args[1]);
+    }
+
+    EvalResult conj(const NativeFunction &, const EvalResult *args, size_t)
+    {
+        return get<VectorValue>(args[0]).vector->push(args[1]);
+    }
+
+    EvalResult freezeValue(const NativeFunction &, const EvalResult *args, size_t)
+    {
+        return freeze(args[0]);
+    }
+
+    string quoted(const EvalResult &value)
+    {
+        auto str = textOf(value);
+        return str ? "\"" + *str + "\"" : toString(value);
+    }
+
+    EvalResult str(const NativeFunction &, const EvalResult *args, size_t)
+    {
+        return toString(args[0]);
+    }
+
+    EvalResult concat(const NativeFunction &, const EvalResult *args, size_t count)
+    {
+        string result;
+        for (size_t i = 0; i < count; ++i)
+        {
+            result += toString(args[i]);
+        }
+        return result;
+    }
+
+    EvalResult substr(const NativeFunction &, const EvalResult *args, size_t)
+    {
+        auto text = textOf(args[0]);
+        if (!text)
+        {
+            throw runtime_error("substr: expected a string");
+        }
+        const auto &s = *text;
+        auto start = get<int>(args[1]);
+        auto length = get<int>(args[2]);
+        if (start < 0 || length < 0 || static_cast<size_t>(start) > s.size())
+        {
+            throw runtime_error("substr: range out of bounds");
+        }
+        return s.substr(start, length);
+    }
+
+    /**
+     * State of a builder function: the accumulated string and the heap it was charged for.
+     */
+    struct StringBuilder
+    {
+        string text;
+        HeapAccount heap;
+
+        void append(const string &piece)
+        {
+            if (text.size() + piece.size() > text.capacity())
+            {
+                const auto grown = std::max(text.size() + piece.size(), text.capacity() * 2);
+                heap.grow(grown - text.capacity());
+                text.reserve(grown);
+            }
+            text += piece;
+        }
+    };
+
+    EvalResult append(const NativeFunction &function, const EvalResult *args, size_t count)
+    {
+        auto &builder = *static_cast<StringBuilder *>(const_cast<void *>(function.state.get()));
+        if (count == 0)
+        {
+            return builder.text;
+        }
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (auto piece = textOf(args[i]))
+            {
+                builder.append(*piece);
+            }
+            else
+            {
+                builder.append(toString(args[i]));
+            }
+        }
+        return static_cast<int>(builder.text.size());
+    }
+
+    EvalResult builder(const NativeFunction &, const EvalResult *, size_t)
+    {
+        return NativeFunction{"builder", NativeFunction::variadic, append, nullptr, make_shared<StringBuilder>()};
+    }
+
+    EventLoop &loop(const NativeFunction &function)
+    {
+        auto loop = EventLoop::current();
+        if (!loop)
+        {
+            throw runtime_error(function.name + ": no event loop is running");
+        }
+        return *loop;
+    }
+
+    const string &path(const NativeFunction &function, const EvalResult &value)
+    {
+        auto text = textOf(value);
+        if (!text)
+        {
+            throw runtime_error(function.name + ": path must be a string");
+        }
+        return *text;
+    }
+
+    EvalResult readFile(const NativeFunction &function, const EvalResult *args, size_t)
+    {
+        return loop(function).readFile(path(function, args[0]));
+    }
+
+    EvalResult writeFile(const NativeFunction &function, const EvalResult *args, size_t)
+    {
+        auto data = textOf(args[1]);
+        return loop(function).writeFile(path(function, args[0]), data ? *data : toString(args[1]));
+    }
+
+    EvalResult sleepFor(const NativeFunction &function, const EvalResult *args, size_t)
+    {
+        return loop(function).sleep(get<int>(args[0]));
+    }
+
+    EvalResult await(const NativeFunction &function, const EvalResult *args, size_t)
+    {
+        return loop(function).await(get<int>(args[0]));
+    }
+
+    Generator &generatorOf(const NativeFunction &function, const EvalResult &value)
+    {
+        auto generator = get_if<GeneratorValue>(&value);
+        if (!generator)
+        {
+            throw runtime_error(function.name + ": expected a generator");
+        }
+        return *generator->generator;
+    }
+
+    EvalResult next(const NativeFunction &function, const EvalResult *args, size_t)
+    {
+        EvalResult value = Null{};
+        void(generatorOf(function, args[0]).next(value));
+        return value;
+    }
+
+    EvalResult done(const NativeFunction &function, const EvalResult *args, size_t)
+    {
+        return generatorOf(function, args[0]).isDone();
+    }
+
+    EvalResult range(const NativeFunction &, const EvalResult *args, size_t count)
+    {
+        switch (count)
+        {
+        case 1:
+            return SequenceValue{Sequence::range(0, get<int>(args[0]))};
+        case 2:
+            return SequenceValue{Sequence::range(get<int>(args[0]), get<int>(args[1]))};
+        case 3:
+            return SequenceValue{Sequence::range(get<int>(args[0]), get<int>(args[1]), get<int>(args[2]))};
+        default:
+            throw runtime_error("range: expected end, start and end, or start, end and step");
+        }
+    }
+
+    EvalResult mapSequence(const NativeFunction &, const EvalResult *args, size_t)
+    {
+        return Sequence::of(args[0])->then({Sequence::StageKind::MAP, args[1]});
+    }
+
+    EvalResult filterSequence(const NativeFunction &, const EvalResult *args, size_t)
+    {
+        return Sequence::of(args[0])->then({Sequence::StageKind::FILTER, args[1]});
+    }
+
+    EvalResult take(const NativeFunction &, const EvalResult *args, size_t)
+    {
+        auto count = get<int>(args[1]);
+        if (count < 0)
+        {
+            throw runtime_error("take: count cannot be negative");
+        }
+        return Sequence::of(args[0])->then({Sequence::StageKind::TAKE, Null{}, static_cast<size_t>(count)});
+    }
+
+    EvalResult reduce(const NativeFunction &, const EvalResult *args, size_t)
+    {
+        auto cursor = Sequence::of(args[0])->cursor();
+        EvalResult pair[2] = {args[2], Null{}};
+        while (cursor->next(pair[1]))
+        {
+            pair[0] = AnonymousFunctionCall::invoke(args[1], pair, 2);
+        }
+        return std::move(pair[0]);
+    }
+
+    EvalResult collect(const NativeFunction &, const EvalResult *args, size_t)
+    {
+        auto cursor = Sequence::of(args[0])->cursor();
+        vector<EvalResult> items;
+        EvalResult item;
+        while (cursor->next(item))
+        {
+            items.push_back(std::move(item));
+        }
+        return List::create(std::move(items));
+    }
+
+    EvalResult pmap(const NativeFunction &, const EvalResult *args, size_t)
+    {
+        return Parallel::map(args[0], args[1]);
+    }
+
+    EvalResult preduce(const NativeFunction &, const EvalResult *args, size_t count)
+    {
+        if (count != 3 && count != 4)
+        {
+            throw runtime_error("preduce: expected items, fn and initial, and optionally combine");
+        }
+        return Parallel::reduce(args[0], args[1], args[2], count == 4 ? args[3] : Null{});
+    }
+
+    EvalResult isolated(const NativeFunction &, const EvalResult *args, size_t)
+    {
+        return Parallel::isIsolated(args[0]);
+    }
+
+    Channel &channelOf(const NativeFunction &function, const EvalResult &value)
+    {
+        auto channel = get_if<ChannelValue>(&value);
+        if (!channel)
+        {
+            throw runtime_error(function.name + ": expected a channel");
+        }
+        return *channel->channel;
+    }
+
+    EvalResult makeChannel(const NativeFunction &, const EvalResult *args, size_t)
+    {
+        auto capacity = get<int>(args[0]);
+        if (capacity <= 0)
+        {
+            throw runtime_error("channel: capacity must be positive");
+        }
+        return ChannelValue{Channel::create(static_cast<size_t>(capacity))};
+    }
+
+    EvalResult send(const NativeFunction &function, const EvalResult *args, size_t)
+    {
+        channelOf(function, args[0]).send(args[1]);
+        return args[1];
+    }
+
+    EvalResult receive(const NativeFunction &function, const EvalResult *args, size_t)
+    {
+        EvalResult value = Null{};
+        void(channelOf(function, args[0]).receive(value));
+        return value;
+    }
+
+    EvalResult closeChannel(const NativeFunction &function, const EvalResult *args, size_t)
+    {
+        channelOf(function, args[0]).close();
+        return Null{};
+    }
+
+    void add(EvalMap &map, string name, size_t arity, NativeFunction::Callback callback)
+    {
+        map.emplace(name, NativeFunction{name, arity, callback});
+    }
+}
+
+const EvalMap &builtins()
+{
+    static const EvalMap map = []
+    {
+        EvalMap map;
+        add(map, "print", NativeFunction::variadic, print);
+        add(map, "readLine", 0, readLine);
+        add(map, "abs", 1, abs);
+        add(map, "min", 2, min);
+        add(map, "max", 2, max);
+        add(map, "pow", 2, pow);
+        add(map, "len", 1, len);
+        add(map, "str", 1, str);
+        add(map, "concat", NativeFunction::variadic, concat);
+        add(map, "substr", 3, substr);
+        add(map, "push", 2, push);
+        add(map, "pop", 1, pop);
+        add(map, "has", 2, has);
+        add(map, "remove", 2, remove);
+        add(map, "keys", 1, keys);
+        add(map, "vector", NativeFunction::variadic, makeVector);
+        add(map, "table", NativeFunction::variadic, makeTable);
+        add(map, "assoc", 3, assoc);
+        add(map, "dissoc", 2, dissoc);
+        add(map, "conj", 2, conj);
+        add(map, "freeze", 1, freezeValue);
+        add(map, "builder", 0, builder);
+        add(map, "readFile", 1, readFile);
+        add(map, "writeFile", 2, writeFile);
+        add(map, "sleep", 1, sleepFor);
+        add(map, "await", 1, await);
+        add(map, "next", 1, next);
+        add(map, "done", 1, done);
+        add(map, "range", NativeFunction::variadic, range);
+        add(map, "map", 2, mapSequence);
+        add(map, "filter", 2, filterSequence);
+        add(map, "take", 2, take);
+        add(map, "reduce", 3, reduce);
+        add(map, "collect", 1, collect);
+        add(map, "pmap", 2, pmap);
+        add(map, "preduce", NativeFunction::variadic, preduce);
+        add(map, "isolated", 1, isolated);
+        add(map, "channel", 1, makeChannel);
+        add(map, "send", 2, send);
+        add(map, "receive", 1, receive);
+        add(map, "close", 1, closeChannel);
+        return map;
+    }();
+    return map;
+}
+
+std::string toString(const EvalResult &value)
+{
+    struct
+    {
+        string operator()(int x) const { return to_string(x); }
+        string operator()(const string &s) const { return s; }
+        string operator()(bool b) const { return b ? "true" : "false"; }
+        string operator()(const Null &) const { return "null"; }
+        string operator()(const FunctionDefinition &f) const { return f.name.empty() ? "<lambda>" : "<function " + f.name + ">"; }
+        string operator()(const ClassDefinition &c) const { return "<class " + c.name + ">"; }
+        string operator()(const InstanceDefinition &) const { return "<instance>"; }
+        string operator()(const NativeFunction &f) const { return "<native " + f.name + ">"; }
+        string operator()(const GeneratorValue &) const { return "<generator>"; }
+        string operator()(const SequenceValue &) const { return "<sequence>"; }
+        string operator()(const ChannelValue &) const { return "<channel>"; }
+
+        string operator()(const ListValue &l) const
+        {
+            string result = "[";
+            for (size_t i = 0; i < l.list->size(); ++i)
+            {
+                result += (i == 0 ? "" : ", ") + quoted(l.list->items[i]);
+            }
+            return result + "]";
+        }
+
+        string operator()(const MapValue &m) const
+        {
+            string result = "{";
+            m.map->forEach([&result](const EvalResult &key, const EvalResult &value)
+                           { result += (result.size() == 1 ? "" : ", ") + quoted(key) + ": " + quoted(value); });
+            return result + "}";
+        }
+
+        string operator()(const RopeValue &r) const { return r.rope->flatten(); }
+
+        string operator()(const VectorValue &v) const
+        {
+            string result = "#[";
+            v.vector->forEach([&result](const EvalResult &item)
+                              { result += (result.size() == 2 ? "" : ", ") + quoted(item); });
+            return result + "]";
+        }
+
+        string operator()(const TableValue &t) const
+        {
+            string result = "#{";
+            t.map->forEach([&result](const EvalResult &key, const EvalResult &value)
+                           { result += (result.size() == 2 ? "" : ", ") + quoted(key) + ": " + quoted(value); });
+            return result + "}";
+        }
+    } visitor;
+    return visit(visitor, value);
+}
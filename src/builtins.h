@@ -0,0 +1,54 @@
+#ifndef CPP_EVA_BUILTINS_H
+#define CPP_EVA_BUILTINS_H
+
+#include <string>
+#include "eval_types.h"
+
+/**
+ * @brief Get the native functions predefined in the global environment
+ *
+ * The builtins are:
+ * - print(args...): print the arguments followed by a new line
+ * - readLine(): read a line from the standard input, null at the end of the input
+ * - abs(x), min(a, b), max(a, b), pow(base, exponent): integer math
+ * - len(s), str(value), concat(args...), substr(s, start, length): string operations, which accept ropes
+ *   too, len also counts collections
+ * - push(list, value), pop(list): add or remove the last item of a list
+ * - has(map, key), remove(map, key), keys(map): key operations of maps, has and keys also accept tables
+ * - vector(items...), table(key, value, ...), freeze(value): create persistent vectors and tables
+ * - assoc(collection, key, value), dissoc(table, key), conj(vector, value): updated copies of persistent values
+ * - builder(): a function accumulating a string; called with arguments it appends them and returns the length,
+ *   called without arguments it returns the string
+ * - readFile(path), writeFile(path, text), sleep(milliseconds): start an operation on the running EventLoop and
+ *   return its id
+ * - await(id): suspend the script until the operation has completed and return its result
+ * - next(generator): run a generator to its next yield and return the value, null once it has finished
+ * - done(generator): whether a generator has finished
+ * - range(end), range(start, end), range(start, end, step): the lazy sequence of the integers up to end
+ * - map(items, fn), filter(items, fn), take(items, n): lazy sequences over a list, map, vector, table, generator
+ *   or sequence; chained stages run fused, in a single pass over the source
+ * - reduce(items, fn, initial): fold the items with fn(accumulator, item)
+ * - collect(items): a list of the items
+ * - pmap(items, fn), preduce(items, fn, initial), preduce(items, fn, initial, combine): map and reduce on the
+ *   threads of the process, for isolated functions; the folds of the chunks start from initial, which must be
+ *   an identity, and are combined with combine, or with fn, which then must be associative
+ * - isolated(fn): whether a function can be called from several threads at once
+ * - channel(capacity): a bounded channel to another interpreter, see Actor
+ * - send(channel, value): send a copy of the value, waiting while the channel is full; returns the value
+ * - receive(channel): the next value, waiting while the channel is empty; null once it is closed and drained
+ * - close(channel): tell the receivers nothing more will be sent; channels are iterable until closed
+ *
+ * @return The map of builtin names to native functions
+ */
+const EvalMap &builtins();
+
+/**
+ * @brief Convert a value to its printable representation
+ *
+ * @param value The value to convert
+ *
+ * @return The string representation of the value
+ */
+std::string toString(const EvalResult &value);
+
+#endif // CPP_EVA_BUILTINS_H
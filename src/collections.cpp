@@ -0,0 +1,382 @@
+#include "collections.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <variant>
+#include "persistent.h"
+#include "rope.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+namespace
+{
+    constexpr size_t npos = SIZE_MAX;
+
+    size_t mix(uint64_t x)
+    {
+        // Finalizer of splitmix64: spreads every input bit over the whole hash
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ULL;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebULL;
+        x ^= x >> 31;
+        return static_cast<size_t>(x);
+    }
+
+    size_t combine(size_t seed, size_t hash)
+    {
+        return mix(seed ^ (hash + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2)));
+    }
+
+    size_t hashPointer(const void *pointer)
+    {
+        return mix(reinterpret_cast<uintptr_t>(pointer));
+    }
+
+    /**
+     * Bit mask of the slots of a group whose control byte equals the given byte.
+     */
+    uint32_t match(const int8_t *group, int8_t byte)
+    {
+#ifdef __SSE2__
+        auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(group));
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(byte))));
+#else
+        uint32_t mask = 0;
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            mask |= uint32_t(group[i] == byte) << i;
+        }
+        return mask;
+#endif
+    }
+
+    int lowestBit(uint32_t mask)
+    {
+        return __builtin_ctz(mask);
+    }
+}
+
+size_t hashValue(const EvalResult &value)
+{
+    struct
+    {
+        size_t operator()(int x) const { return mix(static_cast<uint32_t>(x)); }
+        size_t operator()(const string &s) const { return mix(hash<string>{}(s)); }
+        size_t operator()(bool b) const { return mix(b ? 0x51 : 0x50); }
+        size_t operator()(const Null &) const { return mix(0x4e); }
+        size_t operator()(const FunctionDefinition &f) const { return combine(hashPointer(f.body.get()), hashPointer(f.env.get())); }
+        size_t operator()(const ClassDefinition &c) const { return hashPointer(c.env.get()); }
+        size_t operator()(const InstanceDefinition &i) const { return hashPointer(i.env.get()); }
+        size_t operator()(const NativeFunction &f) const { return combine(mix(hash<string>{}(f.name)), hashPointer(f.state.get())); }
+        size_t operator()(const GeneratorValue &g) const { return hashPointer(g.generator.get()); }
+        size_t operator()(const SequenceValue &s) const { return hashPointer(s.sequence.get()); }
+        size_t operator()(const ChannelValue &c) const { return hashPointer(c.channel.get()); }
+
+        size_t operator()(const ListValue &l) const
+        {
+            size_t result = mix(l.list->size());
+            for (const auto &item : l.list->items)
+            {
+                result = combine(result, hashValue(item));
+            }
+            return result;
+        }
+
+        size_t operator()(const MapValue &m) const
+        {
+            // Entries are combined with a commutative operation, so the hash does not depend on the slot order
+            size_t result = mix(m.map->size());
+            m.map->forEach([&result](const EvalResult &key, const EvalResult &value)
+                           { result += combine(hashValue(key), hashValue(value)); });
+            return result;
+        }
+
+        size_t operator()(const VectorValue &v) const
+        {
+            size_t result = mix(v.vector->size());
+            v.vector->forEach([&result](const EvalResult &item)
+                              { result = combine(result, hashValue(item)); });
+            return result;
+        }
+
+        size_t operator()(const TableValue &t) const
+        {
+            size_t result = mix(t.map->size());
+            t.map->forEach([&result](const EvalResult &key, const EvalResult &value)
+                           { result += combine(hashValue(key), hashValue(value)); });
+            return result;
+        }
+
+        size_t operator()(const RopeValue &r) const { return (*this)(r.rope->flatten()); }
+    } visitor;
+    // Ropes hash like strings
+    auto index = holds_alternative<RopeValue>(value) ? EvalResult(in_place_type<string>).index() : value.index();
+    return std::visit(visitor, value) + index;
+}
+
+bool equalValues(const EvalResult &a, const EvalResult &b)
+{
+    if (holds_alternative<RopeValue>(a) || holds_alternative<RopeValue>(b))
+    {
+        auto x = textOf(a);
+        auto y = textOf(b);
+        return x && y && *x == *y;
+    }
+    if (a.index() != b.index())
+    {
+        return false;
+    }
+
+    struct
+    {
+        const EvalResult &other;
+
+        bool operator()(int x) const { return x == get<int>(other); }
+        bool operator()(const string &s) const { return s == get<string>(other); }
+        bool operator()(bool b) const { return b == get<bool>(other); }
+        bool operator()(const Null &) const { return true; }
+
+        bool operator()(const FunctionDefinition &f) const
+        {
+            const auto &g = get<FunctionDefinition>(other);
+            return f.body == g.body && f.env == g.env;
+        }
+
+        bool operator()(const ClassDefinition &c) const { return c.env == get<ClassDefinition>(other).env; }
+        bool operator()(const InstanceDefinition &i) const { return i.env == get<InstanceDefinition>(other).env; }
+        bool operator()(const GeneratorValue &g) const { return g.generator == get<GeneratorValue>(other).generator; }
+        bool operator()(const SequenceValue &s) const { return s.sequence == get<SequenceValue>(other).sequence; }
+        bool operator()(const ChannelValue &c) const { return c.channel == get<ChannelValue>(other).channel; }
+
+        bool operator()(const NativeFunction &f) const
+        {
+            const auto &g = get<NativeFunction>(other);
+            return f.name == g.name && f.callback == g.callback && f.target == g.target && f.state == g.state;
+        }
+
+        bool operator()(const ListValue &l) const
+        {
+            const auto &m = get<ListValue>(other);
+            if (l.list == m.list)
+            {
+                return true;
+            }
+            if (l.list->size() != m.list->size())
+            {
+                return false;
+            }
+            for (size_t i = 0; i < l.list->size(); ++i)
+            {
+                if (!equalValues(l.list->items[i], m.list->items[i]))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        bool operator()(const MapValue &m) const
+        {
+            const auto &n = get<MapValue>(other);
+            if (m.map == n.map)
+            {
+                return true;
+            }
+            if (m.map->size() != n.map->size())
+            {
+                return false;
+            }
+            bool equal = true;
+            m.map->forEach([&](const EvalResult &key, const EvalResult &value)
+                           {
+                auto found = n.map->find(key);
+                equal = equal && found && equalValues(value, *found); });
+            return equal;
+        }
+
+        bool operator()(const VectorValue &v) const
+        {
+            const auto &w = get<VectorValue>(other);
+            if (v.vector == w.vector)
+            {
+                return true;
+            }
+            if (v.vector->size() != w.vector->size())
+            {
+                return false;
+            }
+            int index = 0;
+            bool equal = true;
+            v.vector->forEach([&](const EvalResult &item)
+                              { equal = equal && equalValues(item, w.vector->at(index++)); });
+            return equal;
+        }
+
+        bool operator()(const TableValue &t) const
+        {
+            const auto &u = get<TableValue>(other);
+            if (t.map == u.map)
+            {
+                return true;
+            }
+            if (t.map->size() != u.map->size())
+            {
+                return false;
+            }
+            bool equal = true;
+            t.map->forEach([&](const EvalResult &key, const EvalResult &value)
+                           {
+                auto found = u.map->find(key);
+                equal = equal && found && equalValues(value, *found); });
+            return equal;
+        }
+
+        bool operator()(const RopeValue &) const { return false; }
+    } visitor{b};
+    return std::visit(visitor, a);
+}
+
+EvalResult &List::at(int index)
+{
+    if (index < 0 || static_cast<size_t>(index) >= items.size())
+    {
+        throw out_of_range("List index " + to_string(index) + " out of range");
+    }
+    return items[index];
+}
+
+void List::push(EvalResult item)
+{
+    if (items.size() == items.capacity())
+    {
+        const auto grown = max<size_t>(items.capacity() * 2, 4);
+        heap.grow((grown - items.capacity()) * sizeof(EvalResult));
+        items.reserve(grown);
+    }
+    items.push_back(std::move(item));
+}
+
+EvalResult *HashMap::find(const EvalResult &key)
+{
+    if (count == 0)
+    {
+        return nullptr;
+    }
+    auto slot = locate(key, hashValue(key));
+    return slot == npos ? nullptr : &slots[slot].value;
+}
+
+size_t HashMap::locate(const EvalResult &key, size_t hash) const
+{
+    const auto tag = static_cast<int8_t>(hash & 0x7F);
+    const size_t groupMask = capacity / groupSize - 1;
+
+    size_t group = (hash >> 7) & groupMask;
+    for (size_t step = 1;; group = (group + step++) & groupMask)
+    {
+        const auto *bytes = control.get() + group * groupSize;
+        for (auto candidates = match(bytes, tag); candidates != 0; candidates &= candidates - 1)
+        {
+            auto slot = group * groupSize + lowestBit(candidates);
+            if (equalValues(slots[slot].key, key))
+            {
+                return slot;
+            }
+        }
+        if (match(bytes, empty) != 0)
+        {
+            return npos;
+        }
+    }
+}
+
+EvalResult &HashMap::assign(const EvalResult &key, EvalResult value)
+{
+    const auto hash = hashValue(key);
+    if (count > 0)
+    {
+        auto slot = locate(key, hash);
+        if (slot != npos)
+        {
+            return slots[slot].value = std::move(value);
+        }
+    }
+
+    if ((count + tombstones + 1) * 8 > capacity * 7)
+    {
+        // Tables full of tombstones are cleaned up without growing
+        rehash(count * 2 + 2 > capacity ? max(capacity * 2, groupSize) : capacity);
+    }
+
+    const size_t groupMask = capacity / groupSize - 1;
+    size_t group = (hash >> 7) & groupMask;
+    for (size_t step = 1;; group = (group + step++) & groupMask)
+    {
+        const auto *bytes = control.get() + group * groupSize;
+        auto free = match(bytes, empty) | match(bytes, deleted);
+        if (free != 0)
+        {
+            auto slot = group * groupSize + lowestBit(free);
+            tombstones -= control[slot] == deleted;
+            control[slot] = static_cast<int8_t>(hash & 0x7F);
+            slots[slot] = Entry{key, std::move(value)};
+            ++count;
+            return slots[slot].value;
+        }
+    }
+}
+
+bool HashMap::erase(const EvalResult &key)
+{
+    if (count == 0)
+    {
+        return false;
+    }
+
+    auto slot = locate(key, hashValue(key));
+    if (slot == npos)
+    {
+        return false;
+    }
+
+    control[slot] = deleted;
+    slots[slot] = Entry{Null{}, Null{}};
+    --count;
+    ++tombstones;
+    return true;
+}
+
+void HashMap::rehash(size_t newCapacity)
+{
+    if (newCapacity > capacity)
+    {
+        heap.grow((newCapacity - capacity) * (sizeof(Entry) + sizeof(int8_t)));
+    }
+
+    auto oldControl = std::move(control);
+    auto oldSlots = std::move(slots);
+    auto oldCapacity = capacity;
+
+    control = make_unique<int8_t[]>(newCapacity);
+    memset(control.get(), empty, newCapacity);
+    slots = make_unique<Entry[]>(newCapacity);
+    capacity = newCapacity;
+    count = 0;
+    tombstones = 0;
+
+    for (size_t i = 0; i < oldCapacity; ++i)
+    {
+        if (oldControl[i] >= 0)
+        {
+            assign(oldSlots[i].key, std::move(oldSlots[i].value));
+        }
+    }
+}
@@ -0,0 +1,191 @@
+#ifndef CPP_EVA_COLLECTIONS_H
+#define CPP_EVA_COLLECTIONS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "eval_types.h"
+#include "governor.h"
+
+/**
+ * @brief Hash a value structurally
+ *
+ * Scalars, strings and ropes are hashed by value, collections by their contents, functions, classes and instances
+ * by identity. Values that are equal according to equalValues have the same hash.
+ *
+ * @param value The value to hash
+ *
+ * @return The hash of the value
+ */
+size_t hashValue(const EvalResult &value);
+
+/**
+ * @brief Compare two values structurally
+ *
+ * Values of different types are never equal, except strings and ropes with the same characters. Lists and vectors are equal if their items are, maps and tables
+ * if they hold the same keys with equal values. Collections that contain themselves are not supported.
+ *
+ * @param a The first value
+ * @param b The second value
+ *
+ * @return true if the values are equal
+ */
+bool equalValues(const EvalResult &a, const EvalResult &b);
+
+/**
+ * This class is used to store the items of a list value contiguously.
+ *
+ * The storage of the items is charged to the resource governor when it is allocated or grows.
+ */
+class List
+{
+public:
+    static ListValue create(std::vector<EvalResult> items = {})
+    {
+        return ListValue{std::make_shared<List>(std::move(items))};
+    }
+
+    explicit List(std::vector<EvalResult> items) : items(std::move(items))
+    {
+        heap.grow(this->items.capacity() * sizeof(EvalResult));
+    }
+
+    /**
+     * @brief Append an item
+     *
+     * @throw EvaluationAborted if growing the storage exceeds the heap limit
+     */
+    void push(EvalResult item);
+
+    /**
+     * @brief Get the item at an index
+     *
+     * @throw std::out_of_range if the index is out of range
+     */
+    EvalResult &at(int index);
+
+    [[nodiscard]] size_t size() const
+    {
+        return items.size();
+    }
+
+    std::vector<EvalResult> items;
+
+private:
+    HeapAccount heap;
+};
+
+/**
+ * This class is used to store the entries of a map value in a Swiss table.
+ *
+ * Entries live in a flat array of slots, split into groups of 16. Every slot has a control byte: EMPTY,
+ * DELETED, or the low 7 bits of the hash of its key. A lookup compares the control bytes of a whole group
+ * with the hash at once (with SSE2 when available) and only compares keys whose bytes match, so probing
+ * touches one cache line of control bytes per group. Groups are probed triangularly and the table grows
+ * past a load factor of 7/8. Growing the table charges the new slots to the resource governor.
+ */
+class HashMap
+{
+public:
+    struct Entry
+    {
+        EvalResult key;
+        EvalResult value;
+    };
+
+    static MapValue create()
+    {
+        return MapValue{std::make_shared<HashMap>()};
+    }
+
+    HashMap() = default;
+
+    HashMap(const HashMap &) = delete;
+    HashMap &operator=(const HashMap &) = delete;
+
+    /**
+     * @brief Find the value of a key
+     *
+     * @return A pointer to the value, nullptr if the key is not in the map
+     */
+    EvalResult *find(const EvalResult &key);
+
+    const EvalResult *find(const EvalResult &key) const
+    {
+        return const_cast<HashMap *>(this)->find(key);
+    }
+
+    /**
+     * @brief Set the value of a key, adding the key if needed
+     *
+     * @return The stored value
+     */
+    EvalResult &assign(const EvalResult &key, EvalResult value);
+
+    /**
+     * @brief Remove a key
+     *
+     * @return true if the key was in the map
+     */
+    bool erase(const EvalResult &key);
+
+    [[nodiscard]] size_t size() const
+    {
+        return count;
+    }
+
+    /**
+     * @brief Call a function with the key and the value of every entry, in slot order
+     */
+    template <typename Function>
+    void forEach(Function &&function) const
+    {
+        for (size_t i = 0; i < capacity; ++i)
+        {
+            if (control[i] >= 0)
+            {
+                function(slots[i].key, slots[i].value);
+            }
+        }
+    }
+
+    /**
+     * @brief Find the first entry at or after a slot, for iterating without a callback
+     *
+     * Entries added while iterating may be skipped or seen twice.
+     *
+     * @param slot The slot to start at, set to the slot of the entry
+     *
+     * @return The entry, nullptr if there is none
+     */
+    const Entry *findEntry(size_t &slot) const
+    {
+        for (; slot < capacity; ++slot)
+        {
+            if (control[slot] >= 0)
+            {
+                return &slots[slot];
+            }
+        }
+        return nullptr;
+    }
+
+private:
+    static constexpr size_t groupSize = 16;
+    static constexpr int8_t empty = -128;
+    static constexpr int8_t deleted = -2;
+
+    size_t locate(const EvalResult &key, size_t hash) const;
+
+    void rehash(size_t newCapacity);
+
+    std::unique_ptr<int8_t[]> control;
+    std::unique_ptr<Entry[]> slots;
+    size_t capacity = 0;
+    size_t count = 0;
+    size_t tombstones = 0;
+    HeapAccount heap;
+};
+
+#endif // CPP_EVA_COLLECTIONS_H
@@ -1,37 +1,167 @@
 #include "environment.h"
 
+#include <algorithm>
 #include <utility>
+#include <stdexcept>
+#include "governor.h"
 
 using namespace std;
 
+namespace
+{
+    /**
+     * Approximate heap footprint of a value held by a variable, beyond the variable itself.
+     */
+    size_t valueBytes(const EvalResult &value)
+    {
+        auto str = get_if<string>(&value);
+        return str ? str->size() : 0;
+    }
+
+    /**
+     * Approximate heap footprint of a variable stored in an environment.
+     */
+    size_t footprint(const string &name, const EvalResult &value)
+    {
+        return sizeof(Variable) + name.size() + valueBytes(value);
+    }
+}
+
+Environment::Environment(EvalMap vars, std::shared_ptr<Environment> parent)
+    : vars(std::move(vars)), parent(std::move(parent))
+{
+    if (ResourceGovernor::current())
+    {
+        size_t bytes = sizeof(Environment);
+        for (const auto &variable : this->vars)
+        {
+            bytes += footprint(variable.name, variable.value);
+        }
+        account(bytes);
+    }
+}
+
+Environment::~Environment()
+{
+    if (governorId != 0)
+    {
+        ResourceGovernor::release(governorId, charged);
+    }
+}
+
+void Environment::account(size_t bytes)
+{
+    auto id = ResourceGovernor::charge(bytes);
+    if (governorId == 0 && charged == 0)
+    {
+        governorId = id;
+    }
+    if (id != 0 && id == governorId)
+    {
+        charged += bytes;
+    }
+}
+
 void Environment::define(const std::string &name, EvalResult value)
 {
-    vars[name] = std::move(value);
+    if (auto slot = vars.find(name))
+    {
+        *slot = std::move(value);
+        return;
+    }
+
+    if (ResourceGovernor::current())
+    {
+        account(footprint(name, value));
+    }
+    vars.insert(name, std::move(value));
 }
 
 EvalResult Environment::lookup(const std::string &name) const
 {
-    return resolve(name).at(name);
+    return resolve(name);
 }
 
 EvalResult Environment::assign(const string &name, EvalResult value)
 {
-    return resolve(name)[name] = std::move(value);
+    if (!ResourceGovernor::current())
+    {
+        return resolve(name) = std::move(value);
+    }
+
+    for (auto env = this; env != nullptr; env = env->parent.get())
+    {
+        if (auto slot = env->vars.find(name))
+        {
+            // Only the difference is charged, the variable itself was charged when it was defined
+            const auto oldBytes = valueBytes(*slot);
+            const auto newBytes = valueBytes(value);
+            if (newBytes > oldBytes)
+            {
+                env->account(newBytes - oldBytes);
+            }
+            else if (oldBytes > newBytes && env->governorId != 0)
+            {
+                const auto released = min(oldBytes - newBytes, env->charged);
+                ResourceGovernor::release(env->governorId, released);
+                env->charged -= released;
+            }
+            return *slot = std::move(value);
+        }
+    }
+    throw std::runtime_error("Undefined variable: " + name);
 }
 
-EvalMap &Environment::resolve(const string &name)
+EvalResult &Environment::resolve(const string &name)
 {
-    auto it = vars.find(name);
-    if (it != vars.end())
+    for (auto env = this; env != nullptr; env = env->parent.get())
     {
-        return vars;
+        if (auto slot = env->vars.find(name))
+        {
+            return *slot;
+        }
     }
-    else if (parent != nullptr)
+    throw std::runtime_error("Undefined variable: " + name);
+}
+
+Environment *Environment::owner(const std::string &name)
+{
+    for (auto env = this; env != nullptr; env = env->parent.get())
     {
-        return parent->resolve(name);
+        if (env->vars.findVariable(name))
+        {
+            return env;
+        }
     }
-    else
+    return nullptr;
+}
+
+std::shared_ptr<EvalResult> Environment::capture(const std::string &name)
+{
+    auto variable = vars.findVariable(name);
+    if (!variable)
     {
         throw std::runtime_error("Undefined variable: " + name);
     }
+    if (!variable->cell)
+    {
+        variable->cell = make_shared<EvalResult>(std::move(variable->value));
+        variable->value = Null{};
+    }
+    return variable->cell;
+}
+
+void Environment::share(const std::string &name, std::shared_ptr<EvalResult> cell)
+{
+    if (auto variable = vars.findVariable(name))
+    {
+        variable->cell = std::move(cell);
+        return;
+    }
+
+    if (ResourceGovernor::current())
+    {
+        account(footprint(name, Null{}));
+    }
+    vars.insertCell(name, std::move(cell));
 }
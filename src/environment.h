@@ -6,17 +6,23 @@
 #include <memory>
 #include <exception>
 #include "eval_types.h"
+#include "variable_table.h"
 
 /**
  * This class is used to represent an environment
  *
  * The environment is used to store variables and their values.
+ * Variables are kept in a VariableTable, a flat array searched linearly in small scopes.
  */
 class Environment
 {
 public:
-    explicit Environment(EvalMap vars, std::shared_ptr<Environment> parent = nullptr)
-        : vars(std::move(vars)), parent(parent) {}
+    explicit Environment(EvalMap vars, std::shared_ptr<Environment> parent = nullptr);
+
+    ~Environment();
+
+    Environment(const Environment &) = delete;
+    Environment &operator=(const Environment &) = delete;
 
     /**
      * @brief Define a variable in the environment
@@ -53,16 +59,75 @@ public:
      */
     EvalResult lookup(const std::string &name) const;
 
-private:
-    const EvalMap &resolve(const std::string &name) const
+    /**
+     * @brief Find the environment of the chain that defines a variable
+     *
+     * @param name The name of the variable
+     *
+     * @return The environment, nullptr if the variable is not defined
+     */
+    Environment *owner(const std::string &name);
+
+    /**
+     * @brief Move a variable of this environment to a cell that can be shared with a closure
+     *
+     * Both environments read and write the value through the cell afterwards.
+     *
+     * @param name The name of the variable
+     *
+     * @return The cell of the variable
+     *
+     * @throw std::runtime_error if the variable is not defined in this environment
+     */
+    std::shared_ptr<EvalResult> capture(const std::string &name);
+
+    /**
+     * @brief Define a variable whose value is stored in a cell shared with another environment
+     *
+     * @param name The name of the variable
+     * @param cell The cell returned by capture
+     */
+    void share(const std::string &name, std::shared_ptr<EvalResult> cell);
+
+    /**
+     * @brief Find the value of a variable in the environment chain, to read or update it in place
+     *
+     * The reference is invalidated when a variable is defined in the environment that holds it.
+     *
+     * @param name The name of the variable
+     *
+     * @return The value of the variable
+     *
+     * @throw std::runtime_error if the variable is not defined
+     */
+    EvalResult &resolve(const std::string &name);
+
+    const EvalResult &resolve(const std::string &name) const
     {
         return const_cast<Environment *>(this)->resolve(name);
     }
 
-    EvalMap &resolve(const std::string &name);
+    [[nodiscard]] const VariableTable &getVariables() const
+    {
+        return vars;
+    }
+
+    [[nodiscard]] const std::shared_ptr<Environment> &getParent() const
+    {
+        return parent;
+    }
+
+private:
+    friend class FramePool;
 
-    EvalMap vars;
+    void account(size_t bytes);
+
+    VariableTable vars;
     std::shared_ptr<Environment> parent;
+
+    // Heap bytes charged to the resource governor that was active when the environment was created
+    uint64_t governorId = 0;
+    size_t charged = 0;
 };
 
 #endif // CPP_EVA_ENVIRONMENT_H
@@ -1,4 +1,5 @@
 #include "eva.h"
+#include "superinstructions.h"
 #include <vector>
 #include <string>
 #include <sstream>
@@ -37,8 +38,96 @@ EvalResult Eva::eval(ExpressionPtr exp, std::shared_ptr<Environment> env)
     return Null{};
 }
 
+EvalResult Eva::eval(const Expression &exp, std::shared_ptr<Environment> env)
+{
+    try
+    {
+        return exp.eval(env ? env : global);
+    }
+    catch (const std::exception &e)
+    {
+        cerr << "Error evaluating expression: " << endl
+             << "- " << e.what() << endl;
+    }
+    return Null{};
+}
+
+EvalResult Eva::eval(ExpressionPtr exp, const EvalLimits &limits, std::shared_ptr<Environment> env)
+{
+    ResourceGovernor governor(limits);
+    try
+    {
+        return _eval(std::move(exp), env);
+    }
+    catch (const EvaluationAborted &)
+    {
+        throw;
+    }
+    catch (const std::exception &e)
+    {
+        cerr << "Error evaluating expression: " << endl
+             << "- " << e.what() << endl;
+    }
+    return Null{};
+}
+
+EvalResult Eva::eval(ExpressionPtr exp, PerfProfile &profile, std::shared_ptr<Environment> env)
+{
+    PerfProfiler profiler(profile);
+    return eval(std::move(exp), std::move(env));
+}
+
+EvalResult Eva::eval(const NativeModule &module, size_t entry, std::shared_ptr<Environment> env)
+{
+    try
+    {
+        return module.run(entry, env ? env : global);
+    }
+    catch (const std::exception &e)
+    {
+        cerr << "Error evaluating expression: " << endl
+             << "- " << e.what() << endl;
+    }
+    return Null{};
+}
+
+EvalResult Eva::eval(const TaggedTree &tree, std::shared_ptr<Environment> env)
+{
+    try
+    {
+        return tree.eval(env ? env : global);
+    }
+    catch (const std::exception &e)
+    {
+        cerr << "Error evaluating expression: " << endl
+             << "- " << e.what() << endl;
+    }
+    return Null{};
+}
+
+void Eva::spawn(ExpressionPtr exp, std::shared_ptr<Environment> env)
+{
+    if (!loop)
+    {
+        loop = make_unique<EventLoop>();
+    }
+    // std::function needs a copyable target, the expression is moved out when the task starts
+    auto program = make_shared<ExpressionPtr>(std::move(exp));
+    loop->spawn([this, program, env]
+                { return eval(std::move(*program), env); });
+}
+
+std::vector<EvalResult> Eva::run()
+{
+    return loop ? loop->run() : vector<EvalResult>{};
+}
+
 EvalResult Eva::_eval(ExpressionPtr exp, std::shared_ptr<Environment> env)
 {
+    if (fusing)
+    {
+        exp = Superinstructions::fuse(std::move(exp));
+    }
     return exp->eval(env ? env : global);
     /*
         // Variable update: (set foo 10)
@@ -47,3 +136,12 @@ EvalResult Eva::_eval(ExpressionPtr exp, std::shared_ptr<Environment> env)
         }
     */
 }
+
+void Eva::defineBinding(const std::string &name, EvalResult function)
+{
+    if (global->getVariables().find(name))
+    {
+        throw runtime_error("Cannot bind " + name + ": the name is already defined");
+    }
+    global->define(name, std::move(function));
+}
@@ -11,44 +11,61 @@
 #include "expressions.h"
 #include "eval_types.h"
 #include "environment.h"
+#include "governor.h"
+#include "perf_counters.h"
+#include "builtins.h"
+#include "event_loop.h"
+#include "binding.h"
+#include "transpiler.h"
+#include "tagged_tree.h"
 
 using namespace std::string_literals;
 
 /**
- * Global environment with predefined values.
+ * @brief Get the predefined values and builtin functions every interpreter starts from
  */
-const auto globalEnv = std::make_shared<Environment>(EvalMap{
-    {"VERSION", "0.1"s},
-    {"null", Null{}},
-    {"true", true},
-    {"false", false},
-    //        {"print", std::make_unique<Expression>())
-    //        {"var", std::make_unique<Var>()},
-    //        {"set", std::make_unique<Set>()},
-    //        {"id", std::make_unique<Id>()},
-    //        {"if", std::make_unique<If>()},
-    //        {"loop", std::make_unique<Loop>()},
-    //        {"+", std::make_unique<BinaryOperation>("+")},
-    //        {"-", std::make_unique<BinaryOperation>("-")},
-    //        {"*", std::make_unique<BinaryOperation>("*")},
-    //        {"/", std::make_unique<BinaryOperation>("/")},
-    //        {">", std::make_unique<BinaryOperation>(">")},
-    //        {"<", std::make_unique<BinaryOperation}("<")},
-    //        {"=", std::make_unique<BinaryOperation>("=")},
-    //        {"block", std::make_unique<Block>()},
-    //        {"condition", std::make_unique<Condition>()},
-    //        {"literal", std::make_unique<Literal>()},
-    //        {"identifier", std::make_unique<Identifier>()},
-    //        {"variable_declaration", std::make_unique<VariableDeclaration>()},
-    //        {"assignment", std::make_unique<Assignment>()},
-    //        {"function", std::make_unique<FunctionDefinition>()},
-    //        {"call", std::make_unique<Call>()},
-    //        {"return", std::make_unique<Return>()},
-    //        {"lambda", std::make_unique<Lambda>()},
-    //        {"parameter", std::make_unique<Parameter>()},
-    //        {"arguments", std::make_unique<Arguments>()},
-    //        {"program", std::make_unique<Program>()}
-});
+inline EvalMap globalVariables()
+{
+    EvalMap variables{
+        {"VERSION", "0.1"s},
+        {"null", Null{}},
+        {"true", true},
+        {"false", false},
+        //        {"print", std::make_unique<Expression>())
+        //        {"var", std::make_unique<Var>()},
+        //        {"set", std::make_unique<Set>()},
+        //        {"id", std::make_unique<Id>()},
+        //        {"if", std::make_unique<If>()},
+        //        {"loop", std::make_unique<Loop>()},
+        //        {"+", std::make_unique<BinaryOperation>("+")},
+        //        {"-", std::make_unique<BinaryOperation>("-")},
+        //        {"*", std::make_unique<BinaryOperation>("*")},
+        //        {"/", std::make_unique<BinaryOperation>("/")},
+        //        {">", std::make_unique<BinaryOperation>(">")},
+        //        {"<", std::make_unique<BinaryOperation}("<")},
+        //        {"=", std::make_unique<BinaryOperation>("=")},
+        //        {"block", std::make_unique<Block>()},
+        //        {"condition", std::make_unique<Condition>()},
+        //        {"literal", std::make_unique<Literal>()},
+        //        {"identifier", std::make_unique<Identifier>()},
+        //        {"variable_declaration", std::make_unique<VariableDeclaration>()},
+        //        {"assignment", std::make_unique<Assignment>()},
+        //        {"function", std::make_unique<FunctionDefinition>()},
+        //        {"call", std::make_unique<Call>()},
+        //        {"return", std::make_unique<Return>()},
+        //        {"lambda", std::make_unique<Lambda>()},
+        //        {"parameter", std::make_unique<Parameter>()},
+        //        {"arguments", std::make_unique<Arguments>()},
+        //        {"program", std::make_unique<Program>()}
+    };
+    variables.insert(builtins().begin(), builtins().end());
+    return variables;
+}
+
+/**
+ * Global environment with predefined values and builtin functions.
+ */
+const auto globalEnv = std::make_shared<Environment>(globalVariables());
 
 /**
  * Class of Eva language interpreter.
@@ -84,9 +101,167 @@ public:
      */
     EvalResult eval(ExpressionPtr exp, std::shared_ptr<Environment> env = nullptr);
 
+    /**
+     * @brief Evaluate an expression owned by the caller
+     *
+     * Evaluation only reads the tree, so one program can be evaluated any number of times and by
+     * interpreters on different threads at once.
+     *
+     * @param exp The expression to evaluate
+     * @param env The environment to evaluate the expression in
+     *
+     * @return The result of the evaluation
+     */
+    EvalResult eval(const Expression &exp, std::shared_ptr<Environment> env = nullptr);
+
+    /**
+     * @brief Evaluate the expression within an execution budget
+     *
+     * Loops and calls are safepoints: each one consumes a unit of fuel and polls the cancel flag.
+     *
+     * @param exp The expression to evaluate
+     * @param limits The fuel, heap and cancellation limits of the evaluation
+     * @param env The environment to evaluate the expression in
+     *
+     * @return The result of the evaluation
+     *
+     * @throw EvaluationAborted if any of the limits is exceeded
+     */
+    EvalResult eval(ExpressionPtr exp, const EvalLimits &limits, std::shared_ptr<Environment> env = nullptr);
+
+    /**
+     * @brief Evaluate the expression and count the processor events it causes
+     *
+     * The counts of the evaluation are added to the profile, and with perFunction set the self counts of
+     * every function it calls too. Events the machine cannot count are left without a value.
+     *
+     * @param exp The expression to evaluate
+     * @param profile The profile the counts are added to
+     * @param env The environment to evaluate the expression in
+     *
+     * @return The result of the evaluation
+     */
+    EvalResult eval(ExpressionPtr exp, PerfProfile &profile, std::shared_ptr<Environment> env = nullptr);
+
+    /**
+     * @brief Run a program compiled ahead of time by the Transpiler
+     *
+     * @param module The loaded native module
+     * @param entry The index of the program in the module
+     * @param env The environment to run the program in
+     *
+     * @return The result of the program
+     */
+    EvalResult eval(const NativeModule &module, size_t entry = 0, std::shared_ptr<Environment> env = nullptr);
+
+    /**
+     * @brief Evaluate a program lowered into a tagged tree
+     *
+     * @param tree The tree
+     * @param env The environment to evaluate the program in
+     *
+     * @return The result of the program
+     */
+    EvalResult eval(const TaggedTree &tree, std::shared_ptr<Environment> env = nullptr);
+
+    /**
+     * @brief Expose a C++ function pointer, lambda or functor to scripts
+     *
+     * The arity and the argument conversions are deduced from the signature of the callable. Functors are
+     * stored once: every copy of the bound function value calls the same object and shares its mutable state.
+     *
+     * @param name The name of the function in the global environment
+     * @param function The callable
+     *
+     * @throw std::runtime_error if the name is already defined
+     *
+     * @code
+     * eva.bind("add", &add);
+     * eva.bind("next", [counter]() mutable { return ++counter; });
+     * @endcode
+     */
+    template <typename Function>
+    void bind(const std::string &name, Function &&function)
+    {
+        defineBinding(name, binding::makeNative(name, std::forward<Function>(function)));
+    }
+
+    /**
+     * @brief Expose a C++ function known at compile time to scripts
+     *
+     * The call is resolved at compile time, so the glue code can be inlined into the callback.
+     *
+     * @param name The name of the function in the global environment
+     *
+     * @throw std::runtime_error if the name is already defined
+     *
+     * @code
+     * eva.bind<&add>("add");
+     * @endcode
+     */
+    template <auto Function>
+    void bind(const std::string &name)
+    {
+        defineBinding(name, binding::makeNative<Function>(name));
+    }
+
+    /**
+     * @brief Expose a member function called on the given object to scripts
+     *
+     * @param name The name of the function in the global environment
+     * @param method The member function
+     * @param object A raw pointer to an object that outlives the binding, or a shared pointer
+     *
+     * @throw std::runtime_error if the name is already defined
+     *
+     * @code
+     * eva.bind("push", &Stack::push, &stack);
+     * @endcode
+     */
+    template <typename Method, typename Object>
+    void bind(const std::string &name, Method method, Object &&object)
+    {
+        defineBinding(name, binding::makeNative(name, method, std::forward<Object>(object)));
+    }
+
+    /**
+     * @brief Schedule the expression to run concurrently with other scripts
+     *
+     * The expression runs as a task of the event loop of the interpreter when run() is called, and can use
+     * the async builtins.
+     *
+     * @param exp The expression to evaluate
+     * @param env The environment to evaluate the expression in
+     */
+    void spawn(ExpressionPtr exp, std::shared_ptr<Environment> env = nullptr);
+
+    /**
+     * @brief Run the scheduled expressions until all of them have finished
+     *
+     * Errors are reported like in eval, the result of a failed expression is null.
+     *
+     * @return The results of the expressions, in the order they were scheduled
+     */
+    std::vector<EvalResult> run();
+
+    /**
+     * @brief Turn the rewriting of the programs this interpreter evaluates into superinstructions on or off
+     */
+    void setFusing(bool value)
+    {
+        fusing = value;
+    }
+
+    [[nodiscard]] std::shared_ptr<Environment> getGlobal() const
+    {
+        return global;
+    }
+
 private:
     EvalResult _eval(ExpressionPtr exp, std::shared_ptr<Environment> env);
 
+    void defineBinding(const std::string &name, EvalResult function);
+
     int _evalBody(const std::vector<std::string> &exp, std::shared_ptr<Environment> env)
     {
         // Implement body evaluation
@@ -94,6 +269,8 @@ private:
     }
 
     std::shared_ptr<Environment> global;
+    std::unique_ptr<EventLoop> loop;
+    bool fusing = true;
 };
 
 #endif // CPP_EVA_EVA_H
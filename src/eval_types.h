@@ -1,6 +1,8 @@
 #ifndef CPP_EVA_EVAL_TYPES_H
 #define CPP_EVA_EVAL_TYPES_H
 
+#include <cstddef>
+#include <cstdint>
 #include <utility>
 #include <variant>
 #include <unordered_map>
@@ -23,17 +25,23 @@ inline bool operator==(const Null &, const Null &)
     return true;
 }
 
+struct CallProfile;
+
 /**
  * This struct is used to represent a function definition.
  *
  * The function definition consists of a name, a list of parameters, a body expression and an environment.
+ * The call profile is shared by all copies of the definition and is used by the JIT.
+ * Calling a generator function returns a generator over its body instead of running it.
  */
 struct FunctionDefinition
 {
     std::string name;
     std::vector<std::string> params;
-    std::shared_ptr<Expression> body;
+    std::shared_ptr<const Expression> body;
     std::shared_ptr<Environment> env;
+    std::shared_ptr<CallProfile> profile = nullptr;
+    bool generator = false;
 };
 
 /**
@@ -57,6 +65,97 @@ struct InstanceDefinition
     std::shared_ptr<Environment> env;
 };
 
+struct NativeFunction;
+
+class List;
+class HashMap;
+class PersistentVector;
+class PersistentMap;
+class Rope;
+class Generator;
+class Sequence;
+class Channel;
+
+/**
+ * This struct is used to represent a list value.
+ *
+ * Lists are shared by reference: copies of the value refer to the same list.
+ */
+struct ListValue
+{
+    std::shared_ptr<List> list;
+};
+
+/**
+ * This struct is used to represent a hash map value.
+ *
+ * Maps are shared by reference: copies of the value refer to the same map.
+ */
+struct MapValue
+{
+    std::shared_ptr<HashMap> map;
+};
+
+/**
+ * This struct is used to represent a persistent vector value.
+ *
+ * Vectors are immutable: updates return a new vector sharing most of its storage with the original one.
+ */
+struct VectorValue
+{
+    std::shared_ptr<const PersistentVector> vector;
+};
+
+/**
+ * This struct is used to represent a persistent table value, i.e. an immutable map.
+ *
+ * Tables are immutable: updates return a new table sharing most of its storage with the original one.
+ */
+struct TableValue
+{
+    std::shared_ptr<const PersistentMap> map;
+};
+
+/**
+ * This struct is used to represent a string built by concatenation.
+ *
+ * Ropes behave like strings: they are equal to, and hash like, the string with the same characters.
+ */
+struct RopeValue
+{
+    std::shared_ptr<const Rope> rope;
+};
+
+/**
+ * This struct is used to represent a generator, the suspended call of a generator function.
+ *
+ * Generators are shared by reference: copies of the value refer to the same generator.
+ */
+struct GeneratorValue
+{
+    std::shared_ptr<Generator> generator;
+};
+
+/**
+ * This struct is used to represent a lazy sequence, e.g. a range or a map over a list.
+ *
+ * Sequences are immutable: adding a stage returns a new sequence.
+ */
+struct SequenceValue
+{
+    std::shared_ptr<const Sequence> sequence;
+};
+
+/**
+ * This struct is used to represent a channel between interpreters.
+ *
+ * Channels are shared by reference, across threads too.
+ */
+struct ChannelValue
+{
+    std::shared_ptr<Channel> channel;
+};
+
 /**
  * This type is used to represent the result of an evaluation.
  *
@@ -68,8 +167,39 @@ struct InstanceDefinition
  * - a function definition
  * - a class definition
  * - an instance definition
+ * - a native function
+ * - a list
+ * - a hash map
+ * - a persistent vector
+ * - a persistent table
+ * - a rope
+ * - a generator
+ * - a lazy sequence
+ * - a channel
  */
-using EvalResult = std::variant<int, std::string, bool, Null, FunctionDefinition, ClassDefinition, InstanceDefinition>;
+using EvalResult = std::variant<int, std::string, bool, Null, FunctionDefinition, ClassDefinition, InstanceDefinition, NativeFunction,
+                                ListValue, MapValue, VectorValue, TableValue, RopeValue, GeneratorValue,
+                                SequenceValue, ChannelValue>;
+
+/**
+ * This struct is used to represent a function implemented in C++.
+ *
+ * The arguments are evaluated into a contiguous array and passed to the callback directly, without creating
+ * an environment for the call. The arity is checked before the callback is invoked unless it is variadic.
+ * The target and state fields are available to the callback, e.g. to forward the call to a bound C++ function.
+ */
+struct NativeFunction
+{
+    using Callback = EvalResult (*)(const NativeFunction &function, const EvalResult *args, size_t count);
+
+    static constexpr size_t variadic = SIZE_MAX;
+
+    std::string name;
+    size_t arity;
+    Callback callback;
+    void (*target)() = nullptr;
+    std::shared_ptr<const void> state = nullptr;
+};
 
 /**
  * This type is used to represent a map of evaluation results.
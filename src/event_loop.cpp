@@ -0,0 +1,418 @@
+#include "event_loop.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__SANITIZE_ADDRESS__)
+#define CPP_EVA_ASAN_FIBERS
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define CPP_EVA_ASAN_FIBERS
+#endif
+#endif
+
+#ifdef CPP_EVA_ASAN_FIBERS
+#include <sanitizer/common_interface_defs.h>
+#endif
+
+using namespace std;
+
+namespace
+{
+    /**
+     * AddressSanitizer has to be told about stack switches, or it reports the other stack as overflowed.
+     */
+    void startSwitch([[maybe_unused]] void **fakeStack, [[maybe_unused]] const void *bottom,
+                     [[maybe_unused]] size_t size)
+    {
+#ifdef CPP_EVA_ASAN_FIBERS
+        __sanitizer_start_switch_fiber(fakeStack, bottom, size);
+#endif
+    }
+
+    void finishSwitch([[maybe_unused]] void *fakeStack, [[maybe_unused]] const void **bottom,
+                      [[maybe_unused]] size_t *size)
+    {
+#ifdef CPP_EVA_ASAN_FIBERS
+        __sanitizer_finish_switch_fiber(fakeStack, bottom, size);
+#endif
+    }
+
+    string systemError(const string &operation, const string &path)
+    {
+        return operation + ": " + path + ": " + strerror(errno);
+    }
+
+    /**
+     * Read a whole file, returns false and leaves errno set on failure.
+     */
+    bool readAll(const string &path, string &content)
+    {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            return false;
+        }
+        struct stat info{};
+        if (fstat(fd, &info) == 0 && info.st_size > 0)
+        {
+            content.reserve(info.st_size);
+        }
+        char buffer[1 << 16];
+        ssize_t count;
+        while ((count = read(fd, buffer, sizeof(buffer))) != 0)
+        {
+            if (count < 0 && errno != EINTR)
+            {
+                int error = errno;
+                close(fd);
+                errno = error;
+                return false;
+            }
+            if (count > 0)
+            {
+                content.append(buffer, count);
+            }
+        }
+        close(fd);
+        return true;
+    }
+
+    bool writeAll(const string &path, const string &data)
+    {
+        int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0)
+        {
+            return false;
+        }
+        size_t written = 0;
+        while (written < data.size())
+        {
+            auto count = write(fd, data.data() + written, data.size() - written);
+            if (count < 0 && errno != EINTR)
+            {
+                int error = errno;
+                close(fd);
+                errno = error;
+                return false;
+            }
+            written += count > 0 ? count : 0;
+        }
+        return close(fd) == 0;
+    }
+}
+
+EventLoop::EventLoop(size_t ioThreads)
+{
+    epoll = epoll_create1(EPOLL_CLOEXEC);
+    notifier = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll < 0 || notifier < 0)
+    {
+        throw runtime_error(string("Cannot create event loop: ") + strerror(errno));
+    }
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = notifier;
+    if (epoll_ctl(epoll, EPOLL_CTL_ADD, notifier, &event) != 0)
+    {
+        throw runtime_error(string("Cannot create event loop: ") + strerror(errno));
+    }
+
+    for (size_t i = 0; i < ioThreads; ++i)
+    {
+        workers.emplace_back(&EventLoop::work, this);
+    }
+}
+
+EventLoop::~EventLoop()
+{
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+    for (auto &task : tasks)
+    {
+        munmap(task->stack, stackSize);
+    }
+    close(notifier);
+    close(epoll);
+}
+
+void EventLoop::spawn(function<EvalResult()> body)
+{
+    auto task = make_unique<Task>();
+    task->body = std::move(body);
+    task->stack = mmap(nullptr, stackSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+    if (task->stack == MAP_FAILED)
+    {
+        throw runtime_error(string("Cannot allocate task stack: ") + strerror(errno));
+    }
+    // Guard page: a task that overflows its stack faults instead of corrupting memory
+    mprotect(task->stack, getpagesize(), PROT_NONE);
+
+    getcontext(&task->context);
+    task->context.uc_stack.ss_sp = task->stack;
+    task->context.uc_stack.ss_size = stackSize;
+    task->context.uc_link = &scheduler;
+    makecontext(&task->context, &EventLoop::start, 0);
+
+    ready.push_back(task.get());
+    tasks.push_back(std::move(task));
+}
+
+void EventLoop::start()
+{
+    auto loop = active;
+    auto task = loop->running;
+    finishSwitch(nullptr, &loop->schedulerStack, &loop->schedulerStackSize);
+    try
+    {
+        task->result = task->body();
+    }
+    catch (...)
+    {
+        task->error = current_exception();
+    }
+    task->body = nullptr;
+    task->finished = true;
+    // Returning switches to uc_link, the scheduler, and this stack is never resumed
+    startSwitch(nullptr, loop->schedulerStack, loop->schedulerStackSize);
+}
+
+vector<EvalResult> EventLoop::run()
+{
+    auto previous = active;
+    active = this;
+
+    size_t unfinished = 0;
+    for (const auto &task : tasks)
+    {
+        unfinished += !task->finished;
+    }
+
+    while (unfinished > 0)
+    {
+        while (!ready.empty())
+        {
+            running = ready.front();
+            ready.pop_front();
+            void *fakeStack = nullptr;
+            startSwitch(&fakeStack, running->stack, stackSize);
+            swapcontext(&scheduler, &running->context);
+            finishSwitch(fakeStack, nullptr, nullptr);
+            if (running->finished)
+            {
+                --unfinished;
+            }
+            running = nullptr;
+        }
+        if (unfinished > 0)
+        {
+            poll();
+        }
+    }
+    active = previous;
+
+    vector<EvalResult> results;
+    exception_ptr error;
+    for (auto &task : tasks)
+    {
+        munmap(task->stack, stackSize);
+        results.push_back(std::move(task->result));
+        if (!error)
+        {
+            error = task->error;
+        }
+    }
+    tasks.clear();
+    if (error)
+    {
+        rethrow_exception(error);
+    }
+    return results;
+}
+
+int EventLoop::readFile(string path)
+{
+    return submit(Job{0, false, std::move(path), {}});
+}
+
+int EventLoop::writeFile(string path, string data)
+{
+    return submit(Job{0, true, std::move(path), std::move(data)});
+}
+
+int EventLoop::sleep(int milliseconds)
+{
+    int id = nextId++;
+    operations[id];
+    timers.emplace(chrono::steady_clock::now() + chrono::milliseconds(milliseconds), id);
+    ++inFlight;
+    return id;
+}
+
+EvalResult EventLoop::await(int id)
+{
+    auto found = operations.find(id);
+    if (found == operations.end())
+    {
+        throw runtime_error("await: unknown operation " + to_string(id));
+    }
+    if (!found->second.done)
+    {
+        if (!running)
+        {
+            throw runtime_error("await: not called from a task");
+        }
+        if (found->second.waiter)
+        {
+            throw runtime_error("await: operation " + to_string(id) + " is already awaited");
+        }
+        found->second.waiter = running;
+        void *fakeStack = nullptr;
+        startSwitch(&fakeStack, schedulerStack, schedulerStackSize);
+        swapcontext(&running->context, &scheduler);
+        finishSwitch(fakeStack, &schedulerStack, &schedulerStackSize);
+        found = operations.find(id);
+    }
+
+    auto operation = std::move(found->second);
+    operations.erase(found);
+    if (!operation.error.empty())
+    {
+        throw runtime_error(operation.error);
+    }
+    return std::move(operation.result);
+}
+
+int EventLoop::submit(Job job)
+{
+    job.id = nextId++;
+    operations[job.id];
+    ++inFlight;
+    {
+        lock_guard<mutex> guard(lock);
+        jobs.push_back(std::move(job));
+    }
+    wake.notify_one();
+    return nextId - 1;
+}
+
+void EventLoop::complete(int id, EvalResult result, string error)
+{
+    auto &operation = operations[id];
+    operation.done = true;
+    operation.result = std::move(result);
+    operation.error = std::move(error);
+    --inFlight;
+    if (operation.waiter)
+    {
+        ready.push_back(operation.waiter);
+        operation.waiter = nullptr;
+    }
+}
+
+void EventLoop::poll()
+{
+    if (inFlight == 0)
+    {
+        throw logic_error("Event loop has waiting tasks but no pending operations");
+    }
+
+    int timeout = -1;
+    if (!timers.empty())
+    {
+        auto remaining = chrono::ceil<chrono::milliseconds>(timers.begin()->first - chrono::steady_clock::now());
+        timeout = static_cast<int>(max<int64_t>(0, remaining.count()));
+    }
+
+    epoll_event event{};
+    if (epoll_wait(epoll, &event, 1, timeout) > 0)
+    {
+        uint64_t count;
+        while (read(notifier, &count, sizeof(count)) > 0)
+        {
+        }
+        vector<Completion> done;
+        {
+            lock_guard<mutex> guard(lock);
+            done.swap(completed);
+        }
+        for (auto &completion : done)
+        {
+            complete(completion.id, std::move(completion.result), std::move(completion.error));
+        }
+    }
+
+    auto now = chrono::steady_clock::now();
+    while (!timers.empty() && timers.begin()->first <= now)
+    {
+        auto id = timers.begin()->second;
+        timers.erase(timers.begin());
+        complete(id, Null{}, "");
+    }
+}
+
+void EventLoop::work()
+{
+    while (true)
+    {
+        Job job;
+        {
+            unique_lock<mutex> guard(lock);
+            wake.wait(guard, [this]
+                      { return stopping || !jobs.empty(); });
+            if (jobs.empty())
+            {
+                return;
+            }
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+
+        Completion completion{job.id, Null{}, ""};
+        if (job.write)
+        {
+            if (writeAll(job.path, job.data))
+            {
+                completion.result = static_cast<int>(job.data.size());
+            }
+            else
+            {
+                completion.error = systemError("writeFile", job.path);
+            }
+        }
+        else
+        {
+            string content;
+            if (readAll(job.path, content))
+            {
+                completion.result = std::move(content);
+            }
+            else
+            {
+                completion.error = systemError("readFile", job.path);
+            }
+        }
+
+        {
+            lock_guard<mutex> guard(lock);
+            completed.push_back(std::move(completion));
+        }
+        uint64_t one = 1;
+        [[maybe_unused]] auto written = ::write(notifier, &one, sizeof(one));
+    }
+}
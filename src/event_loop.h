@@ -0,0 +1,173 @@
+#ifndef CPP_EVA_EVENT_LOOP_H
+#define CPP_EVA_EVENT_LOOP_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <ucontext.h>
+#include "eval_types.h"
+
+/**
+ * This class is used to run scripts concurrently on one thread and overlap their I/O.
+ *
+ * Every spawned script runs as a task on a stack of its own. The async builtins start an operation and
+ * return its id; await() suspends the task until the operation has completed, and the loop resumes
+ * another task in the meantime. The loop sleeps in epoll_wait until an operation completes or a timer
+ * expires.
+ *
+ * Regular files cannot be polled with epoll, so reads and writes run on a small pool of I/O threads,
+ * which report completions through an eventfd watched by the loop. Scripts never block: only the
+ * I/O threads wait on the disk, and any number of operations can be in flight at once.
+ */
+class EventLoop
+{
+public:
+    static constexpr size_t stackSize = 1 << 20;
+
+    explicit EventLoop(size_t ioThreads = 4);
+
+    ~EventLoop();
+
+    EventLoop(const EventLoop &) = delete;
+    EventLoop &operator=(const EventLoop &) = delete;
+
+    /**
+     * @brief Get the loop running on the current thread
+     *
+     * @return The loop or nullptr if no loop is running
+     */
+    static EventLoop *current()
+    {
+        return active;
+    }
+
+    /**
+     * @brief Add a task to the loop
+     *
+     * The task starts when the loop runs.
+     *
+     * @param body The function to run in the task
+     */
+    void spawn(std::function<EvalResult()> body);
+
+    /**
+     * @brief Run the loop until all tasks have finished
+     *
+     * @return The results of the tasks, in the order they were spawned
+     *
+     * @throw std::exception the first exception that escaped a task, after all tasks have finished
+     */
+    std::vector<EvalResult> run();
+
+    /**
+     * @brief Start reading a whole file
+     *
+     * @return The id of the operation, whose result is the content of the file
+     */
+    int readFile(std::string path);
+
+    /**
+     * @brief Start replacing the content of a file
+     *
+     * @return The id of the operation, whose result is the number of bytes written
+     */
+    int writeFile(std::string path, std::string data);
+
+    /**
+     * @brief Start a timer
+     *
+     * @return The id of the operation, whose result is null
+     */
+    int sleep(int milliseconds);
+
+    /**
+     * @brief Wait for an operation to complete
+     *
+     * The current task is suspended until then.
+     *
+     * @return The result of the operation
+     *
+     * @throw std::runtime_error if the operation failed or does not exist, or if no task is running
+     */
+    EvalResult await(int id);
+
+private:
+    struct Task
+    {
+        ucontext_t context;
+        void *stack = nullptr;
+        std::function<EvalResult()> body;
+        EvalResult result;
+        std::exception_ptr error;
+        bool finished = false;
+    };
+
+    struct Operation
+    {
+        bool done = false;
+        EvalResult result;
+        std::string error;
+        Task *waiter = nullptr;
+    };
+
+    struct Job
+    {
+        int id;
+        bool write;
+        std::string path;
+        std::string data;
+    };
+
+    struct Completion
+    {
+        int id;
+        EvalResult result;
+        std::string error;
+    };
+
+    static void start();
+
+    int submit(Job job);
+
+    void complete(int id, EvalResult result, std::string error);
+
+    void poll();
+
+    void work();
+
+    static inline thread_local EventLoop *active = nullptr;
+
+    int epoll;
+    int notifier;
+
+    std::vector<std::unique_ptr<Task>> tasks;
+    std::deque<Task *> ready;
+    Task *running = nullptr;
+    ucontext_t scheduler;
+    const void *schedulerStack = nullptr;
+    size_t schedulerStackSize = 0;
+
+    std::unordered_map<int, Operation> operations;
+    std::multimap<std::chrono::steady_clock::time_point, int> timers;
+    size_t inFlight = 0;
+    int nextId = 1;
+
+    std::mutex lock;
+    std::condition_variable wake;
+    std::deque<Job> jobs;
+    std::vector<Completion> completed;
+    bool stopping = false;
+    std::vector<std::thread> workers;
+};
+
+#endif // CPP_EVA_EVENT_LOOP_H
@@ -1,9 +1,22 @@
 #include "expressions.h"
 
+#include <algorithm>
+#include <map>
 #include <string>
 #include <variant>
+#include <stdexcept>
+#include <typeinfo>
 #include "eval_types.h"
+#include "builtins.h"
+#include "collections.h"
+#include "persistent.h"
+#include "rope.h"
+#include "generator.h"
+#include "sequence.h"
 #include "environment.h"
+#include "governor.h"
+#include "jit.h"
+#include "perf_counters.h"
 
 using namespace std;
 
@@ -36,21 +49,26 @@ EvalResult Identifier::eval(std::shared_ptr<Environment> env) const
 
 EvalResult BinaryOperation::eval(std::shared_ptr<Environment> env) const
 {
-    const int lhs = get<int>(left->eval(env));
-    const int rhs = get<int>(right->eval(env));
+    auto lhsValue = left->eval(env);
+    auto rhsValue = right->eval(env);
+    if (type == BinaryOperationType::ADDITION && !holds_alternative<int>(lhsValue))
+    {
+        return Rope::concat(lhsValue, rhsValue);
+    }
+
+    return apply(type, get<int>(lhsValue), get<int>(rhsValue));
+}
 
+EvalResult BinaryOperation::apply(BinaryOperationType type, int lhs, int rhs)
+{
     switch (type)
     {
     case BinaryOperationType::ADDITION:
-        return lhs + rhs;
     case BinaryOperationType::SUBTRACTION:
-        return lhs - rhs;
     case BinaryOperationType::MULTIPLICATION:
-        return lhs * rhs;
     case BinaryOperationType::DIVISION:
-        return lhs / rhs;
     case BinaryOperationType::MOD:
-        return lhs % rhs;
+        return arithmetic(type, lhs, rhs);
     case BinaryOperationType::GREATER:
         return lhs > rhs;
     case BinaryOperationType::LESS:
@@ -68,14 +86,612 @@ EvalResult BinaryOperation::eval(std::shared_ptr<Environment> env) const
     }
 }
 
+namespace
+{
+    /**
+     * This class is used to find the declarations of a block and the expressions that can capture its environment.
+     *
+     * Function bodies are not visited: they run in environments of their own, and any function created in the
+     * block captures it anyway. Nested blocks are visited for captures only.
+     */
+    class ScopeAnalysis : public ExpressionVisitor
+    {
+    public:
+        BlockScope analyze(const vector<ExpressionPtr> &expressions)
+        {
+            walk(expressions);
+            return captures ? BlockScope::HEAP : declares ? BlockScope::STACK
+                                                          : BlockScope::ENCLOSING;
+        }
+
+        void visit(const Expression &exp) override
+        {
+            // Unknown expressions may do anything with the environment
+            if (typeid(exp) != typeid(Expression))
+            {
+                declares = captures = true;
+            }
+        }
+
+        void visit(const Block &exp) override
+        {
+            ++depth;
+            walk(exp.getExpressions());
+            --depth;
+        }
+
+        void visit(const Condition &exp) override
+        {
+            walk(exp.getCondition());
+            walk(exp.getThen());
+            walk(exp.getOtherwise());
+        }
+
+        void visit(const Loop &exp) override
+        {
+            walk(exp.getCondition());
+            walk(exp.getBody());
+        }
+
+        void visit(const Identifier &) override {}
+
+        void visit(const Literal &) override {}
+
+        void visit(const VariableDeclaration &exp) override
+        {
+            declare();
+            walk(exp.getValue());
+        }
+
+        void visit(const Assignment &exp) override
+        {
+            walk(exp.getValue());
+        }
+
+        void visit(const BinaryOperation &exp) override
+        {
+            walk(exp.getLeft());
+            walk(exp.getRight());
+        }
+
+        void visit(const FunctionDeclaration &) override
+        {
+            declare();
+            captures = true;
+        }
+
+        void visit(const Lambda &) override
+        {
+            captures = true;
+        }
+
+        void visit(const AnonymousFunctionCall &exp) override
+        {
+            walk(exp.getFunction());
+            walk(exp.getArgs());
+        }
+
+        void visit(const FunctionCall &exp) override
+        {
+            walk(exp.getArgs());
+        }
+
+        void visit(const ForLoop &exp) override
+        {
+            walk(exp.getInit());
+            walk(exp.getCondition());
+
+            // The body and the modifier run in a block of their own
+            ++depth;
+            walk(exp.getBody());
+            walk(exp.getModifier());
+            --depth;
+        }
+
+        void visit(const ForIn &exp) override
+        {
+            walk(exp.getIterable());
+
+            // The variable and the body live in an environment of their own
+            ++depth;
+            walk(exp.getBody());
+            --depth;
+        }
+
+        void visit(const Switch &exp) override
+        {
+            for (const auto &[condition, body] : exp.getCases())
+            {
+                walk(condition);
+                walk(body);
+            }
+        }
+
+        void visit(const Increment &) override {}
+
+        void visit(const Decrement &) override {}
+
+        void visit(const ClassDeclaration &) override
+        {
+            declare();
+            captures = true;
+        }
+
+        void visit(const NewInstance &exp) override
+        {
+            walk(exp.getArgs());
+        }
+
+        void visit(const MemberAccess &) override {}
+
+        void visit(const MemberFunctionCall &exp) override
+        {
+            walk(exp.getArgs());
+        }
+
+        void visit(const ListExpression &exp) override
+        {
+            walk(exp.getItems());
+        }
+
+        void visit(const MapExpression &exp) override
+        {
+            for (const auto &[key, value] : exp.getEntries())
+            {
+                walk(key);
+                walk(value);
+            }
+        }
+
+        void visit(const IndexAccess &exp) override
+        {
+            walk(exp.getCollection());
+            walk(exp.getIndex());
+        }
+
+        void visit(const IndexAssignment &exp) override
+        {
+            walk(exp.getCollection());
+            walk(exp.getIndex());
+            walk(exp.getValue());
+        }
+
+        void visit(const Import &) override
+        {
+            declare();
+        }
+
+        void visit(const Yield &exp) override
+        {
+            walk(exp.getValue());
+        }
+
+    private:
+        void walk(const ExpressionPtr &exp)
+        {
+            if (exp)
+            {
+                exp->accept(*this);
+            }
+        }
+
+        void walk(const vector<ExpressionPtr> &expressions)
+        {
+            for (const auto &exp : expressions)
+            {
+                walk(exp);
+            }
+        }
+
+        void declare()
+        {
+            declares = declares || depth == 0;
+        }
+
+        size_t depth = 0;
+        bool declares = false;
+        bool captures = false;
+    };
+}
+
+namespace
+{
+    /**
+     * This class is used to collect the names a function body refers to.
+     *
+     * Names declared in the body or bound as parameters of nested functions are marked as local: they may
+     * still refer to an enclosing variable before they are declared. The parameters of the function itself
+     * are left out.
+     */
+    class FreeVariables : public ExpressionVisitor
+    {
+    public:
+        explicit FreeVariables(const vector<string> &params) : params(params) {}
+
+        [[nodiscard]] const map<string, bool> &getNames() const
+        {
+            return names;
+        }
+
+        [[nodiscard]] bool isOpaque() const
+        {
+            return opaque;
+        }
+
+        void visit(const Expression &exp) override
+        {
+            opaque = opaque || typeid(exp) != typeid(Expression);
+        }
+
+        void visit(const Block &exp) override
+        {
+            walk(exp.getExpressions());
+        }
+
+        void visit(const Condition &exp) override
+        {
+            walk(exp.getCondition());
+            walk(exp.getThen());
+            walk(exp.getOtherwise());
+        }
+
+        void visit(const Loop &exp) override
+        {
+            walk(exp.getCondition());
+            walk(exp.getBody());
+        }
+
+        void visit(const Identifier &exp) override
+        {
+            use(exp.getName());
+        }
+
+        void visit(const Literal &) override {}
+
+        void visit(const VariableDeclaration &exp) override
+        {
+            declare(exp.getName());
+            walk(exp.getValue());
+        }
+
+        void visit(const Assignment &exp) override
+        {
+            use(exp.getMemberAccess() ? exp.getMemberAccess()->getInstance() : exp.getName());
+            walk(exp.getValue());
+        }
+
+        void visit(const BinaryOperation &exp) override
+        {
+            walk(exp.getLeft());
+            walk(exp.getRight());
+        }
+
+        void visit(const FunctionDeclaration &exp) override
+        {
+            declare(exp.getName());
+            function(exp);
+        }
+
+        void visit(const Lambda &exp) override
+        {
+            function(exp);
+        }
+
+        void visit(const AnonymousFunctionCall &exp) override
+        {
+            walk(exp.getFunction());
+            walk(exp.getArgs());
+        }
+
+        void visit(const FunctionCall &exp) override
+        {
+            use(exp.getName());
+            walk(exp.getArgs());
+        }
+
+        void visit(const ForLoop &exp) override
+        {
+            walk(exp.getInit());
+            walk(exp.getCondition());
+            walk(exp.getBody());
+            walk(exp.getModifier());
+        }
+
+        void visit(const ForIn &exp) override
+        {
+            declare(exp.getName());
+            walk(exp.getIterable());
+            walk(exp.getBody());
+        }
+
+        void visit(const Switch &exp) override
+        {
+            for (const auto &[condition, body] : exp.getCases())
+            {
+                walk(condition);
+                walk(body);
+            }
+        }
+
+        void visit(const Increment &exp) override
+        {
+            use(exp.getIdentifier()->getName());
+        }
+
+        void visit(const Decrement &exp) override
+        {
+            use(exp.getIdentifier()->getName());
+        }
+
+        void visit(const ClassDeclaration &exp) override
+        {
+            declare(exp.getName());
+            if (exp.getParent())
+            {
+                use(exp.getParent()->getName());
+            }
+            walk(exp.getExpressions());
+        }
+
+        void visit(const NewInstance &exp) override
+        {
+            use(exp.getName());
+            walk(exp.getArgs());
+        }
+
+        void visit(const MemberAccess &exp) override
+        {
+            use(exp.getInstance());
+        }
+
+        void visit(const MemberFunctionCall &exp) override
+        {
+            walk(exp.getFunction());
+            walk(exp.getArgs());
+        }
+
+        void visit(const ListExpression &exp) override
+        {
+            walk(exp.getItems());
+        }
+
+        void visit(const MapExpression &exp) override
+        {
+            for (const auto &[key, value] : exp.getEntries())
+            {
+                walk(key);
+                walk(value);
+            }
+        }
+
+        void visit(const IndexAccess &exp) override
+        {
+            walk(exp.getCollection());
+            walk(exp.getIndex());
+        }
+
+        void visit(const IndexAssignment &exp) override
+        {
+            walk(exp.getCollection());
+            walk(exp.getIndex());
+            walk(exp.getValue());
+        }
+
+        void visit(const Import &exp) override
+        {
+            // Importing every export defines names that are only known when the module is loaded
+            opaque = opaque || exp.getNames().empty();
+            for (const auto &name : exp.getNames())
+            {
+                declare(name);
+            }
+        }
+
+        void visit(const Yield &exp) override
+        {
+            walk(exp.getValue());
+        }
+
+    private:
+        void walk(const ExpressionPtr &exp)
+        {
+            if (exp)
+            {
+                exp->accept(*this);
+            }
+        }
+
+        void walk(const vector<ExpressionPtr> &expressions)
+        {
+            for (const auto &exp : expressions)
+            {
+                walk(exp);
+            }
+        }
+
+        void function(const FunctionDeclaration &exp)
+        {
+            for (const auto &param : exp.getParams())
+            {
+                declare(param);
+            }
+            if (exp.getBody())
+            {
+                exp.getBody()->accept(*this);
+            }
+        }
+
+        void use(const string &name)
+        {
+            if (find(params.begin(), params.end(), name) == params.end())
+            {
+                names.emplace(name, false);
+            }
+        }
+
+        void declare(const string &name)
+        {
+            if (find(params.begin(), params.end(), name) == params.end())
+            {
+                names[name] = true;
+            }
+        }
+
+        const vector<string> &params;
+        map<string, bool> names;
+        bool opaque = false;
+    };
+}
+
+namespace
+{
+    /**
+     * This class is used to find the yields at statement positions of a function body.
+     *
+     * Only blocks, branches, loop bodies and switch cases are visited: a yield anywhere else cannot suspend
+     * the function, and yields in nested functions and classes belong to those.
+     */
+    class YieldSearch : public ExpressionVisitor
+    {
+    public:
+        [[nodiscard]] bool isFound() const
+        {
+            return found;
+        }
+
+        void visit(const Expression &) override {}
+
+        void visit(const Block &exp) override
+        {
+            for (const auto &child : exp.getExpressions())
+            {
+                walk(child);
+            }
+        }
+
+        void visit(const Condition &exp) override
+        {
+            walk(exp.getThen());
+            walk(exp.getOtherwise());
+        }
+
+        void visit(const Loop &exp) override
+        {
+            walk(exp.getBody());
+        }
+
+        void visit(const Identifier &) override {}
+
+        void visit(const Literal &) override {}
+
+        void visit(const VariableDeclaration &) override {}
+
+        void visit(const Assignment &) override {}
+
+        void visit(const BinaryOperation &) override {}
+
+        void visit(const FunctionDeclaration &) override {}
+
+        void visit(const Lambda &) override {}
+
+        void visit(const AnonymousFunctionCall &) override {}
+
+        void visit(const FunctionCall &) override {}
+
+        void visit(const ForLoop &exp) override
+        {
+            walk(exp.getBody());
+            walk(exp.getModifier());
+        }
+
+        void visit(const ForIn &exp) override
+        {
+            walk(exp.getBody());
+        }
+
+        void visit(const Switch &exp) override
+        {
+            for (const auto &[condition, body] : exp.getCases())
+            {
+                walk(body);
+            }
+        }
+
+        void visit(const Increment &) override {}
+
+        void visit(const Decrement &) override {}
+
+        void visit(const ClassDeclaration &) override {}
+
+        void visit(const NewInstance &) override {}
+
+        void visit(const MemberAccess &) override {}
+
+        void visit(const MemberFunctionCall &) override {}
+
+        void visit(const ListExpression &) override {}
+
+        void visit(const MapExpression &) override {}
+
+        void visit(const IndexAccess &) override {}
+
+        void visit(const IndexAssignment &) override {}
+
+        void visit(const Import &) override {}
+
+        void visit(const Yield &) override
+        {
+            found = true;
+        }
+
+    private:
+        void walk(const ExpressionPtr &exp)
+        {
+            if (exp && !found)
+            {
+                exp->accept(*this);
+            }
+        }
+
+        bool found = false;
+    };
+}
+
+bool FunctionDeclaration::yields(const Expression *body)
+{
+    if (!body)
+    {
+        return false;
+    }
+    YieldSearch search;
+    body->accept(search);
+    return search.isFound();
+}
+
+BlockScope Block::analyzeScope(const std::vector<ExpressionPtr> &expressions)
+{
+    return ScopeAnalysis().analyze(expressions);
+}
+
 EvalResult Block::eval(std::shared_ptr<Environment> env) const
 {
-    EvalMap vars;
-    auto blockEnv = make_shared<Environment>(vars, env);
-    return evalBlock(blockEnv);
+    switch (scope)
+    {
+    case BlockScope::ENCLOSING:
+        return evalBlock(std::move(env));
+    case BlockScope::STACK:
+    {
+        // Nothing can keep a reference to the environment once the block is over, so it does not need an owner
+        Environment blockEnv(EvalMap{}, std::move(env));
+        return evalBlock(shared_ptr<Environment>(shared_ptr<Environment>(), &blockEnv));
+    }
+    default:
+        return evalBlock(make_shared<Environment>(EvalMap{}, std::move(env)));
+    }
 }
 
 Block::Block(Block &&other) noexcept
+    : scope(other.scope)
 {
     swap(expressions, other.expressions);
 }
@@ -107,6 +723,7 @@ EvalResult Loop::eval(std::shared_ptr<Environment> env) const
     EvalResult result;
     while (get<bool>(condition->eval(env)))
     {
+        ResourceGovernor::safepoint();
         result = body->eval(env);
     }
     return result;
@@ -114,63 +731,200 @@ EvalResult Loop::eval(std::shared_ptr<Environment> env) const
 
 EvalResult FunctionDeclaration::eval(std::shared_ptr<Environment> env) const
 {
-    // JIT-transpile to variable declaration with lambda
-
-    auto _this = const_cast<FunctionDeclaration *>(this);
-    auto lambda = Lambda::create(params, std::move(_this->body));
+    // The name is defined first, so a local function can capture itself for recursion
+    if (env && env->getParent() && !env->getVariables().find(name))
+    {
+        env->define(name, Null{});
+    }
 
-    auto value = lambda->eval(env);
+    auto closureEnv = body ? Lambda::closure(params, *body, env) : env;
+    EvalResult value = FunctionDefinition{name, params, body, std::move(closureEnv), make_shared<CallProfile>(), generator};
     env->define(name, value);
     return value;
 }
 
-FunctionDefinition FunctionCall::resolveFunction(std::shared_ptr<Environment> env) const
+EvalResult FunctionCall::resolveFunction(std::shared_ptr<Environment> env) const
 {
-    return get<FunctionDefinition>(env->lookup(name));
+    return env->lookup(name);
 }
 
 EvalResult Lambda::eval(std::shared_ptr<Environment> env) const
 {
-    auto _this = const_cast<Lambda *>(this);
-    return FunctionDefinition{name, params, std::move(_this->body), env};
+    auto closureEnv = body ? closure(params, *body, env) : env;
+    return FunctionDefinition{name, params, body, std::move(closureEnv), make_shared<CallProfile>(), generator};
+}
+
+std::shared_ptr<Environment> Lambda::closure(const std::vector<std::string> &params, const Expression &body,
+                                             const std::shared_ptr<Environment> &env)
+{
+    // Functions created in the global environment have nothing to flatten
+    if (!env || !env->getParent())
+    {
+        return env;
+    }
+
+    FreeVariables analysis(params);
+    body.accept(analysis);
+    if (analysis.isOpaque())
+    {
+        return env;
+    }
+
+    auto root = env;
+    while (root->getParent())
+    {
+        root = root->getParent();
+    }
+
+    auto closureEnv = make_shared<Environment>(EvalMap{}, root);
+    for (const auto &[name, local] : analysis.getNames())
+    {
+        auto owner = env->owner(name);
+        if (!owner)
+        {
+            // A name defined later can only be found through the defining environment
+            if (!local)
+            {
+                return env;
+            }
+            continue;
+        }
+        if (owner != root.get())
+        {
+            closureEnv->share(name, owner->capture(name));
+        }
+    }
+    return closureEnv;
 }
 
 EvalResult AnonymousFunctionCall::eval(std::shared_ptr<Environment> env) const
 {
-    const auto fun = resolveFunction(env);
-    auto funEnv = make_shared<Environment>(EvalMap{}, fun.env);
+    ResourceGovernor::safepoint();
+
+    const auto callee = resolveFunction(env);
+
+    // Arguments are evaluated in place for the common case of a few arguments
+
+    constexpr size_t inlineArgs = 4;
+    const size_t count = args.size();
+
+    if (count <= inlineArgs)
+    {
+        EvalResult values[inlineArgs];
+        for (size_t i = 0; i < count; ++i)
+        {
+            values[i] = args[i]->eval(env);
+        }
+        return invoke(callee, values, count);
+    }
+
+    vector<EvalResult> values;
+    values.reserve(count);
+    for (const auto &arg : args)
+    {
+        values.push_back(arg->eval(env));
+    }
+    return invoke(callee, values.data(), count);
+}
+
+EvalResult AnonymousFunctionCall::invoke(const EvalResult &callee, const EvalResult *args, size_t count)
+{
+    if (auto native = get_if<NativeFunction>(&callee))
+    {
+        // Native functions do not need an environment for the call
+        if (native->arity != NativeFunction::variadic && native->arity != count)
+        {
+            throw runtime_error("Function " + native->name + " expects " + to_string(native->arity) +
+                                " arguments, got " + to_string(count));
+        }
+        return native->callback(*native, args, count);
+    }
+
+    const auto &fun = get<FunctionDefinition>(callee);
+    if (count < fun.params.size())
+    {
+        throw runtime_error("Function " + fun.name + " expects " + to_string(fun.params.size()) +
+                            " arguments, got " + to_string(count));
+    }
+
+    if (fun.generator)
+    {
+        // The frame of a generator outlives the call, so it does not come from the frame pool
+        auto funEnv = make_shared<Environment>(EvalMap{}, fun.env);
+        for (size_t i = 0; i < fun.params.size(); ++i)
+        {
+            funEnv->define(fun.params[i], args[i]);
+        }
+        return GeneratorValue{Generator::create(fun.body, std::move(funEnv))};
+    }
+
+    PerfProfiler::Call profiled(fun.name);
+
+    EvalResult result;
+    if (Jit::tryCall(fun, args, count, result))
+    {
+        return result;
+    }
 
+    if (!fun.profile)
+    {
+        auto funEnv = make_shared<Environment>(EvalMap{}, fun.env);
+        for (size_t i = 0; i < fun.params.size(); ++i)
+        {
+            funEnv->define(fun.params[i], args[i]);
+        }
+        return fun.body->eval(funEnv);
+    }
+
+    auto funEnv = fun.profile->frames.acquire(fun.env);
     for (size_t i = 0; i < fun.params.size(); ++i)
     {
-        funEnv->define(fun.params[i], args[i]->eval(env));
+        funEnv->define(fun.params[i], args[i]);
     }
 
-    return fun.body->eval(funEnv);
+    result = fun.body->eval(funEnv);
+    fun.profile->frames.release(std::move(funEnv), fun.params.size());
+    return result;
 }
 
-FunctionDefinition AnonymousFunctionCall::resolveFunction(std::shared_ptr<Environment> env) const
+EvalResult AnonymousFunctionCall::resolveFunction(std::shared_ptr<Environment> env) const
 {
-    return resolveFunctionImpl(nullptr);
+    return resolveFunctionImpl(env);
 }
 
-FunctionDefinition AnonymousFunctionCall::resolveFunctionImpl(std::shared_ptr<Environment> env) const
+EvalResult AnonymousFunctionCall::resolveFunctionImpl(std::shared_ptr<Environment> env) const
 {
-    return get<FunctionDefinition>(function->eval(env));
+    return function->eval(env);
 }
 
 EvalResult ForLoop::eval(std::shared_ptr<Environment> env) const
 {
-    // JIT-transpile to while loop
-
     auto _ = init->eval(env);
-    auto _this = const_cast<ForLoop *>(this);
 
-    vector<unique_ptr<Expression>> bodyExpressions;
-    bodyExpressions.push_back(std::move(_this->body));
-    bodyExpressions.push_back(std::move(_this->modifier));
+    EvalResult result;
+    while (get<bool>(condition->eval(env)))
+    {
+        ResourceGovernor::safepoint();
+        result = step.eval(env);
+    }
+    return result;
+}
+
+EvalResult ForIn::eval(std::shared_ptr<Environment> env) const
+{
+    auto cursor = Sequence::of(iterable->eval(env))->cursor();
+    auto loopEnv = make_shared<Environment>(EvalMap{}, std::move(env));
+    loopEnv->define(name, Null{});
 
-    auto whileLoop = Loop::create(std::move(_this->condition), Block::create(std::move(bodyExpressions)));
-    return whileLoop->eval(env);
+    EvalResult result;
+    EvalResult item;
+    while (cursor->next(item))
+    {
+        ResourceGovernor::safepoint();
+        loopEnv->assign(name, std::move(item));
+        result = body->eval(loopEnv);
+    }
+    return result;
 }
 
 EvalResult Switch::eval(std::shared_ptr<Environment> env) const
@@ -180,22 +934,14 @@ EvalResult Switch::eval(std::shared_ptr<Environment> env) const
         return Null{};
     }
 
-    auto _this = const_cast<Switch *>(this);
-
-    unique_ptr<Condition> condition = Condition::create(
-        std::move(_this->cases.back().first),
-        std::move(_this->cases.back().second),
-        nullptr);
-
-    for (auto i = cases.size(); i-- > 1;)
+    for (const auto &[test, body] : cases)
     {
-        condition = Condition::create(
-            std::move(_this->cases[i - 1].first),
-            std::move(_this->cases[i - 1].second),
-            std::move(condition));
+        if (get<bool>(test->eval(env)))
+        {
+            return body->eval(env);
+        }
     }
-
-    return condition->eval(env);
+    throw runtime_error("No case of the switch matches");
 }
 
 EvalResult Increment::eval(std::shared_ptr<Environment> env) const
@@ -240,21 +986,34 @@ EvalResult ClassDeclaration::eval(std::shared_ptr<Environment> env) const
 
 EvalResult NewInstance::eval(std::shared_ptr<Environment> env) const
 {
+    ResourceGovernor::safepoint();
+
     auto classDefinition = get<ClassDefinition>(env->lookup(name));
     auto instanceEnv = make_shared<Environment>(EvalMap{}, classDefinition.env);
 
     auto constructorDefinition = get<FunctionDefinition>(classDefinition.env->lookup("constructor"));
-    auto constructorEnv = make_shared<Environment>(EvalMap{}, constructorDefinition.env);
+
+    // Frames are only shared with plain calls of the constructor if both define the same variables
+    const auto &params = constructorDefinition.params;
+    auto frames = constructorDefinition.profile && !params.empty() && params[0] == "self"
+                      ? &constructorDefinition.profile->frames
+                      : nullptr;
+    auto constructorEnv = frames ? frames->acquire(constructorDefinition.env)
+                                 : make_shared<Environment>(EvalMap{}, constructorDefinition.env);
 
     const InstanceDefinition &instanceDefinition = InstanceDefinition{instanceEnv};
     constructorEnv->define("self", instanceDefinition);
 
-    for (size_t i = 1; i < constructorDefinition.params.size(); ++i)
+    for (size_t i = 1; i < params.size(); ++i)
     {
-        constructorEnv->define(constructorDefinition.params[i], args[i - 1]->eval(env));
+        constructorEnv->define(params[i], args[i - 1]->eval(env));
     }
 
     void(constructorDefinition.body->eval(constructorEnv));
+    if (frames)
+    {
+        frames->release(std::move(constructorEnv), params.size());
+    }
 
     return instanceDefinition;
 }
@@ -265,7 +1024,98 @@ EvalResult MemberAccess::eval(std::shared_ptr<Environment> env) const
     return instanceDefinition.env->lookup(getMember());
 }
 
-FunctionDefinition MemberFunctionCall::resolveFunction(std::shared_ptr<Environment> env) const
+EvalResult MemberFunctionCall::resolveFunction(std::shared_ptr<Environment> env) const
 {
     return resolveFunctionImpl(env);
 }
+
+EvalResult ListExpression::eval(std::shared_ptr<Environment> env) const
+{
+    vector<EvalResult> values;
+    values.reserve(items.size());
+    for (const auto &item : items)
+    {
+        values.push_back(item->eval(env));
+    }
+    return List::create(std::move(values));
+}
+
+EvalResult MapExpression::eval(std::shared_ptr<Environment> env) const
+{
+    auto result = HashMap::create();
+    for (const auto &[key, value] : entries)
+    {
+        auto keyValue = key->eval(env);
+        result.map->assign(keyValue, value->eval(env));
+    }
+    return result;
+}
+
+EvalResult IndexAccess::eval(std::shared_ptr<Environment> env) const
+{
+    auto collectionValue = collection->eval(env);
+    return access(collectionValue, index->eval(env));
+}
+
+EvalResult IndexAccess::access(const EvalResult &collection, const EvalResult &index)
+{
+    if (auto list = get_if<ListValue>(&collection))
+    {
+        return list->list->at(get<int>(index));
+    }
+    if (auto map = get_if<MapValue>(&collection))
+    {
+        if (auto value = map->map->find(index))
+        {
+            return *value;
+        }
+        throw runtime_error("Key not found: " + toString(index));
+    }
+    if (auto vector = get_if<VectorValue>(&collection))
+    {
+        return vector->vector->at(get<int>(index));
+    }
+    if (auto table = get_if<TableValue>(&collection))
+    {
+        if (auto value = table->map->find(index))
+        {
+            return *value;
+        }
+        throw runtime_error("Key not found: " + toString(index));
+    }
+    throw runtime_error("Only collections can be indexed");
+}
+
+EvalResult IndexAssignment::eval(std::shared_ptr<Environment> env) const
+{
+    auto collectionValue = collection->eval(env);
+    auto indexValue = index->eval(env);
+    return assign(collectionValue, indexValue, value->eval(env));
+}
+
+EvalResult Import::eval(std::shared_ptr<Environment> env) const
+{
+    return bind(path, names, env);
+}
+
+EvalResult IndexAssignment::assign(const EvalResult &collection, const EvalResult &index, EvalResult value)
+{
+    if (auto list = get_if<ListValue>(&collection))
+    {
+        return list->list->at(get<int>(index)) = std::move(value);
+    }
+    if (auto map = get_if<MapValue>(&collection))
+    {
+        return map->map->assign(index, std::move(value));
+    }
+    if (holds_alternative<VectorValue>(collection) || holds_alternative<TableValue>(collection))
+    {
+        throw runtime_error("Persistent collections cannot be modified, use assoc");
+    }
+    throw runtime_error("Only lists and maps can be indexed");
+}
+
+EvalResult Yield::eval(std::shared_ptr<Environment>) const
+{
+    throw runtime_error("yield can only be used as a statement of a generator function");
+}
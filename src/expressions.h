@@ -3,11 +3,81 @@
 
 #include <vector>
 #include <memory>
+#include <stdexcept>
 #include <string>
 #include "eval_types.h"
 
 class Environment;
 
+class Expression;
+class Block;
+class Condition;
+class Loop;
+struct Identifier;
+struct Literal;
+class VariableDeclaration;
+class Assignment;
+class BinaryOperation;
+class FunctionDeclaration;
+class Lambda;
+class AnonymousFunctionCall;
+class FunctionCall;
+class ForLoop;
+class ForIn;
+class Switch;
+class Increment;
+class Decrement;
+class ClassDeclaration;
+class NewInstance;
+class MemberAccess;
+class MemberFunctionCall;
+class ListExpression;
+class MapExpression;
+class IndexAccess;
+class IndexAssignment;
+class Import;
+class Yield;
+
+/**
+ * Interface for passes that walk the expression tree.
+ *
+ * Every expression dispatches to the overload of its most derived class in accept.
+ */
+class ExpressionVisitor
+{
+public:
+    virtual ~ExpressionVisitor() = default;
+
+    virtual void visit(const Expression &exp) = 0;
+    virtual void visit(const Block &exp) = 0;
+    virtual void visit(const Condition &exp) = 0;
+    virtual void visit(const Loop &exp) = 0;
+    virtual void visit(const Identifier &exp) = 0;
+    virtual void visit(const Literal &exp) = 0;
+    virtual void visit(const VariableDeclaration &exp) = 0;
+    virtual void visit(const Assignment &exp) = 0;
+    virtual void visit(const BinaryOperation &exp) = 0;
+    virtual void visit(const FunctionDeclaration &exp) = 0;
+    virtual void visit(const Lambda &exp) = 0;
+    virtual void visit(const AnonymousFunctionCall &exp) = 0;
+    virtual void visit(const FunctionCall &exp) = 0;
+    virtual void visit(const ForLoop &exp) = 0;
+    virtual void visit(const ForIn &exp) = 0;
+    virtual void visit(const Switch &exp) = 0;
+    virtual void visit(const Increment &exp) = 0;
+    virtual void visit(const Decrement &exp) = 0;
+    virtual void visit(const ClassDeclaration &exp) = 0;
+    virtual void visit(const NewInstance &exp) = 0;
+    virtual void visit(const MemberAccess &exp) = 0;
+    virtual void visit(const MemberFunctionCall &exp) = 0;
+    virtual void visit(const ListExpression &exp) = 0;
+    virtual void visit(const MapExpression &exp) = 0;
+    virtual void visit(const IndexAccess &exp) = 0;
+    virtual void visit(const IndexAssignment &exp) = 0;
+    virtual void visit(const Import &exp) = 0;
+    virtual void visit(const Yield &exp) = 0;
+};
+
 /**
  * Base class for all expressions.
  *
@@ -24,18 +94,40 @@ public:
         return std::make_unique<Expression>();
     }
 
+    virtual ~Expression() = default;
+
     [[nodiscard]] virtual EvalResult eval(std::shared_ptr<Environment> env) const
     {
         return Null{};
     }
+
+    virtual void accept(ExpressionVisitor &visitor) const
+    {
+        visitor.visit(*this);
+    }
 };
 
 using ExpressionPtr = std::unique_ptr<Expression>;
 
+/**
+ * This enum is used to describe which environment a block needs for its variables.
+ *
+ * ENCLOSING: the block declares nothing and is evaluated in the enclosing environment.
+ * STACK: the block declares variables, but nothing in it can capture its environment.
+ * HEAP: the block may capture its environment, e.g. in a closure or a class.
+ */
+enum class BlockScope
+{
+    ENCLOSING,
+    STACK,
+    HEAP
+};
+
 /**
  * This class is used to group multiple expressions together.
  *
  * The eval method evaluates each expression in the block in order and returns the result of the last expression.
+ * The scope of the block is analyzed once, when it is created.
  */
 class Block : public Expression
 {
@@ -46,7 +138,7 @@ public:
     }
 
     explicit Block(std::vector<ExpressionPtr> expressions)
-        : expressions(std::move(expressions)) {}
+        : expressions(std::move(expressions)), scope(analyzeScope(this->expressions)) {}
 
     Block(Block &&other) noexcept;
 
@@ -54,8 +146,28 @@ public:
 
     [[nodiscard]] EvalResult evalBlock(std::shared_ptr<Environment> env) const;
 
+    void accept(ExpressionVisitor &visitor) const override
+    {
+        visitor.visit(*this);
+    }
+
+    [[nodiscard]] const std::vector<ExpressionPtr> &getExpressions() const
+    {
+        return expressions;
+    }
+
+    [[nodiscard]] BlockScope getScope() const
+    {
+        return scope;
+    }
+
 protected:
     std::vector<ExpressionPtr> expressions;
+
+private:
+    static BlockScope analyzeScope(const std::vector<ExpressionPtr> &expressions);
+
+    BlockScope scope = BlockScope::HEAP;
 };
 
 using BlockPtr = std::unique_ptr<Block>;
@@ -79,6 +191,26 @@ public:
 
     [[nodiscard]] EvalResult eval(std::shared_ptr<Environment> env) const override;
 
+    void accept(ExpressionVisitor &visitor) const override
+    {
+        visitor.visit(*this);
+    }
+
+    [[nodiscard]] const ExpressionPtr &getCondition() const
+    {
+        return condition;
+    }
+
+    [[nodiscard]] const ExpressionPtr &getThen() const
+    {
+        return then;
+    }
+
+    [[nodiscard]] const ExpressionPtr &getOtherwise() const
+    {
+        return otherwise;
+    }
+
 private:
     ExpressionPtr condition;
     ExpressionPtr then;
@@ -104,6 +236,21 @@ public:
 
     [[nodiscard]] EvalResult eval(std::shared_ptr<Environment> env) const override;
 
+    void accept(ExpressionVisitor &visitor) const override
+    {
+        visitor.visit(*this);
+    }
+
+    [[nodiscard]] const ExpressionPtr &getCondition() const
+    {
+        return condition;
+    }
+
+    [[nodiscard]] const ExpressionPtr &getBody() const
+    {
+        return body;
+    }
+
 private:
     ExpressionPtr condition;
     ExpressionPtr body;
@@ -126,6 +273,11 @@ public:
 
     [[nodiscard]] EvalResult eval(std::shared_ptr<Environment> env) const override;
 
+    void accept(ExpressionVisitor &visitor) const override
+    {
+        visitor.visit(*this);
+    }
+
     [[nodiscard]] std::string getName() const
     {
         return name;
@@ -157,6 +309,16 @@ public:
         return value;
     }
 
+    void accept(ExpressionVisitor &visitor) const override
+    {
+        visitor.visit(*this);
+    }
+
+    [[nodiscard]] const EvalResult &getValue() const
+    {
+        return value;
+    }
+
 private:
     EvalResult value;
 };
@@ -179,6 +341,21 @@ public:
 
     [[nodiscard]] EvalResult eval(std::shared_ptr<Environment> env) const override;
 
+    void accept(ExpressionVisitor &visitor) const override
+    {
+        visitor.visit(*this);
+    }
+
+    [[nodiscard]] std::string getName() const
+    {
+        return name;
+    }
+
+    [[nodiscard]] const ExpressionPtr &getValue() const
+    {
+        return value;
+    }
+
 private:
     std::basic_string<char> name;
     ExpressionPtr value;
@@ -212,6 +389,26 @@ public:
 
     [[nodiscard]] EvalResult eval(std::shared_ptr<Environment> env) const override;
 
+    void accept(ExpressionVisitor &visitor) const override
+    {
+        visitor.visit(*this);
+    }
+
+    [[nodiscard]] std::string getName() const
+    {
+        return name;
+    }
+
+    [[nodiscard]] const ExpressionPtr &getValue() const
+    {
+        return value;
+    }
+
+    [[nodiscard]] const MemberAccessPtr &getMemberAccess() const
+    {
+        return memberAccess;
+    }
+
 private:
     std::string name;
     ExpressionPtr value;
@@ -239,7 +436,7 @@ enum BinaryOperationType
  * The eval method evaluates the left and right expressions and performs the operation on them.
  *
  * The supported operations are:
- * - addition
+ * - addition, which also concatenates strings into ropes (see Rope)
  * - subtraction
  * - multiplication
  * - division
@@ -264,6 +461,79 @@ public:
 
     [[nodiscard]] EvalResult eval(std::shared_ptr<Environment> env) const override;
 
+    void accept(ExpressionVisitor &visitor) const override
+    {
+        visitor.visit(*this);
+    }
+
+    /**
+     * @brief Apply an operation to two integers
+     *
+     * @param type The operation
+     * @param lhs The left operand
+     * @param rhs The right operand
+     *
+     * @return The integer result of an arithmetic operation or the boolean result of a comparison
+     */
+    static EvalResult apply(BinaryOperationType type, int lhs, int rhs);
+
+    /**
+     * @brief Apply an arithmetic operation to two integers
+     *
+     * Results wrap at 32 bits, INT_MIN / -1 included, the same in the interpreter, in native code and in
+     * constant expressions of the compile-time DSL.
+     *
+     * @param type The operation, an addition, a subtraction, a multiplication, a division or a modulus
+     * @param lhs The left operand
+     * @param rhs The right operand
+     *
+     * @return The result
+     *
+     * @throw std::runtime_error if the divisor is zero
+     */
+    static constexpr int arithmetic(BinaryOperationType type, int lhs, int rhs)
+    {
+        switch (type)
+        {
+        case ADDITION:
+            return static_cast<int>(static_cast<unsigned>(lhs) + static_cast<unsigned>(rhs));
+        case SUBTRACTION:
+            return static_cast<int>(static_cast<unsigned>(lhs) - static_cast<unsigned>(rhs));
+        case MULTIPLICATION:
+            return static_cast<int>(static_cast<unsigned>(lhs) * static_cast<unsigned>(rhs));
+        case DIVISION:
+            if (rhs == 0)
+            {
+                throw std::runtime_error("Division by zero");
+            }
+            // INT_MIN / -1 overflows, the negation wraps back to INT_MIN
+            return rhs == -1 ? static_cast<int>(0u - static_cast<unsigned>(lhs)) : lhs / rhs;
+        case MOD:
+            if (rhs == 0)
+            {
+                throw std::runtime_error("Division by zero");
+            }
+            return rhs == -1 ? 0 : lhs % rhs;
+        default:
+            throw std::runtime_error("Not an arithmetic operation");
+        }
+    }
+
+    [[nodiscard]] BinaryOperationType getType() const
+    {
+        return type;
+    }
+
+    [[nodiscard]] const ExpressionPtr &getLeft() const
+    {
+        return left;
+    }
+
+    [[nodiscard]] const ExpressionPtr &getRight() const
+    {
+        return right;
+    }
+
 private:
     BinaryOperationType type;
     ExpressionPtr left;
@@ -274,6 +544,7 @@ private:
  * This class is used to represent a function declaration
  *
  * The eval method creates a new function definition and assigns it to the function name in the environment.
+ * A function whose body yields is a generator function, this is found when the declaration is created.
  */
 class FunctionDeclaration : public Expression
 {
@@ -283,15 +554,57 @@ public:
         return std::make_unique<FunctionDeclaration>(std::move(name), std::move(params), std::move(body));
     }
 
+    static auto create(std::string name, std::vector<std::string> params, ExpressionPtr body, bool generator)
+    {
+        return std::make_unique<FunctionDeclaration>(std::move(name), std::move(params), std::move(body), generator);
+    }
+
     FunctionDeclaration(std::string name, std::vector<std::string> params, ExpressionPtr body)
-        : name(std::move(name)), params(std::move(params)), body(std::move(body)) {}
+        : name(std::move(name)), params(std::move(params)), body(std::move(body)), generator(yields(this->body.get())) {}
+
+    FunctionDeclaration(std::string name, std::vector<std::string> params, ExpressionPtr body, bool generator)
+        : name(std::move(name)), params(std::move(params)), body(std::move(body)), generator(generator) {}
 
     [[nodiscard]] EvalResult eval(std::shared_ptr<Environment> env) const override;
 
+    void accept(ExpressionVisitor &visitor) const override
+    {
+        visitor.visit(*this);
+    }
+
+    [[nodiscard]] std::string getName() const
+    {
+        return name;
+    }
+
+    [[nodiscard]] const std::vector<std::string> &getParams() const
+    {
+        return params;
+    }
+
+    [[nodiscard]] const std::shared_ptr<const Expression> &getBody() const
+    {
+        return body;
+    }
+
+    [[nodiscard]] bool isGenerator() const
+    {
+        return generator;
+    }
+
+    /**
+     * @brief Check whether a function body yields, i.e. whether it is the body of a generator function
+     *
+     * Only yields at statement positions count, yields in nested functions belong to those functions.
+     */
+    static bool yields(const Expression *body);
+
 protected:
     std::string name;
     std::vector<std::string> params;
-    ExpressionPtr body;
+    // Shared with every function definition created from the declaration
+    std::shared_ptr<const Expression> body;
+    bool generator;
 };
 
 using FunctionDeclarationPtr = std::unique_ptr<FunctionDeclaration>;
@@ -309,10 +622,39 @@ public:
         return std::make_unique<Lambda>(std::move(params), std::move(body));
     }
 
+    static auto create(std::vector<std::string> params, ExpressionPtr body, bool generator)
+    {
+        return std::make_unique<Lambda>(std::move(params), std::move(body), generator);
+    }
+
     Lambda(std::vector<std::string> params, ExpressionPtr _body)
         : FunctionDeclaration("", std::move(params), std::move(_body)) {}
 
+    Lambda(std::vector<std::string> params, ExpressionPtr _body, bool generator)
+        : FunctionDeclaration("", std::move(params), std::move(_body), generator) {}
+
     [[nodiscard]] EvalResult eval(std::shared_ptr<Environment> env) const override;
+
+    void accept(ExpressionVisitor &visitor) const override
+    {
+        visitor.visit(*this);
+    }
+
+    /**
+     * @brief Build the environment of a closure created in the given environment
+     *
+     * The closure only holds the variables its body refers to, shared through cells with the scopes that
+     * define them, and looks up everything else in the global environment. If the body refers to a name
+     * that is not defined yet, the whole defining environment is captured instead.
+     *
+     * @param params The parameters of the function
+     * @param body The body of the function
+     * @param env The environment the function is created in
+     *
+     * @return The environment of the closure
+     */
+    static std::shared_ptr<Environment> closure(const std::vector<std::string> &params, const Expression &body,
+                                                const std::shared_ptr<Environment> &env);
 };
 
 /**
@@ -333,10 +675,38 @@ public:
 
     [[nodiscard]] EvalResult eval(std::shared_ptr<Environment> env) const override;
 
+    void accept(ExpressionVisitor &visitor) const override
+    {
+        visitor.visit(*this);
+    }
+
+    [[nodiscard]] const ExpressionPtr &getFunction() const
+    {
+        return function;
+    }
+
+    [[nodiscard]] const std::vector<ExpressionPtr> &getArgs() const
+    {
+        return args;
+    }
+
+    /**
+     * @brief Call a function with evaluated arguments
+     *
+     * @param callee The function definition or native function to call
+     * @param args The values of the arguments
+     * @param count The number of arguments
+     *
+     * @return The result of the call
+     *
+     * @throw std::runtime_error if the number of arguments does not match the function
+     */
+    static EvalResult invoke(const EvalResult &callee, const EvalResult *args, size_t count);
+
 protected:
-    [[nodiscard]] virtual FunctionDefinition resolveFunction(std::shared_ptr<Environment> env) const;
+    [[nodiscard]] virtual EvalResult resolveFunction(std::shared_ptr<Environment> env) const;
 
-    [[nodiscard]] virtual FunctionDefinition resolveFunctionImpl(std::shared_ptr<Environment> env) const;
+    [[nodiscard]] virtual EvalResult resolveFunctionImpl(std::shared_ptr<Environment> env) const;
 
 private:
     ExpressionPtr function;
@@ -364,8 +734,18 @@ public:
     FunctionCall(std::string name, std::vector<ExpressionPtr> args)
         : name(std::move(name)), AnonymousFunctionCall(nullptr, std::move(args)) {}
 
+    void accept(ExpressionVisitor &visitor) const override
+    {
+        visitor.visit(*this);
+    }
+
+    [[nodiscard]] std::string getName() const
+    {
+        return name;
+    }
+
 protected:
-    [[nodiscard]] FunctionDefinition resolveFunction(std::shared_ptr<Environment> env) const override;
+    [[nodiscard]] EvalResult resolveFunction(std::shared_ptr<Environment> env) const override;
 
 private:
     std::string name;
@@ -378,6 +758,7 @@ private:
  * The eval method evaluates the init expression, then evaluates the condition expression.
  * If the result is true, evaluates the body expression and then evaluates the modifier expression.
  * This process is repeated until the condition expression evaluates to false.
+ * The body and the modifier are evaluated together, as one block per iteration.
  */
 class ForLoop : public Expression
 {
@@ -388,14 +769,97 @@ public:
     }
 
     ForLoop(ExpressionPtr init, ExpressionPtr condition, ExpressionPtr modifier, ExpressionPtr body)
-        : init(std::move(init)), condition(std::move(condition)), modifier(std::move(modifier)), body(std::move(body)) {}
+        : init(std::move(init)), condition(std::move(condition)), step(steps(std::move(body), std::move(modifier))) {}
 
     [[nodiscard]] EvalResult eval(std::shared_ptr<Environment> env) const override;
 
+    void accept(ExpressionVisitor &visitor) const override
+    {
+        visitor.visit(*this);
+    }
+
+    [[nodiscard]] const ExpressionPtr &getInit() const
+    {
+        return init;
+    }
+
+    [[nodiscard]] const ExpressionPtr &getCondition() const
+    {
+        return condition;
+    }
+
+    [[nodiscard]] const ExpressionPtr &getModifier() const
+    {
+        return step.getExpressions()[1];
+    }
+
+    [[nodiscard]] const ExpressionPtr &getBody() const
+    {
+        return step.getExpressions()[0];
+    }
+
+    [[nodiscard]] const Block &getStep() const
+    {
+        return step;
+    }
+
 private:
+    static std::vector<ExpressionPtr> steps(ExpressionPtr body, ExpressionPtr modifier)
+    {
+        std::vector<ExpressionPtr> expressions;
+        expressions.push_back(std::move(body));
+        expressions.push_back(std::move(modifier));
+        return expressions;
+    }
+
     ExpressionPtr init;
     ExpressionPtr condition;
-    ExpressionPtr modifier;
+    Block step;
+};
+
+/**
+ * This class is used to represent a loop over the items of a list, map, vector, table, generator or sequence.
+ *
+ * The eval method pulls the items from a cursor one at a time and evaluates the body with the variable set to
+ * each of them. The variable is defined once, in an environment of its own, and assigned for every item.
+ * The result is the result of the last evaluation of the body.
+ */
+class ForIn : public Expression
+{
+public:
+    static auto create(std::string name, ExpressionPtr iterable, ExpressionPtr body)
+    {
+        return std::make_unique<ForIn>(std::move(name), std::move(iterable), std::move(body));
+    }
+
+    ForIn(std::string name, ExpressionPtr iterable, ExpressionPtr body)
+        : name(std::move(name)), iterable(std::move(iterable)), body(std::move(body)) {}
+
+    [[nodiscard]] EvalResult eval(std::shared_ptr<Environment> env) const override;
+
+    void accept(ExpressionVisitor &visitor) const override
+    {
+        visitor.visit(*this);
+    }
+
+    [[nodiscard]] const std::string &getName() const
+    {
+        return name;
+    }
+
+    [[nodiscard]] const ExpressionPtr &getIterable() const
+    {
+        return iterable;
+    }
+
+    [[nodiscard]] const ExpressionPtr &getBody() const
+    {
+        return body;
+    }
+
+private:
+    std::string name;
+    ExpressionPtr iterable;
     ExpressionPtr body;
 };
 
@@ -403,6 +867,7 @@ private:
  * This class is used to represent a switch statement in an expression.
  *
  * The eval method evaluates each case expression in order and returns the result of the first case expression that evaluates to true.
+ * If no case matches, an error is thrown.
  */
 class Switch : public Expression
 {
@@ -417,6 +882,16 @@ public:
 
     [[nodiscard]] EvalResult eval(std::shared_ptr<Environment> env) const override;
 
+    void accept(ExpressionVisitor &visitor) const override
+    {
+        visitor.visit(*this);
+    }
+
+    [[nodiscard]] const std::vector<std::pair<ExpressionPtr, ExpressionPtr>> &getCases() const
+    {
+        return cases;
+    }
+
 private:
     std::vector<std::pair<ExpressionPtr, ExpressionPtr>> cases;
 };
@@ -438,6 +913,16 @@ public:
 
     [[nodiscard]] EvalResult eval(std::shared_ptr<Environment> env) const override;
 
+    void accept(ExpressionVisitor &visitor) const override
+    {
+        visitor.visit(*this);
+    }
+
+    [[nodiscard]] const IdentifierPtr &getIdentifier() const
+    {
+        return identifier;
+    }
+
 private:
     IdentifierPtr identifier;
 };
@@ -459,6 +944,16 @@ public:
 
     [[nodiscard]] EvalResult eval(std::shared_ptr<Environment> env) const override;
 
+    void accept(ExpressionVisitor &visitor) const override
+    {
+        visitor.visit(*this);
+    }
+
+    [[nodiscard]] const IdentifierPtr &getIdentifier() const
+    {
+        return identifier;
+    }
+
 private:
     IdentifierPtr identifier;
 };
@@ -481,6 +976,21 @@ public:
 
     [[nodiscard]] EvalResult eval(std::shared_ptr<Environment> env) const override;
 
+    void accept(ExpressionVisitor &visitor) const override
+    {
+        visitor.visit(*this);
+    }
+
+    [[nodiscard]] std::string getName() const
+    {
+        return name;
+    }
+
+    [[nodiscard]] const IdentifierPtr &getParent() const
+    {
+        return parent;
+    }
+
 private:
     std::string name;
     IdentifierPtr parent;
@@ -505,6 +1015,21 @@ public:
 
     [[nodiscard]] EvalResult eval(std::shared_ptr<Environment> env) const override;
 
+    void accept(ExpressionVisitor &visitor) const override
+    {
+        visitor.visit(*this);
+    }
+
+    [[nodiscard]] std::string getName() const
+    {
+        return name;
+    }
+
+    [[nodiscard]] const std::vector<ExpressionPtr> &getArgs() const
+    {
+        return args;
+    }
+
 private:
     std::string name;
     std::vector<ExpressionPtr> args;
@@ -528,6 +1053,11 @@ public:
 
     [[nodiscard]] EvalResult eval(std::shared_ptr<Environment> env) const override;
 
+    void accept(ExpressionVisitor &visitor) const override
+    {
+        visitor.visit(*this);
+    }
+
     std::string getInstance() const
     {
         return instance;
@@ -558,8 +1088,274 @@ public:
     MemberFunctionCall(MemberAccessPtr memberFunction, std::vector<ExpressionPtr> args)
         : AnonymousFunctionCall(std::move(memberFunction), std::move(args)) {}
 
+    void accept(ExpressionVisitor &visitor) const override
+    {
+        visitor.visit(*this);
+    }
+
 protected:
-    [[nodiscard]] FunctionDefinition resolveFunction(std::shared_ptr<Environment> env) const override;
+    [[nodiscard]] EvalResult resolveFunction(std::shared_ptr<Environment> env) const override;
+};
+
+/**
+ * This class is used to represent a list literal
+ *
+ * The eval method evaluates the items in order and returns a new list.
+ */
+class ListExpression : public Expression
+{
+public:
+    static auto create(std::vector<ExpressionPtr> items)
+    {
+        return std::make_unique<ListExpression>(std::move(items));
+    }
+
+    explicit ListExpression(std::vector<ExpressionPtr> items)
+        : items(std::move(items)) {}
+
+    [[nodiscard]] EvalResult eval(std::shared_ptr<Environment> env) const override;
+
+    void accept(ExpressionVisitor &visitor) const override
+    {
+        visitor.visit(*this);
+    }
+
+    [[nodiscard]] const std::vector<ExpressionPtr> &getItems() const
+    {
+        return items;
+    }
+
+private:
+    std::vector<ExpressionPtr> items;
+};
+
+/**
+ * This class is used to represent a hash map literal
+ *
+ * The eval method evaluates the keys and values in order and returns a new map. Later entries replace
+ * earlier ones with an equal key.
+ */
+class MapExpression : public Expression
+{
+public:
+    static auto create(std::vector<std::pair<ExpressionPtr, ExpressionPtr>> entries)
+    {
+        return std::make_unique<MapExpression>(std::move(entries));
+    }
+
+    explicit MapExpression(std::vector<std::pair<ExpressionPtr, ExpressionPtr>> entries)
+        : entries(std::move(entries)) {}
+
+    [[nodiscard]] EvalResult eval(std::shared_ptr<Environment> env) const override;
+
+    void accept(ExpressionVisitor &visitor) const override
+    {
+        visitor.visit(*this);
+    }
+
+    [[nodiscard]] const std::vector<std::pair<ExpressionPtr, ExpressionPtr>> &getEntries() const
+    {
+        return entries;
+    }
+
+private:
+    std::vector<std::pair<ExpressionPtr, ExpressionPtr>> entries;
+};
+
+/**
+ * This class is used to represent an indexed access to a list or a map
+ *
+ * Lists are indexed by position in constant time, maps by key.
+ */
+class IndexAccess : public Expression
+{
+public:
+    static auto create(ExpressionPtr collection, ExpressionPtr index)
+    {
+        return std::make_unique<IndexAccess>(std::move(collection), std::move(index));
+    }
+
+    IndexAccess(ExpressionPtr collection, ExpressionPtr index)
+        : collection(std::move(collection)), index(std::move(index)) {}
+
+    [[nodiscard]] EvalResult eval(std::shared_ptr<Environment> env) const override;
+
+    void accept(ExpressionVisitor &visitor) const override
+    {
+        visitor.visit(*this);
+    }
+
+    /**
+     * @brief Get the item of a list or the value of a key in a map
+     *
+     * @param collection The list or the map
+     * @param index The position in the list or the key in the map
+     *
+     * @return The item or the value
+     *
+     * @throw std::runtime_error if the collection cannot be indexed or the key is not in the map
+     * @throw std::out_of_range if the position is out of the list
+     */
+    static EvalResult access(const EvalResult &collection, const EvalResult &index);
+
+    [[nodiscard]] const ExpressionPtr &getCollection() const
+    {
+        return collection;
+    }
+
+    [[nodiscard]] const ExpressionPtr &getIndex() const
+    {
+        return index;
+    }
+
+private:
+    ExpressionPtr collection;
+    ExpressionPtr index;
+};
+
+/**
+ * This class is used to represent an assignment to an item of a list or a key of a map
+ *
+ * Lists can only be assigned within their bounds, maps add missing keys.
+ */
+class IndexAssignment : public Expression
+{
+public:
+    static auto create(ExpressionPtr collection, ExpressionPtr index, ExpressionPtr value)
+    {
+        return std::make_unique<IndexAssignment>(std::move(collection), std::move(index), std::move(value));
+    }
+
+    IndexAssignment(ExpressionPtr collection, ExpressionPtr index, ExpressionPtr value)
+        : collection(std::move(collection)), index(std::move(index)), value(std::move(value)) {}
+
+    [[nodiscard]] EvalResult eval(std::shared_ptr<Environment> env) const override;
+
+    void accept(ExpressionVisitor &visitor) const override
+    {
+        visitor.visit(*this);
+    }
+
+    /**
+     * @brief Set the item of a list or the value of a key in a map
+     *
+     * @param collection The list or the map
+     * @param index The position in the list or the key in the map
+     * @param value The value to store
+     *
+     * @return The stored value
+     *
+     * @throw std::runtime_error if the collection cannot be indexed
+     * @throw std::out_of_range if the position is out of the list
+     */
+    static EvalResult assign(const EvalResult &collection, const EvalResult &index, EvalResult value);
+
+    [[nodiscard]] const ExpressionPtr &getCollection() const
+    {
+        return collection;
+    }
+
+    [[nodiscard]] const ExpressionPtr &getIndex() const
+    {
+        return index;
+    }
+
+    [[nodiscard]] const ExpressionPtr &getValue() const
+    {
+        return value;
+    }
+
+private:
+    ExpressionPtr collection;
+    ExpressionPtr index;
+    ExpressionPtr value;
+};
+
+/**
+ * This class is used to represent the import of a module
+ *
+ * The module is a program image file, compiled once per process by the ModuleCache and evaluated once per
+ * root environment. The import defines the listed exports of the module, or all of them if none are listed,
+ * in the current environment, and evaluates to a table of the defined names and values.
+ */
+class Import : public Expression
+{
+public:
+    static auto create(std::string path, std::vector<std::string> names = {})
+    {
+        return std::make_unique<Import>(std::move(path), std::move(names));
+    }
+
+    Import(std::string path, std::vector<std::string> names)
+        : path(std::move(path)), names(std::move(names)) {}
+
+    [[nodiscard]] EvalResult eval(std::shared_ptr<Environment> env) const override;
+
+    void accept(ExpressionVisitor &visitor) const override
+    {
+        visitor.visit(*this);
+    }
+
+    /**
+     * @brief Define the exports of a module in an environment
+     *
+     * @param path The path of the module, relative to the working directory
+     * @param names The exports to define, all of them if empty
+     * @param env The environment to define the exports in
+     *
+     * @return A table of the defined names and values
+     *
+     * @throw std::runtime_error if the module cannot be compiled or does not export one of the names
+     */
+    static EvalResult bind(const std::string &path, const std::vector<std::string> &names, const std::shared_ptr<Environment> &env);
+
+    [[nodiscard]] const std::string &getPath() const
+    {
+        return path;
+    }
+
+    [[nodiscard]] const std::vector<std::string> &getNames() const
+    {
+        return names;
+    }
+
+private:
+    std::string path;
+    std::vector<std::string> names;
+};
+
+/**
+ * This class is used to represent a yield in a generator function
+ *
+ * A yield is a statement: it can appear in a block, a branch of a condition, the body of a loop or a case of
+ * a switch. The generator evaluates the value, suspends the function and hands the value to the caller of
+ * next. Evaluating a yield in any other position, or outside of a generator, is an error.
+ */
+class Yield : public Expression
+{
+public:
+    static auto create(ExpressionPtr value)
+    {
+        return std::make_unique<Yield>(std::move(value));
+    }
+
+    explicit Yield(ExpressionPtr value)
+        : value(std::move(value)) {}
+
+    [[nodiscard]] EvalResult eval(std::shared_ptr<Environment> env) const override;
+
+    void accept(ExpressionVisitor &visitor) const override
+    {
+        visitor.visit(*this);
+    }
+
+    [[nodiscard]] const ExpressionPtr &getValue() const
+    {
+        return value;
+    }
+
+private:
+    ExpressionPtr value;
 };
 
 #endif // CPP_EVA_EXPRESSIONS_H
@@ -0,0 +1,87 @@
+#include "frame_pool.h"
+
+#include <atomic>
+#include <vector>
+#include "environment.h"
+#include "governor.h"
+
+using namespace std;
+
+namespace
+{
+    constexpr size_t cacheEntries = 16;
+
+    atomic<uint64_t> nextPoolId{1};
+
+    /**
+     * Free frames of the pool that last used an entry of the cache on this thread.
+     */
+    struct CachedFrames
+    {
+        uint64_t pool = 0;
+        vector<shared_ptr<Environment>> frames;
+    };
+
+    thread_local CachedFrames cache[cacheEntries];
+
+    CachedFrames &cached(uint64_t pool)
+    {
+        return cache[pool % cacheEntries];
+    }
+}
+
+FramePool::FramePool() : id(nextPoolId.fetch_add(1, memory_order_relaxed)) {}
+
+std::shared_ptr<Environment> FramePool::acquire(const std::shared_ptr<Environment> &parent)
+{
+    if (!ResourceGovernor::current())
+    {
+        auto &entry = cached(id);
+        if (entry.pool == id && !entry.frames.empty())
+        {
+            auto frame = std::move(entry.frames.back());
+            entry.frames.pop_back();
+            frame->parent = parent;
+            return frame;
+        }
+    }
+    return make_shared<Environment>(EvalMap{}, parent);
+}
+
+void FramePool::release(std::shared_ptr<Environment> frame, size_t variables)
+{
+    if (frame.use_count() != 1 || frame->governorId != 0 || frame->vars.size() != variables)
+    {
+        return;
+    }
+
+    // Values and the parent are dropped now, so a pooled frame keeps nothing alive
+    for (auto &variable : frame->vars)
+    {
+        variable.value = Null{};
+        variable.cell.reset();
+    }
+    frame->parent.reset();
+
+    auto &entry = cached(id);
+    if (entry.pool != id)
+    {
+        // Frames of the previous pool hold no values, dropping them runs no script code
+        entry.frames.clear();
+        entry.pool = id;
+    }
+    if (entry.frames.size() < capacity)
+    {
+        if (entry.frames.capacity() == 0)
+        {
+            entry.frames.reserve(capacity);
+        }
+        entry.frames.push_back(std::move(frame));
+    }
+}
+
+size_t FramePool::size() const
+{
+    const auto &entry = cached(id);
+    return entry.pool == id ? entry.frames.size() : 0;
+}
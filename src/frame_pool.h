@@ -0,0 +1,59 @@
+#ifndef CPP_EVA_FRAME_POOL_H
+#define CPP_EVA_FRAME_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+class Environment;
+
+/**
+ * This class is used to recycle the call environments of a function.
+ *
+ * A frame is returned to the pool when the call is over and nothing else references it, i.e. it was not
+ * captured by a closure or an inner scope, and it holds exactly the variables defined for the call. Its
+ * values are reset, but the table keeps its variables, so the next call overwrites the parameters in place
+ * without allocating. Frames created while a resource governor is active are never pooled, so the heap
+ * accounting stays exact.
+ *
+ * Free frames are kept per thread, in a small thread local cache indexed by the id of the pool, so
+ * acquiring and releasing a frame takes no lock. Pools whose ids share an entry of the cache evict each
+ * other's frames.
+ */
+class FramePool
+{
+public:
+    static constexpr size_t capacity = 32;
+
+    FramePool();
+
+    FramePool(const FramePool &) = delete;
+    FramePool &operator=(const FramePool &) = delete;
+
+    /**
+     * @brief Get an environment for a call
+     *
+     * @param parent The environment the function was defined in
+     *
+     * @return A recycled frame, or a new one if the pool is empty
+     */
+    std::shared_ptr<Environment> acquire(const std::shared_ptr<Environment> &parent);
+
+    /**
+     * @brief Return the environment of a finished call to the pool
+     *
+     * @param frame The environment returned by acquire
+     * @param variables The number of variables defined for the call
+     */
+    void release(std::shared_ptr<Environment> frame, size_t variables);
+
+    /**
+     * @brief Get the number of free frames of the pool on the calling thread
+     */
+    [[nodiscard]] size_t size() const;
+
+private:
+    const uint64_t id;
+};
+
+#endif // CPP_EVA_FRAME_POOL_H
@@ -0,0 +1,382 @@
+#include "generator.h"
+
+#include <iterator>
+#include <stdexcept>
+#include <variant>
+#include "environment.h"
+#include "expressions.h"
+#include "governor.h"
+#include "sequence.h"
+
+using namespace std;
+
+/**
+ * This class is used to run the body of a generator from one yield to the next.
+ *
+ * Blocks, conditions, loops and switches are evaluated here, so that they can stop at a yield and be
+ * resumed. Every other expression cannot contain a yield at a statement position and is evaluated by the
+ * interpreter. Each resumable expression takes the next frame of the path while the generator is being
+ * resumed, and adds its frame to the path when a yield below it suspends the generator.
+ */
+class Generator::Runner : public ExpressionVisitor
+{
+public:
+    explicit Runner(vector<Frame> path) : path(std::move(path)) {}
+
+    /**
+     * @brief Evaluate an expression until it finishes or yields
+     *
+     * @return true if the expression suspended at a yield
+     */
+    bool run(const Expression &exp, const shared_ptr<Environment> &env, EvalResult &result)
+    {
+        State state{env, Null{}, false};
+        auto outer = current;
+        current = &state;
+        exp.accept(*this);
+        current = outer;
+        result = std::move(state.result);
+        return state.suspended;
+    }
+
+    /**
+     * @brief Get the path to the yield the body suspended at, outermost frame first
+     */
+    vector<Frame> takePath()
+    {
+        return {make_move_iterator(unwound.rbegin()), make_move_iterator(unwound.rend())};
+    }
+
+    EvalResult takeYielded()
+    {
+        return std::move(yielded);
+    }
+
+    void visit(const Expression &exp) override
+    {
+        evaluate(exp);
+    }
+
+    void visit(const Block &exp) override
+    {
+        auto &state = *current;
+        Frame frame;
+        if (!restore(frame))
+        {
+            // The environment of the block has to outlive a suspension, so it is always allocated
+            frame.env = exp.getScope() == BlockScope::ENCLOSING ? state.env : make_shared<Environment>(EvalMap{}, state.env);
+        }
+
+        const auto &expressions = exp.getExpressions();
+        for (; frame.position < expressions.size(); ++frame.position)
+        {
+            if (run(*expressions[frame.position], frame.env, state.result))
+            {
+                suspend(std::move(frame));
+                return;
+            }
+        }
+    }
+
+    void visit(const Condition &exp) override
+    {
+        auto &state = *current;
+        Frame frame;
+        if (!restore(frame))
+        {
+            frame.position = get<bool>(exp.getCondition()->eval(state.env)) ? 0 : 1;
+        }
+
+        const auto &branch = frame.position == 0 ? exp.getThen() : exp.getOtherwise();
+        if (!branch)
+        {
+            throw runtime_error("Condition without otherwise branch is false");
+        }
+        if (run(*branch, state.env, state.result))
+        {
+            suspend(std::move(frame));
+        }
+    }
+
+    void visit(const Loop &exp) override
+    {
+        loop(*exp.getCondition(), *exp.getBody());
+    }
+
+    void visit(const Identifier &exp) override
+    {
+        evaluate(exp);
+    }
+
+    void visit(const Literal &exp) override
+    {
+        evaluate(exp);
+    }
+
+    void visit(const VariableDeclaration &exp) override
+    {
+        evaluate(exp);
+    }
+
+    void visit(const Assignment &exp) override
+    {
+        evaluate(exp);
+    }
+
+    void visit(const BinaryOperation &exp) override
+    {
+        evaluate(exp);
+    }
+
+    void visit(const FunctionDeclaration &exp) override
+    {
+        evaluate(exp);
+    }
+
+    void visit(const Lambda &exp) override
+    {
+        evaluate(exp);
+    }
+
+    void visit(const AnonymousFunctionCall &exp) override
+    {
+        evaluate(exp);
+    }
+
+    void visit(const FunctionCall &exp) override
+    {
+        evaluate(exp);
+    }
+
+    void visit(const ForLoop &exp) override
+    {
+        if (path.size() == next)
+        {
+            void(exp.getInit()->eval(current->env));
+        }
+        loop(*exp.getCondition(), exp.getStep());
+    }
+
+    void visit(const ForIn &exp) override
+    {
+        auto &state = *current;
+        Frame frame;
+        // A resumed loop continues in the body with the item it was suspended at
+        auto resumed = restore(frame);
+        if (!resumed)
+        {
+            frame.cursor = Sequence::of(exp.getIterable()->eval(state.env))->cursor();
+            frame.env = make_shared<Environment>(EvalMap{}, state.env);
+            frame.env->define(exp.getName(), Null{});
+        }
+
+        EvalResult item;
+        while (resumed || frame.cursor->next(item))
+        {
+            if (!resumed)
+            {
+                ResourceGovernor::safepoint();
+                void(frame.env->assign(exp.getName(), std::move(item)));
+            }
+            resumed = false;
+            if (run(*exp.getBody(), frame.env, state.result))
+            {
+                suspend(std::move(frame));
+                return;
+            }
+        }
+    }
+
+    void visit(const Switch &exp) override
+    {
+        auto &state = *current;
+        const auto &cases = exp.getCases();
+        Frame frame;
+        if (!restore(frame))
+        {
+            if (cases.empty())
+            {
+                state.result = Null{};
+                return;
+            }
+            while (frame.position < cases.size() && !get<bool>(cases[frame.position].first->eval(state.env)))
+            {
+                ++frame.position;
+            }
+            if (frame.position == cases.size())
+            {
+                throw runtime_error("No case of the switch matches");
+            }
+        }
+
+        if (run(*cases[frame.position].second, state.env, state.result))
+        {
+            suspend(std::move(frame));
+        }
+    }
+
+    void visit(const Increment &exp) override
+    {
+        evaluate(exp);
+    }
+
+    void visit(const Decrement &exp) override
+    {
+        evaluate(exp);
+    }
+
+    void visit(const ClassDeclaration &exp) override
+    {
+        evaluate(exp);
+    }
+
+    void visit(const NewInstance &exp) override
+    {
+        evaluate(exp);
+    }
+
+    void visit(const MemberAccess &exp) override
+    {
+        evaluate(exp);
+    }
+
+    void visit(const MemberFunctionCall &exp) override
+    {
+        evaluate(exp);
+    }
+
+    void visit(const ListExpression &exp) override
+    {
+        evaluate(exp);
+    }
+
+    void visit(const MapExpression &exp) override
+    {
+        evaluate(exp);
+    }
+
+    void visit(const IndexAccess &exp) override
+    {
+        evaluate(exp);
+    }
+
+    void visit(const IndexAssignment &exp) override
+    {
+        evaluate(exp);
+    }
+
+    void visit(const Import &exp) override
+    {
+        evaluate(exp);
+    }
+
+    void visit(const Yield &exp) override
+    {
+        Frame frame;
+        if (restore(frame))
+        {
+            // The generator was suspended here, the yield itself is over
+            current->result = Null{};
+            return;
+        }
+        yielded = exp.getValue() ? exp.getValue()->eval(current->env) : EvalResult(Null{});
+        suspend(std::move(frame));
+    }
+
+private:
+    struct State
+    {
+        shared_ptr<Environment> env;
+        EvalResult result;
+        bool suspended = false;
+    };
+
+    void evaluate(const Expression &exp)
+    {
+        current->result = exp.eval(current->env);
+    }
+
+    void loop(const Expression &condition, const Expression &body)
+    {
+        auto &state = *current;
+        Frame frame;
+        // A resumed loop continues in the body, the condition was checked before the suspension
+        auto resumed = restore(frame);
+        while (resumed || get<bool>(condition.eval(state.env)))
+        {
+            if (!resumed)
+            {
+                ResourceGovernor::safepoint();
+            }
+            resumed = false;
+            if (run(body, state.env, state.result))
+            {
+                suspend(std::move(frame));
+                return;
+            }
+        }
+    }
+
+    bool restore(Frame &frame)
+    {
+        if (next == path.size())
+        {
+            return false;
+        }
+        frame = std::move(path[next++]);
+        return true;
+    }
+
+    void suspend(Frame frame)
+    {
+        unwound.push_back(std::move(frame));
+        current->suspended = true;
+    }
+
+    vector<Frame> path;
+    size_t next = 0;
+    // Frames of the suspended expressions, innermost first
+    vector<Frame> unwound;
+    EvalResult yielded;
+    State *current = nullptr;
+};
+
+bool Generator::next(EvalResult &value)
+{
+    if (!body)
+    {
+        return false;
+    }
+    if (running)
+    {
+        throw runtime_error("Generator is already running");
+    }
+
+    running = true;
+    Runner runner(std::move(frames));
+    bool suspended;
+    try
+    {
+        EvalResult result;
+        suspended = runner.run(*body, env, result);
+    }
+    catch (...)
+    {
+        running = false;
+        body.reset();
+        env.reset();
+        throw;
+    }
+    running = false;
+
+    if (!suspended)
+    {
+        // The environment of a finished generator is released right away
+        body.reset();
+        env.reset();
+        return false;
+    }
+    frames = runner.takePath();
+    value = runner.takeYielded();
+    return true;
+}
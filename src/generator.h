@@ -0,0 +1,72 @@
+#ifndef CPP_EVA_GENERATOR_H
+#define CPP_EVA_GENERATOR_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include "eval_types.h"
+
+class Cursor;
+
+/**
+ * This class is used to represent the suspended call of a generator function.
+ *
+ * Generators are stackless: nothing of the native stack is kept while a generator is suspended. The state
+ * of the call is a path of heap-allocated frames, one per block, branch, loop or switch case between the
+ * body of the function and the yield it stopped at, with the position reached in each of them, the
+ * environment of each block and the cursor of each loop over items. Resuming walks down the same path to
+ * the yield and continues after it, so a suspended generator costs a few frames however long the sequence
+ * it produces is.
+ *
+ * A generator runs on the thread that calls next, it must not be resumed by two threads at once.
+ */
+class Generator
+{
+public:
+    static auto create(std::shared_ptr<const Expression> body, std::shared_ptr<Environment> env)
+    {
+        return std::make_shared<Generator>(std::move(body), std::move(env));
+    }
+
+    /**
+     * @param body The body of the generator function
+     * @param env The environment of the call, with the arguments defined
+     */
+    Generator(std::shared_ptr<const Expression> body, std::shared_ptr<Environment> env)
+        : body(std::move(body)), env(std::move(env)) {}
+
+    /**
+     * @brief Run the body up to its next yield
+     *
+     * @param value Set to the yielded value
+     *
+     * @return false once the body has finished, value is left unchanged then
+     *
+     * @throw std::runtime_error if the generator is resumed from its own body; errors of the body are
+     * rethrown and finish the generator
+     */
+    bool next(EvalResult &value);
+
+    [[nodiscard]] bool isDone() const
+    {
+        return !body;
+    }
+
+private:
+    class Runner;
+
+    struct Frame
+    {
+        size_t position = 0;
+        std::shared_ptr<Environment> env;
+        std::shared_ptr<Cursor> cursor;
+    };
+
+    std::shared_ptr<const Expression> body;
+    std::shared_ptr<Environment> env;
+    // The path to the yield the generator is suspended at, outermost frame first
+    std::vector<Frame> frames;
+    bool running = false;
+};
+
+#endif // CPP_EVA_GENERATOR_H
@@ -0,0 +1,100 @@
+#include "governor.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace
+{
+    atomic<uint64_t> nextGovernorId{1};
+
+    string describe(AbortReason reason)
+    {
+        switch (reason)
+        {
+        case AbortReason::FUEL_EXHAUSTED:
+            return "Evaluation aborted: fuel exhausted";
+        case AbortReason::HEAP_LIMIT_EXCEEDED:
+            return "Evaluation aborted: heap limit exceeded";
+        case AbortReason::CANCELLED:
+            return "Evaluation aborted: cancelled";
+        default:
+            return "Evaluation aborted";
+        }
+    }
+}
+
+EvaluationAborted::EvaluationAborted(AbortReason reason)
+    : runtime_error(describe(reason)), reason(reason) {}
+
+ResourceGovernor::ResourceGovernor(const EvalLimits &limits)
+    : fuelLimit(limits.fuel),
+      maxHeapBytes(limits.maxHeapBytes),
+      id(nextGovernorId.fetch_add(1, memory_order_relaxed)),
+      cancel(limits.cancel),
+      previous(active)
+{
+    refill();
+    active = this;
+}
+
+ResourceGovernor::~ResourceGovernor()
+{
+    active = previous;
+}
+
+void ResourceGovernor::refill()
+{
+    if (cancel && cancel->load(memory_order_relaxed))
+    {
+        throw EvaluationAborted(AbortReason::CANCELLED);
+    }
+
+    if (fuelLimit == 0)
+    {
+        slice = sliceSize;
+        granted += slice;
+        return;
+    }
+
+    if (exhausted)
+    {
+        throw EvaluationAborted(AbortReason::FUEL_EXHAUSTED);
+    }
+
+    // The last unit of fuel was consumed by the current safepoint: the next one has to fail.
+    slice = granted == fuelLimit ? 1 : min(sliceSize, fuelLimit - granted);
+    exhausted = granted == fuelLimit;
+    granted += slice;
+}
+
+uint64_t ResourceGovernor::charge(size_t bytes)
+{
+    auto governor = active;
+    if (!governor)
+    {
+        return 0;
+    }
+
+    governor->heapBytes += bytes;
+    if (governor->maxHeapBytes != 0 && governor->heapBytes > governor->maxHeapBytes)
+    {
+        governor->heapBytes -= bytes;
+        throw EvaluationAborted(AbortReason::HEAP_LIMIT_EXCEEDED);
+    }
+    return governor->id;
+}
+
+void ResourceGovernor::release(uint64_t id, size_t bytes)
+{
+    auto governor = active;
+    if (governor && governor->id == id)
+    {
+        governor->heapBytes -= min(bytes, governor->heapBytes);
+    }
+}
+
+uint64_t ResourceGovernor::getFuelUsed() const
+{
+    return granted - slice;
+}
@@ -0,0 +1,192 @@
+#ifndef CPP_EVA_GOVERNOR_H
+#define CPP_EVA_GOVERNOR_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+/**
+ * This struct is used to describe the execution budget of a single evaluation.
+ *
+ * A zero fuel or heap limit means the resource is not limited.
+ * The cancel flag may be raised from any thread to stop the evaluation at the next safepoint.
+ */
+struct EvalLimits
+{
+    uint64_t fuel = 0;
+    size_t maxHeapBytes = 0;
+    std::shared_ptr<std::atomic<bool>> cancel;
+};
+
+/**
+ * This enum is used to describe why an evaluation was aborted.
+ */
+enum class AbortReason
+{
+    FUEL_EXHAUSTED,
+    HEAP_LIMIT_EXCEEDED,
+    CANCELLED
+};
+
+/**
+ * This exception is thrown when an evaluation exceeds its execution budget.
+ */
+class EvaluationAborted : public std::runtime_error
+{
+public:
+    explicit EvaluationAborted(AbortReason reason);
+
+    [[nodiscard]] AbortReason getReason() const
+    {
+        return reason;
+    }
+
+private:
+    AbortReason reason;
+};
+
+/**
+ * This class is used to enforce EvalLimits on the current thread.
+ *
+ * The governor is installed for the lifetime of the object and restores the previously active one on destruction.
+ * Expressions call safepoint() on every loop iteration and function call, and environments report the bytes
+ * they hold with charge() and release().
+ *
+ * A safepoint costs one thread local load, one decrement and one branch: the fuel counter and the cancel flag
+ * are only inspected when the current slice of fuel runs out.
+ */
+class ResourceGovernor
+{
+public:
+    explicit ResourceGovernor(const EvalLimits &limits);
+
+    ~ResourceGovernor();
+
+    ResourceGovernor(const ResourceGovernor &) = delete;
+    ResourceGovernor &operator=(const ResourceGovernor &) = delete;
+
+    /**
+     * @brief Get the governor installed on the current thread
+     *
+     * @return The active governor or nullptr if the evaluation is not limited
+     */
+    static ResourceGovernor *current()
+    {
+        return active;
+    }
+
+    /**
+     * @brief Consume one unit of fuel and poll the cancel flag
+     *
+     * @throw EvaluationAborted if the fuel is exhausted or the evaluation was cancelled
+     */
+    static void safepoint()
+    {
+        if (auto governor = active; governor && --governor->slice == 0)
+        {
+            governor->refill();
+        }
+    }
+
+    /**
+     * @brief Account heap bytes allocated by the current evaluation
+     *
+     * @param bytes The number of bytes allocated
+     *
+     * @return The id of the governor the bytes were charged to or 0 if the evaluation is not limited
+     *
+     * @throw EvaluationAborted if the heap limit is exceeded
+     */
+    static uint64_t charge(size_t bytes);
+
+    /**
+     * @brief Return heap bytes previously charged to the governor with the given id
+     *
+     * Bytes charged to a governor that is no longer active on this thread are ignored.
+     *
+     * @param id The id returned by charge
+     * @param bytes The number of bytes released
+     */
+    static void release(uint64_t id, size_t bytes);
+
+    [[nodiscard]] uint64_t getFuelUsed() const;
+
+    [[nodiscard]] size_t getHeapBytes() const
+    {
+        return heapBytes;
+    }
+
+private:
+    void refill();
+
+    static constexpr uint64_t sliceSize = 1024;
+
+    static inline thread_local ResourceGovernor *active = nullptr;
+
+    uint64_t slice = 0;
+    uint64_t granted = 0;
+    uint64_t fuelLimit;
+    bool exhausted = false;
+    size_t heapBytes = 0;
+    size_t maxHeapBytes;
+    uint64_t id;
+    std::shared_ptr<std::atomic<bool>> cancel;
+    ResourceGovernor *previous;
+};
+
+/**
+ * This class is used to charge the heap bytes of an object to the governor active when it grows.
+ *
+ * Owners call grow() before allocating more storage. The bytes are returned to that governor when the
+ * account is destroyed, the way environments account for their variables.
+ */
+class HeapAccount
+{
+public:
+    HeapAccount() = default;
+
+    ~HeapAccount()
+    {
+        if (governorId != 0)
+        {
+            ResourceGovernor::release(governorId, charged);
+        }
+    }
+
+    HeapAccount(const HeapAccount &) = delete;
+    HeapAccount &operator=(const HeapAccount &) = delete;
+
+    /**
+     * @brief Charge bytes about to be allocated by the owner
+     *
+     * @param bytes The number of bytes
+     *
+     * @throw EvaluationAborted if the heap limit is exceeded
+     */
+    void grow(size_t bytes)
+    {
+        if (bytes == 0 || !ResourceGovernor::current())
+        {
+            return;
+        }
+
+        auto id = ResourceGovernor::charge(bytes);
+        if (governorId == 0 && charged == 0)
+        {
+            governorId = id;
+        }
+        if (id == governorId)
+        {
+            charged += bytes;
+        }
+    }
+
+private:
+    uint64_t governorId = 0;
+    size_t charged = 0;
+};
+
+#endif // CPP_EVA_GOVERNOR_H
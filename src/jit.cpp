@@ -0,0 +1,954 @@
+#include "jit.h"
+
+#include <cstring>
+#include <exception>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+#include "environment.h"
+#include "expressions.h"
+#include "governor.h"
+#include "perf_counters.h"
+
+#if defined(__x86_64__) && defined(__linux__)
+#define CPP_EVA_JIT_X86_64 1
+#include <sys/mman.h>
+#endif
+
+using namespace std;
+
+namespace
+{
+    enum class Type
+    {
+        INT,
+        BOOL
+    };
+
+    /**
+     * State of a call of native code. The status is the first member: the generated code tests it after calls.
+     */
+    struct NativeContext
+    {
+        enum Status : int32_t
+        {
+            OK,
+            FAILED,
+            DIVISION_BY_ZERO
+        };
+
+        int32_t status = OK;
+        const CompiledFunction *code;
+        const FunctionDefinition *function;
+        exception_ptr error;
+    };
+
+    static_assert(offsetof(NativeContext, status) == 0);
+
+    /**
+     * A call of a named function made from native code.
+     */
+    struct CallSite
+    {
+        string name;
+        vector<Type> args;
+        Type result;
+    };
+
+    constexpr size_t maxParams = 16;
+}
+
+/**
+ * This class is used to own the executable memory of a compiled function.
+ */
+class CompiledFunction
+{
+public:
+    using Entry = int64_t (*)(const int64_t *args, NativeContext *context);
+
+    CompiledFunction(const vector<uint8_t> &bytes, size_t arity, Type result, vector<CallSite> sites);
+
+    ~CompiledFunction();
+
+    CompiledFunction(const CompiledFunction &) = delete;
+    CompiledFunction &operator=(const CompiledFunction &) = delete;
+
+    [[nodiscard]] int64_t run(const FunctionDefinition &function, const int64_t *args, NativeContext &context) const
+    {
+        context.code = this;
+        context.function = &function;
+        return entry(args, &context);
+    }
+
+    [[nodiscard]] EvalResult box(int64_t value) const
+    {
+        if (result == Type::BOOL)
+        {
+            return value != 0;
+        }
+        return static_cast<int>(value);
+    }
+
+    [[nodiscard]] size_t getArity() const
+    {
+        return arity;
+    }
+
+    [[nodiscard]] Type getResult() const
+    {
+        return result;
+    }
+
+    [[nodiscard]] const CallSite &getSite(uint32_t index) const
+    {
+        return sites[index];
+    }
+
+private:
+    void *memory = nullptr;
+    size_t size = 0;
+    Entry entry = nullptr;
+    size_t arity;
+    Type result;
+    vector<CallSite> sites;
+};
+
+CallProfile::CallProfile() = default;
+
+CallProfile::~CallProfile() = default;
+
+namespace
+{
+    int64_t callFromNative(NativeContext *context, uint32_t index, const int64_t *args) noexcept;
+
+    /**
+     * Thrown while generating code for a construct the JIT does not support.
+     */
+    struct Unsupported
+    {
+    };
+
+    /**
+     * This class is used to emit x86-64 machine code.
+     */
+    class Assembler
+    {
+    public:
+        void emit(initializer_list<uint8_t> bytes)
+        {
+            code.insert(code.end(), bytes);
+        }
+
+        void emit32(int32_t value)
+        {
+            uint8_t bytes[4];
+            memcpy(bytes, &value, sizeof(bytes));
+            code.insert(code.end(), bytes, bytes + sizeof(bytes));
+        }
+
+        void emit64(uint64_t value)
+        {
+            uint8_t bytes[8];
+            memcpy(bytes, &value, sizeof(bytes));
+            code.insert(code.end(), bytes, bytes + sizeof(bytes));
+        }
+
+        /**
+         * Emit a jump with a 32 bit displacement and return its position for patch().
+         */
+        size_t jump(initializer_list<uint8_t> opcode)
+        {
+            emit(opcode);
+            auto at = code.size();
+            emit32(0);
+            return at;
+        }
+
+        void patch(size_t at, size_t target)
+        {
+            auto displacement = static_cast<int32_t>(target - (at + 4));
+            memcpy(&code[at], &displacement, sizeof(displacement));
+        }
+
+        void patch32(size_t at, int32_t value)
+        {
+            memcpy(&code[at], &value, sizeof(value));
+        }
+
+        [[nodiscard]] size_t position() const
+        {
+            return code.size();
+        }
+
+        vector<uint8_t> code;
+    };
+
+    /**
+     * This class is used to translate the body of a function to machine code.
+     *
+     * Values are kept in rax, temporaries are pushed on the stack, parameters and locals live in stack slots.
+     * rbx holds the array of arguments and r12 the native context for the whole call.
+     */
+    class CodeGenerator : public ExpressionVisitor
+    {
+    public:
+        unique_ptr<CompiledFunction> compile(const FunctionDefinition &function)
+        {
+            if (function.params.size() > maxParams || !function.body)
+            {
+                throw Unsupported{};
+            }
+
+            // push rbp; mov rbp, rsp; push rbx; push r12; sub rsp, frame; mov rbx, rdi; mov r12, rsi
+            as.emit({0x55, 0x48, 0x89, 0xE5, 0x53, 0x41, 0x54, 0x48, 0x81, 0xEC});
+            auto frame = as.position();
+            as.emit32(0);
+            as.emit({0x48, 0x89, 0xFB, 0x49, 0x89, 0xF4});
+
+            scopes.emplace_back();
+            for (size_t i = 0; i < function.params.size(); ++i)
+            {
+                auto slot = allocate();
+                // mov rax, [rbx + 8 * i]
+                as.emit({0x48, 0x8B, 0x83});
+                as.emit32(static_cast<int32_t>(8 * i));
+                store(slot);
+                scopes.back()[function.params[i]] = {slot, Type::INT};
+            }
+
+            compileValue(*function.body, true);
+            auto result = type;
+            epilogue();
+
+            auto errorExit = as.position();
+            for (auto at : errorJumps)
+            {
+                as.patch(at, errorExit);
+            }
+            // xor eax, eax
+            as.emit({0x31, 0xC0});
+            epilogue();
+
+            as.patch32(frame, static_cast<int32_t>((slots * 8 + 15) & ~size_t(15)));
+            return make_unique<CompiledFunction>(as.code, function.params.size(), result, std::move(sites));
+        }
+
+        void visit(const Expression &) override
+        {
+            throw Unsupported{};
+        }
+
+        void visit(const Block &exp) override
+        {
+            const auto &expressions = exp.getExpressions();
+            if (expressions.empty())
+            {
+                loadImmediate(0);
+                type = Type::INT;
+                return;
+            }
+
+            scopes.emplace_back();
+            for (const auto &statement : expressions)
+            {
+                compileValue(*statement, true);
+            }
+            scopes.pop_back();
+        }
+
+        void visit(const Condition &exp) override
+        {
+            if (!exp.getOtherwise())
+            {
+                throw Unsupported{};
+            }
+
+            compileTest(*exp.getCondition());
+            auto otherwise = as.jump({0x0F, 0x84});
+
+            compileValue(*exp.getThen());
+            auto thenType = type;
+            auto end = as.jump({0xE9});
+
+            as.patch(otherwise, as.position());
+            compileValue(*exp.getOtherwise());
+            if (type != thenType)
+            {
+                throw Unsupported{};
+            }
+            as.patch(end, as.position());
+        }
+
+        void visit(const Loop &exp) override
+        {
+            // The loop evaluates to the last value of the body or to 0 if the body never runs
+            auto result = allocate();
+            loadImmediate(0);
+            store(result);
+
+            auto top = as.position();
+            compileTest(*exp.getCondition());
+            auto end = as.jump({0x0F, 0x84});
+
+            compileValue(*exp.getBody());
+            if (type != Type::INT)
+            {
+                throw Unsupported{};
+            }
+            store(result);
+            auto back = as.jump({0xE9});
+            as.patch(back, top);
+
+            as.patch(end, as.position());
+            load(result);
+            type = Type::INT;
+        }
+
+        void visit(const Identifier &exp) override
+        {
+            const auto &local = resolve(exp.getName());
+            load(local.slot);
+            type = local.type;
+        }
+
+        void visit(const Literal &exp) override
+        {
+            const auto &value = exp.getValue();
+            if (auto number = get_if<int>(&value))
+            {
+                loadImmediate(*number);
+                type = Type::INT;
+            }
+            else if (auto flag = get_if<bool>(&value))
+            {
+                loadImmediate(*flag ? 1 : 0);
+                type = Type::BOOL;
+            }
+            else
+            {
+                throw Unsupported{};
+            }
+        }
+
+        void visit(const VariableDeclaration &exp) override
+        {
+            // Declarations outside of blocks, e.g. in a branch of a condition, depend on control flow
+            if (!allowDeclarations || scopes.back().count(exp.getName()))
+            {
+                throw Unsupported{};
+            }
+
+            compileValue(*exp.getValue());
+            auto slot = allocate();
+            store(slot);
+            scopes.back()[exp.getName()] = {slot, type};
+        }
+
+        void visit(const Assignment &exp) override
+        {
+            if (exp.getMemberAccess())
+            {
+                throw Unsupported{};
+            }
+
+            const auto local = resolve(exp.getName());
+            compileValue(*exp.getValue());
+            if (type != local.type)
+            {
+                throw Unsupported{};
+            }
+            store(local.slot);
+        }
+
+        void visit(const BinaryOperation &exp) override
+        {
+            compileOperand(*exp.getLeft());
+            // push rax
+            as.emit({0x50});
+            ++depth;
+            compileOperand(*exp.getRight());
+            // mov rcx, rax; pop rax
+            as.emit({0x48, 0x89, 0xC1, 0x58});
+            --depth;
+
+            switch (exp.getType())
+            {
+            case ADDITION:
+                as.emit({0x01, 0xC8});
+                break;
+            case SUBTRACTION:
+                as.emit({0x29, 0xC8});
+                break;
+            case MULTIPLICATION:
+                as.emit({0x0F, 0xAF, 0xC1});
+                break;
+            case DIVISION:
+            case MOD:
+            {
+                // test ecx, ecx; jne divide; mov dword [r12], DIVISION_BY_ZERO; jmp error
+                as.emit({0x85, 0xC9});
+                auto divide = as.jump({0x0F, 0x85});
+                as.emit({0x41, 0xC7, 0x04, 0x24});
+                as.emit32(NativeContext::DIVISION_BY_ZERO);
+                errorJumps.push_back(as.jump({0xE9}));
+                as.patch(divide, as.position());
+                // idiv traps on INT_MIN / -1, a divisor of -1 negates or yields 0 instead:
+                // cmp ecx, -1; jne divide; neg eax or xor eax, eax; jmp done
+                as.emit({0x83, 0xF9, 0xFF});
+                auto divideNegative = as.jump({0x0F, 0x85});
+                if (exp.getType() == MOD)
+                {
+                    as.emit({0x31, 0xC0});
+                }
+                else
+                {
+                    as.emit({0xF7, 0xD8});
+                }
+                auto done = as.jump({0xE9});
+                as.patch(divideNegative, as.position());
+                // cdq; idiv ecx
+                as.emit({0x99, 0xF7, 0xF9});
+                if (exp.getType() == MOD)
+                {
+                    // mov eax, edx
+                    as.emit({0x89, 0xD0});
+                }
+                as.patch(done, as.position());
+                break;
+            }
+            case GREATER:
+                compare(0x9F);
+                return;
+            case LESS:
+                compare(0x9C);
+                return;
+            case EQUAL:
+                compare(0x94);
+                return;
+            case NOT_EQUAL:
+                compare(0x95);
+                return;
+            case GREATER_OR_EQUAL:
+                compare(0x9D);
+                return;
+            case LESS_OR_EQUAL:
+                compare(0x9E);
+                return;
+            default:
+                throw Unsupported{};
+            }
+
+            // Arithmetic wraps at 32 bits like int: movsxd rax, eax
+            as.emit({0x48, 0x63, 0xC0});
+            type = Type::INT;
+        }
+
+        void visit(const FunctionDeclaration &) override
+        {
+            throw Unsupported{};
+        }
+
+        void visit(const Lambda &) override
+        {
+            throw Unsupported{};
+        }
+
+        void visit(const AnonymousFunctionCall &) override
+        {
+            throw Unsupported{};
+        }
+
+        void visit(const FunctionCall &exp) override
+        {
+            // The result of a call can only be used where the interpreter checks its type as well
+            if (!expected || isLocal(exp.getName()))
+            {
+                throw Unsupported{};
+            }
+            auto result = *expected;
+
+            // Arguments are stored in consecutive slots, the first one at the lowest address
+            const auto &args = exp.getArgs();
+            auto first = slots;
+            slots += args.size();
+            auto base = args.empty() ? first : first + args.size() - 1;
+
+            CallSite site{exp.getName(), {}, result};
+            for (size_t i = 0; i < args.size(); ++i)
+            {
+                compileValue(*args[i]);
+                site.args.push_back(type);
+                store(base - i);
+            }
+
+            auto index = static_cast<int32_t>(sites.size());
+            sites.push_back(std::move(site));
+
+            if (depth % 2)
+            {
+                // sub rsp, 8
+                as.emit({0x48, 0x83, 0xEC, 0x08});
+            }
+            // mov rdi, r12; mov esi, index; lea rdx, [rbp + base]; mov rax, callFromNative; call rax
+            as.emit({0x4C, 0x89, 0xE7, 0xBE});
+            as.emit32(index);
+            as.emit({0x48, 0x8D, 0x95});
+            as.emit32(offset(base));
+            as.emit({0x48, 0xB8});
+            as.emit64(reinterpret_cast<uint64_t>(&callFromNative));
+            as.emit({0xFF, 0xD0});
+            if (depth % 2)
+            {
+                // add rsp, 8
+                as.emit({0x48, 0x83, 0xC4, 0x08});
+            }
+
+            // cmp dword [r12], OK; jne error
+            as.emit({0x41, 0x83, 0x3C, 0x24, 0x00});
+            errorJumps.push_back(as.jump({0x0F, 0x85}));
+            type = result;
+        }
+
+        void visit(const ForLoop &) override
+        {
+            throw Unsupported{};
+        }
+
+        void visit(const ForIn &) override
+        {
+            throw Unsupported{};
+        }
+
+        void visit(const Switch &) override
+        {
+            throw Unsupported{};
+        }
+
+        void visit(const Increment &exp) override
+        {
+            step(exp.getIdentifier()->getName(), 0xC0);
+        }
+
+        void visit(const Decrement &exp) override
+        {
+            step(exp.getIdentifier()->getName(), 0xE8);
+        }
+
+        void visit(const ClassDeclaration &) override
+        {
+            throw Unsupported{};
+        }
+
+        void visit(const NewInstance &) override
+        {
+            throw Unsupported{};
+        }
+
+        void visit(const MemberAccess &) override
+        {
+            throw Unsupported{};
+        }
+
+        void visit(const MemberFunctionCall &) override
+        {
+            throw Unsupported{};
+        }
+
+        void visit(const ListExpression &) override
+        {
+            throw Unsupported{};
+        }
+
+        void visit(const MapExpression &) override
+        {
+            throw Unsupported{};
+        }
+
+        void visit(const IndexAccess &) override
+        {
+            throw Unsupported{};
+        }
+
+        void visit(const IndexAssignment &) override
+        {
+            throw Unsupported{};
+        }
+
+        void visit(const Import &) override
+        {
+            throw Unsupported{};
+        }
+
+        void visit(const Yield &) override
+        {
+            throw Unsupported{};
+        }
+
+    private:
+        struct Local
+        {
+            size_t slot;
+            Type type;
+        };
+
+        /**
+         * Compile an expression whose value is used without a type check, declarations are only allowed
+         * for statements of a block.
+         */
+        void compileValue(const Expression &exp, bool declaration = false)
+        {
+            compile(exp, nullopt, declaration);
+        }
+
+        void compileOperand(const Expression &exp)
+        {
+            compile(exp, Type::INT, false);
+            if (type != Type::INT)
+            {
+                throw Unsupported{};
+            }
+        }
+
+        void compileTest(const Expression &exp)
+        {
+            compile(exp, Type::BOOL, false);
+            if (type != Type::BOOL)
+            {
+                throw Unsupported{};
+            }
+            // test eax, eax
+            as.emit({0x85, 0xC0});
+        }
+
+        /**
+         * The expectation and the declaration flag only apply to the expression itself, not to its children.
+         */
+        void compile(const Expression &exp, optional<Type> expectation, bool declaration)
+        {
+            expected = expectation;
+            allowDeclarations = declaration;
+            exp.accept(*this);
+        }
+
+        void compare(uint8_t condition)
+        {
+            // cmp eax, ecx; setcc al; movzx eax, al
+            as.emit({0x39, 0xC8, 0x0F, condition, 0xC0, 0x0F, 0xB6, 0xC0});
+            type = Type::BOOL;
+        }
+
+        void step(const string &name, uint8_t operation)
+        {
+            const auto local = resolve(name);
+            if (local.type != Type::INT)
+            {
+                throw Unsupported{};
+            }
+            load(local.slot);
+            // add eax, 1 or sub eax, 1; movsxd rax, eax
+            as.emit({0x83, operation, 0x01, 0x48, 0x63, 0xC0});
+            store(local.slot);
+            type = Type::INT;
+        }
+
+        bool isLocal(const string &name) const
+        {
+            for (auto scope = scopes.rbegin(); scope != scopes.rend(); ++scope)
+            {
+                if (scope->count(name))
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        const Local &resolve(const string &name) const
+        {
+            for (auto scope = scopes.rbegin(); scope != scopes.rend(); ++scope)
+            {
+                auto it = scope->find(name);
+                if (it != scope->end())
+                {
+                    return it->second;
+                }
+            }
+            // Variables of enclosing environments are not tracked by the compiled code
+            throw Unsupported{};
+        }
+
+        size_t allocate()
+        {
+            return slots++;
+        }
+
+        static int32_t offset(size_t slot)
+        {
+            // Slots are below the saved rbx and r12
+            return -24 - static_cast<int32_t>(8 * slot);
+        }
+
+        void load(size_t slot)
+        {
+            // mov rax, [rbp + offset]
+            as.emit({0x48, 0x8B, 0x85});
+            as.emit32(offset(slot));
+        }
+
+        void store(size_t slot)
+        {
+            // mov [rbp + offset], rax
+            as.emit({0x48, 0x89, 0x85});
+            as.emit32(offset(slot));
+        }
+
+        void loadImmediate(int32_t value)
+        {
+            // mov rax, imm32
+            as.emit({0x48, 0xC7, 0xC0});
+            as.emit32(value);
+        }
+
+        void epilogue()
+        {
+            // lea rsp, [rbp - 16]; pop r12; pop rbx; pop rbp; ret
+            as.emit({0x48, 0x8D, 0x65, 0xF0, 0x41, 0x5C, 0x5B, 0x5D, 0xC3});
+        }
+
+        Assembler as;
+        vector<unordered_map<string, Local>> scopes;
+        vector<CallSite> sites;
+        vector<size_t> errorJumps;
+        size_t slots = 0;
+        size_t depth = 0;
+        Type type = Type::INT;
+        optional<Type> expected;
+        bool allowDeclarations = false;
+    };
+
+    /**
+     * Convert a value to the representation used by native code.
+     */
+    bool unbox(const EvalResult &value, Type type, int64_t &result)
+    {
+        if (type == Type::INT)
+        {
+            if (auto number = get_if<int>(&value))
+            {
+                result = *number;
+                return true;
+            }
+            return false;
+        }
+        if (auto flag = get_if<bool>(&value))
+        {
+            result = *flag ? 1 : 0;
+            return true;
+        }
+        return false;
+    }
+
+    const CompiledFunction *compile(const FunctionDefinition &fun, CallProfile &profile)
+    {
+        lock_guard<mutex> guard(profile.lock);
+        if (auto code = profile.code.load(memory_order_acquire))
+        {
+            return code;
+        }
+
+        try
+        {
+            profile.owner = CodeGenerator().compile(fun);
+        }
+        catch (const Unsupported &)
+        {
+            profile.rejected.store(true, memory_order_relaxed);
+            return nullptr;
+        }
+        catch (const exception &)
+        {
+            // Executable memory may be unavailable, e.g. under a strict W^X policy
+            profile.rejected.store(true, memory_order_relaxed);
+            return nullptr;
+        }
+
+        profile.code.store(profile.owner.get(), memory_order_release);
+        return profile.owner.get();
+    }
+
+    [[noreturn]] void raise(const NativeContext &context)
+    {
+        if (context.status == NativeContext::DIVISION_BY_ZERO)
+        {
+            throw runtime_error("Division by zero");
+        }
+        rethrow_exception(context.error);
+    }
+
+    int64_t callFromNative(NativeContext *context, uint32_t index, const int64_t *args) noexcept
+    {
+        try
+        {
+            const auto &site = context->code->getSite(index);
+            const auto callee = context->function->env->lookup(site.name);
+            const size_t count = site.args.size();
+
+            // Compiled callees with integer parameters are called directly, without boxing the arguments
+            auto fun = get_if<FunctionDefinition>(&callee);
+            auto code = fun && fun->profile ? fun->profile->code.load(memory_order_acquire) : nullptr;
+            bool direct = code && code->getArity() == count && Jit::isEnabled() && !ResourceGovernor::current() &&
+                          !PerfProfiler::countsCalls();
+            for (size_t i = 0; direct && i < count; ++i)
+            {
+                direct = site.args[i] == Type::INT;
+            }
+
+            if (direct)
+            {
+                NativeContext inner;
+                auto value = code->run(*fun, args, inner);
+                if (inner.status != NativeContext::OK)
+                {
+                    context->status = inner.status;
+                    context->error = inner.error;
+                    return 0;
+                }
+                if (code->getResult() != site.result)
+                {
+                    throw bad_variant_access();
+                }
+                return value;
+            }
+
+            vector<EvalResult> values;
+            values.reserve(count);
+            for (size_t i = 0; i < count; ++i)
+            {
+                if (site.args[i] == Type::BOOL)
+                {
+                    values.emplace_back(args[i] != 0);
+                }
+                else
+                {
+                    values.emplace_back(static_cast<int>(args[i]));
+                }
+            }
+
+            auto result = AnonymousFunctionCall::invoke(callee, values.data(), count);
+            if (site.result == Type::BOOL)
+            {
+                return get<bool>(result) ? 1 : 0;
+            }
+            return get<int>(result);
+        }
+        catch (...)
+        {
+            context->error = current_exception();
+            context->status = NativeContext::FAILED;
+            return 0;
+        }
+    }
+}
+
+CompiledFunction::CompiledFunction(const vector<uint8_t> &bytes, size_t arity, Type result, vector<CallSite> sites)
+    : arity(arity), result(result), sites(std::move(sites))
+{
+#ifdef CPP_EVA_JIT_X86_64
+    size = bytes.size();
+    memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+    {
+        throw runtime_error("Cannot allocate memory for native code");
+    }
+
+    memcpy(memory, bytes.data(), size);
+    if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0)
+    {
+        munmap(memory, size);
+        throw runtime_error("Cannot make native code executable");
+    }
+    entry = reinterpret_cast<Entry>(memory);
+#else
+    throw runtime_error("Native code is not supported on this platform");
+#endif
+}
+
+CompiledFunction::~CompiledFunction()
+{
+#ifdef CPP_EVA_JIT_X86_64
+    munmap(memory, size);
+#endif
+}
+
+bool Jit::tryCall(const FunctionDefinition &fun, const EvalResult *args, size_t count, EvalResult &result)
+{
+#ifdef CPP_EVA_JIT_X86_64
+    auto profile = fun.profile.get();
+    if (!profile || !isEnabled() || ResourceGovernor::current() || PerfProfiler::countsCalls())
+    {
+        return false;
+    }
+
+    auto code = profile->code.load(memory_order_acquire);
+    if (!code)
+    {
+        if (profile->rejected.load(memory_order_relaxed) ||
+            profile->calls.fetch_add(1, memory_order_relaxed) + 1 < hotCallThreshold)
+        {
+            return false;
+        }
+        code = compile(fun, *profile);
+        if (!code)
+        {
+            return false;
+        }
+    }
+
+    // Type guard: compiled code is specialized for integer arguments
+    int64_t values[maxParams];
+    if (count != code->getArity())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (!unbox(args[i], Type::INT, values[i]))
+        {
+            return false;
+        }
+    }
+
+    NativeContext context;
+    auto value = code->run(fun, values, context);
+    if (context.status != NativeContext::OK)
+    {
+        raise(context);
+    }
+    result = code->box(value);
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool Jit::isCompiled(const FunctionDefinition &fun)
+{
+    return fun.profile && fun.profile->code.load(memory_order_acquire) != nullptr;
+}
+
+bool Jit::isRejected(const FunctionDefinition &fun)
+{
+    return fun.profile && fun.profile->rejected.load(memory_order_relaxed);
+}
+
+bool Jit::isSupported()
+{
+#ifdef CPP_EVA_JIT_X86_64
+    return true;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,95 @@
+#ifndef CPP_EVA_JIT_H
+#define CPP_EVA_JIT_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include "eval_types.h"
+#include "frame_pool.h"
+
+class CompiledFunction;
+
+/**
+ * This struct is used to count the calls of a function, to keep its native code once it is compiled and
+ * to recycle its call frames.
+ */
+struct CallProfile
+{
+    CallProfile();
+
+    ~CallProfile();
+
+    std::atomic<uint32_t> calls{0};
+    std::atomic<bool> rejected{false};
+    std::atomic<const CompiledFunction *> code{nullptr};
+    std::mutex lock;
+    std::unique_ptr<CompiledFunction> owner;
+    FramePool frames;
+};
+
+/**
+ * This class is used to run hot functions as native code.
+ *
+ * A function is compiled for x86-64 once it has been called hotCallThreshold times. Only functions whose bodies
+ * use integers, booleans, parameters and locals, binary operations, conditions, while loops, increments,
+ * decrements and calls of named functions are compiled, the others are marked as rejected and always interpreted.
+ *
+ * Compiled code expects integer arguments: calls with arguments of other types, calls with a resource governor
+ * installed and calls on other platforms are interpreted. Calls made from native code go back through
+ * AnonymousFunctionCall::invoke unless the callee is compiled as well, and their results are checked against
+ * the type the compiled code expects, so type errors are reported like in the interpreter.
+ */
+class Jit
+{
+public:
+    static constexpr uint32_t hotCallThreshold = 8;
+
+    /**
+     * @brief Run the function as native code if it is compiled or hot enough to be compiled
+     *
+     * @param fun The function to call
+     * @param args The values of the arguments
+     * @param count The number of arguments
+     * @param result The result of the call, set if the function was run as native code
+     *
+     * @return true if the function was run as native code, false if it has to be interpreted
+     */
+    static bool tryCall(const FunctionDefinition &fun, const EvalResult *args, size_t count, EvalResult &result);
+
+    /**
+     * @brief Check whether the function has been compiled to native code
+     */
+    static bool isCompiled(const FunctionDefinition &fun);
+
+    /**
+     * @brief Check whether the function was found unsuitable for compilation
+     */
+    static bool isRejected(const FunctionDefinition &fun);
+
+    /**
+     * @brief Check whether native code can be generated on this platform
+     */
+    static bool isSupported();
+
+    /**
+     * @brief Enable or disable running functions as native code
+     *
+     * @param value true to enable the JIT
+     */
+    static void setEnabled(bool value)
+    {
+        enabled.store(value, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] static bool isEnabled()
+    {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+private:
+    static inline std::atomic<bool> enabled{true};
+};
+
+#endif // CPP_EVA_JIT_H
@@ -0,0 +1,278 @@
+#include "modules.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include "environment.h"
+#include "persistent.h"
+
+using namespace std;
+
+namespace
+{
+    /**
+     * Name of the hidden variable of a root environment that holds the environment of an instantiated module.
+     */
+    string instanceName(const CompiledModule &module)
+    {
+        return "<module " + module.getPath() + ">";
+    }
+}
+
+shared_ptr<Environment> CompiledModule::instantiate(const shared_ptr<Environment> &root) const
+{
+    auto env = make_shared<Environment>(EvalMap{}, root);
+    // The top level of the module is its scope, not a block nested in it
+    if (auto block = dynamic_cast<const Block *>(program.get()))
+    {
+        void(block->evalBlock(env));
+    }
+    else
+    {
+        void(program->eval(env));
+    }
+    return env;
+}
+
+ModuleCache &ModuleCache::process()
+{
+    static ModuleCache cache;
+    return cache;
+}
+
+string ModuleCache::resolve(const string &path)
+{
+    char resolved[PATH_MAX];
+    if (!realpath(path.c_str(), resolved))
+    {
+        throw runtime_error("Cannot find module: " + path);
+    }
+    return resolved;
+}
+
+size_t ModuleCache::size() const
+{
+    lock_guard<mutex> guard(lock);
+    return modules.size();
+}
+
+shared_future<ModuleCache::LoadedImage> ModuleCache::load(const string &path)
+{
+    lock_guard<mutex> guard(lock);
+    auto found = loading.find(path);
+    if (found != loading.end())
+    {
+        return found->second;
+    }
+
+    auto future = async(launch::async, [path]
+                        {
+        LoadedImage loaded{ProgramImage::load(path), {}};
+        const auto &header = loaded.image->getHeader();
+        for (uint32_t i = 0; i < header.nodeCount; ++i)
+        {
+            const auto &node = loaded.image->getNode(i);
+            if (node.kind == NodeKind::IMPORT)
+            {
+                loaded.imports.push_back(resolve(string(loaded.image->getString(node.a))));
+            }
+        }
+        return loaded; })
+                      .share();
+    loading.emplace(path, future);
+    return future;
+}
+
+shared_ptr<const CompiledModule> ModuleCache::compile(const string &path)
+{
+    auto root = resolve(path);
+    {
+        lock_guard<mutex> guard(lock);
+        auto found = modules.find(root);
+        if (found != modules.end())
+        {
+            return found->second;
+        }
+    }
+
+    // Load the graph one level at a time, the images of a level in parallel
+    map<string, LoadedImage> graph;
+    vector<string> level{root};
+    while (!level.empty())
+    {
+        vector<pair<string, shared_future<LoadedImage>>> pending;
+        for (const auto &module : level)
+        {
+            pending.emplace_back(module, load(module));
+        }
+
+        set<string> next;
+        for (auto &[module, future] : pending)
+        {
+            try
+            {
+                graph[module] = future.get();
+            }
+            catch (...)
+            {
+                // Forget the failure, so the module is loaded again once it is fixed
+                lock_guard<mutex> guard(lock);
+                loading.erase(module);
+                throw;
+            }
+            for (const auto &import : graph[module].imports)
+            {
+                lock_guard<mutex> guard(lock);
+                if (!graph.count(import) && !modules.count(import))
+                {
+                    next.insert(import);
+                }
+            }
+        }
+        level.assign(next.begin(), next.end());
+    }
+
+    // Order the modules after their dependencies, reporting cycles, and group them by the length of their
+    // longest chain of dependencies that still have to be compiled
+    map<string, shared_ptr<const CompiledModule>> compiled;
+    map<string, size_t> height;
+    vector<vector<string>> levels;
+    vector<string> chain;
+    function<size_t(const string &)> order = [&](const string &module) -> size_t
+    {
+        auto found = height.find(module);
+        if (found != height.end())
+        {
+            return found->second;
+        }
+        {
+            lock_guard<mutex> guard(lock);
+            auto published = modules.find(module);
+            if (published != modules.end())
+            {
+                compiled.emplace(module, published->second);
+                return height[module] = 0;
+            }
+        }
+        auto cycleStart = find(chain.begin(), chain.end(), module);
+        if (cycleStart != chain.end())
+        {
+            string cycle;
+            for (auto it = cycleStart; it != chain.end(); ++it)
+            {
+                cycle += *it + " -> ";
+            }
+            throw runtime_error("Import cycle: " + cycle + module);
+        }
+
+        chain.push_back(module);
+        size_t level = 0;
+        for (const auto &import : graph.at(module).imports)
+        {
+            level = max(level, order(import) + 1);
+        }
+        chain.pop_back();
+
+        if (levels.size() <= level)
+        {
+            levels.resize(level + 1);
+        }
+        levels[level].push_back(module);
+        return height[module] = level;
+    };
+    order(root);
+
+    // Materialize the modules of a level in parallel, the first compilation to finish a module publishes it
+    auto build = [&](const string &module)
+    {
+        vector<shared_ptr<const CompiledModule>> dependencies;
+        for (const auto &import : graph.at(module).imports)
+        {
+            dependencies.push_back(compiled.at(import));
+        }
+        return make_shared<const CompiledModule>(module, graph.at(module).image, std::move(dependencies));
+    };
+    for (const auto &level : levels)
+    {
+        vector<future<shared_ptr<const CompiledModule>>> pending;
+        for (size_t i = 1; i < level.size(); ++i)
+        {
+            pending.push_back(async(launch::async, build, cref(level[i])));
+        }
+        vector<shared_ptr<const CompiledModule>> built;
+        if (!level.empty())
+        {
+            built.push_back(build(level[0]));
+        }
+        for (auto &module : pending)
+        {
+            built.push_back(module.get());
+        }
+
+        lock_guard<mutex> guard(lock);
+        for (size_t i = 0; i < level.size(); ++i)
+        {
+            loading.erase(level[i]);
+            compiled[level[i]] = modules.emplace(level[i], std::move(built[i])).first->second;
+        }
+    }
+    return compiled.at(root);
+}
+
+EvalResult Import::bind(const string &path, const vector<string> &names, const shared_ptr<Environment> &env)
+{
+    auto module = ModuleCache::process().compile(path);
+
+    auto root = env;
+    while (root->getParent())
+    {
+        root = root->getParent();
+    }
+    auto key = instanceName(*module);
+    shared_ptr<Environment> moduleEnv;
+    if (auto instance = root->getVariables().find(key))
+    {
+        moduleEnv = get<InstanceDefinition>(*instance).env;
+    }
+    else
+    {
+        moduleEnv = module->instantiate(root);
+        root->define(key, InstanceDefinition{moduleEnv});
+    }
+
+    auto exports = PersistentMap::create();
+    auto define = [&env, &exports](const string &name, const EvalResult &value)
+    {
+        if (env->getVariables().find(name))
+        {
+            env->assign(name, value);
+        }
+        else
+        {
+            env->define(name, value);
+        }
+        exports = exports.map->assoc(name, value);
+    };
+
+    if (names.empty())
+    {
+        for (const auto &variable : moduleEnv->getVariables())
+        {
+            define(variable.name, variable.get());
+        }
+    }
+    for (const auto &name : names)
+    {
+        auto value = moduleEnv->getVariables().find(name);
+        if (!value)
+        {
+            throw runtime_error("Module " + path + " does not export " + name);
+        }
+        define(name, *value);
+    }
+    return exports;
+}
@@ -0,0 +1,121 @@
+#ifndef CPP_EVA_MODULES_H
+#define CPP_EVA_MODULES_H
+
+#include <cstddef>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "program_image.h"
+
+class Environment;
+
+/**
+ * This class is used to represent a compiled module: a program image and the modules it imports.
+ *
+ * Compiled modules are immutable and shared read-only by every interpreter of the process. The top level of
+ * the image is materialized once and evaluated by every interpreter that imports the module, function
+ * bodies stay in the image until they are first called.
+ */
+class CompiledModule
+{
+public:
+    CompiledModule(std::string path, ProgramImagePtr image, std::vector<std::shared_ptr<const CompiledModule>> dependencies)
+        : path(std::move(path)), image(std::move(image)), program(this->image->materialize()),
+          dependencies(std::move(dependencies)) {}
+
+    /**
+     * @brief Evaluate the top level of the module
+     *
+     * @param root The root environment of the interpreter
+     *
+     * @return The environment of the module, whose variables are its exports
+     */
+    [[nodiscard]] std::shared_ptr<Environment> instantiate(const std::shared_ptr<Environment> &root) const;
+
+    [[nodiscard]] const std::string &getPath() const
+    {
+        return path;
+    }
+
+    [[nodiscard]] const ProgramImagePtr &getImage() const
+    {
+        return image;
+    }
+
+    [[nodiscard]] const std::vector<std::shared_ptr<const CompiledModule>> &getDependencies() const
+    {
+        return dependencies;
+    }
+
+private:
+    std::string path;
+    ProgramImagePtr image;
+    std::shared_ptr<const Expression> program;
+    std::vector<std::shared_ptr<const CompiledModule>> dependencies;
+};
+
+/**
+ * This class is used to compile every module of the process once.
+ *
+ * Compiling a module compiles the modules it imports first. The images of a dependency graph are loaded one
+ * level at a time, every module of a level on a thread of its own, and a module that is already being
+ * loaded for another compilation is waited for rather than loaded again. Cycles are reported once the graph
+ * is known, so concurrent compilations never wait on each other in a cycle. The modules are then
+ * materialized in order of their dependencies, the modules whose dependencies are all compiled in parallel.
+ */
+class ModuleCache
+{
+public:
+    /**
+     * @brief Get the cache shared by the whole process
+     */
+    static ModuleCache &process();
+
+    ModuleCache() = default;
+
+    ModuleCache(const ModuleCache &) = delete;
+    ModuleCache &operator=(const ModuleCache &) = delete;
+
+    /**
+     * @brief Get a compiled module, compiling it and its dependencies if needed
+     *
+     * @param path The path of the program image of the module, relative to the working directory
+     *
+     * @return The compiled module
+     *
+     * @throw std::runtime_error if a module cannot be found or loaded, or if the modules import each other
+     */
+    std::shared_ptr<const CompiledModule> compile(const std::string &path);
+
+    /**
+     * @brief Get the number of compiled modules
+     */
+    [[nodiscard]] size_t size() const;
+
+    /**
+     * @brief Resolve the path of a module
+     *
+     * @return The canonical absolute path
+     *
+     * @throw std::runtime_error if the module does not exist
+     */
+    static std::string resolve(const std::string &path);
+
+private:
+    struct LoadedImage
+    {
+        ProgramImagePtr image;
+        std::vector<std::string> imports;
+    };
+
+    std::shared_future<LoadedImage> load(const std::string &path);
+
+    mutable std::mutex lock;
+    std::unordered_map<std::string, std::shared_future<LoadedImage>> loading;
+    std::unordered_map<std::string, std::shared_ptr<const CompiledModule>> modules;
+};
+
+#endif // CPP_EVA_MODULES_H
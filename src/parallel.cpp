@@ -0,0 +1,432 @@
+#include "parallel.h"
+
+#include <algorithm>
+#include <set>
+#include <string>
+#include <typeinfo>
+#include <variant>
+#include <vector>
+#include "builtins.h"
+#include "collections.h"
+#include "environment.h"
+#include "expressions.h"
+#include "governor.h"
+#include "jit.h"
+#include "sequence.h"
+#include "worker_pool.h"
+
+using namespace std;
+
+namespace
+{
+    /**
+     * This class is used to find whether a function can run on several threads at once.
+     *
+     * Names are resolved like the interpreter does: against the variables declared so far in the blocks
+     * around them, then against the environment the function was defined in. The functions found in that
+     * environment are checked with their own environments.
+     */
+    class IsolationCheck : public ExpressionVisitor
+    {
+    public:
+        bool value(const EvalResult &value)
+        {
+            if (auto function = get_if<FunctionDefinition>(&value))
+            {
+                return this->function(*function);
+            }
+            if (auto native = get_if<NativeFunction>(&value))
+            {
+                return isPureBuiltin(*native);
+            }
+            // Iterating a generator runs it, iterating a channel receives from it
+            return !holds_alternative<GeneratorValue>(value) && !holds_alternative<ChannelValue>(value);
+        }
+
+        void visit(const Expression &exp) override
+        {
+            // Unknown expressions may do anything
+            if (typeid(exp) != typeid(Expression))
+            {
+                isolated = false;
+            }
+        }
+
+        void visit(const Block &exp) override
+        {
+            scopes.emplace_back();
+            for (const auto &child : exp.getExpressions())
+            {
+                walk(child);
+            }
+            scopes.pop_back();
+        }
+
+        void visit(const Condition &exp) override
+        {
+            walk(exp.getCondition());
+            branch(exp.getThen());
+            branch(exp.getOtherwise());
+        }
+
+        void visit(const Loop &exp) override
+        {
+            walk(exp.getCondition());
+            branch(exp.getBody());
+        }
+
+        void visit(const Identifier &exp) override
+        {
+            use(exp.getName());
+        }
+
+        void visit(const Literal &) override {}
+
+        void visit(const VariableDeclaration &exp) override
+        {
+            walk(exp.getValue());
+            scopes.back().push_back(exp.getName());
+        }
+
+        void visit(const Assignment &exp) override
+        {
+            walk(exp.getValue());
+            isolated = isolated && !exp.getMemberAccess() && isLocal(exp.getName());
+        }
+
+        void visit(const BinaryOperation &exp) override
+        {
+            walk(exp.getLeft());
+            walk(exp.getRight());
+        }
+
+        void visit(const FunctionDeclaration &) override
+        {
+            // Creating a closure moves the variables it captures to cells of the environments they belong to
+            isolated = false;
+        }
+
+        void visit(const Lambda &) override
+        {
+            isolated = false;
+        }
+
+        void visit(const AnonymousFunctionCall &exp) override
+        {
+            const auto &function = exp.getFunction();
+            if (function && typeid(*function) == typeid(Identifier))
+            {
+                call(static_cast<const Identifier &>(*function).getName());
+            }
+            else
+            {
+                isolated = false;
+            }
+            walk(exp.getArgs());
+        }
+
+        void visit(const FunctionCall &exp) override
+        {
+            call(exp.getName());
+            walk(exp.getArgs());
+        }
+
+        void visit(const ForLoop &exp) override
+        {
+            walk(exp.getInit());
+            walk(exp.getCondition());
+            scopes.emplace_back();
+            walk(exp.getBody());
+            walk(exp.getModifier());
+            scopes.pop_back();
+        }
+
+        void visit(const ForIn &exp) override
+        {
+            walk(exp.getIterable());
+            scopes.push_back({exp.getName()});
+            walk(exp.getBody());
+            scopes.pop_back();
+        }
+
+        void visit(const Switch &exp) override
+        {
+            for (const auto &[condition, body] : exp.getCases())
+            {
+                walk(condition);
+                branch(body);
+            }
+        }
+
+        void visit(const Increment &exp) override
+        {
+            isolated = isolated && isLocal(exp.getIdentifier()->getName());
+        }
+
+        void visit(const Decrement &exp) override
+        {
+            isolated = isolated && isLocal(exp.getIdentifier()->getName());
+        }
+
+        void visit(const ClassDeclaration &) override
+        {
+            isolated = false;
+        }
+
+        void visit(const NewInstance &) override
+        {
+            isolated = false;
+        }
+
+        void visit(const MemberAccess &exp) override
+        {
+            use(exp.getInstance());
+        }
+
+        void visit(const MemberFunctionCall &) override
+        {
+            // Methods mutate their instance
+            isolated = false;
+        }
+
+        void visit(const ListExpression &exp) override
+        {
+            walk(exp.getItems());
+        }
+
+        void visit(const MapExpression &exp) override
+        {
+            for (const auto &[key, value] : exp.getEntries())
+            {
+                walk(key);
+                walk(value);
+            }
+        }
+
+        void visit(const IndexAccess &exp) override
+        {
+            walk(exp.getCollection());
+            walk(exp.getIndex());
+        }
+
+        void visit(const IndexAssignment &) override
+        {
+            // A local variable may refer to a collection the function did not create
+            isolated = false;
+        }
+
+        void visit(const Import &) override
+        {
+            isolated = false;
+        }
+
+        void visit(const Yield &exp) override
+        {
+            walk(exp.getValue());
+        }
+
+    private:
+        static bool isPureBuiltin(const NativeFunction &native)
+        {
+            static const set<string> pure = {"abs", "min", "max", "pow", "len", "str", "concat", "substr", "has",
+                                             "keys", "vector", "table", "assoc", "dissoc", "conj", "freeze", "range"};
+            if (native.state || native.target || pure.count(native.name) == 0)
+            {
+                return false;
+            }
+            auto builtin = builtins().find(native.name);
+            return builtin != builtins().end() && get<NativeFunction>(builtin->second).callback == native.callback;
+        }
+
+        bool function(const FunctionDefinition &function)
+        {
+            // A function being checked is assumed to be isolated when it is called again, e.g. recursively
+            if (!function.body || !checked.insert(function.body.get()).second)
+            {
+                return true;
+            }
+
+            auto outerEnv = std::move(env);
+            auto outerScopes = std::move(scopes);
+            env = function.env;
+            scopes = {function.params};
+            function.body->accept(*this);
+            env = std::move(outerEnv);
+            scopes = std::move(outerScopes);
+            return isolated;
+        }
+
+        void walk(const ExpressionPtr &exp)
+        {
+            if (exp && isolated)
+            {
+                exp->accept(*this);
+            }
+        }
+
+        /**
+         * @brief Walk an expression that may not run
+         *
+         * Branches declare their variables in the enclosing environment, but only when they are taken, so
+         * the names they declare are only local within the branch.
+         */
+        void branch(const ExpressionPtr &exp)
+        {
+            scopes.emplace_back();
+            walk(exp);
+            scopes.pop_back();
+        }
+
+        void walk(const vector<ExpressionPtr> &expressions)
+        {
+            for (const auto &exp : expressions)
+            {
+                walk(exp);
+            }
+        }
+
+        bool isLocal(const string &name) const
+        {
+            return any_of(scopes.begin(), scopes.end(), [&name](const vector<string> &scope)
+                          { return find(scope.begin(), scope.end(), name) != scope.end(); });
+        }
+
+        void use(const string &name)
+        {
+            if (!isolated || isLocal(name))
+            {
+                return;
+            }
+            auto owner = env ? env->owner(name) : nullptr;
+            isolated = owner && value(owner->lookup(name));
+        }
+
+        void call(const string &name)
+        {
+            // The value of a local variable is only known when the function runs
+            isolated = isolated && !isLocal(name);
+            use(name);
+        }
+
+        shared_ptr<Environment> env;
+        vector<vector<string>> scopes;
+        set<const Expression *> checked;
+        bool isolated = true;
+    };
+
+    vector<EvalResult> itemsOf(const EvalResult &items)
+    {
+        vector<EvalResult> values;
+        auto cursor = Sequence::of(items)->cursor();
+        EvalResult item;
+        while (cursor->next(item))
+        {
+            values.push_back(std::move(item));
+        }
+        return values;
+    }
+
+    bool runsInParallel(const EvalResult &function, size_t count)
+    {
+        return count > 1 && !ResourceGovernor::current() && Parallel::isIsolated(function);
+    }
+
+    size_t chunkCount(size_t count)
+    {
+        return min(count, Parallel::maxChunks);
+    }
+
+    size_t chunkStart(size_t chunk, size_t chunks, size_t count)
+    {
+        return chunk * count / chunks;
+    }
+
+    /**
+     * @brief Copy a function for one chunk, with a call profile of its own
+     */
+    EvalResult chunkFunction(const EvalResult &function)
+    {
+        auto definition = get_if<FunctionDefinition>(&function);
+        if (!definition)
+        {
+            return function;
+        }
+        auto copy = *definition;
+        copy.profile = make_shared<CallProfile>();
+        return copy;
+    }
+}
+
+bool Parallel::isIsolated(const EvalResult &function)
+{
+    if (!holds_alternative<FunctionDefinition>(function) && !holds_alternative<NativeFunction>(function))
+    {
+        return false;
+    }
+    return IsolationCheck().value(function);
+}
+
+EvalResult Parallel::map(const EvalResult &items, const EvalResult &function)
+{
+    auto values = itemsOf(items);
+    vector<EvalResult> results(values.size());
+    if (!runsInParallel(function, values.size()))
+    {
+        for (size_t i = 0; i < values.size(); ++i)
+        {
+            results[i] = AnonymousFunctionCall::invoke(function, &values[i], 1);
+        }
+        return List::create(std::move(results));
+    }
+
+    auto chunks = chunkCount(values.size());
+    WorkerPool::process().run(chunks, [&](size_t chunk)
+                              {
+                                  auto local = chunkFunction(function);
+                                  auto end = chunkStart(chunk + 1, chunks, values.size());
+                                  for (auto i = chunkStart(chunk, chunks, values.size()); i < end; ++i)
+                                  {
+                                      results[i] = AnonymousFunctionCall::invoke(local, &values[i], 1);
+                                  } });
+    return List::create(std::move(results));
+}
+
+EvalResult Parallel::reduce(const EvalResult &items, const EvalResult &function, const EvalResult &initial,
+                           const EvalResult &combine)
+{
+    auto values = itemsOf(items);
+    EvalResult pair[2] = {initial, Null{}};
+    if (!runsInParallel(function, values.size()))
+    {
+        for (auto &value : values)
+        {
+            pair[1] = std::move(value);
+            pair[0] = AnonymousFunctionCall::invoke(function, pair, 2);
+        }
+        return std::move(pair[0]);
+    }
+
+    auto chunks = chunkCount(values.size());
+    vector<EvalResult> partials(chunks);
+    WorkerPool::process().run(chunks, [&](size_t chunk)
+                              {
+                                  auto local = chunkFunction(function);
+                                  auto begin = chunkStart(chunk, chunks, values.size());
+                                  auto end = chunkStart(chunk + 1, chunks, values.size());
+                                  EvalResult accumulated[2] = {initial, Null{}};
+                                  for (auto i = begin; i < end; ++i)
+                                  {
+                                      accumulated[1] = values[i];
+                                      accumulated[0] = AnonymousFunctionCall::invoke(local, accumulated, 2);
+                                  }
+                                  partials[chunk] = std::move(accumulated[0]); });
+
+    const auto &combining = holds_alternative<Null>(combine) ? function : combine;
+    pair[0] = std::move(partials[0]);
+    for (size_t i = 1; i < chunks; ++i)
+    {
+        pair[1] = std::move(partials[i]);
+        pair[0] = AnonymousFunctionCall::invoke(combining, pair, 2);
+    }
+    return std::move(pair[0]);
+}
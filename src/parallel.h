@@ -0,0 +1,71 @@
+#ifndef CPP_EVA_PARALLEL_H
+#define CPP_EVA_PARALLEL_H
+
+#include <cstddef>
+#include "eval_types.h"
+
+/**
+ * This class is used to apply a function to the items of a collection on the WorkerPool of the process.
+ *
+ * The items are split into at most maxChunks chunks of consecutive items, by their count only, so the same
+ * items are always combined in the same way whatever the number of threads. Every chunk calls a copy of the
+ * function with a call profile of its own: call frames are recycled and the native code is compiled per
+ * chunk, and the workers share nothing but the closure they read.
+ *
+ * Only isolated functions run in parallel. A function that may write a variable it did not declare,
+ * mutate a collection or an instance, or call anything that does, is called on the calling thread, one
+ * item after the other; so is every function while a ResourceGovernor is active, as its limits are kept
+ * per thread.
+ */
+class Parallel
+{
+public:
+    static constexpr size_t maxChunks = 64;
+
+    /**
+     * @brief Check whether a function can be called from several threads at once
+     *
+     * A function definition is isolated if its body only assigns variables it declares itself, only
+     * calls isolated functions and side effect free builtins by name, reads no generator or channel and creates no
+     * function, class or instance. Every function it refers to is checked too. The check is conservative:
+     * calling a function held by a local variable or a parameter is never isolated.
+     *
+     * @param function The function to check
+     *
+     * @return true if the function is isolated
+     */
+    static bool isIsolated(const EvalResult &function);
+
+    /**
+     * @brief Call a function for every item
+     *
+     * @param items A list, map, vector, table, generator or sequence
+     * @param function The function to call with each item
+     *
+     * @return The list of the results, in the order of the items
+     *
+     * @throw The error of the first item that failed
+     */
+    static EvalResult map(const EvalResult &items, const EvalResult &function);
+
+    /**
+     * @brief Fold the items with a function and combine the folds of the chunks
+     *
+     * Every chunk is folded on its own from the initial value, and the results of the chunks are combined in
+     * the order of the chunks. The result is the one of a fold from the left as long as the initial value is
+     * an identity of the combining function and folding an item into an accumulator is the same as combining
+     * the accumulator with the fold of the item. Without a combining function the folding function combines,
+     * which then has to take two accumulators, e.g. an associative operation on the type of the items.
+     *
+     * @param items A list, map, vector, table, generator or sequence
+     * @param function The function called with an accumulator and an item
+     * @param initial The result for no items, an identity of the combining function
+     * @param combine The function called with two accumulators, null to combine with the folding function
+     *
+     * @return The folded value
+     */
+    static EvalResult reduce(const EvalResult &items, const EvalResult &function, const EvalResult &initial,
+                             const EvalResult &combine = Null{});
+};
+
+#endif // CPP_EVA_PARALLEL_H
@@ -0,0 +1,201 @@
+#include "perf_counters.h"
+
+#if defined(__linux__)
+#define CPP_EVA_PERF_EVENTS 1
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace
+{
+#ifdef CPP_EVA_PERF_EVENTS
+    perf_event_attr attributesOf(PerfEvent event)
+    {
+        perf_event_attr attributes;
+        memset(&attributes, 0, sizeof(attributes));
+        attributes.size = sizeof(attributes);
+        attributes.type = PERF_TYPE_HARDWARE;
+        attributes.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        // The interpreter runs in user space, counting the kernel would need more privileges
+        attributes.exclude_kernel = 1;
+        attributes.exclude_hv = 1;
+
+        switch (event)
+        {
+        case PerfEvent::TASK_CLOCK:
+            attributes.type = PERF_TYPE_SOFTWARE;
+            attributes.config = PERF_COUNT_SW_TASK_CLOCK;
+            break;
+        case PerfEvent::CYCLES:
+            attributes.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case PerfEvent::INSTRUCTIONS:
+            attributes.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case PerfEvent::L1D_MISSES:
+            attributes.type = PERF_TYPE_HW_CACHE;
+            attributes.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+        case PerfEvent::LLC_MISSES:
+            attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+            break;
+        case PerfEvent::BRANCH_MISSES:
+            attributes.config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+        }
+        return attributes;
+    }
+#endif
+
+    optional<uint64_t> difference(const optional<uint64_t> &later, const optional<uint64_t> &earlier)
+    {
+        if (!later || !earlier)
+        {
+            return nullopt;
+        }
+        // Scaled counts of multiplexed events may go back a little
+        return *later > *earlier ? *later - *earlier : 0;
+    }
+}
+
+const char *perfEventName(PerfEvent event)
+{
+    switch (event)
+    {
+    case PerfEvent::TASK_CLOCK:
+        return "taskClockNs";
+    case PerfEvent::CYCLES:
+        return "cycles";
+    case PerfEvent::INSTRUCTIONS:
+        return "instructions";
+    case PerfEvent::L1D_MISSES:
+        return "l1dMisses";
+    case PerfEvent::LLC_MISSES:
+        return "llcMisses";
+    case PerfEvent::BRANCH_MISSES:
+        return "branchMisses";
+    default:
+        return "unknown";
+    }
+}
+
+PerfSample &PerfSample::operator+=(const PerfSample &other)
+{
+    for (size_t i = 0; i < perfEventCount; ++i)
+    {
+        if (other.counts[i])
+        {
+            counts[i] = counts[i].value_or(0) + *other.counts[i];
+        }
+    }
+    return *this;
+}
+
+PerfSample PerfSample::operator-(const PerfSample &earlier) const
+{
+    PerfSample result;
+    for (size_t i = 0; i < perfEventCount; ++i)
+    {
+        result.counts[i] = difference(counts[i], earlier.counts[i]);
+    }
+    return result;
+}
+
+PerfCounters::PerfCounters()
+{
+    descriptors.fill(-1);
+#ifdef CPP_EVA_PERF_EVENTS
+    for (size_t i = 0; i < perfEventCount; ++i)
+    {
+        auto attributes = attributesOf(static_cast<PerfEvent>(i));
+        // The calling thread on any CPU; a failure, e.g. ENOENT without a PMU or EACCES, leaves the event out
+        descriptors[i] = static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+    }
+#endif
+}
+
+PerfCounters::~PerfCounters()
+{
+#ifdef CPP_EVA_PERF_EVENTS
+    for (auto descriptor : descriptors)
+    {
+        if (descriptor >= 0)
+        {
+            close(descriptor);
+        }
+    }
+#endif
+}
+
+PerfCounters &PerfCounters::thread()
+{
+    static thread_local PerfCounters counters;
+    return counters;
+}
+
+PerfSample PerfCounters::read() const
+{
+    PerfSample sample;
+#ifdef CPP_EVA_PERF_EVENTS
+    for (size_t i = 0; i < perfEventCount; ++i)
+    {
+        uint64_t values[3];
+        if (descriptors[i] < 0 || ::read(descriptors[i], values, sizeof(values)) != sizeof(values))
+        {
+            continue;
+        }
+        auto [value, enabled, running] = values;
+        if (running == 0)
+        {
+            sample.counts[i] = 0;
+        }
+        else
+        {
+            sample.counts[i] = running < enabled ? static_cast<uint64_t>(static_cast<double>(value) * enabled / running)
+                                                 : value;
+        }
+    }
+#endif
+    return sample;
+}
+
+PerfProfiler::PerfProfiler(PerfProfile &profile)
+    : profile(profile),
+      previous(active)
+{
+    active = this;
+    start = PerfCounters::thread().read();
+}
+
+PerfProfiler::~PerfProfiler()
+{
+    profile.total += PerfCounters::thread().read() - start;
+    active = previous;
+}
+
+void PerfProfiler::Call::enter(PerfProfiler &profiler, const std::string &name)
+{
+    this->profiler = &profiler;
+    profiler.calls.push_back({&name, PerfCounters::thread().read(), {}});
+}
+
+void PerfProfiler::Call::leave()
+{
+    auto &calls = profiler->calls;
+    auto frame = std::move(calls.back());
+    calls.pop_back();
+
+    auto elapsed = PerfCounters::thread().read() - frame.start;
+    auto &counters = profiler->profile.functions[frame.name->empty() ? "<lambda>" : *frame.name];
+    ++counters.calls;
+    counters.self += elapsed - frame.callees;
+    if (!calls.empty())
+    {
+        calls.back().callees += elapsed;
+    }
+}
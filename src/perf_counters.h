@@ -0,0 +1,206 @@
+#ifndef CPP_EVA_PERF_COUNTERS_H
+#define CPP_EVA_PERF_COUNTERS_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+/**
+ * This enum is used to describe the events counted by PerfCounters.
+ *
+ * The task clock is a software event, in nanoseconds; the others are counted by the processor and are
+ * missing on machines without a performance monitoring unit, e.g. most virtual machines.
+ */
+enum class PerfEvent
+{
+    TASK_CLOCK,
+    CYCLES,
+    INSTRUCTIONS,
+    L1D_MISSES,
+    LLC_MISSES,
+    BRANCH_MISSES
+};
+
+constexpr size_t perfEventCount = 6;
+
+/**
+ * @brief Get the name of an event, as used in reports
+ */
+const char *perfEventName(PerfEvent event);
+
+/**
+ * This struct is used to hold the counts of one measurement.
+ *
+ * An event the kernel could not count has no value, so a missing counter is never reported as zero.
+ */
+struct PerfSample
+{
+    std::array<std::optional<uint64_t>, perfEventCount> counts;
+
+    const std::optional<uint64_t> &operator[](PerfEvent event) const
+    {
+        return counts[static_cast<size_t>(event)];
+    }
+
+    PerfSample &operator+=(const PerfSample &other);
+
+    /**
+     * @brief Get the counts since an earlier reading of the same counters
+     */
+    PerfSample operator-(const PerfSample &earlier) const;
+};
+
+/**
+ * This class is used to read the hardware and software event counters of the calling thread with
+ * perf_event_open.
+ *
+ * Every event is opened on its own, user space only, so an event the processor or the permissions do
+ * not allow leaves the others working. Counts are scaled when the kernel multiplexes the events.
+ */
+class PerfCounters
+{
+public:
+    PerfCounters();
+
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    /**
+     * @brief Get the counters of the calling thread, opened on first use
+     */
+    static PerfCounters &thread();
+
+    [[nodiscard]] bool isAvailable(PerfEvent event) const
+    {
+        return descriptors[static_cast<size_t>(event)] >= 0;
+    }
+
+    /**
+     * @brief Read the running totals of the available events
+     */
+    [[nodiscard]] PerfSample read() const;
+
+private:
+    std::array<int, perfEventCount> descriptors;
+};
+
+/**
+ * This struct is used to hold the counts of the calls of one function.
+ *
+ * The counts are self counts: the events of the functions it called are counted for those functions.
+ */
+struct FunctionCounters
+{
+    uint64_t calls = 0;
+    PerfSample self;
+};
+
+/**
+ * This struct is used to collect the counts of an evaluation profiled with Eva::eval.
+ *
+ * Functions are profiled by name, lambdas as "<lambda>". Reading the counters around every call costs
+ * a system call per event, so they are only collected when perFunction is set.
+ */
+struct PerfProfile
+{
+    bool perFunction = false;
+    PerfSample total;
+    std::map<std::string, FunctionCounters> functions;
+};
+
+/**
+ * This class is used to count the events of an evaluation on the current thread into a PerfProfile.
+ *
+ * The profiler is installed for the lifetime of the object and restores the previously active one on
+ * destruction, when the counts of the evaluation are added to the profile. Work handed to other threads,
+ * by the worker pool or by actors, is not counted.
+ */
+class PerfProfiler
+{
+public:
+    explicit PerfProfiler(PerfProfile &profile);
+
+    ~PerfProfiler();
+
+    PerfProfiler(const PerfProfiler &) = delete;
+    PerfProfiler &operator=(const PerfProfiler &) = delete;
+
+    /**
+     * @brief Get the profiler installed on the current thread
+     *
+     * @return The active profiler or nullptr if the evaluation is not profiled
+     */
+    static PerfProfiler *current()
+    {
+        return active;
+    }
+
+    /**
+     * @brief Check whether every function call on the current thread has to be counted
+     *
+     * Compiled functions then stay interpreted, as their direct calls to each other would not be counted.
+     */
+    static bool countsCalls()
+    {
+        auto profiler = active;
+        return profiler && profiler->profile.perFunction;
+    }
+
+    /**
+     * This class is used to attribute the events of one function call, for the lifetime of the object.
+     *
+     * Without a profiler collecting function counts it costs one thread local load and one branch.
+     */
+    class Call
+    {
+    public:
+        explicit Call(const std::string &name)
+        {
+            if (countsCalls())
+            {
+                enter(*active, name);
+            }
+        }
+
+        ~Call()
+        {
+            if (profiler)
+            {
+                leave();
+            }
+        }
+
+        Call(const Call &) = delete;
+        Call &operator=(const Call &) = delete;
+
+    private:
+        void enter(PerfProfiler &profiler, const std::string &name);
+
+        void leave();
+
+        PerfProfiler *profiler = nullptr;
+    };
+
+private:
+    struct Frame
+    {
+        const std::string *name;
+        PerfSample start;
+        PerfSample callees;
+    };
+
+    static inline thread_local PerfProfiler *active = nullptr;
+
+    PerfProfile &profile;
+    PerfSample start;
+    std::vector<Frame> calls;
+    PerfProfiler *previous;
+};
+
+#endif // CPP_EVA_PERF_COUNTERS_H
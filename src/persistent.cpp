@@ -0,0 +1,336 @@
+#include "persistent.h"
+
+#include <stdexcept>
+#include <string>
+#include <variant>
+#include "collections.h"
+
+using namespace std;
+
+namespace
+{
+    constexpr unsigned bits = 5;
+    constexpr size_t width = size_t(1) << bits;
+    constexpr size_t mask = width - 1;
+    constexpr unsigned hashBits = 64;
+
+    using VectorNode = PersistentVector::Node;
+    using MapNode = PersistentMap::Node;
+    using Slot = PersistentMap::Slot;
+
+    /**
+     * Copy of the path to `index` with the item replaced or appended.
+     */
+    shared_ptr<const VectorNode> assocIn(const VectorNode *node, unsigned level, size_t index, EvalResult &value)
+    {
+        auto copy = node ? make_shared<VectorNode>(*node) : make_shared<VectorNode>();
+        size_t position = (index >> level) & mask;
+        if (level == 0)
+        {
+            if (position == copy->values.size())
+            {
+                copy->values.push_back(std::move(value));
+            }
+            else
+            {
+                copy->values[position] = std::move(value);
+            }
+            return copy;
+        }
+
+        const VectorNode *child = position < copy->children.size() ? copy->children[position].get() : nullptr;
+        auto updated = assocIn(child, level - bits, index, value);
+        if (position == copy->children.size())
+        {
+            copy->children.push_back(std::move(updated));
+        }
+        else
+        {
+            copy->children[position] = std::move(updated);
+        }
+        return copy;
+    }
+
+    unsigned position(size_t hash, unsigned shift)
+    {
+        return (hash >> shift) & mask;
+    }
+
+    size_t slotIndex(uint32_t bitmap, uint32_t bit)
+    {
+        return __builtin_popcount(bitmap & (bit - 1));
+    }
+
+    /**
+     * Node holding two entries whose hashes are equal up to `shift`.
+     */
+    shared_ptr<const MapNode> merge(unsigned shift, Slot a, Slot b)
+    {
+        auto node = make_shared<MapNode>();
+        if (shift >= hashBits)
+        {
+            node->collision = true;
+            node->slots = {std::move(a), std::move(b)};
+            return node;
+        }
+
+        auto bitA = uint32_t(1) << position(a.hash, shift);
+        auto bitB = uint32_t(1) << position(b.hash, shift);
+        if (bitA == bitB)
+        {
+            node->bitmap = bitA;
+            node->slots.push_back(Slot{0, Null{}, Null{}, merge(shift + bits, std::move(a), std::move(b))});
+            return node;
+        }
+
+        node->bitmap = bitA | bitB;
+        if (bitA < bitB)
+        {
+            node->slots = {std::move(a), std::move(b)};
+        }
+        else
+        {
+            node->slots = {std::move(b), std::move(a)};
+        }
+        return node;
+    }
+
+    shared_ptr<const MapNode> assocIn(const MapNode *node, unsigned shift, Slot &entry, bool &added)
+    {
+        if (!node)
+        {
+            auto leaf = make_shared<MapNode>();
+            leaf->bitmap = uint32_t(1) << position(entry.hash, shift);
+            leaf->slots.push_back(std::move(entry));
+            added = true;
+            return leaf;
+        }
+
+        auto copy = make_shared<MapNode>(*node);
+        if (node->collision)
+        {
+            for (auto &slot : copy->slots)
+            {
+                if (equalValues(slot.key, entry.key))
+                {
+                    slot.value = std::move(entry.value);
+                    return copy;
+                }
+            }
+            copy->slots.push_back(std::move(entry));
+            added = true;
+            return copy;
+        }
+
+        auto bit = uint32_t(1) << position(entry.hash, shift);
+        auto index = slotIndex(node->bitmap, bit);
+        if (!(node->bitmap & bit))
+        {
+            copy->bitmap |= bit;
+            copy->slots.insert(copy->slots.begin() + index, std::move(entry));
+            added = true;
+            return copy;
+        }
+
+        auto &slot = copy->slots[index];
+        if (slot.child)
+        {
+            slot.child = assocIn(slot.child.get(), shift + bits, entry, added);
+        }
+        else if (slot.hash == entry.hash && equalValues(slot.key, entry.key))
+        {
+            slot.value = std::move(entry.value);
+        }
+        else
+        {
+            added = true;
+            auto existing = std::move(slot);
+            slot = Slot{0, Null{}, Null{}, merge(shift + bits, std::move(existing), std::move(entry))};
+        }
+        return copy;
+    }
+
+    /**
+     * Copy of the node without the key, nullptr if it becomes empty, the node itself if the key is missing.
+     */
+    shared_ptr<const MapNode> dissocIn(const shared_ptr<const MapNode> &node, unsigned shift, size_t hash,
+                                       const EvalResult &key, bool &removed)
+    {
+        if (node->collision)
+        {
+            for (size_t i = 0; i < node->slots.size(); ++i)
+            {
+                if (equalValues(node->slots[i].key, key))
+                {
+                    removed = true;
+                    if (node->slots.size() == 1)
+                    {
+                        return nullptr;
+                    }
+                    auto copy = make_shared<MapNode>(*node);
+                    copy->slots.erase(copy->slots.begin() + i);
+                    return copy;
+                }
+            }
+            return node;
+        }
+
+        auto bit = uint32_t(1) << position(hash, shift);
+        if (!(node->bitmap & bit))
+        {
+            return node;
+        }
+        auto index = slotIndex(node->bitmap, bit);
+        const auto &slot = node->slots[index];
+
+        shared_ptr<const MapNode> child;
+        if (slot.child)
+        {
+            child = dissocIn(slot.child, shift + bits, hash, key, removed);
+            if (child == slot.child)
+            {
+                return node;
+            }
+        }
+        else if (slot.hash != hash || !equalValues(slot.key, key))
+        {
+            return node;
+        }
+        removed = true;
+
+        auto copy = make_shared<MapNode>(*node);
+        if (child)
+        {
+            copy->slots[index].child = std::move(child);
+            return copy;
+        }
+        copy->bitmap &= ~bit;
+        copy->slots.erase(copy->slots.begin() + index);
+        return copy->slots.empty() ? nullptr : copy;
+    }
+}
+
+VectorValue PersistentVector::create(const vector<EvalResult> &items)
+{
+    VectorValue result{make_shared<const PersistentVector>()};
+    for (const auto &item : items)
+    {
+        result = result.vector->push(item);
+    }
+    return result;
+}
+
+const EvalResult &PersistentVector::at(int index) const
+{
+    if (index < 0 || static_cast<size_t>(index) >= count)
+    {
+        throw out_of_range("Index out of range: " + to_string(index));
+    }
+    const Node *node = root.get();
+    for (unsigned level = shift; level > 0; level -= bits)
+    {
+        node = node->children[(size_t(index) >> level) & mask].get();
+    }
+    return node->values[size_t(index) & mask];
+}
+
+VectorValue PersistentVector::assoc(int index, EvalResult value) const
+{
+    if (index < 0 || static_cast<size_t>(index) > count)
+    {
+        throw out_of_range("Index out of range: " + to_string(index));
+    }
+    if (static_cast<size_t>(index) == count)
+    {
+        return push(std::move(value));
+    }
+    return VectorValue{make_shared<const PersistentVector>(count, shift, assocIn(root.get(), shift, index, value))};
+}
+
+VectorValue PersistentVector::push(EvalResult value) const
+{
+    auto newShift = shift;
+    auto newRoot = root;
+    if (count == (width << shift))
+    {
+        // The trie is full: grow it by one level above the current root
+        auto grown = make_shared<Node>();
+        grown->children.push_back(std::move(newRoot));
+        newRoot = std::move(grown);
+        newShift += bits;
+    }
+    return VectorValue{make_shared<const PersistentVector>(count + 1, newShift, assocIn(newRoot.get(), newShift, count, value))};
+}
+
+const EvalResult *PersistentMap::find(const EvalResult &key) const
+{
+    auto hash = hashValue(key);
+    const Node *node = root.get();
+    for (unsigned shift = 0; node; shift += bits)
+    {
+        if (node->collision)
+        {
+            for (const auto &slot : node->slots)
+            {
+                if (equalValues(slot.key, key))
+                {
+                    return &slot.value;
+                }
+            }
+            return nullptr;
+        }
+
+        auto bit = uint32_t(1) << position(hash, shift);
+        if (!(node->bitmap & bit))
+        {
+            return nullptr;
+        }
+        const auto &slot = node->slots[slotIndex(node->bitmap, bit)];
+        if (!slot.child)
+        {
+            return slot.hash == hash && equalValues(slot.key, key) ? &slot.value : nullptr;
+        }
+        node = slot.child.get();
+    }
+    return nullptr;
+}
+
+TableValue PersistentMap::assoc(const EvalResult &key, EvalResult value) const
+{
+    Slot entry{hashValue(key), key, std::move(value), nullptr};
+    bool added = false;
+    auto newRoot = assocIn(root.get(), 0, entry, added);
+    return TableValue{make_shared<const PersistentMap>(count + added, std::move(newRoot))};
+}
+
+TableValue PersistentMap::dissoc(const EvalResult &key) const
+{
+    bool removed = false;
+    auto newRoot = root ? dissocIn(root, 0, hashValue(key), key, removed) : nullptr;
+    if (!removed)
+    {
+        return TableValue{shared_from_this()};
+    }
+    return TableValue{make_shared<const PersistentMap>(count - 1, std::move(newRoot))};
+}
+
+EvalResult freeze(const EvalResult &value)
+{
+    if (auto list = get_if<ListValue>(&value))
+    {
+        VectorValue result{make_shared<const PersistentVector>()};
+        for (const auto &item : list->list->items)
+        {
+            result = result.vector->push(freeze(item));
+        }
+        return result;
+    }
+    if (auto map = get_if<MapValue>(&value))
+    {
+        auto result = PersistentMap::create();
+        map->map->forEach([&result](const EvalResult &key, const EvalResult &item)
+                          { result = result.map->assoc(freeze(key), freeze(item)); });
+        return result;
+    }
+    return value;
+}
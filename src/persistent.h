@@ -0,0 +1,209 @@
+#ifndef CPP_EVA_PERSISTENT_H
+#define CPP_EVA_PERSISTENT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "eval_types.h"
+
+/**
+ * This class is used to store the items of a vector value in a persistent bitmapped trie.
+ *
+ * Items live in leaves of 32 values under inner nodes of 32 children, so an index is resolved by
+ * taking 5 bits per level. Updates copy the path from the root to the changed leaf and share every
+ * other node with the original vector, so they cost O(log32 n) allocations and leave it unchanged.
+ *
+ * Nodes are never modified once they are reachable from a vector, so vectors can be read from any
+ * number of threads without locks.
+ */
+class PersistentVector
+{
+public:
+    struct Node
+    {
+        std::vector<std::shared_ptr<const Node>> children;
+        std::vector<EvalResult> values;
+    };
+
+    static VectorValue create(const std::vector<EvalResult> &items = {});
+
+    PersistentVector() = default;
+
+    PersistentVector(size_t count, unsigned shift, std::shared_ptr<const Node> root)
+        : count(count), shift(shift), root(std::move(root)) {}
+
+    /**
+     * @brief Get the item at an index
+     *
+     * @throw std::out_of_range if the index is out of range
+     */
+    [[nodiscard]] const EvalResult &at(int index) const;
+
+    /**
+     * @brief Replace the item at an index, or append an item if the index is the size
+     *
+     * @return The updated vector
+     *
+     * @throw std::out_of_range if the index is out of range
+     */
+    [[nodiscard]] VectorValue assoc(int index, EvalResult value) const;
+
+    /**
+     * @brief Append an item
+     *
+     * @return The updated vector
+     */
+    [[nodiscard]] VectorValue push(EvalResult value) const;
+
+    [[nodiscard]] size_t size() const
+    {
+        return count;
+    }
+
+    /**
+     * @brief Call a function with every item, in index order
+     */
+    template <typename Function>
+    void forEach(Function &&function) const
+    {
+        forEach(root.get(), shift, function);
+    }
+
+private:
+    template <typename Function>
+    static void forEach(const Node *node, unsigned level, Function &function)
+    {
+        if (!node)
+        {
+            return;
+        }
+        if (level == 0)
+        {
+            for (const auto &value : node->values)
+            {
+                function(value);
+            }
+            return;
+        }
+        for (const auto &child : node->children)
+        {
+            forEach(child.get(), level - 5, function);
+        }
+    }
+
+    size_t count = 0;
+    unsigned shift = 0;
+    std::shared_ptr<const Node> root;
+};
+
+/**
+ * This class is used to store the entries of a table value in a persistent hash array mapped trie.
+ *
+ * Every node holds a 32-bit bitmap of the occupied slots and a compact array of them; a slot is an entry
+ * or a child node, and each level consumes 5 bits of the structural hash of the key. Keys whose hashes
+ * are equal end in a collision node that is searched linearly. Like PersistentVector, updates copy one
+ * path and share the rest, and tables can be read from any number of threads without locks.
+ */
+class PersistentMap : public std::enable_shared_from_this<PersistentMap>
+{
+public:
+    struct Node;
+
+    struct Slot
+    {
+        size_t hash;
+        EvalResult key;
+        EvalResult value;
+        std::shared_ptr<const Node> child;
+    };
+
+    struct Node
+    {
+        uint32_t bitmap = 0;
+        bool collision = false;
+        std::vector<Slot> slots;
+    };
+
+    static TableValue create()
+    {
+        return TableValue{std::make_shared<const PersistentMap>()};
+    }
+
+    PersistentMap() = default;
+
+    PersistentMap(size_t count, std::shared_ptr<const Node> root) : count(count), root(std::move(root)) {}
+
+    /**
+     * @brief Find the value of a key
+     *
+     * @return A pointer to the value, nullptr if the key is not in the table
+     */
+    [[nodiscard]] const EvalResult *find(const EvalResult &key) const;
+
+    /**
+     * @brief Set the value of a key, adding the key if needed
+     *
+     * @return The updated table
+     */
+    [[nodiscard]] TableValue assoc(const EvalResult &key, EvalResult value) const;
+
+    /**
+     * @brief Remove a key
+     *
+     * @return The updated table, the same table if the key is not in it
+     */
+    [[nodiscard]] TableValue dissoc(const EvalResult &key) const;
+
+    [[nodiscard]] size_t size() const
+    {
+        return count;
+    }
+
+    /**
+     * @brief Call a function with the key and the value of every entry, in hash order
+     */
+    template <typename Function>
+    void forEach(Function &&function) const
+    {
+        forEach(root.get(), function);
+    }
+
+private:
+    template <typename Function>
+    static void forEach(const Node *node, Function &function)
+    {
+        if (!node)
+        {
+            return;
+        }
+        for (const auto &slot : node->slots)
+        {
+            if (slot.child)
+            {
+                forEach(slot.child.get(), function);
+            }
+            else
+            {
+                function(slot.key, slot.value);
+            }
+        }
+    }
+
+    size_t count = 0;
+    std::shared_ptr<const Node> root;
+};
+
+/**
+ * @brief Convert a value to a persistent one
+ *
+ * Lists become vectors and maps become tables, recursively, so the result can be shared between threads.
+ * Other values are returned as they are.
+ *
+ * @param value The value to convert
+ *
+ * @return The converted value
+ */
+EvalResult freeze(const EvalResult &value);
+
+#endif // CPP_EVA_PERSISTENT_H
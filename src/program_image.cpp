@@ -0,0 +1,892 @@
+#include "program_image.h"
+
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <variant>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "environment.h"
+
+using namespace std;
+
+/*
+ * Operands of the node records:
+ *
+ * BLOCK                    a = first child in the list table, b = number of children
+ * CONDITION                a = condition, b = then, c = otherwise
+ * LOOP                     a = condition, b = body
+ * IDENTIFIER               a = name
+ * LITERAL                  op = LiteralKind, a = int value, string or bool
+ * VARIABLE_DECLARATION     a = name, b = value
+ * ASSIGNMENT               a = name, b = value, c = member access
+ * BINARY_OPERATION         op = BinaryOperationType, a = left, b = right
+ * FUNCTION_DECLARATION     op = 1 for generators, a = name, b = first parameter name in the list table,
+ *                          c = number of parameters, d = body
+ * LAMBDA                   op = 1 for generators, b = first parameter name in the list table, c = number of parameters,
+ *                          d = body
+ * ANONYMOUS_FUNCTION_CALL  a = function, b = first argument in the list table, c = number of arguments
+ * FUNCTION_CALL            a = name, b = first argument in the list table, c = number of arguments
+ * MEMBER_FUNCTION_CALL     a = member access, b = first argument in the list table, c = number of arguments
+ * FOR_LOOP                 a = init, b = condition, c = modifier, d = body
+ * FOR_IN                   a = name, b = iterable, c = body
+ * SWITCH                   a = first case in the list table (condition and body pairs), b = number of cases
+ * INCREMENT, DECREMENT     a = identifier
+ * CLASS_DECLARATION        a = name, b = parent, c = first member in the list table, d = number of members
+ * LIST                     a = first item in the list table, b = number of items
+ * MAP                      a = first entry in the list table (key and value pairs), b = number of entries
+ * INDEX_ACCESS             a = collection, b = index
+ * INDEX_ASSIGNMENT         a = collection, b = index, c = value
+ * IMPORT                   a = path, b = first name in the list table, c = number of names
+ * YIELD                    a = value
+ * NEW_INSTANCE             a = name, b = first argument in the list table, c = number of arguments
+ * MEMBER_ACCESS            a = instance name, b = member name
+ *
+ * Missing operands are stored as ProgramWriter::npos.
+ */
+
+namespace
+{
+    constexpr char magic[4] = {'E', 'V', 'A', 'P'};
+    constexpr uint32_t byteOrderMark = 0x01020304;
+    constexpr uint32_t npos = ProgramWriter::npos;
+
+    uint64_t fnv1a(const char *data, size_t size)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash ^= static_cast<unsigned char>(data[i]);
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    size_t align(size_t offset)
+    {
+        return (offset + 7) & ~size_t(7);
+    }
+
+    bool readHeader(const string &path, ProgramHeader &header)
+    {
+        ifstream file(path, ios::binary);
+        return file.read(reinterpret_cast<char *>(&header), sizeof(header)) &&
+               memcmp(header.magic, magic, sizeof(magic)) == 0 &&
+               header.version == ProgramImage::version &&
+               header.byteOrder == byteOrderMark;
+    }
+
+    /**
+     * This class is used to defer materialization of a function body until it is first evaluated.
+     */
+    class LazyExpression : public Expression
+    {
+    public:
+        LazyExpression(ProgramImagePtr image, uint32_t index)
+            : image(std::move(image)), index(index) {}
+
+        [[nodiscard]] EvalResult eval(std::shared_ptr<Environment> env) const override
+        {
+            return get().eval(std::move(env));
+        }
+
+        void accept(ExpressionVisitor &visitor) const override
+        {
+            get().accept(visitor);
+        }
+
+    private:
+        const Expression &get() const
+        {
+            call_once(once, [this]
+                      { expression = image->materialize(index); });
+            return *expression;
+        }
+
+        ProgramImagePtr image;
+        uint32_t index;
+        mutable once_flag once;
+        mutable ExpressionPtr expression;
+    };
+
+    string name(const ProgramImage &image, uint32_t index)
+    {
+        return string(image.getString(index));
+    }
+
+    ExpressionPtr optional(const ProgramImage &image, uint32_t index)
+    {
+        return index == npos ? nullptr : image.materialize(index);
+    }
+
+    vector<ExpressionPtr> children(const ProgramImage &image, uint32_t start, uint32_t count)
+    {
+        vector<ExpressionPtr> expressions;
+        expressions.reserve(count);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            expressions.push_back(image.materialize(image.getListItem(start, i)));
+        }
+        return expressions;
+    }
+
+    vector<string> names(const ProgramImage &image, uint32_t start, uint32_t count)
+    {
+        vector<string> result;
+        result.reserve(count);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            result.push_back(name(image, image.getListItem(start, i)));
+        }
+        return result;
+    }
+
+    MemberAccessPtr memberAccess(const ProgramImage &image, uint32_t index)
+    {
+        const auto &node = image.getNode(index);
+        if (node.kind != NodeKind::MEMBER_ACCESS)
+        {
+            throw runtime_error("Malformed program image: member access expected");
+        }
+        return MemberAccess::create(name(image, node.a), name(image, node.b));
+    }
+
+    IdentifierPtr identifier(const ProgramImage &image, uint32_t index)
+    {
+        const auto &node = image.getNode(index);
+        if (node.kind == NodeKind::MEMBER_ACCESS)
+        {
+            return memberAccess(image, index);
+        }
+        if (node.kind != NodeKind::IDENTIFIER)
+        {
+            throw runtime_error("Malformed program image: identifier expected");
+        }
+        return Identifier::create(name(image, node.a));
+    }
+
+    ExpressionPtr body(const ProgramImage &image, uint32_t index)
+    {
+        return index == npos ? nullptr : image.materializeLazily(index);
+    }
+
+    EvalResult literal(const ProgramImage &image, const NodeRecord &node)
+    {
+        switch (static_cast<LiteralKind>(node.op))
+        {
+        case LiteralKind::INT:
+            return static_cast<int>(node.a);
+        case LiteralKind::STRING:
+            return name(image, node.a);
+        case LiteralKind::BOOL:
+            return node.a != 0;
+        case LiteralKind::NUL:
+            return Null{};
+        default:
+            throw runtime_error("Malformed program image: unknown literal kind");
+        }
+    }
+}
+
+/**
+ * This class is used to append the nodes of an expression tree to a program writer.
+ */
+class ProgramSerializer : public ExpressionVisitor
+{
+public:
+    explicit ProgramSerializer(ProgramWriter &writer) : writer(writer) {}
+
+    uint32_t add(const Expression *exp)
+    {
+        if (!exp)
+        {
+            return npos;
+        }
+        exp->accept(*this);
+        return last;
+    }
+
+    void visit(const Expression &) override
+    {
+        emit({NodeKind::NOP, 0, 0, 0, 0, 0, 0});
+    }
+
+    void visit(const Block &exp) override
+    {
+        auto list = addAll(exp.getExpressions());
+        emit({NodeKind::BLOCK, 0, 0, list, count(exp.getExpressions()), 0, 0});
+    }
+
+    void visit(const Condition &exp) override
+    {
+        auto condition = add(exp.getCondition().get());
+        auto then = add(exp.getThen().get());
+        auto otherwise = add(exp.getOtherwise().get());
+        emit({NodeKind::CONDITION, 0, 0, condition, then, otherwise, 0});
+    }
+
+    void visit(const Loop &exp) override
+    {
+        auto condition = add(exp.getCondition().get());
+        auto body = add(exp.getBody().get());
+        emit({NodeKind::LOOP, 0, 0, condition, body, 0, 0});
+    }
+
+    void visit(const Identifier &exp) override
+    {
+        emit({NodeKind::IDENTIFIER, 0, 0, writer.addString(exp.getName()), 0, 0, 0});
+    }
+
+    void visit(const Literal &exp) override
+    {
+        const auto &value = exp.getValue();
+        if (auto number = get_if<int>(&value))
+        {
+            emit({NodeKind::LITERAL, uint8_t(LiteralKind::INT), 0, static_cast<uint32_t>(*number), 0, 0, 0});
+        }
+        else if (auto str = get_if<string>(&value))
+        {
+            emit({NodeKind::LITERAL, uint8_t(LiteralKind::STRING), 0, writer.addString(*str), 0, 0, 0});
+        }
+        else if (auto flag = get_if<bool>(&value))
+        {
+            emit({NodeKind::LITERAL, uint8_t(LiteralKind::BOOL), 0, *flag ? 1u : 0u, 0, 0, 0});
+        }
+        else if (holds_alternative<Null>(value))
+        {
+            emit({NodeKind::LITERAL, uint8_t(LiteralKind::NUL), 0, 0, 0, 0, 0});
+        }
+        else
+        {
+            throw runtime_error("Cannot serialize a literal of a runtime value");
+        }
+    }
+
+    void visit(const VariableDeclaration &exp) override
+    {
+        auto value = add(exp.getValue().get());
+        emit({NodeKind::VARIABLE_DECLARATION, 0, 0, writer.addString(exp.getName()), value, 0, 0});
+    }
+
+    void visit(const Assignment &exp) override
+    {
+        auto value = add(exp.getValue().get());
+        auto member = add(exp.getMemberAccess().get());
+        auto name = member == npos ? writer.addString(exp.getName()) : npos;
+        emit({NodeKind::ASSIGNMENT, 0, 0, name, value, member, 0});
+    }
+
+    void visit(const BinaryOperation &exp) override
+    {
+        auto left = add(exp.getLeft().get());
+        auto right = add(exp.getRight().get());
+        emit({NodeKind::BINARY_OPERATION, uint8_t(exp.getType()), 0, left, right, 0, 0});
+    }
+
+    void visit(const FunctionDeclaration &exp) override
+    {
+        function(NodeKind::FUNCTION_DECLARATION, writer.addString(exp.getName()), exp);
+    }
+
+    void visit(const Lambda &exp) override
+    {
+        function(NodeKind::LAMBDA, npos, exp);
+    }
+
+    void visit(const AnonymousFunctionCall &exp) override
+    {
+        auto function = add(exp.getFunction().get());
+        call(NodeKind::ANONYMOUS_FUNCTION_CALL, function, exp.getArgs());
+    }
+
+    void visit(const FunctionCall &exp) override
+    {
+        call(NodeKind::FUNCTION_CALL, writer.addString(exp.getName()), exp.getArgs());
+    }
+
+    void visit(const ForLoop &exp) override
+    {
+        auto init = add(exp.getInit().get());
+        auto condition = add(exp.getCondition().get());
+        auto modifier = add(exp.getModifier().get());
+        auto body = add(exp.getBody().get());
+        emit({NodeKind::FOR_LOOP, 0, 0, init, condition, modifier, body});
+    }
+
+    void visit(const ForIn &exp) override
+    {
+        auto iterable = add(exp.getIterable().get());
+        auto body = add(exp.getBody().get());
+        emit({NodeKind::FOR_IN, 0, 0, writer.addString(exp.getName()), iterable, body, 0});
+    }
+
+    void visit(const Switch &exp) override
+    {
+        vector<uint32_t> items;
+        for (const auto &[condition, body] : exp.getCases())
+        {
+            items.push_back(add(condition.get()));
+            items.push_back(add(body.get()));
+        }
+        emit({NodeKind::SWITCH, 0, 0, writer.addList(items), count(exp.getCases()), 0, 0});
+    }
+
+    void visit(const Increment &exp) override
+    {
+        emit({NodeKind::INCREMENT, 0, 0, add(exp.getIdentifier().get()), 0, 0, 0});
+    }
+
+    void visit(const Decrement &exp) override
+    {
+        emit({NodeKind::DECREMENT, 0, 0, add(exp.getIdentifier().get()), 0, 0, 0});
+    }
+
+    void visit(const ClassDeclaration &exp) override
+    {
+        auto parent = add(exp.getParent().get());
+        auto members = addAll(exp.getExpressions());
+        emit({NodeKind::CLASS_DECLARATION, 0, 0, writer.addString(exp.getName()), parent, members, count(exp.getExpressions())});
+    }
+
+    void visit(const NewInstance &exp) override
+    {
+        call(NodeKind::NEW_INSTANCE, writer.addString(exp.getName()), exp.getArgs());
+    }
+
+    void visit(const MemberAccess &exp) override
+    {
+        emit({NodeKind::MEMBER_ACCESS, 0, 0, writer.addString(exp.getInstance()), writer.addString(exp.getMember()),
+              0, 0});
+    }
+
+    void visit(const MemberFunctionCall &exp) override
+    {
+        auto function = add(exp.getFunction().get());
+        call(NodeKind::MEMBER_FUNCTION_CALL, function, exp.getArgs());
+    }
+
+    void visit(const ListExpression &exp) override
+    {
+        auto list = addAll(exp.getItems());
+        emit({NodeKind::LIST, 0, 0, list, count(exp.getItems()), 0, 0});
+    }
+
+    void visit(const MapExpression &exp) override
+    {
+        vector<uint32_t> items;
+        for (const auto &[key, value] : exp.getEntries())
+        {
+            items.push_back(add(key.get()));
+            items.push_back(add(value.get()));
+        }
+        emit({NodeKind::MAP, 0, 0, writer.addList(items), count(exp.getEntries()), 0, 0});
+    }
+
+    void visit(const IndexAccess &exp) override
+    {
+        auto collection = add(exp.getCollection().get());
+        auto index = add(exp.getIndex().get());
+        emit({NodeKind::INDEX_ACCESS, 0, 0, collection, index, 0, 0});
+    }
+
+    void visit(const IndexAssignment &exp) override
+    {
+        auto collection = add(exp.getCollection().get());
+        auto index = add(exp.getIndex().get());
+        auto value = add(exp.getValue().get());
+        emit({NodeKind::INDEX_ASSIGNMENT, 0, 0, collection, index, value, 0});
+    }
+
+    void visit(const Import &exp) override
+    {
+        vector<uint32_t> items;
+        for (const auto &name : exp.getNames())
+        {
+            items.push_back(writer.addString(name));
+        }
+        emit({NodeKind::IMPORT, 0, 0, writer.addString(exp.getPath()), writer.addList(items), count(exp.getNames()), 0});
+    }
+
+    void visit(const Yield &exp) override
+    {
+        auto value = add(exp.getValue().get());
+        emit({NodeKind::YIELD, 0, 0, value, 0, 0, 0});
+    }
+
+private:
+    template <typename T>
+    static uint32_t count(const vector<T> &items)
+    {
+        return static_cast<uint32_t>(items.size());
+    }
+
+    uint32_t addAll(const vector<ExpressionPtr> &expressions)
+    {
+        vector<uint32_t> items;
+        items.reserve(expressions.size());
+        for (const auto &exp : expressions)
+        {
+            items.push_back(add(exp.get()));
+        }
+        return writer.addList(items);
+    }
+
+    void function(NodeKind kind, uint32_t name, const FunctionDeclaration &exp)
+    {
+        vector<uint32_t> params;
+        for (const auto &param : exp.getParams())
+        {
+            params.push_back(writer.addString(param));
+        }
+        auto body = add(exp.getBody().get());
+        emit({kind, uint8_t(exp.isGenerator()), 0, name, writer.addList(params), count(exp.getParams()), body});
+    }
+
+    void call(NodeKind kind, uint32_t callee, const vector<ExpressionPtr> &args)
+    {
+        auto list = addAll(args);
+        emit({kind, 0, 0, callee, list, count(args), 0});
+    }
+
+    void emit(NodeRecord node)
+    {
+        last = writer.addNode(node);
+    }
+
+    ProgramWriter &writer;
+    uint32_t last = npos;
+};
+
+void writeFileAtomically(const std::string &path, const std::string &bytes)
+{
+    auto temporary = path + ".tmp." + to_string(getpid());
+    {
+        ofstream file(temporary, ios::binary | ios::trunc);
+        if (!file.write(bytes.data(), static_cast<streamsize>(bytes.size())))
+        {
+            throw runtime_error("Cannot write file: " + temporary);
+        }
+    }
+    if (rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        unlink(temporary.c_str());
+        throw runtime_error("Cannot write file: " + path);
+    }
+}
+
+uint32_t ProgramWriter::add(const Expression &exp)
+{
+    ProgramSerializer serializer(*this);
+    auto index = serializer.add(&exp);
+    if (root == npos)
+    {
+        root = index;
+    }
+    return index;
+}
+
+uint32_t ProgramWriter::addString(const std::string &value)
+{
+    auto it = stringIndex.find(value);
+    if (it != stringIndex.end())
+    {
+        return it->second;
+    }
+
+    auto index = static_cast<uint32_t>(strings.size());
+    strings.push_back({static_cast<uint32_t>(stringData.size()), static_cast<uint32_t>(value.size())});
+    stringData += value;
+    stringIndex.emplace(value, index);
+    return index;
+}
+
+uint32_t ProgramWriter::addNode(const NodeRecord &node)
+{
+    nodes.push_back(node);
+    return static_cast<uint32_t>(nodes.size() - 1);
+}
+
+uint32_t ProgramWriter::addList(const std::vector<uint32_t> &items)
+{
+    auto start = static_cast<uint32_t>(lists.size());
+    lists.insert(lists.end(), items.begin(), items.end());
+    return start;
+}
+
+std::string ProgramWriter::serialize(uint64_t sourceHash) const
+{
+    ProgramHeader header{};
+    memcpy(header.magic, magic, sizeof(magic));
+    header.version = ProgramImage::version;
+    header.byteOrder = byteOrderMark;
+    header.root = root;
+    header.sourceHash = sourceHash;
+    header.nodeCount = static_cast<uint32_t>(nodes.size());
+    header.listCount = static_cast<uint32_t>(lists.size());
+    header.stringCount = static_cast<uint32_t>(strings.size());
+    header.stringDataSize = static_cast<uint32_t>(stringData.size());
+
+    header.nodesOffset = align(sizeof(ProgramHeader));
+    header.listsOffset = align(header.nodesOffset + nodes.size() * sizeof(NodeRecord));
+    header.stringsOffset = align(header.listsOffset + lists.size() * sizeof(uint32_t));
+    header.stringDataOffset = align(header.stringsOffset + strings.size() * sizeof(StringRecord));
+    header.size = align(header.stringDataOffset + stringData.size());
+
+    string bytes(header.size, '\0');
+    memcpy(&bytes[header.nodesOffset], nodes.data(), nodes.size() * sizeof(NodeRecord));
+    memcpy(&bytes[header.listsOffset], lists.data(), lists.size() * sizeof(uint32_t));
+    memcpy(&bytes[header.stringsOffset], strings.data(), strings.size() * sizeof(StringRecord));
+    memcpy(&bytes[header.stringDataOffset], stringData.data(), stringData.size());
+
+    header.contentHash = fnv1a(bytes.data() + sizeof(ProgramHeader), bytes.size() - sizeof(ProgramHeader));
+    memcpy(&bytes[0], &header, sizeof(header));
+    return bytes;
+}
+
+bool ProgramWriter::write(const std::string &path, uint64_t sourceHash) const
+{
+    auto bytes = serialize(sourceHash);
+    const auto &header = *reinterpret_cast<const ProgramHeader *>(bytes.data());
+
+    ProgramHeader existing{};
+    if (readHeader(path, existing) && existing.sourceHash == header.sourceHash && existing.contentHash == header.contentHash)
+    {
+        return false;
+    }
+
+    writeFileAtomically(path, bytes);
+    return true;
+}
+
+ProgramImage::ProgramImage(std::shared_ptr<const void> storage, const char *data, size_t size)
+    : storage(std::move(storage)), data(data), size(size),
+      header(nullptr), nodes(nullptr), lists(nullptr), strings(nullptr), stringData(nullptr) {}
+
+MappedFile MappedFile::open(const std::string &path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        throw runtime_error("Cannot open file: " + path);
+    }
+
+    struct stat info{};
+    if (fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        close(fd);
+        throw runtime_error("Cannot map empty file: " + path);
+    }
+
+    auto size = static_cast<size_t>(info.st_size);
+    void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        throw runtime_error("Cannot map file: " + path);
+    }
+
+    shared_ptr<const void> storage(mapping, [size](const void *address)
+                                   { munmap(const_cast<void *>(address), size); });
+    return {std::move(storage), static_cast<const char *>(mapping), size};
+}
+
+std::shared_ptr<const ProgramImage> ProgramImage::load(const std::string &path)
+{
+    auto file = MappedFile::open(path);
+    return fromRegion(std::move(file.storage), file.data, file.size);
+}
+
+std::shared_ptr<const ProgramImage> ProgramImage::fromBytes(std::string bytes)
+{
+    auto storage = make_shared<const string>(std::move(bytes));
+    return fromRegion(storage, storage->data(), storage->size());
+}
+
+std::shared_ptr<const ProgramImage> ProgramImage::fromRegion(std::shared_ptr<const void> storage, const char *data, size_t size)
+{
+    shared_ptr<ProgramImage> image(new ProgramImage(std::move(storage), data, size));
+    image->validate();
+    return image;
+}
+
+bool ProgramImage::isUpToDate(const std::string &path, uint64_t sourceHash)
+{
+    ProgramHeader header{};
+    return readHeader(path, header) && header.sourceHash == sourceHash;
+}
+
+void ProgramImage::validate()
+{
+    auto fits = [this](uint64_t offset, uint64_t count, size_t itemSize)
+    {
+        return offset % 8 == 0 && offset <= size && count <= (size - offset) / itemSize;
+    };
+
+    if (size < sizeof(ProgramHeader) || reinterpret_cast<uintptr_t>(data) % 8 != 0)
+    {
+        throw runtime_error("Invalid program image: truncated header");
+    }
+
+    header = reinterpret_cast<const ProgramHeader *>(data);
+    if (memcmp(header->magic, magic, sizeof(magic)) != 0)
+    {
+        throw runtime_error("Invalid program image: bad magic");
+    }
+    if (header->version != version || header->byteOrder != byteOrderMark)
+    {
+        throw runtime_error("Invalid program image: unsupported version");
+    }
+    if (header->size != size ||
+        !fits(header->nodesOffset, header->nodeCount, sizeof(NodeRecord)) ||
+        !fits(header->listsOffset, header->listCount, sizeof(uint32_t)) ||
+        !fits(header->stringsOffset, header->stringCount, sizeof(StringRecord)) ||
+        !fits(header->stringDataOffset, header->stringDataSize, 1))
+    {
+        throw runtime_error("Invalid program image: section out of bounds");
+    }
+
+    nodes = reinterpret_cast<const NodeRecord *>(data + header->nodesOffset);
+    lists = reinterpret_cast<const uint32_t *>(data + header->listsOffset);
+    strings = reinterpret_cast<const StringRecord *>(data + header->stringsOffset);
+    stringData = data + header->stringDataOffset;
+
+    for (uint32_t index = 0; index < header->nodeCount; ++index)
+    {
+        validateReferences(index);
+    }
+}
+
+void ProgramImage::validateReferences(uint32_t index) const
+{
+    // Children are written before their parents, so a reference to the node itself or to a later node
+    // could form a cycle that materialize would follow forever
+    auto child = [index](uint32_t reference, bool optional = false)
+    {
+        if (reference == npos ? !optional : reference >= index)
+        {
+            throw runtime_error("Malformed program image: node refers to itself or to a later node");
+        }
+    };
+    auto children = [this, &child](uint32_t start, uint64_t count)
+    {
+        for (uint64_t i = 0; i < count; ++i)
+        {
+            child(getListItem(start, static_cast<uint32_t>(i)));
+        }
+    };
+
+    const auto &node = nodes[index];
+    switch (node.kind)
+    {
+    case NodeKind::BLOCK:
+    case NodeKind::LIST:
+        children(node.a, node.b);
+        break;
+    case NodeKind::CONDITION:
+        child(node.a);
+        child(node.b);
+        child(node.c, true);
+        break;
+    case NodeKind::LOOP:
+    case NodeKind::BINARY_OPERATION:
+    case NodeKind::INDEX_ACCESS:
+        child(node.a);
+        child(node.b);
+        break;
+    case NodeKind::VARIABLE_DECLARATION:
+        child(node.b);
+        break;
+    case NodeKind::ASSIGNMENT:
+        child(node.b);
+        child(node.c, true);
+        break;
+    case NodeKind::FUNCTION_DECLARATION:
+    case NodeKind::LAMBDA:
+        child(node.d, true);
+        break;
+    case NodeKind::ANONYMOUS_FUNCTION_CALL:
+    case NodeKind::MEMBER_FUNCTION_CALL:
+        child(node.a);
+        children(node.b, node.c);
+        break;
+    case NodeKind::FUNCTION_CALL:
+    case NodeKind::NEW_INSTANCE:
+        children(node.b, node.c);
+        break;
+    case NodeKind::FOR_LOOP:
+        child(node.a);
+        child(node.b);
+        child(node.c);
+        child(node.d);
+        break;
+    case NodeKind::FOR_IN:
+        child(node.b);
+        child(node.c);
+        break;
+    case NodeKind::INDEX_ASSIGNMENT:
+        child(node.a);
+        child(node.b);
+        child(node.c);
+        break;
+    case NodeKind::SWITCH:
+    case NodeKind::MAP:
+        children(node.a, 2 * uint64_t(node.b));
+        break;
+    case NodeKind::INCREMENT:
+    case NodeKind::DECREMENT:
+    case NodeKind::YIELD:
+        child(node.a, node.kind == NodeKind::YIELD);
+        break;
+    case NodeKind::CLASS_DECLARATION:
+        child(node.b, true);
+        children(node.c, node.d);
+        break;
+    case NodeKind::NOP:
+    case NodeKind::IDENTIFIER:
+    case NodeKind::LITERAL:
+    case NodeKind::MEMBER_ACCESS:
+    case NodeKind::IMPORT:
+        // Only names and immediate values
+        break;
+    default:
+        // Unknown kinds are rejected when they are materialized
+        break;
+    }
+}
+
+const NodeRecord &ProgramImage::getNode(uint32_t index) const
+{
+    if (index >= header->nodeCount)
+    {
+        throw runtime_error("Malformed program image: node index out of bounds");
+    }
+    return nodes[index];
+}
+
+std::string_view ProgramImage::getString(uint32_t index) const
+{
+    if (index >= header->stringCount)
+    {
+        throw runtime_error("Malformed program image: string index out of bounds");
+    }
+
+    const auto &record = strings[index];
+    if (record.offset > header->stringDataSize || record.length > header->stringDataSize - record.offset)
+    {
+        throw runtime_error("Malformed program image: string out of bounds");
+    }
+    return {stringData + record.offset, record.length};
+}
+
+uint32_t ProgramImage::getListItem(uint32_t start, uint32_t offset) const
+{
+    if (start > header->listCount || offset >= header->listCount - start)
+    {
+        throw runtime_error("Malformed program image: list out of bounds");
+    }
+    return lists[start + offset];
+}
+
+ExpressionPtr ProgramImage::materialize(uint32_t index) const
+{
+    if (index == ProgramWriter::npos)
+    {
+        index = header->root;
+    }
+    const auto &node = getNode(index);
+    const auto &image = *this;
+
+    switch (node.kind)
+    {
+    case NodeKind::NOP:
+        return Expression::create();
+    case NodeKind::BLOCK:
+        return Block::create(children(image, node.a, node.b));
+    case NodeKind::CONDITION:
+        return Condition::create(materialize(node.a), materialize(node.b), optional(image, node.c));
+    case NodeKind::LOOP:
+        return Loop::create(materialize(node.a), materialize(node.b));
+    case NodeKind::IDENTIFIER:
+        return Identifier::create(name(image, node.a));
+    case NodeKind::LITERAL:
+        return Literal::create(literal(image, node));
+    case NodeKind::VARIABLE_DECLARATION:
+        return VariableDeclaration::create(name(image, node.a), materialize(node.b));
+    case NodeKind::ASSIGNMENT:
+        if (node.c != npos)
+        {
+            return Assignment::create(memberAccess(image, node.c), materialize(node.b));
+        }
+        return Assignment::create(name(image, node.a), materialize(node.b));
+    case NodeKind::BINARY_OPERATION:
+        if (node.op > BinaryOperationType::LESS_OR_EQUAL)
+        {
+            throw runtime_error("Malformed program image: unknown operation");
+        }
+        return BinaryOperation::create(static_cast<BinaryOperationType>(node.op), materialize(node.a), materialize(node.b));
+    case NodeKind::FUNCTION_DECLARATION:
+        // The flag is stored, finding the yields would materialize the body
+        return FunctionDeclaration::create(name(image, node.a), names(image, node.b, node.c), body(image, node.d), node.op != 0);
+    case NodeKind::LAMBDA:
+        return Lambda::create(names(image, node.b, node.c), body(image, node.d), node.op != 0);
+    case NodeKind::ANONYMOUS_FUNCTION_CALL:
+        return make_unique<AnonymousFunctionCall>(materialize(node.a), children(image, node.b, node.c));
+    case NodeKind::FUNCTION_CALL:
+        return FunctionCall::create(name(image, node.a), children(image, node.b, node.c));
+    case NodeKind::MEMBER_FUNCTION_CALL:
+        return MemberFunctionCall::create(memberAccess(image, node.a), children(image, node.b, node.c));
+    case NodeKind::FOR_LOOP:
+        return ForLoop::create(materialize(node.a), materialize(node.b), materialize(node.c), materialize(node.d));
+    case NodeKind::FOR_IN:
+        return ForIn::create(name(image, node.a), materialize(node.b), materialize(node.c));
+    case NodeKind::SWITCH:
+    {
+        vector<pair<ExpressionPtr, ExpressionPtr>> cases;
+        for (uint32_t i = 0; i < node.b; ++i)
+        {
+            cases.emplace_back(materialize(getListItem(node.a, 2 * i)), materialize(getListItem(node.a, 2 * i + 1)));
+        }
+        return Switch::create(std::move(cases));
+    }
+    case NodeKind::INCREMENT:
+        return Increment::create(identifier(image, node.a));
+    case NodeKind::DECREMENT:
+        return Decrement::create(identifier(image, node.a));
+    case NodeKind::CLASS_DECLARATION:
+        return ClassDeclaration::create(name(image, node.a), identifier(image, node.b), Block::create(children(image, node.c, node.d)));
+    case NodeKind::NEW_INSTANCE:
+        return NewInstance::create(name(image, node.a), children(image, node.b, node.c));
+    case NodeKind::MEMBER_ACCESS:
+        return memberAccess(image, index);
+    case NodeKind::LIST:
+        return ListExpression::create(children(image, node.a, node.b));
+    case NodeKind::MAP:
+    {
+        vector<pair<ExpressionPtr, ExpressionPtr>> entries;
+        for (uint32_t i = 0; i < node.b; ++i)
+        {
+            entries.emplace_back(materialize(getListItem(node.a, 2 * i)), materialize(getListItem(node.a, 2 * i + 1)));
+        }
+        return MapExpression::create(std::move(entries));
+    }
+    case NodeKind::INDEX_ACCESS:
+        return IndexAccess::create(materialize(node.a), materialize(node.b));
+    case NodeKind::INDEX_ASSIGNMENT:
+        return IndexAssignment::create(materialize(node.a), materialize(node.b), materialize(node.c));
+    case NodeKind::IMPORT:
+        return Import::create(name(image, node.a), names(image, node.b, node.c));
+    case NodeKind::YIELD:
+        return Yield::create(optional(image, node.a));
+    default:
+        throw runtime_error("Malformed program image: unknown node kind");
+    }
+}
+
+ExpressionPtr ProgramImage::materializeLazily(uint32_t index) const
+{
+    void(getNode(index));
+    return make_unique<LazyExpression>(shared_from_this(), index);
+}
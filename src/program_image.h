@@ -0,0 +1,342 @@
+#ifndef CPP_EVA_PROGRAM_IMAGE_H
+#define CPP_EVA_PROGRAM_IMAGE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "expressions.h"
+
+/**
+ * Kinds of nodes stored in a program image.
+ */
+enum class NodeKind : uint8_t
+{
+    NOP,
+    BLOCK,
+    CONDITION,
+    LOOP,
+    IDENTIFIER,
+    LITERAL,
+    VARIABLE_DECLARATION,
+    ASSIGNMENT,
+    BINARY_OPERATION,
+    FUNCTION_DECLARATION,
+    LAMBDA,
+    ANONYMOUS_FUNCTION_CALL,
+    FUNCTION_CALL,
+    FOR_LOOP,
+    SWITCH,
+    INCREMENT,
+    DECREMENT,
+    CLASS_DECLARATION,
+    NEW_INSTANCE,
+    MEMBER_ACCESS,
+    MEMBER_FUNCTION_CALL,
+    LIST,
+    MAP,
+    INDEX_ACCESS,
+    INDEX_ASSIGNMENT,
+    IMPORT,
+    YIELD,
+    FOR_IN
+};
+
+/**
+ * Kinds of values stored in literal nodes.
+ */
+enum class LiteralKind : uint8_t
+{
+    INT,
+    STRING,
+    BOOL,
+    NUL
+};
+
+/**
+ * This struct is used to represent the header of a program image.
+ *
+ * All offsets are relative to the beginning of the image and all sections are 8 byte aligned.
+ * The content hash covers everything after the header, the source hash is provided by the producer
+ * of the image (e.g. a hash of the script text) and is used to skip recompiling unchanged programs.
+ */
+struct ProgramHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t root;
+    uint64_t sourceHash;
+    uint64_t contentHash;
+    uint64_t size;
+    uint64_t nodesOffset;
+    uint32_t nodeCount;
+    uint32_t listCount;
+    uint64_t listsOffset;
+    uint64_t stringsOffset;
+    uint32_t stringCount;
+    uint32_t stringDataSize;
+    uint64_t stringDataOffset;
+};
+
+/**
+ * This struct is used to represent a single node of a program image.
+ *
+ * The meaning of the operands depends on the kind of the node: they are indices of other nodes,
+ * of strings, of the first element of a list, lengths of lists or immediate values.
+ */
+struct NodeRecord
+{
+    NodeKind kind;
+    uint8_t op;
+    uint16_t reserved;
+    uint32_t a;
+    uint32_t b;
+    uint32_t c;
+    uint32_t d;
+};
+
+/**
+ * This struct is used to represent an entry of the string table of a program image.
+ */
+struct StringRecord
+{
+    uint32_t offset;
+    uint32_t length;
+};
+
+/**
+ * This struct is used to represent a read-only memory mapping of a file.
+ *
+ * The mapping is released when the last copy of the storage is destroyed.
+ */
+struct MappedFile
+{
+    std::shared_ptr<const void> storage;
+    const char *data = nullptr;
+    size_t size = 0;
+
+    /**
+     * @brief Map a file into memory
+     *
+     * @param path The path of the file
+     *
+     * @return The mapping
+     *
+     * @throw std::runtime_error if the file cannot be mapped
+     */
+    static MappedFile open(const std::string &path);
+};
+
+/**
+ * @brief Replace the contents of a file atomically
+ *
+ * The bytes are written to a temporary file that is renamed over the target, so readers that have
+ * the previous version mapped are not affected.
+ *
+ * @param path The path of the file
+ * @param bytes The new contents of the file
+ *
+ * @throw std::runtime_error if the file cannot be written
+ */
+void writeFileAtomically(const std::string &path, const std::string &bytes);
+
+/**
+ * This class is used to serialize an expression tree into the binary program format.
+ *
+ * Strings are deduplicated and every node is stored as a fixed size record, so the image can be
+ * used in place after it is mapped into memory.
+ */
+class ProgramWriter
+{
+public:
+    static constexpr uint32_t npos = UINT32_MAX;
+
+    /**
+     * @brief Add an expression tree to the image
+     *
+     * The first added tree becomes the root of the image.
+     *
+     * @param exp The expression to serialize
+     *
+     * @return The index of the node representing the expression
+     */
+    uint32_t add(const Expression &exp);
+
+    /**
+     * @brief Add a string to the string table
+     *
+     * @param value The string to add
+     *
+     * @return The index of the string
+     */
+    uint32_t addString(const std::string &value);
+
+    /**
+     * @brief Add a list of indices to the list table
+     *
+     * @param items The indices of nodes or strings
+     *
+     * @return The index of the first item
+     */
+    uint32_t addList(const std::vector<uint32_t> &items);
+
+    /**
+     * @brief Serialize the image
+     *
+     * @param sourceHash The hash of the source the program was compiled from
+     *
+     * @return The bytes of the image
+     */
+    [[nodiscard]] std::string serialize(uint64_t sourceHash = 0) const;
+
+    /**
+     * @brief Write the image to a file unless the file already contains the same program
+     *
+     * The file is replaced atomically, so processes that have the previous version mapped are not affected.
+     *
+     * @param path The path of the image file
+     * @param sourceHash The hash of the source the program was compiled from
+     *
+     * @return true if the file was written, false if it was up to date
+     *
+     * @throw std::runtime_error if the file cannot be written
+     */
+    bool write(const std::string &path, uint64_t sourceHash = 0) const;
+
+private:
+    friend class ProgramSerializer;
+
+    uint32_t addNode(const NodeRecord &node);
+
+    std::vector<NodeRecord> nodes;
+    std::vector<uint32_t> lists;
+    std::vector<StringRecord> strings;
+    std::string stringData;
+    std::unordered_map<std::string, uint32_t> stringIndex;
+    uint32_t root = npos;
+};
+
+/**
+ * This class is used to represent a program image mapped into memory.
+ *
+ * Loading only maps the file and validates its header and the references between its nodes, nodes and
+ * strings are referenced in place.
+ * Expressions are materialized on demand: function bodies stay in the image until they are first evaluated.
+ */
+class ProgramImage : public std::enable_shared_from_this<ProgramImage>
+{
+public:
+    static constexpr uint32_t version = 1;
+
+    /**
+     * @brief Map a program image file into memory
+     *
+     * @param path The path of the image file
+     *
+     * @return The loaded image
+     *
+     * @throw std::runtime_error if the file cannot be mapped or is not a valid image
+     */
+    static std::shared_ptr<const ProgramImage> load(const std::string &path);
+
+    /**
+     * @brief Use a program image stored in memory
+     *
+     * @param bytes The bytes of the image
+     *
+     * @return The loaded image
+     *
+     * @throw std::runtime_error if the bytes are not a valid image
+     */
+    static std::shared_ptr<const ProgramImage> fromBytes(std::string bytes);
+
+    /**
+     * @brief Use a program image embedded in a larger memory region
+     *
+     * @param storage The owner of the memory region, kept alive as long as the image is used
+     * @param data The beginning of the image, aligned to 8 bytes
+     * @param size The size of the image
+     *
+     * @return The loaded image
+     *
+     * @throw std::runtime_error if the bytes are not a valid image
+     */
+    static std::shared_ptr<const ProgramImage> fromRegion(std::shared_ptr<const void> storage, const char *data, size_t size);
+
+    /**
+     * @brief Check whether an image file was compiled from the given source
+     *
+     * Only the header of the file is read.
+     *
+     * @param path The path of the image file
+     * @param sourceHash The hash of the source
+     *
+     * @return true if the file is a valid image with the same source hash
+     */
+    static bool isUpToDate(const std::string &path, uint64_t sourceHash);
+
+    ProgramImage(const ProgramImage &) = delete;
+    ProgramImage &operator=(const ProgramImage &) = delete;
+
+    [[nodiscard]] const ProgramHeader &getHeader() const
+    {
+        return *header;
+    }
+
+    [[nodiscard]] uint32_t getRoot() const
+    {
+        return header->root;
+    }
+
+    [[nodiscard]] const NodeRecord &getNode(uint32_t index) const;
+
+    [[nodiscard]] std::string_view getString(uint32_t index) const;
+
+    [[nodiscard]] uint32_t getListItem(uint32_t start, uint32_t offset) const;
+
+    /**
+     * @brief Build an expression tree from a node of the image
+     *
+     * @param index The index of the node, the root of the image by default
+     *
+     * @return The expression tree
+     *
+     * @throw std::runtime_error if the image is malformed
+     */
+    [[nodiscard]] ExpressionPtr materialize(uint32_t index = ProgramWriter::npos) const;
+
+    /**
+     * @brief Build an expression that materializes a node of the image when it is first used
+     *
+     * @param index The index of the node
+     *
+     * @return The expression
+     *
+     * @throw std::runtime_error if the index is out of bounds
+     */
+    [[nodiscard]] ExpressionPtr materializeLazily(uint32_t index) const;
+
+private:
+    ProgramImage(std::shared_ptr<const void> storage, const char *data, size_t size);
+
+    void validate();
+
+    void validateReferences(uint32_t index) const;
+
+    std::shared_ptr<const void> storage;
+    const char *data;
+    size_t size;
+    const ProgramHeader *header;
+    const NodeRecord *nodes;
+    const uint32_t *lists;
+    const StringRecord *strings;
+    const char *stringData;
+};
+
+using ProgramImagePtr = std::shared_ptr<const ProgramImage>;
+
+#endif // CPP_EVA_PROGRAM_IMAGE_H
@@ -0,0 +1,126 @@
+#include "rope.h"
+
+#include <stdexcept>
+#include <variant>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+    shared_ptr<const Rope> toRope(const EvalResult &value)
+    {
+        if (auto rope = get_if<RopeValue>(&value))
+        {
+            return rope->rope;
+        }
+        return make_shared<const Rope>(get<string>(value));
+    }
+}
+
+EvalResult Rope::concat(const EvalResult &left, const EvalResult &right)
+{
+    auto leftText = get_if<string>(&left);
+    auto rightText = get_if<string>(&right);
+    auto leftRope = get_if<RopeValue>(&left);
+    if ((!leftText && !leftRope) || (!rightText && !holds_alternative<RopeValue>(right)))
+    {
+        throw runtime_error("Only strings can be concatenated");
+    }
+
+    if (leftText && rightText && leftText->size() + rightText->size() < leafSize)
+    {
+        return *leftText + *rightText;
+    }
+
+    // Appending a short piece to a rope: copy its last leaf instead of adding a node for the piece
+    if (leftRope && rightText && leftRope->rope->right)
+    {
+        const auto &last = *leftRope->rope->right;
+        if (!last.right && last.leaf.size() + rightText->size() <= leafSize)
+        {
+            auto merged = make_shared<const Rope>(last.leaf + *rightText);
+            return RopeValue{make_shared<const Rope>(leftRope->rope->left, std::move(merged))};
+        }
+    }
+
+    return RopeValue{make_shared<const Rope>(toRope(left), toRope(right))};
+}
+
+Rope::Rope(string text) : length(text.size()), leaf(std::move(text))
+{
+    heap.grow(sizeof(Rope) + leaf.capacity());
+}
+
+Rope::Rope(shared_ptr<const Rope> left, shared_ptr<const Rope> right)
+    : length(left->size() + right->size()), left(std::move(left)), right(std::move(right))
+{
+    heap.grow(sizeof(Rope));
+}
+
+Rope::~Rope()
+{
+    vector<shared_ptr<const Rope>> pending;
+    auto take = [&pending](shared_ptr<const Rope> &child)
+    {
+        // Only inner nodes that nobody else owns would be destroyed recursively
+        if (child && child->left && child.use_count() == 1)
+        {
+            pending.push_back(std::move(child));
+        }
+    };
+
+    take(left);
+    take(right);
+    while (!pending.empty())
+    {
+        auto node = std::move(pending.back());
+        pending.pop_back();
+        // The node is destroyed at the end of the iteration, after its children were taken
+        auto &owned = const_cast<Rope &>(*node);
+        take(owned.left);
+        take(owned.right);
+    }
+}
+
+const string &Rope::flatten() const
+{
+    if (!left)
+    {
+        return leaf;
+    }
+
+    call_once(flattened, [this]
+              {
+        heap.grow(length);
+        text.reserve(length);
+        vector<const Rope *> pending{this};
+        while (!pending.empty())
+        {
+            auto node = pending.back();
+            pending.pop_back();
+            if (!node->left)
+            {
+                text += node->leaf;
+            }
+            else
+            {
+                pending.push_back(node->right.get());
+                pending.push_back(node->left.get());
+            }
+        } });
+    return text;
+}
+
+const string *textOf(const EvalResult &value)
+{
+    if (auto text = get_if<string>(&value))
+    {
+        return text;
+    }
+    if (auto rope = get_if<RopeValue>(&value))
+    {
+        return &rope->rope->flatten();
+    }
+    return nullptr;
+}
@@ -0,0 +1,85 @@
+#ifndef CPP_EVA_ROPE_H
+#define CPP_EVA_ROPE_H
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "eval_types.h"
+#include "governor.h"
+
+/**
+ * This class is used to represent long strings built by concatenation.
+ *
+ * A rope is a binary tree whose leaves hold the characters. Concatenating creates a node above the operands
+ * instead of copying them, and short pieces appended to a rope are merged into its last leaf, so building a
+ * string from n appends takes O(n) time and keeps the tree shallow enough to walk. The characters are only
+ * copied into one string when they are needed, the first time flatten() is called.
+ *
+ * Ropes are immutable, flattening is synchronized, so they can be shared between threads. Nodes, leaves and
+ * the flattened string are charged to the resource governor.
+ */
+class Rope
+{
+public:
+    /**
+     * Concatenations shorter than this produce plain strings, and leaves grow up to this size.
+     */
+    static constexpr size_t leafSize = 256;
+
+    /**
+     * @brief Concatenate two strings or ropes
+     *
+     * @param left The first operand
+     * @param right The second operand
+     *
+     * @return A string if the result is shorter than leafSize, a rope otherwise
+     *
+     * @throw std::runtime_error if an operand is not a string or a rope
+     */
+    static EvalResult concat(const EvalResult &left, const EvalResult &right);
+
+    explicit Rope(std::string text);
+
+    Rope(std::shared_ptr<const Rope> left, std::shared_ptr<const Rope> right);
+
+    Rope(const Rope &) = delete;
+    Rope &operator=(const Rope &) = delete;
+
+    /**
+     * Releases long chains of nodes iteratively, so destroying a rope cannot overflow the stack.
+     */
+    ~Rope();
+
+    /**
+     * @brief Get the characters of the rope
+     *
+     * @return The string, built on the first call
+     */
+    [[nodiscard]] const std::string &flatten() const;
+
+    [[nodiscard]] size_t size() const
+    {
+        return length;
+    }
+
+private:
+    size_t length;
+    std::string leaf;
+    std::shared_ptr<const Rope> left;
+    std::shared_ptr<const Rope> right;
+    mutable std::once_flag flattened;
+    mutable std::string text;
+    mutable HeapAccount heap;
+};
+
+/**
+ * @brief Get the characters of a string or a rope
+ *
+ * @param value The value
+ *
+ * @return A pointer to the characters, nullptr if the value is neither a string nor a rope
+ */
+const std::string *textOf(const EvalResult &value);
+
+#endif // CPP_EVA_ROPE_H
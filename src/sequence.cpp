@@ -0,0 +1,291 @@
+#include "sequence.h"
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <variant>
+#include "actor.h"
+#include "builtins.h"
+#include "collections.h"
+#include "expressions.h"
+#include "generator.h"
+#include "persistent.h"
+
+using namespace std;
+
+namespace
+{
+    class RangeCursor : public Cursor
+    {
+    public:
+        RangeCursor(int start, int end, int step) : current(start), end(end), step(step) {}
+
+        bool next(EvalResult &value) override
+        {
+            if (step > 0 ? current >= end : current <= end)
+            {
+                return false;
+            }
+            value = current;
+            // A step past the end would overflow near the limits of int, so the range ends at its bound instead
+            auto left = static_cast<int64_t>(end) - current;
+            current = step > 0 ? (left <= step ? end : current + step) : (left >= step ? end : current + step);
+            return true;
+        }
+
+    private:
+        int current;
+        int end;
+        int step;
+    };
+
+    class ListCursor : public Cursor
+    {
+    public:
+        explicit ListCursor(shared_ptr<List> list) : list(std::move(list)) {}
+
+        bool next(EvalResult &value) override
+        {
+            if (index >= list->size())
+            {
+                return false;
+            }
+            value = list->items[index++];
+            return true;
+        }
+
+    private:
+        shared_ptr<List> list;
+        size_t index = 0;
+    };
+
+    class MapCursor : public Cursor
+    {
+    public:
+        explicit MapCursor(shared_ptr<HashMap> map) : map(std::move(map)) {}
+
+        bool next(EvalResult &value) override
+        {
+            auto entry = map->findEntry(slot);
+            if (!entry)
+            {
+                return false;
+            }
+            value = entry->key;
+            ++slot;
+            return true;
+        }
+
+    private:
+        shared_ptr<HashMap> map;
+        size_t slot = 0;
+    };
+
+    class VectorCursor : public Cursor
+    {
+    public:
+        explicit VectorCursor(shared_ptr<const PersistentVector> vector) : vector(std::move(vector)) {}
+
+        bool next(EvalResult &value) override
+        {
+            if (index >= vector->size())
+            {
+                return false;
+            }
+            value = vector->at(static_cast<int>(index++));
+            return true;
+        }
+
+    private:
+        shared_ptr<const PersistentVector> vector;
+        size_t index = 0;
+    };
+
+    class KeysCursor : public Cursor
+    {
+    public:
+        explicit KeysCursor(const PersistentMap &map)
+        {
+            keys.reserve(map.size());
+            map.forEach([this](const EvalResult &key, const EvalResult &)
+                        { keys.push_back(key); });
+        }
+
+        bool next(EvalResult &value) override
+        {
+            if (index >= keys.size())
+            {
+                return false;
+            }
+            value = std::move(keys[index++]);
+            return true;
+        }
+
+    private:
+        vector<EvalResult> keys;
+        size_t index = 0;
+    };
+
+    class GeneratorCursor : public Cursor
+    {
+    public:
+        explicit GeneratorCursor(shared_ptr<Generator> generator) : generator(std::move(generator)) {}
+
+        bool next(EvalResult &value) override
+        {
+            return generator->next(value);
+        }
+
+    private:
+        shared_ptr<Generator> generator;
+    };
+
+    class ChannelCursor : public Cursor
+    {
+    public:
+        explicit ChannelCursor(shared_ptr<Channel> channel) : channel(std::move(channel)) {}
+
+        bool next(EvalResult &value) override
+        {
+            return channel->receive(value);
+        }
+
+    private:
+        shared_ptr<Channel> channel;
+    };
+
+    /**
+     * This class is used to run the stages of a sequence over its source in a single pass.
+     */
+    class StageCursor : public Cursor
+    {
+    public:
+        StageCursor(unique_ptr<Cursor> source, shared_ptr<const Sequence> sequence)
+            : source(std::move(source)), sequence(std::move(sequence)), stages(this->sequence->getStages()),
+              remaining(stages.size())
+        {
+            for (size_t i = 0; i < stages.size(); ++i)
+            {
+                remaining[i] = stages[i].count;
+                // A take of no items lets nothing through, so nothing is pulled for it
+                finished = finished || (stages[i].kind == Sequence::StageKind::TAKE && stages[i].count == 0);
+            }
+        }
+
+        bool next(EvalResult &value) override
+        {
+            EvalResult item;
+            // Nothing is pulled from the source once a take stage has let its last item through
+            while (!finished && source->next(item))
+            {
+                if (pass(item))
+                {
+                    value = std::move(item);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+    private:
+        bool pass(EvalResult &item)
+        {
+            for (size_t i = 0; i < stages.size(); ++i)
+            {
+                const auto &stage = stages[i];
+                switch (stage.kind)
+                {
+                case Sequence::StageKind::MAP:
+                    item = AnonymousFunctionCall::invoke(stage.function, &item, 1);
+                    break;
+                case Sequence::StageKind::FILTER:
+                    if (!get<bool>(AnonymousFunctionCall::invoke(stage.function, &item, 1)))
+                    {
+                        return false;
+                    }
+                    break;
+                case Sequence::StageKind::TAKE:
+                    if (remaining[i] == 0)
+                    {
+                        finished = true;
+                        return false;
+                    }
+                    finished = finished || --remaining[i] == 0;
+                    break;
+                }
+            }
+            return true;
+        }
+
+        unique_ptr<Cursor> source;
+        shared_ptr<const Sequence> sequence;
+        const vector<Sequence::Stage> &stages;
+        vector<size_t> remaining;
+        bool finished = false;
+    };
+}
+
+shared_ptr<const Sequence> Sequence::of(const EvalResult &value)
+{
+    if (auto sequence = get_if<SequenceValue>(&value))
+    {
+        return sequence->sequence;
+    }
+    if (holds_alternative<ListValue>(value) || holds_alternative<MapValue>(value) || holds_alternative<VectorValue>(value) ||
+        holds_alternative<TableValue>(value) || holds_alternative<GeneratorValue>(value) ||
+        holds_alternative<ChannelValue>(value))
+    {
+        return make_shared<Sequence>(value, vector<Stage>{});
+    }
+    throw runtime_error("Cannot iterate over " + toString(value));
+}
+
+shared_ptr<const Sequence> Sequence::range(int start, int end, int step)
+{
+    if (step == 0)
+    {
+        throw runtime_error("range: step cannot be 0");
+    }
+    return make_shared<Sequence>(start, end, step);
+}
+
+SequenceValue Sequence::then(Stage stage) const
+{
+    auto sequence = make_shared<Sequence>(*this);
+    sequence->stages.push_back(std::move(stage));
+    return SequenceValue{std::move(sequence)};
+}
+
+unique_ptr<Cursor> Sequence::cursor() const
+{
+    unique_ptr<Cursor> items;
+    if (isRange)
+    {
+        items = make_unique<RangeCursor>(start, end, step);
+    }
+    else if (auto list = get_if<ListValue>(&source))
+    {
+        items = make_unique<ListCursor>(list->list);
+    }
+    else if (auto map = get_if<MapValue>(&source))
+    {
+        items = make_unique<MapCursor>(map->map);
+    }
+    else if (auto vector = get_if<VectorValue>(&source))
+    {
+        items = make_unique<VectorCursor>(vector->vector);
+    }
+    else if (auto table = get_if<TableValue>(&source))
+    {
+        items = make_unique<KeysCursor>(*table->map);
+    }
+    else if (auto channel = get_if<ChannelValue>(&source))
+    {
+        items = make_unique<ChannelCursor>(channel->channel);
+    }
+    else
+    {
+        items = make_unique<GeneratorCursor>(get<GeneratorValue>(source).generator);
+    }
+    return stages.empty() ? std::move(items) : make_unique<StageCursor>(std::move(items), shared_from_this());
+}
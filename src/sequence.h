@@ -0,0 +1,111 @@
+#ifndef CPP_EVA_SEQUENCE_H
+#define CPP_EVA_SEQUENCE_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include "eval_types.h"
+
+/**
+ * This class is used to iterate over the items of a sequence, one item at a time.
+ *
+ * Cursors are the iterator protocol of the interpreter: ranges, lists, maps, vectors, tables, generators,
+ * channels and lazy sequences all produce their items through a cursor, for loops over values pull from one.
+ */
+class Cursor
+{
+public:
+    virtual ~Cursor() = default;
+
+    /**
+     * @brief Move to the next item
+     *
+     * @param value Set to the item
+     *
+     * @return false once there are no more items, value is left unchanged then
+     */
+    virtual bool next(EvalResult &value) = 0;
+};
+
+/**
+ * This class is used to represent a lazy sequence: a source of items and the stages applied to them.
+ *
+ * Stages are only recorded when a sequence is built, nothing runs until the sequence is iterated. Adding a
+ * stage to a sequence copies the list of stages, never the items, so a chain like filter, map, take runs as
+ * one fused loop over the source: every item goes through all the stages before the next one is pulled, and
+ * no collection is built between them. Iterating a sequence again starts over from the source, except for
+ * generators and channels, which produce each item once.
+ *
+ * The source is iterated as it is when the cursor pulls from it: lists see the items added during the
+ * iteration, maps iterate their keys in slot order, tables the keys they held when the cursor was created.
+ */
+class Sequence : public std::enable_shared_from_this<Sequence>
+{
+public:
+    enum class StageKind
+    {
+        MAP,
+        FILTER,
+        TAKE
+    };
+
+    struct Stage
+    {
+        StageKind kind;
+        // The function of MAP and FILTER stages
+        EvalResult function;
+        // The number of items a TAKE stage lets through
+        size_t count = 0;
+    };
+
+    /**
+     * @brief Get the sequence of the items of a value
+     *
+     * @param value A list, map, vector, table, generator, channel or sequence
+     *
+     * @return The sequence, the value itself for sequences
+     *
+     * @throw std::runtime_error if the value cannot be iterated
+     */
+    static std::shared_ptr<const Sequence> of(const EvalResult &value);
+
+    /**
+     * @brief Create the sequence of the integers from start up to, not including, end
+     *
+     * @throw std::runtime_error if the step is 0
+     */
+    static std::shared_ptr<const Sequence> range(int start, int end, int step = 1);
+
+    Sequence(EvalResult source, std::vector<Stage> stages)
+        : source(std::move(source)), stages(std::move(stages)) {}
+
+    Sequence(int start, int end, int step)
+        : start(start), end(end), step(step), isRange(true) {}
+
+    /**
+     * @brief Create a sequence with one more stage
+     */
+    [[nodiscard]] SequenceValue then(Stage stage) const;
+
+    /**
+     * @brief Start iterating the sequence
+     *
+     * The cursor keeps the sequence alive.
+     */
+    [[nodiscard]] std::unique_ptr<Cursor> cursor() const;
+
+    [[nodiscard]] const std::vector<Stage> &getStages() const
+    {
+        return stages;
+    }
+
+private:
+    EvalResult source;
+    int start = 0;
+    int end = 0;
+    int step = 1;
+    bool isRange = false;
+    std::vector<Stage> stages;
+};
+
+#endif // CPP_EVA_SEQUENCE_H
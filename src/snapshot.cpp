@@ -0,0 +1,455 @@
+#include "snapshot.h"
+
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+#include "builtins.h"
+#include "jit.h"
+#include "program_image.h"
+#include "rope.h"
+
+using namespace std;
+
+namespace
+{
+    constexpr char magic[4] = {'E', 'V', 'A', 'S'};
+    constexpr uint32_t byteOrderMark = 0x01020304;
+    constexpr uint32_t npos = ProgramWriter::npos;
+
+    enum class ValueKind : uint8_t
+    {
+        INT,
+        STRING,
+        BOOL,
+        NUL,
+        FUNCTION,
+        CLASS,
+        INSTANCE,
+        NATIVE,
+        GENERATOR,
+        CELL
+    };
+
+    /**
+     * Header of a snapshot. The program image holding names, strings and function bodies follows the records.
+     *
+     * Variables captured by closures share a cell between environments. The value of each cell is stored
+     * once in the cells section, and the variables sharing it refer to it by index.
+     */
+    struct SnapshotHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint32_t root;
+        uint64_t size;
+        uint32_t environmentCount;
+        uint32_t variableCount;
+        uint32_t cellCount;
+        uint32_t reserved;
+        uint64_t environmentsOffset;
+        uint64_t variablesOffset;
+        uint64_t cellsOffset;
+        uint64_t imageOffset;
+        uint64_t imageSize;
+    };
+
+    struct EnvironmentRecord
+    {
+        uint32_t parent;
+        uint32_t firstVariable;
+        uint32_t variableCount;
+        uint32_t reserved;
+    };
+
+    /*
+     * Operands of the variable records:
+     *
+     * INT, BOOL   a = value
+     * STRING      a = string
+     * FUNCTION    a = name, b = first parameter name in the list table, c = number of parameters, d = body, e = environment
+     * GENERATOR   the operands of FUNCTION, for a generator function
+     * CLASS       a = name, e = environment
+     * INSTANCE    e = environment
+     * NATIVE      a = name of the builtin
+     * CELL        a = cell
+     */
+    struct VariableRecord
+    {
+        uint32_t name;
+        ValueKind kind;
+        uint8_t reserved[3];
+        uint32_t a;
+        uint32_t b;
+        uint32_t c;
+        uint32_t d;
+        uint32_t e;
+    };
+
+    size_t align(size_t offset)
+    {
+        return (offset + 7) & ~size_t(7);
+    }
+
+    /**
+     * This class is used to collect the environments reachable from the global one.
+     */
+    class SnapshotWriter
+    {
+    public:
+        uint32_t add(const Environment *env)
+        {
+            if (!env)
+            {
+                return npos;
+            }
+
+            auto it = environmentIndex.find(env);
+            if (it != environmentIndex.end())
+            {
+                return it->second;
+            }
+
+            auto index = static_cast<uint32_t>(environments.size());
+            environmentIndex.emplace(env, index);
+            environments.push_back({});
+            variables.emplace_back();
+
+            auto parent = add(env->getParent().get());
+            vector<VariableRecord> records;
+            for (const auto &variable : env->getVariables())
+            {
+                auto record = variable.cell ? share(variable.cell.get()) : encode(variable.get());
+                record.name = program.addString(variable.name);
+                records.push_back(record);
+            }
+
+            environments[index].parent = parent;
+            variables[index] = std::move(records);
+            return index;
+        }
+
+        string serialize(uint32_t root) const
+        {
+            auto image = program.serialize();
+
+            SnapshotHeader header{};
+            memcpy(header.magic, magic, sizeof(magic));
+            header.version = Snapshot::version;
+            header.byteOrder = byteOrderMark;
+            header.root = root;
+            header.environmentCount = static_cast<uint32_t>(environments.size());
+
+            vector<EnvironmentRecord> envs = environments;
+            vector<VariableRecord> vars;
+            for (size_t i = 0; i < envs.size(); ++i)
+            {
+                envs[i].firstVariable = static_cast<uint32_t>(vars.size());
+                envs[i].variableCount = static_cast<uint32_t>(variables[i].size());
+                vars.insert(vars.end(), variables[i].begin(), variables[i].end());
+            }
+            header.variableCount = static_cast<uint32_t>(vars.size());
+            header.cellCount = static_cast<uint32_t>(cells.size());
+
+            header.environmentsOffset = align(sizeof(SnapshotHeader));
+            header.variablesOffset = align(header.environmentsOffset + envs.size() * sizeof(EnvironmentRecord));
+            header.cellsOffset = align(header.variablesOffset + vars.size() * sizeof(VariableRecord));
+            header.imageOffset = align(header.cellsOffset + cells.size() * sizeof(VariableRecord));
+            header.imageSize = image.size();
+            header.size = align(header.imageOffset + image.size());
+
+            string bytes(header.size, '\0');
+            memcpy(&bytes[0], &header, sizeof(header));
+            memcpy(&bytes[header.environmentsOffset], envs.data(), envs.size() * sizeof(EnvironmentRecord));
+            memcpy(&bytes[header.variablesOffset], vars.data(), vars.size() * sizeof(VariableRecord));
+            memcpy(&bytes[header.cellsOffset], cells.data(), cells.size() * sizeof(VariableRecord));
+            memcpy(&bytes[header.imageOffset], image.data(), image.size());
+            return bytes;
+        }
+
+    private:
+        VariableRecord share(const EvalResult *cell)
+        {
+            VariableRecord record{};
+            record.kind = ValueKind::CELL;
+
+            auto it = cellIndex.find(cell);
+            if (it != cellIndex.end())
+            {
+                record.a = it->second;
+                return record;
+            }
+
+            // The index is reserved first, the value may be a closure over an environment sharing the cell
+            record.a = static_cast<uint32_t>(cells.size());
+            cellIndex.emplace(cell, record.a);
+            cells.emplace_back();
+            cells[record.a] = encode(*cell);
+            return record;
+        }
+
+        VariableRecord encode(const EvalResult &value)
+        {
+            VariableRecord record{};
+            if (auto number = get_if<int>(&value))
+            {
+                record.kind = ValueKind::INT;
+                record.a = static_cast<uint32_t>(*number);
+            }
+            else if (auto str = textOf(value))
+            {
+                // Ropes are restored as the flattened string
+                record.kind = ValueKind::STRING;
+                record.a = program.addString(*str);
+            }
+            else if (auto flag = get_if<bool>(&value))
+            {
+                record.kind = ValueKind::BOOL;
+                record.a = *flag ? 1 : 0;
+            }
+            else if (holds_alternative<Null>(value))
+            {
+                record.kind = ValueKind::NUL;
+            }
+            else if (auto function = get_if<FunctionDefinition>(&value))
+            {
+                vector<uint32_t> params;
+                for (const auto &param : function->params)
+                {
+                    params.push_back(program.addString(param));
+                }
+                record.kind = function->generator ? ValueKind::GENERATOR : ValueKind::FUNCTION;
+                record.a = program.addString(function->name);
+                record.b = program.addList(params);
+                record.c = static_cast<uint32_t>(params.size());
+                record.d = body(function->body.get());
+                record.e = add(function->env.get());
+            }
+            else if (auto classDefinition = get_if<ClassDefinition>(&value))
+            {
+                record.kind = ValueKind::CLASS;
+                record.a = program.addString(classDefinition->name);
+                record.e = add(classDefinition->env.get());
+            }
+            else if (auto instance = get_if<InstanceDefinition>(&value))
+            {
+                record.kind = ValueKind::INSTANCE;
+                record.e = add(instance->env.get());
+            }
+            else if (auto native = get_if<NativeFunction>(&value))
+            {
+                if (builtins().count(native->name) == 0)
+                {
+                    throw runtime_error("Cannot serialize native function " + native->name + " in snapshot");
+                }
+                record.kind = ValueKind::NATIVE;
+                record.a = program.addString(native->name);
+            }
+            else
+            {
+                throw runtime_error("Cannot serialize value in snapshot");
+            }
+            return record;
+        }
+
+        uint32_t body(const Expression *exp)
+        {
+            if (!exp)
+            {
+                return npos;
+            }
+
+            auto it = bodies.find(exp);
+            if (it != bodies.end())
+            {
+                return it->second;
+            }
+            auto index = program.add(*exp);
+            bodies.emplace(exp, index);
+            return index;
+        }
+
+        ProgramWriter program;
+        unordered_map<const Environment *, uint32_t> environmentIndex;
+        unordered_map<const Expression *, uint32_t> bodies;
+        unordered_map<const EvalResult *, uint32_t> cellIndex;
+        vector<EnvironmentRecord> environments;
+        vector<vector<VariableRecord>> variables;
+        vector<VariableRecord> cells;
+    };
+}
+
+std::string Snapshot::serialize(const Environment &global)
+{
+    SnapshotWriter writer;
+    auto root = writer.add(&global);
+    return writer.serialize(root);
+}
+
+void Snapshot::write(const Environment &global, const std::string &path)
+{
+    writeFileAtomically(path, serialize(global));
+}
+
+std::shared_ptr<Environment> Snapshot::load(const std::string &path)
+{
+    auto file = MappedFile::open(path);
+    return restore(std::move(file.storage), file.data, file.size);
+}
+
+std::shared_ptr<Environment> Snapshot::fromBytes(std::string bytes)
+{
+    auto storage = make_shared<const string>(std::move(bytes));
+    return restore(storage, storage->data(), storage->size());
+}
+
+std::shared_ptr<Environment> Snapshot::restore(std::shared_ptr<const void> storage, const char *data, size_t size)
+{
+    auto fits = [size](uint64_t offset, uint64_t count, size_t itemSize)
+    {
+        return offset % 8 == 0 && offset <= size && count <= (size - offset) / itemSize;
+    };
+
+    if (size < sizeof(SnapshotHeader) || reinterpret_cast<uintptr_t>(data) % 8 != 0)
+    {
+        throw runtime_error("Invalid snapshot: truncated header");
+    }
+
+    const auto &header = *reinterpret_cast<const SnapshotHeader *>(data);
+    if (memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version != version || header.byteOrder != byteOrderMark)
+    {
+        throw runtime_error("Invalid snapshot: unsupported format");
+    }
+    if (header.size != size ||
+        header.root >= header.environmentCount ||
+        !fits(header.environmentsOffset, header.environmentCount, sizeof(EnvironmentRecord)) ||
+        !fits(header.variablesOffset, header.variableCount, sizeof(VariableRecord)) ||
+        !fits(header.cellsOffset, header.cellCount, sizeof(VariableRecord)) ||
+        !fits(header.imageOffset, header.imageSize, 1))
+    {
+        throw runtime_error("Invalid snapshot: section out of bounds");
+    }
+
+    auto records = reinterpret_cast<const EnvironmentRecord *>(data + header.environmentsOffset);
+    auto variables = reinterpret_cast<const VariableRecord *>(data + header.variablesOffset);
+    auto cellRecords = reinterpret_cast<const VariableRecord *>(data + header.cellsOffset);
+    auto image = ProgramImage::fromRegion(std::move(storage), data + header.imageOffset, header.imageSize);
+
+    vector<shared_ptr<Environment>> environments(header.environmentCount);
+    vector<bool> visiting(header.environmentCount);
+
+    function<shared_ptr<Environment>(uint32_t)> environment = [&](uint32_t index) -> shared_ptr<Environment>
+    {
+        if (index == npos)
+        {
+            return nullptr;
+        }
+        if (index >= header.environmentCount || visiting[index])
+        {
+            throw runtime_error("Invalid snapshot: bad environment reference");
+        }
+        if (!environments[index])
+        {
+            visiting[index] = true;
+            environments[index] = make_shared<Environment>(EvalMap{}, environment(records[index].parent));
+            visiting[index] = false;
+        }
+        return environments[index];
+    };
+
+    unordered_map<uint32_t, shared_ptr<Expression>> bodies;
+    auto body = [&](uint32_t index) -> shared_ptr<Expression>
+    {
+        if (index == npos)
+        {
+            return nullptr;
+        }
+        auto &exp = bodies[index];
+        if (!exp)
+        {
+            exp = image->materializeLazily(index);
+        }
+        return exp;
+    };
+
+    auto decode = [&](const VariableRecord &record) -> EvalResult
+    {
+        switch (record.kind)
+        {
+        case ValueKind::INT:
+            return static_cast<int>(record.a);
+        case ValueKind::STRING:
+            return string(image->getString(record.a));
+        case ValueKind::BOOL:
+            return record.a != 0;
+        case ValueKind::NUL:
+            return Null{};
+        case ValueKind::FUNCTION:
+        case ValueKind::GENERATOR:
+        {
+            vector<string> params;
+            for (uint32_t i = 0; i < record.c; ++i)
+            {
+                params.emplace_back(image->getString(image->getListItem(record.b, i)));
+            }
+            return FunctionDefinition{string(image->getString(record.a)), std::move(params), body(record.d), environment(record.e),
+                                      make_shared<CallProfile>(), record.kind == ValueKind::GENERATOR};
+        }
+        case ValueKind::CLASS:
+            return ClassDefinition{string(image->getString(record.a)), environment(record.e)};
+        case ValueKind::INSTANCE:
+            return InstanceDefinition{environment(record.e)};
+        case ValueKind::NATIVE:
+        {
+            auto it = builtins().find(string(image->getString(record.a)));
+            if (it == builtins().end())
+            {
+                throw runtime_error("Invalid snapshot: unknown native function");
+            }
+            return it->second;
+        }
+        default:
+            throw runtime_error("Invalid snapshot: unknown value kind");
+        }
+    };
+
+    vector<shared_ptr<EvalResult>> cells(header.cellCount);
+    auto cell = [&](uint32_t index) -> shared_ptr<EvalResult>
+    {
+        if (index >= header.cellCount || cellRecords[index].kind == ValueKind::CELL)
+        {
+            throw runtime_error("Invalid snapshot: bad cell reference");
+        }
+        if (!cells[index])
+        {
+            cells[index] = make_shared<EvalResult>(decode(cellRecords[index]));
+        }
+        return cells[index];
+    };
+
+    for (uint32_t i = 0; i < header.environmentCount; ++i)
+    {
+        const auto &record = records[i];
+        if (record.firstVariable > header.variableCount || record.variableCount > header.variableCount - record.firstVariable)
+        {
+            throw runtime_error("Invalid snapshot: variables out of bounds");
+        }
+
+        auto env = environment(i);
+        for (uint32_t j = 0; j < record.variableCount; ++j)
+        {
+            const auto &variable = variables[record.firstVariable + j];
+            if (variable.kind == ValueKind::CELL)
+            {
+                env->share(string(image->getString(variable.name)), cell(variable.a));
+                continue;
+            }
+            env->define(string(image->getString(variable.name)), decode(variable));
+        }
+    }
+
+    return environments[header.root];
+}
@@ -0,0 +1,73 @@
+#ifndef CPP_EVA_SNAPSHOT_H
+#define CPP_EVA_SNAPSHOT_H
+
+#include <memory>
+#include <string>
+#include "environment.h"
+
+/**
+ * This class is used to save and restore the state of an initialized interpreter.
+ *
+ * A snapshot contains every environment reachable from the global one, together with the variables,
+ * closures, classes and instances stored in them. Function bodies are stored as a program image, so
+ * restoring a snapshot maps the file and rebuilds the environments without evaluating or even
+ * materializing any code: bodies are materialized when they are first called.
+ *
+ * @code
+ * Snapshot::write(*eva.getGlobal(), "prelude.evas");
+ * Eva restored(Snapshot::load("prelude.evas"));
+ * @endcode
+ */
+class Snapshot
+{
+public:
+    static constexpr uint32_t version = 2;
+
+    /**
+     * @brief Serialize an environment and everything reachable from it
+     *
+     * @param global The environment to serialize
+     *
+     * @return The bytes of the snapshot
+     *
+     * @throw std::runtime_error if a value cannot be serialized
+     */
+    static std::string serialize(const Environment &global);
+
+    /**
+     * @brief Write a snapshot of an environment to a file
+     *
+     * @param global The environment to serialize
+     * @param path The path of the snapshot file
+     *
+     * @throw std::runtime_error if a value cannot be serialized or the file cannot be written
+     */
+    static void write(const Environment &global, const std::string &path);
+
+    /**
+     * @brief Restore an environment from a snapshot file
+     *
+     * @param path The path of the snapshot file
+     *
+     * @return The restored environment
+     *
+     * @throw std::runtime_error if the file cannot be mapped or is not a valid snapshot
+     */
+    static std::shared_ptr<Environment> load(const std::string &path);
+
+    /**
+     * @brief Restore an environment from a snapshot stored in memory
+     *
+     * @param bytes The bytes of the snapshot
+     *
+     * @return The restored environment
+     *
+     * @throw std::runtime_error if the bytes are not a valid snapshot
+     */
+    static std::shared_ptr<Environment> fromBytes(std::string bytes);
+
+private:
+    static std::shared_ptr<Environment> restore(std::shared_ptr<const void> storage, const char *data, size_t size);
+};
+
+#endif // CPP_EVA_SNAPSHOT_H
@@ -0,0 +1,590 @@
+#ifndef CPP_EVA_STATIC_EVA_H
+#define CPP_EVA_STATIC_EVA_H
+
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "expressions.h"
+
+/**
+ * Compile-time flavor of the expression DSL.
+ *
+ * The program is encoded in the types of the expression templates built by the functions below, variables are
+ * resolved to typed slots at compile time and ct::eval() runs the program as plain C++ code, which the compiler
+ * can inline or evaluate in a constant expression. The same program can be lowered to a runtime expression tree
+ * with toExpression(), so it can also be run by the interpreter.
+ *
+ * The semantics follow the interpreter:
+ * - arithmetic and comparisons operate on integers, arithmetic wraps at 32 bits and a zero divisor throws
+ *   std::runtime_error (or does not compile in a constant expression),
+ * - blocks create a new scope, a for loop initializer declares its variable in the enclosing scope,
+ * - every iteration of a for loop runs the body and the modifier in a new scope,
+ * - loops return the value of the last iteration, or a default value if the body was never run,
+ * - assignments, increments and decrements return the new value.
+ *
+ * Variable declarations must appear directly in a block or as the initializer of a for loop.
+ *
+ * @code
+ * constexpr auto i = EVA_SYMBOL(i);
+ * constexpr auto sum = EVA_SYMBOL(sum);
+ * constexpr auto program = ct::beg(
+ *     ct::var(sum, 0),
+ *     ct::floop(ct::var(i, 0), ct::lt(ct::id(i), 10), ct::inc(i), ct::set(sum, ct::add(ct::id(sum), ct::id(i)))));
+ * static_assert(ct::eval(program) == 45);
+ * @endcode
+ */
+namespace ct
+{
+    /**
+     * This struct is used to represent a variable name.
+     *
+     * Every symbol has its own type, so variables are resolved when the program is compiled.
+     */
+    template <typename Name>
+    struct Symbol
+    {
+        Name name;
+
+        [[nodiscard]] std::string str() const
+        {
+            return name();
+        }
+    };
+
+    template <typename Name>
+    Symbol(Name) -> Symbol<Name>;
+
+/**
+ * Create a symbol for the given identifier.
+ */
+#define EVA_SYMBOL(identifier) (::ct::Symbol{[] { return #identifier; }})
+
+    /**
+     * Base of all nodes of a compile-time program.
+     */
+    struct Node
+    {
+    };
+
+    /**
+     * Root scope of a compile-time program.
+     */
+    struct Scope
+    {
+    };
+
+    /**
+     * This struct is used to represent a variable declared in a scope.
+     */
+    template <typename Name, typename T, typename Parent>
+    struct Frame
+    {
+        using Tag = Name;
+
+        T value;
+        Parent *parent;
+    };
+
+    template <typename T>
+    constexpr bool alwaysFalse = false;
+
+    template <typename Name, typename Env>
+    constexpr auto &slot(Env &env)
+    {
+        if constexpr (std::is_same_v<Env, Scope>)
+        {
+            static_assert(alwaysFalse<Name>, "Variable is not defined");
+            return env;
+        }
+        else if constexpr (std::is_same_v<typename Env::Tag, Name>)
+        {
+            return env.value;
+        }
+        else
+        {
+            return slot<Name>(*env.parent);
+        }
+    }
+
+    template <typename T, typename = void>
+    struct IsDeclaration : std::false_type
+    {
+    };
+
+    template <typename T>
+    struct IsDeclaration<T, std::void_t<typename T::Declared>> : std::true_type
+    {
+    };
+
+    /**
+     * Evaluate the statements of a block, each declaration opens a new frame visible to the statements after it.
+     */
+    template <typename Env, typename First, typename... Rest>
+    constexpr auto evalSequence(Env &env, const First &first, const Rest &...rest)
+    {
+        if constexpr (IsDeclaration<First>::value)
+        {
+            Frame<typename First::Declared, decltype(first.init(env)), Env> frame{first.init(env), &env};
+            if constexpr (sizeof...(Rest) == 0)
+            {
+                return first.finish(frame);
+            }
+            else
+            {
+                void(first.finish(frame));
+                return evalSequence(frame, rest...);
+            }
+        }
+        else if constexpr (sizeof...(Rest) == 0)
+        {
+            return first.eval(env);
+        }
+        else
+        {
+            void(first.eval(env));
+            return evalSequence(env, rest...);
+        }
+    }
+
+    template <typename T>
+    struct Lit : Node
+    {
+        T value;
+
+        constexpr explicit Lit(T value) : value(value) {}
+
+        template <typename Env>
+        constexpr T eval(Env &) const
+        {
+            return value;
+        }
+
+        [[nodiscard]] ExpressionPtr toExpression() const
+        {
+            return Literal::create(value);
+        }
+    };
+
+    template <typename Name>
+    struct Id : Node
+    {
+        Symbol<Name> symbol;
+
+        constexpr explicit Id(Symbol<Name> symbol) : symbol(symbol) {}
+
+        template <typename Env>
+        constexpr auto eval(Env &env) const
+        {
+            return slot<Name>(env);
+        }
+
+        [[nodiscard]] ExpressionPtr toExpression() const
+        {
+            return Identifier::create(symbol.str());
+        }
+    };
+
+    template <typename Name, typename Value>
+    struct Var : Node
+    {
+        using Declared = Name;
+
+        Symbol<Name> symbol;
+        Value value;
+
+        constexpr Var(Symbol<Name> symbol, Value value) : symbol(symbol), value(value) {}
+
+        template <typename Env>
+        constexpr auto init(Env &env) const
+        {
+            return value.eval(env);
+        }
+
+        template <typename Env>
+        constexpr auto finish(Env &frame) const
+        {
+            return frame.value;
+        }
+
+        [[nodiscard]] ExpressionPtr toExpression() const
+        {
+            return VariableDeclaration::create(symbol.str(), value.toExpression());
+        }
+    };
+
+    template <typename Name, typename Value>
+    struct Set : Node
+    {
+        Symbol<Name> symbol;
+        Value value;
+
+        constexpr Set(Symbol<Name> symbol, Value value) : symbol(symbol), value(value) {}
+
+        template <typename Env>
+        constexpr auto eval(Env &env) const
+        {
+            auto result = value.eval(env);
+            auto &variable = slot<Name>(env);
+            static_assert(std::is_same_v<std::decay_t<decltype(variable)>, decltype(result)>,
+                          "Assigned value must have the type of the variable");
+            variable = result;
+            return variable;
+        }
+
+        [[nodiscard]] ExpressionPtr toExpression() const
+        {
+            return Assignment::create(symbol.str(), value.toExpression());
+        }
+    };
+
+    template <BinaryOperationType Type, typename Left, typename Right>
+    struct Binary : Node
+    {
+        Left left;
+        Right right;
+
+        constexpr Binary(Left left, Right right) : left(left), right(right) {}
+
+        template <typename Env>
+        constexpr auto eval(Env &env) const
+        {
+            auto lhs = left.eval(env);
+            auto rhs = right.eval(env);
+            static_assert(std::is_same_v<decltype(lhs), int> && std::is_same_v<decltype(rhs), int>,
+                          "Binary operations are defined on integers");
+
+            if constexpr (Type == ADDITION || Type == SUBTRACTION || Type == MULTIPLICATION || Type == DIVISION ||
+                          Type == MOD)
+            {
+                return BinaryOperation::arithmetic(Type, lhs, rhs);
+            }
+            else if constexpr (Type == GREATER)
+            {
+                return lhs > rhs;
+            }
+            else if constexpr (Type == LESS)
+            {
+                return lhs < rhs;
+            }
+            else if constexpr (Type == EQUAL)
+            {
+                return lhs == rhs;
+            }
+            else if constexpr (Type == NOT_EQUAL)
+            {
+                return lhs != rhs;
+            }
+            else if constexpr (Type == GREATER_OR_EQUAL)
+            {
+                return lhs >= rhs;
+            }
+            else
+            {
+                return lhs <= rhs;
+            }
+        }
+
+        [[nodiscard]] ExpressionPtr toExpression() const
+        {
+            return BinaryOperation::create(Type, left.toExpression(), right.toExpression());
+        }
+    };
+
+    template <typename... Statements>
+    struct Beg : Node
+    {
+        std::tuple<Statements...> statements;
+
+        constexpr explicit Beg(Statements... statements) : statements(statements...) {}
+
+        template <typename Env>
+        constexpr auto eval(Env &env) const
+        {
+            if constexpr (sizeof...(Statements) == 0)
+            {
+                return 0;
+            }
+            else
+            {
+                return std::apply([&env](const auto &...statement) { return evalSequence(env, statement...); }, statements);
+            }
+        }
+
+        [[nodiscard]] ExpressionPtr toExpression() const
+        {
+            std::vector<ExpressionPtr> expressions;
+            std::apply([&expressions](const auto &...statement) { (expressions.push_back(statement.toExpression()), ...); },
+                       statements);
+            return Block::create(std::move(expressions));
+        }
+    };
+
+    template <typename Condition, typename Then, typename Otherwise>
+    struct If : Node
+    {
+        Condition condition;
+        Then then;
+        Otherwise otherwise;
+
+        constexpr If(Condition condition, Then then, Otherwise otherwise)
+            : condition(condition), then(then), otherwise(otherwise) {}
+
+        template <typename Env>
+        constexpr auto eval(Env &env) const
+        {
+            using Result = std::common_type_t<decltype(then.eval(env)), decltype(otherwise.eval(env))>;
+            static_assert(std::is_same_v<decltype(condition.eval(env)), bool>, "Condition must be a boolean");
+
+            if (condition.eval(env))
+            {
+                return Result(then.eval(env));
+            }
+            return Result(otherwise.eval(env));
+        }
+
+        [[nodiscard]] ExpressionPtr toExpression() const
+        {
+            return ::Condition::create(condition.toExpression(), then.toExpression(), otherwise.toExpression());
+        }
+    };
+
+    template <typename Condition, typename Body>
+    struct While : Node
+    {
+        Condition condition;
+        Body body;
+
+        constexpr While(Condition condition, Body body) : condition(condition), body(body) {}
+
+        template <typename Env>
+        constexpr auto eval(Env &env) const
+        {
+            decltype(body.eval(env)) result{};
+            while (condition.eval(env))
+            {
+                result = body.eval(env);
+            }
+            return result;
+        }
+
+        [[nodiscard]] ExpressionPtr toExpression() const
+        {
+            return Loop::create(condition.toExpression(), body.toExpression());
+        }
+    };
+
+    template <typename Init, typename Condition, typename Modifier, typename Body>
+    struct ForBase : Node
+    {
+        Init initializer;
+        Condition condition;
+        Modifier modifier;
+        Body body;
+
+        constexpr ForBase(Init initializer, Condition condition, Modifier modifier, Body body)
+            : initializer(initializer), condition(condition), modifier(modifier), body(body) {}
+
+        template <typename Env>
+        constexpr auto loop(Env &env) const
+        {
+            decltype(evalSequence(env, body, modifier)) result{};
+            while (condition.eval(env))
+            {
+                result = evalSequence(env, body, modifier);
+            }
+            return result;
+        }
+
+        [[nodiscard]] ExpressionPtr toExpression() const
+        {
+            return ForLoop::create(initializer.toExpression(), condition.toExpression(), modifier.toExpression(),
+                                   body.toExpression());
+        }
+    };
+
+    template <typename Init, typename Condition, typename Modifier, typename Body, typename = void>
+    struct For : ForBase<Init, Condition, Modifier, Body>
+    {
+        using ForBase<Init, Condition, Modifier, Body>::ForBase;
+
+        template <typename Env>
+        constexpr auto eval(Env &env) const
+        {
+            void(this->initializer.eval(env));
+            return this->loop(env);
+        }
+    };
+
+    /**
+     * A for loop declaring its variable in the enclosing scope.
+     */
+    template <typename Init, typename Condition, typename Modifier, typename Body>
+    struct For<Init, Condition, Modifier, Body, std::enable_if_t<IsDeclaration<Init>::value>>
+        : ForBase<Init, Condition, Modifier, Body>
+    {
+        using Declared = typename Init::Declared;
+
+        using ForBase<Init, Condition, Modifier, Body>::ForBase;
+
+        template <typename Env>
+        constexpr auto init(Env &env) const
+        {
+            return this->initializer.init(env);
+        }
+
+        template <typename Env>
+        constexpr auto finish(Env &frame) const
+        {
+            return this->loop(frame);
+        }
+    };
+
+    template <typename Name, int Delta>
+    struct Step : Node
+    {
+        Symbol<Name> symbol;
+
+        constexpr explicit Step(Symbol<Name> symbol) : symbol(symbol) {}
+
+        template <typename Env>
+        constexpr int eval(Env &env) const
+        {
+            auto &variable = slot<Name>(env);
+            static_assert(std::is_same_v<std::decay_t<decltype(variable)>, int>, "Only integers can be incremented");
+            variable = BinaryOperation::arithmetic(ADDITION, variable, Delta);
+            return variable;
+        }
+
+        [[nodiscard]] ExpressionPtr toExpression() const
+        {
+            auto identifier = Identifier::create(symbol.str());
+            if constexpr (Delta > 0)
+            {
+                return Increment::create(std::move(identifier));
+            }
+            else
+            {
+                return Decrement::create(std::move(identifier));
+            }
+        }
+    };
+
+    /**
+     * @brief Wrap integers and booleans into literals, nodes are passed through
+     */
+    template <typename T>
+    constexpr auto wrap(T value)
+    {
+        if constexpr (std::is_base_of_v<Node, T>)
+        {
+            return value;
+        }
+        else
+        {
+            static_assert(std::is_same_v<T, int> || std::is_same_v<T, bool>, "Literals must be integers or booleans");
+            return Lit<T>(value);
+        }
+    }
+
+    template <typename T>
+    constexpr auto lit(T value)
+    {
+        return Lit<T>(value);
+    }
+
+    template <typename Name>
+    constexpr auto id(Symbol<Name> symbol)
+    {
+        return Id<Name>(symbol);
+    }
+
+    template <typename Name, typename T>
+    constexpr auto var(Symbol<Name> symbol, T value)
+    {
+        auto node = wrap(value);
+        return Var<Name, decltype(node)>(symbol, node);
+    }
+
+    template <typename Name, typename T>
+    constexpr auto set(Symbol<Name> symbol, T value)
+    {
+        auto node = wrap(value);
+        return Set<Name, decltype(node)>(symbol, node);
+    }
+
+    template <typename Name>
+    constexpr auto inc(Symbol<Name> symbol)
+    {
+        return Step<Name, 1>(symbol);
+    }
+
+    template <typename Name>
+    constexpr auto dec(Symbol<Name> symbol)
+    {
+        return Step<Name, -1>(symbol);
+    }
+
+    template <typename... Statements>
+    constexpr auto beg(Statements... statements)
+    {
+        return Beg<decltype(wrap(statements))...>(wrap(statements)...);
+    }
+
+    template <typename C, typename T, typename E>
+    constexpr auto iff(C condition, T then, E otherwise)
+    {
+        return If<decltype(wrap(condition)), decltype(wrap(then)), decltype(wrap(otherwise))>(
+            wrap(condition), wrap(then), wrap(otherwise));
+    }
+
+    template <typename C, typename B>
+    constexpr auto loop(C condition, B body)
+    {
+        return While<decltype(wrap(condition)), decltype(wrap(body))>(wrap(condition), wrap(body));
+    }
+
+    template <typename I, typename C, typename M, typename B>
+    constexpr auto floop(I init, C condition, M modifier, B body)
+    {
+        return For<decltype(wrap(init)), decltype(wrap(condition)), decltype(wrap(modifier)), decltype(wrap(body))>(
+            wrap(init), wrap(condition), wrap(modifier), wrap(body));
+    }
+
+#define EVA_CT_BINARY(function, type)                                                             \
+    template <typename L, typename R>                                                             \
+    constexpr auto function(L lhs, R rhs)                                                         \
+    {                                                                                             \
+        return Binary<type, decltype(wrap(lhs)), decltype(wrap(rhs))>(wrap(lhs), wrap(rhs)); \
+    }
+
+    EVA_CT_BINARY(add, ADDITION)
+    EVA_CT_BINARY(sub, SUBTRACTION)
+    EVA_CT_BINARY(mul, MULTIPLICATION)
+    EVA_CT_BINARY(divv, DIVISION)
+    EVA_CT_BINARY(mod, MOD)
+    EVA_CT_BINARY(gt, GREATER)
+    EVA_CT_BINARY(lt, LESS)
+    EVA_CT_BINARY(eq, EQUAL)
+    EVA_CT_BINARY(neq, NOT_EQUAL)
+    EVA_CT_BINARY(gte, GREATER_OR_EQUAL)
+    EVA_CT_BINARY(lte, LESS_OR_EQUAL)
+
+#undef EVA_CT_BINARY
+
+    /**
+     * @brief Run a compile-time program
+     *
+     * @param program The program
+     *
+     * @return The value of the program, usable in constant expressions
+     */
+    template <typename Program>
+    constexpr auto eval(const Program &program)
+    {
+        Scope root;
+        return evalSequence(root, program);
+    }
+}
+
+#endif // CPP_EVA_STATIC_EVA_H
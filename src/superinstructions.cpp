@@ -0,0 +1,549 @@
+#include "superinstructions.h"
+
+#include <algorithm>
+#include <map>
+#include <typeinfo>
+#include <utility>
+#include <variant>
+#include "environment.h"
+
+using namespace std;
+
+namespace
+{
+    bool isVariable(const ExpressionPtr &exp)
+    {
+        // Member accesses are identifiers too, but are looked up in their instance
+        return exp && typeid(*exp) == typeid(Identifier);
+    }
+
+    const int *intLiteral(const ExpressionPtr &exp)
+    {
+        if (!exp || typeid(*exp) != typeid(Literal))
+        {
+            return nullptr;
+        }
+        return get_if<int>(&static_cast<const Literal &>(*exp).getValue());
+    }
+
+    string nameOf(const ExpressionPtr &identifier)
+    {
+        return static_cast<const Identifier &>(*identifier).getName();
+    }
+
+    bool isArithmetic(BinaryOperationType type)
+    {
+        return type == ADDITION || type == SUBTRACTION || type == MULTIPLICATION || type == DIVISION || type == MOD;
+    }
+
+    /**
+     * `x < 10`, `n - 1`: the variable is read in place and the literal is not copied.
+     */
+    class VariableConstantOperation : public BinaryOperation
+    {
+    public:
+        explicit VariableConstantOperation(BinaryOperation &&operation)
+            : BinaryOperation(std::move(operation)), variable(nameOf(getLeft())), constant(*intLiteral(getRight())) {}
+
+        [[nodiscard]] EvalResult eval(std::shared_ptr<Environment> env) const override
+        {
+            if (auto value = get_if<int>(&env->resolve(variable)))
+            {
+                return apply(getType(), *value, constant);
+            }
+            return BinaryOperation::eval(std::move(env));
+        }
+
+    private:
+        string variable;
+        int constant;
+    };
+
+    /**
+     * `i < n`, `a + b`: both variables are read in place.
+     */
+    class VariablesOperation : public BinaryOperation
+    {
+    public:
+        explicit VariablesOperation(BinaryOperation &&operation)
+            : BinaryOperation(std::move(operation)), left(nameOf(getLeft())), right(nameOf(getRight())) {}
+
+        [[nodiscard]] EvalResult eval(std::shared_ptr<Environment> env) const override
+        {
+            auto lhs = get_if<int>(&env->resolve(left));
+            auto rhs = get_if<int>(&env->resolve(right));
+            if (lhs && rhs)
+            {
+                return apply(getType(), *lhs, *rhs);
+            }
+            return BinaryOperation::eval(std::move(env));
+        }
+
+    private:
+        string left;
+        string right;
+    };
+
+    /**
+     * `x = x + k`: with a literal the variable is looked up once and updated in place.
+     */
+    class CompoundAssignment : public Assignment
+    {
+    public:
+        explicit CompoundAssignment(Assignment &&assignment)
+            : Assignment(std::move(assignment)),
+              variable(getName()),
+              operation(static_cast<const BinaryOperation &>(*getValue())),
+              constant(intLiteral(operation.getRight())) {}
+
+        [[nodiscard]] EvalResult eval(std::shared_ptr<Environment> env) const override
+        {
+            auto &slot = env->resolve(variable);
+            auto value = get_if<int>(&slot);
+            if (!value)
+            {
+                return Assignment::eval(std::move(env));
+            }
+            if (constant)
+            {
+                return slot = BinaryOperation::apply(operation.getType(), *value, *constant);
+            }
+
+            // The operand may assign the variable or define others, so the slot is looked up again
+            const int lhs = *value;
+            auto rhs = operation.getRight()->eval(env);
+            return env->assign(variable, BinaryOperation::apply(operation.getType(), lhs, get<int>(rhs)));
+        }
+
+    private:
+        string variable;
+        const BinaryOperation &operation;
+        const int *constant;
+    };
+
+    class FusedIncrement : public Increment
+    {
+    public:
+        explicit FusedIncrement(Increment &&increment)
+            : Increment(std::move(increment)), variable(getIdentifier()->getName()) {}
+
+        [[nodiscard]] EvalResult eval(std::shared_ptr<Environment> env) const override
+        {
+            auto &slot = env->resolve(variable);
+            if (auto value = get_if<int>(&slot))
+            {
+                return slot = BinaryOperation::apply(BinaryOperationType::ADDITION, *value, 1);
+            }
+            return Increment::eval(std::move(env));
+        }
+
+    private:
+        string variable;
+    };
+
+    class FusedDecrement : public Decrement
+    {
+    public:
+        explicit FusedDecrement(Decrement &&decrement)
+            : Decrement(std::move(decrement)), variable(getIdentifier()->getName()) {}
+
+        [[nodiscard]] EvalResult eval(std::shared_ptr<Environment> env) const override
+        {
+            auto &slot = env->resolve(variable);
+            if (auto value = get_if<int>(&slot))
+            {
+                return slot = BinaryOperation::apply(BinaryOperationType::SUBTRACTION, *value, 1);
+            }
+            return Decrement::eval(std::move(env));
+        }
+
+    private:
+        string variable;
+    };
+
+    /**
+     * `items[i]`, `items[0]`: the collection is indexed in place, without copying its handle.
+     */
+    class VariableIndexAccess : public IndexAccess
+    {
+    public:
+        explicit VariableIndexAccess(IndexAccess &&access)
+            : IndexAccess(std::move(access)),
+              collection(nameOf(getCollection())),
+              index(isVariable(getIndex()) ? nameOf(getIndex()) : string()),
+              constant(index.empty() ? &static_cast<const Literal &>(*getIndex()).getValue() : nullptr) {}
+
+        [[nodiscard]] EvalResult eval(std::shared_ptr<Environment> env) const override
+        {
+            const auto &items = env->resolve(collection);
+            return access(items, constant ? *constant : env->resolve(index));
+        }
+
+    private:
+        string collection;
+        string index;
+        const EvalResult *constant;
+    };
+
+    /**
+     * @brief Build the fused node for an expression, moving the expression into it
+     *
+     * @return The fused node, nullptr if the expression has no fusable shape
+     */
+    ExpressionPtr fused(Expression &exp)
+    {
+        const auto &type = typeid(exp);
+        if (type == typeid(BinaryOperation))
+        {
+            auto &operation = static_cast<BinaryOperation &>(exp);
+            if (isVariable(operation.getLeft()) && intLiteral(operation.getRight()))
+            {
+                return make_unique<VariableConstantOperation>(std::move(operation));
+            }
+            if (isVariable(operation.getLeft()) && isVariable(operation.getRight()))
+            {
+                return make_unique<VariablesOperation>(std::move(operation));
+            }
+        }
+        else if (type == typeid(Assignment))
+        {
+            auto &assignment = static_cast<Assignment &>(exp);
+            auto operation = dynamic_cast<const BinaryOperation *>(assignment.getValue().get());
+            if (!assignment.getMemberAccess() && operation && isArithmetic(operation->getType()) &&
+                isVariable(operation->getLeft()) && nameOf(operation->getLeft()) == assignment.getName())
+            {
+                return make_unique<CompoundAssignment>(std::move(assignment));
+            }
+        }
+        else if (type == typeid(Increment))
+        {
+            return make_unique<FusedIncrement>(std::move(static_cast<Increment &>(exp)));
+        }
+        else if (type == typeid(Decrement))
+        {
+            return make_unique<FusedDecrement>(std::move(static_cast<Decrement &>(exp)));
+        }
+        else if (type == typeid(IndexAccess))
+        {
+            auto &access = static_cast<IndexAccess &>(exp);
+            const auto &index = access.getIndex();
+            if (isVariable(access.getCollection()) &&
+                (isVariable(index) || (index && typeid(*index) == typeid(Literal))))
+            {
+                return make_unique<VariableIndexAccess>(std::move(access));
+            }
+        }
+        return nullptr;
+    }
+
+    /**
+     * This class is used to walk the children of every kind of expression.
+     *
+     * Every visit reports the kind of the node before its children.
+     */
+    class ChildWalker : public ExpressionVisitor
+    {
+    public:
+        void visit(const Expression &) override
+        {
+            node("Expression");
+        }
+
+        void visit(const Block &exp) override
+        {
+            node("Block");
+            children(exp.getExpressions());
+        }
+
+        void visit(const Condition &exp) override
+        {
+            node("Condition");
+            child(exp.getCondition());
+            child(exp.getThen());
+            child(exp.getOtherwise());
+        }
+
+        void visit(const Loop &exp) override
+        {
+            node("Loop");
+            child(exp.getCondition());
+            child(exp.getBody());
+        }
+
+        void visit(const Identifier &) override
+        {
+            node("Identifier");
+        }
+
+        void visit(const Literal &) override
+        {
+            node("Literal");
+        }
+
+        void visit(const VariableDeclaration &exp) override
+        {
+            node("VariableDeclaration");
+            child(exp.getValue());
+        }
+
+        void visit(const Assignment &exp) override
+        {
+            node("Assignment");
+            child(exp.getValue());
+        }
+
+        void visit(const BinaryOperation &exp) override
+        {
+            node("BinaryOperation");
+            child(exp.getLeft());
+            child(exp.getRight());
+        }
+
+        void visit(const FunctionDeclaration &exp) override
+        {
+            node("FunctionDeclaration");
+            body(exp.getBody());
+        }
+
+        void visit(const Lambda &exp) override
+        {
+            node("Lambda");
+            body(exp.getBody());
+        }
+
+        void visit(const AnonymousFunctionCall &exp) override
+        {
+            node("AnonymousFunctionCall");
+            child(exp.getFunction());
+            children(exp.getArgs());
+        }
+
+        void visit(const FunctionCall &exp) override
+        {
+            node("FunctionCall");
+            children(exp.getArgs());
+        }
+
+        void visit(const ForLoop &exp) override
+        {
+            node("ForLoop");
+            child(exp.getInit());
+            child(exp.getCondition());
+            child(exp.getBody());
+            child(exp.getModifier());
+        }
+
+        void visit(const ForIn &exp) override
+        {
+            node("ForIn");
+            child(exp.getIterable());
+            child(exp.getBody());
+        }
+
+        void visit(const Switch &exp) override
+        {
+            node("Switch");
+            for (const auto &[condition, body] : exp.getCases())
+            {
+                child(condition);
+                child(body);
+            }
+        }
+
+        void visit(const Increment &) override
+        {
+            node("Increment");
+        }
+
+        void visit(const Decrement &) override
+        {
+            node("Decrement");
+        }
+
+        void visit(const ClassDeclaration &exp) override
+        {
+            node("ClassDeclaration");
+            children(exp.getExpressions());
+        }
+
+        void visit(const NewInstance &exp) override
+        {
+            node("NewInstance");
+            children(exp.getArgs());
+        }
+
+        void visit(const MemberAccess &) override
+        {
+            node("MemberAccess");
+        }
+
+        void visit(const MemberFunctionCall &exp) override
+        {
+            node("MemberFunctionCall");
+            children(exp.getArgs());
+        }
+
+        void visit(const ListExpression &exp) override
+        {
+            node("ListExpression");
+            children(exp.getItems());
+        }
+
+        void visit(const MapExpression &exp) override
+        {
+            node("MapExpression");
+            for (const auto &[key, value] : exp.getEntries())
+            {
+                child(key);
+                child(value);
+            }
+        }
+
+        void visit(const IndexAccess &exp) override
+        {
+            node("IndexAccess");
+            child(exp.getCollection());
+            child(exp.getIndex());
+        }
+
+        void visit(const IndexAssignment &exp) override
+        {
+            node("IndexAssignment");
+            child(exp.getCollection());
+            child(exp.getIndex());
+            child(exp.getValue());
+        }
+
+        void visit(const Import &) override
+        {
+            node("Import");
+        }
+
+        void visit(const Yield &exp) override
+        {
+            node("Yield");
+            child(exp.getValue());
+        }
+
+    protected:
+        virtual void node(const char *) {}
+
+        virtual void child(const ExpressionPtr &slot) = 0;
+
+        virtual void body(const shared_ptr<const Expression> &slot) = 0;
+
+    private:
+        void children(const vector<ExpressionPtr> &slots)
+        {
+            for (const auto &slot : slots)
+            {
+                child(slot);
+            }
+        }
+    };
+
+    /**
+     * This class is used to rewrite a tree from the leaves up.
+     *
+     * The tree is owned by the caller of the pass and not evaluated yet, so its children are replaced in
+     * place even though the expressions only hand them out as constants.
+     */
+    class Fusion : public ChildWalker
+    {
+    public:
+        void rewrite(ExpressionPtr &root)
+        {
+            child(root);
+        }
+
+    protected:
+        void child(const ExpressionPtr &slot) override
+        {
+            if (!slot)
+            {
+                return;
+            }
+            slot->accept(*this);
+            if (auto node = fused(*slot))
+            {
+                const_cast<ExpressionPtr &>(slot) = std::move(node);
+            }
+        }
+
+        void body(const shared_ptr<const Expression> &slot) override
+        {
+            if (!slot || slot.use_count() > 1)
+            {
+                return;
+            }
+            slot->accept(*this);
+            if (auto node = fused(const_cast<Expression &>(*slot)))
+            {
+                const_cast<shared_ptr<const Expression> &>(slot) = std::move(node);
+            }
+        }
+    };
+
+    class PairCounter : public ChildWalker
+    {
+    public:
+        map<pair<string, string>, size_t> counts;
+
+    protected:
+        void node(const char *kind) override
+        {
+            if (parent)
+            {
+                ++counts[{parent, kind}];
+            }
+            parent = kind;
+        }
+
+        void child(const ExpressionPtr &slot) override
+        {
+            if (slot)
+            {
+                visitChild(*slot);
+            }
+        }
+
+        void body(const shared_ptr<const Expression> &slot) override
+        {
+            if (slot)
+            {
+                visitChild(*slot);
+            }
+        }
+
+    private:
+        void visitChild(const Expression &exp)
+        {
+            auto outer = parent;
+            exp.accept(*this);
+            parent = outer;
+        }
+
+        const char *parent = nullptr;
+    };
+}
+
+ExpressionPtr Superinstructions::fuse(ExpressionPtr program)
+{
+    Fusion().rewrite(program);
+    return program;
+}
+
+vector<Superinstructions::NodePair> Superinstructions::countPairs(const Expression &program)
+{
+    PairCounter counter;
+    program.accept(counter);
+
+    vector<NodePair> pairs;
+    for (const auto &[kinds, count] : counter.counts)
+    {
+        pairs.push_back({kinds.first, kinds.second, count});
+    }
+    stable_sort(pairs.begin(), pairs.end(), [](const NodePair &a, const NodePair &b)
+                { return a.count > b.count; });
+    return pairs;
+}
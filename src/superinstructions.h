@@ -0,0 +1,61 @@
+#ifndef CPP_EVA_SUPERINSTRUCTIONS_H
+#define CPP_EVA_SUPERINSTRUCTIONS_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "expressions.h"
+
+/**
+ * This class is used to replace frequent shapes of expressions with fused nodes that evaluate the whole
+ * shape in one call.
+ *
+ * The shapes are the ones the pair counts of the test programs and the benchmarks put first:
+ * - an operation on a variable and an integer literal or another variable, e.g. `i < n` or `n - 1`
+ * - an assignment of an operation on the variable itself, e.g. `x = x + k`
+ * - increments and decrements of a variable
+ * - an index into a variable with a variable or a literal, e.g. `items[i]`
+ *
+ * A fused node derives from the node it replaces and keeps its children, so every pass that walks the
+ * tree sees the original shape; only eval differs. Values that are not integers take the path of the
+ * original node, so the results and the errors do not change.
+ *
+ * Eva fuses the programs it is given ownership of before evaluating them; the rewrite can be turned off
+ * per interpreter with Eva::setFusing for comparisons. Function bodies materialized lazily from a program image are not rewritten.
+ */
+class Superinstructions
+{
+public:
+    /**
+     * This struct is used to report how often a kind of node is the child of another kind.
+     */
+    struct NodePair
+    {
+        std::string parent;
+        std::string child;
+        size_t count;
+    };
+
+    /**
+     * @brief Replace the fusable shapes of a program with fused nodes
+     *
+     * Function bodies already shared with function definitions are left as they are, as they may be
+     * evaluated on other threads.
+     *
+     * @param program The program, owned by the caller
+     *
+     * @return The rewritten program
+     */
+    static ExpressionPtr fuse(ExpressionPtr program);
+
+    /**
+     * @brief Count the parent and child kinds of the nodes of a program
+     *
+     * @param program The program
+     *
+     * @return The pairs, the most frequent first
+     */
+    static std::vector<NodePair> countPairs(const Expression &program);
+};
+
+#endif // CPP_EVA_SUPERINSTRUCTIONS_H
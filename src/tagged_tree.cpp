@@ -0,0 +1,527 @@
+#include "tagged_tree.h"
+
+#include <unordered_map>
+#include <utility>
+#include "collections.h"
+#include "environment.h"
+#include "governor.h"
+#include "jit.h"
+#include "rope.h"
+
+using namespace std;
+
+namespace
+{
+    /**
+     * @brief Apply a binary operation to evaluated operands, like BinaryOperation does
+     */
+    EvalResult operate(BinaryOperationType type, const EvalResult &lhs, const EvalResult &rhs)
+    {
+        if (type == BinaryOperationType::ADDITION && !holds_alternative<int>(lhs))
+        {
+            return Rope::concat(lhs, rhs);
+        }
+        return BinaryOperation::apply(type, get<int>(lhs), get<int>(rhs));
+    }
+}
+
+/**
+ * This class is used to run the body of a function declared by a tagged tree from the table of the tree.
+ *
+ * Its accept forwards to the expression the body was lowered from, so passes see the original shape.
+ */
+class TaggedTree::Body : public Expression
+{
+public:
+    Body(const TaggedTree &tree, uint32_t root, const Expression &source)
+        : tree(tree), root(root), source(source) {}
+
+    [[nodiscard]] EvalResult eval(std::shared_ptr<Environment> env) const override
+    {
+        return tree.evaluate(root, env);
+    }
+
+    void accept(ExpressionVisitor &visitor) const override
+    {
+        source.accept(visitor);
+    }
+
+private:
+    const TaggedTree &tree;
+    uint32_t root;
+    const Expression &source;
+};
+
+/**
+ * This class is used to lower an expression tree into the table of a tagged tree.
+ *
+ * The children of a node are lowered before the node, so the root is the last node of the table.
+ */
+class TaggedTree::Lowering : public ExpressionVisitor
+{
+public:
+    explicit Lowering(TaggedTree &tree) : tree(tree) {}
+
+    uint32_t lower(const Expression &exp)
+    {
+        exp.accept(*this);
+        return last;
+    }
+
+    void visit(const Expression &exp) override
+    {
+        delegate(exp);
+    }
+
+    void visit(const Block &exp) override
+    {
+        Node node{};
+        node.kind = Kind::BLOCK;
+        node.sequence = lowerAll(exp.getExpressions());
+        node.sequence.scope = exp.getScope();
+        emit(node);
+    }
+
+    void visit(const Condition &exp) override
+    {
+        Node node{};
+        node.kind = Kind::CONDITION;
+        node.branch = {noNode, lower(*exp.getCondition()), lower(*exp.getThen()), lower(*exp.getOtherwise())};
+        emit(node);
+    }
+
+    void visit(const Loop &exp) override
+    {
+        Node node{};
+        node.kind = Kind::LOOP;
+        node.branch = {noNode, lower(*exp.getCondition()), lower(*exp.getBody()), noNode};
+        emit(node);
+    }
+
+    void visit(const Identifier &exp) override
+    {
+        Node node{};
+        node.kind = Kind::IDENTIFIER;
+        node.variable = {name(exp.getName()), noNode};
+        emit(node);
+    }
+
+    void visit(const Literal &exp) override
+    {
+        Node node{};
+        node.kind = Kind::LITERAL;
+        node.literal = static_cast<uint32_t>(tree.literals.size());
+        tree.literals.push_back(exp.getValue());
+        emit(node);
+    }
+
+    void visit(const VariableDeclaration &exp) override
+    {
+        Node node{};
+        node.kind = Kind::VARIABLE_DECLARATION;
+        node.variable = {name(exp.getName()), lower(*exp.getValue())};
+        emit(node);
+    }
+
+    void visit(const Assignment &exp) override
+    {
+        if (exp.getMemberAccess())
+        {
+            delegate(exp);
+            return;
+        }
+        Node node{};
+        node.kind = Kind::ASSIGNMENT;
+        node.variable = {name(exp.getName()), lower(*exp.getValue())};
+        emit(node);
+    }
+
+    void visit(const BinaryOperation &exp) override
+    {
+        Node node{};
+        node.kind = Kind::BINARY_OPERATION;
+        node.operation = {exp.getType(), lower(*exp.getLeft()), lower(*exp.getRight())};
+        emit(node);
+    }
+
+    void visit(const FunctionDeclaration &exp) override
+    {
+        function(exp, Kind::FUNCTION_DECLARATION);
+    }
+
+    void visit(const Lambda &exp) override
+    {
+        function(exp, Kind::LAMBDA);
+    }
+
+    void visit(const AnonymousFunctionCall &exp) override
+    {
+        Node node{};
+        node.kind = Kind::CALL;
+        auto callee = lower(*exp.getFunction());
+        auto args = lowerAll(exp.getArgs());
+        node.call = {callee, noNode, args.first, args.count};
+        emit(node);
+    }
+
+    void visit(const FunctionCall &exp) override
+    {
+        Node node{};
+        node.kind = Kind::CALL;
+        auto args = lowerAll(exp.getArgs());
+        node.call = {noNode, name(exp.getName()), args.first, args.count};
+        emit(node);
+    }
+
+    void visit(const ForLoop &exp) override
+    {
+        Node node{};
+        node.kind = Kind::FOR_LOOP;
+        node.branch = {lower(*exp.getInit()), lower(*exp.getCondition()), lower(exp.getStep()), noNode};
+        emit(node);
+    }
+
+    void visit(const ForIn &exp) override
+    {
+        delegate(exp);
+    }
+
+    void visit(const Switch &exp) override
+    {
+        delegate(exp);
+    }
+
+    void visit(const Increment &exp) override
+    {
+        Node node{};
+        node.kind = Kind::INCREMENT;
+        node.variable = {name(exp.getIdentifier()->getName()), noNode};
+        emit(node);
+    }
+
+    void visit(const Decrement &exp) override
+    {
+        Node node{};
+        node.kind = Kind::DECREMENT;
+        node.variable = {name(exp.getIdentifier()->getName()), noNode};
+        emit(node);
+    }
+
+    void visit(const ClassDeclaration &exp) override
+    {
+        delegate(exp);
+    }
+
+    void visit(const NewInstance &exp) override
+    {
+        delegate(exp);
+    }
+
+    void visit(const MemberAccess &exp) override
+    {
+        delegate(exp);
+    }
+
+    void visit(const MemberFunctionCall &exp) override
+    {
+        delegate(exp);
+    }
+
+    void visit(const ListExpression &exp) override
+    {
+        Node node{};
+        node.kind = Kind::LIST;
+        node.sequence = lowerAll(exp.getItems());
+        emit(node);
+    }
+
+    void visit(const MapExpression &exp) override
+    {
+        delegate(exp);
+    }
+
+    void visit(const IndexAccess &exp) override
+    {
+        Node node{};
+        node.kind = Kind::INDEX_ACCESS;
+        node.operation = {BinaryOperationType::ADDITION, lower(*exp.getCollection()), lower(*exp.getIndex())};
+        emit(node);
+    }
+
+    void visit(const IndexAssignment &exp) override
+    {
+        delegate(exp);
+    }
+
+    void visit(const Import &exp) override
+    {
+        delegate(exp);
+    }
+
+    void visit(const Yield &exp) override
+    {
+        delegate(exp);
+    }
+
+private:
+    void emit(const Node &node)
+    {
+        last = static_cast<uint32_t>(tree.nodes.size());
+        tree.nodes.push_back(node);
+    }
+
+    void delegate(const Expression &exp)
+    {
+        Node node{};
+        node.kind = Kind::EXPRESSION;
+        node.expression = &exp;
+        emit(node);
+    }
+
+    void function(const FunctionDeclaration &exp, Kind kind)
+    {
+        // The frames of generators are resumed by walking the expressions, so they are not lowered
+        const auto &body = exp.getBody();
+        if (!body || exp.isGenerator())
+        {
+            delegate(exp);
+            return;
+        }
+        auto root = lower(*body);
+        Node node{};
+        node.kind = kind;
+        node.function = static_cast<uint32_t>(tree.functions.size());
+        tree.functions.push_back({exp.getName(), exp.getParams(), make_unique<Body>(tree, root, *body)});
+        emit(node);
+    }
+
+    uint32_t name(const string &value)
+    {
+        // Every use of a name shares one entry of the table
+        auto [interned, added] = nameIndices.try_emplace(value, static_cast<uint32_t>(tree.names.size()));
+        if (added)
+        {
+            tree.names.push_back(value);
+        }
+        return interned->second;
+    }
+
+    template <typename Expressions>
+    Sequence lowerAll(const Expressions &expressions)
+    {
+        vector<uint32_t> lowered;
+        lowered.reserve(expressions.size());
+        for (const auto &exp : expressions)
+        {
+            lowered.push_back(lower(*exp));
+        }
+        auto first = static_cast<uint32_t>(tree.children.size());
+        tree.children.insert(tree.children.end(), lowered.begin(), lowered.end());
+        return {first, static_cast<uint32_t>(lowered.size()), BlockScope::ENCLOSING};
+    }
+
+    TaggedTree &tree;
+    unordered_map<string, uint32_t> nameIndices;
+    uint32_t last = noNode;
+};
+
+std::shared_ptr<const TaggedTree> TaggedTree::compile(std::shared_ptr<const Expression> program)
+{
+    shared_ptr<TaggedTree> tree(new TaggedTree(std::move(program)));
+    tree->root = Lowering(*tree).lower(*tree->program);
+    return tree;
+}
+
+TaggedTree::TaggedTree(std::shared_ptr<const Expression> program)
+    : program(std::move(program)) {}
+
+TaggedTree::~TaggedTree() = default;
+
+EvalResult TaggedTree::eval(const std::shared_ptr<Environment> &env) const
+{
+    return evaluate(root, env);
+}
+
+size_t TaggedTree::delegated() const
+{
+    size_t count = 0;
+    for (const auto &node : nodes)
+    {
+        count += node.kind == Kind::EXPRESSION;
+    }
+    return count;
+}
+
+inline EvalResult TaggedTree::operand(uint32_t index, const std::shared_ptr<Environment> &env) const
+{
+    // Variables and literals are the most frequent operands, they are read without a call
+    const auto &node = nodes[index];
+    if (node.kind == Kind::IDENTIFIER)
+    {
+        return env->lookup(names[node.variable.name]);
+    }
+    if (node.kind == Kind::LITERAL)
+    {
+        return literals[node.literal];
+    }
+    return evaluate(index, env);
+}
+
+EvalResult TaggedTree::evaluate(uint32_t index, const std::shared_ptr<Environment> &env) const
+{
+    const auto &node = nodes[index];
+    switch (node.kind)
+    {
+    case Kind::BLOCK:
+        switch (node.sequence.scope)
+        {
+        case BlockScope::ENCLOSING:
+            return sequence(node.sequence, env);
+        case BlockScope::STACK:
+        {
+            // Like Block, nothing can keep a reference to the environment once the block is over
+            Environment blockEnv(EvalMap{}, env);
+            return sequence(node.sequence, shared_ptr<Environment>(shared_ptr<Environment>(), &blockEnv));
+        }
+        default:
+            return sequence(node.sequence, make_shared<Environment>(EvalMap{}, env));
+        }
+    case Kind::CONDITION:
+        return evaluate(get<bool>(operand(node.branch.condition, env)) ? node.branch.then : node.branch.otherwise, env);
+    case Kind::LOOP:
+    {
+        EvalResult result;
+        while (get<bool>(operand(node.branch.condition, env)))
+        {
+            ResourceGovernor::safepoint();
+            result = evaluate(node.branch.then, env);
+        }
+        return result;
+    }
+    case Kind::FOR_LOOP:
+    {
+        auto _ = evaluate(node.branch.init, env);
+
+        EvalResult result;
+        while (get<bool>(operand(node.branch.condition, env)))
+        {
+            ResourceGovernor::safepoint();
+            result = evaluate(node.branch.then, env);
+        }
+        return result;
+    }
+    case Kind::IDENTIFIER:
+        return env->lookup(names[node.variable.name]);
+    case Kind::LITERAL:
+        return literals[node.literal];
+    case Kind::VARIABLE_DECLARATION:
+    {
+        auto value = operand(node.variable.value, env);
+        env->define(names[node.variable.name], value);
+        return value;
+    }
+    case Kind::ASSIGNMENT:
+        return env->assign(names[node.variable.name], operand(node.variable.value, env));
+    case Kind::BINARY_OPERATION:
+    {
+        auto lhs = operand(node.operation.left, env);
+        auto rhs = operand(node.operation.right, env);
+        if (holds_alternative<int>(lhs) && holds_alternative<int>(rhs))
+        {
+            return BinaryOperation::apply(node.operation.type, get<int>(lhs), get<int>(rhs));
+        }
+        return operate(node.operation.type, lhs, rhs);
+    }
+    case Kind::INCREMENT:
+    case Kind::DECREMENT:
+    {
+        auto type = node.kind == Kind::INCREMENT ? BinaryOperationType::ADDITION : BinaryOperationType::SUBTRACTION;
+        const auto &name = names[node.variable.name];
+        auto &slot = env->resolve(name);
+        if (auto value = get_if<int>(&slot))
+        {
+            return slot = BinaryOperation::apply(type, *value, 1);
+        }
+        return env->assign(name, operate(type, EvalResult(slot), 1));
+    }
+    case Kind::FUNCTION_DECLARATION:
+    {
+        const auto &function = functions[node.function];
+        // The name is defined first, so a local function can capture itself for recursion
+        if (env && env->getParent() && !env->getVariables().find(function.name))
+        {
+            env->define(function.name, Null{});
+        }
+        auto value = define(function, env);
+        env->define(function.name, value);
+        return value;
+    }
+    case Kind::LAMBDA:
+        return define(functions[node.function], env);
+    case Kind::CALL:
+        return call(node.call, env);
+    case Kind::LIST:
+    {
+        vector<EvalResult> values;
+        values.reserve(node.sequence.count);
+        for (uint32_t i = 0; i < node.sequence.count; ++i)
+        {
+            values.push_back(operand(children[node.sequence.first + i], env));
+        }
+        return List::create(std::move(values));
+    }
+    case Kind::INDEX_ACCESS:
+    {
+        auto collection = operand(node.operation.left, env);
+        return IndexAccess::access(collection, operand(node.operation.right, env));
+    }
+    case Kind::EXPRESSION:
+        return node.expression->eval(env);
+    }
+    return Null{};
+}
+
+EvalResult TaggedTree::sequence(const Sequence &sequence, const std::shared_ptr<Environment> &env) const
+{
+    EvalResult result;
+    for (uint32_t i = 0; i < sequence.count; ++i)
+    {
+        result = operand(children[sequence.first + i], env);
+    }
+    return result;
+}
+
+EvalResult TaggedTree::call(const Call &call, const std::shared_ptr<Environment> &env) const
+{
+    ResourceGovernor::safepoint();
+
+    const auto callee = call.callee == noNode ? env->lookup(names[call.name]) : evaluate(call.callee, env);
+
+    constexpr uint32_t inlineArgs = 4;
+    if (call.count <= inlineArgs)
+    {
+        EvalResult values[inlineArgs];
+        for (uint32_t i = 0; i < call.count; ++i)
+        {
+            values[i] = operand(children[call.first + i], env);
+        }
+        return AnonymousFunctionCall::invoke(callee, values, call.count);
+    }
+
+    vector<EvalResult> values;
+    values.reserve(call.count);
+    for (uint32_t i = 0; i < call.count; ++i)
+    {
+        values.push_back(operand(children[call.first + i], env));
+    }
+    return AnonymousFunctionCall::invoke(callee, values.data(), call.count);
+}
+
+EvalResult TaggedTree::define(const Function &function, const std::shared_ptr<Environment> &env) const
+{
+    // The definition keeps the tree alive for as long as it can be called
+    shared_ptr<const Expression> body(shared_from_this(), function.body.get());
+    auto closureEnv = Lambda::closure(function.params, *body, env);
+    return FunctionDefinition{function.name, function.params, std::move(body), std::move(closureEnv),
+                              make_shared<CallProfile>(), false};
+}
@@ -0,0 +1,188 @@
+#ifndef CPP_EVA_TAGGED_TREE_H
+#define CPP_EVA_TAGGED_TREE_H
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+#include "expressions.h"
+#include "eval_types.h"
+
+/**
+ * This class is used to evaluate a program as a closed set of node kinds instead of the open hierarchy of
+ * expressions.
+ *
+ * The program is lowered once into a flat table of nodes. Every node is a kind tag and a union of small
+ * payloads; children are indices into the table and names and literals are kept in side tables. Evaluation
+ * is a switch over the kind, so the compiler sees every case: literals and variables read as operands do
+ * not need a call, and nothing goes through a virtual table.
+ *
+ * The common kinds are evaluated by the switch: blocks, conditions, loops, for loops, variables, literals,
+ * declarations and assignments of variables, binary operations, increments and decrements, functions and
+ * lambdas, calls, lists and index accesses. Every other kind, e.g. classes, maps or generator functions, is
+ * delegated to the expression it was lowered from, which evaluates its whole subtree.
+ *
+ * The functions declared by the program run their bodies from the table too. Passes that walk a body, e.g.
+ * the closure analysis or the JIT, see the expression it was lowered from.
+ */
+class TaggedTree : public std::enable_shared_from_this<TaggedTree>
+{
+public:
+    /**
+     * @brief Lower a program into a tagged tree
+     *
+     * @param program The program, kept alive by the tree
+     *
+     * @return The tree
+     */
+    static std::shared_ptr<const TaggedTree> compile(std::shared_ptr<const Expression> program);
+
+    TaggedTree(const TaggedTree &) = delete;
+    TaggedTree &operator=(const TaggedTree &) = delete;
+
+    ~TaggedTree();
+
+    /**
+     * @brief Evaluate the program
+     *
+     * @param env The environment to evaluate the program in
+     *
+     * @return The result of the program
+     */
+    [[nodiscard]] EvalResult eval(const std::shared_ptr<Environment> &env) const;
+
+    /**
+     * @brief Get the number of nodes of the tree
+     */
+    [[nodiscard]] size_t size() const
+    {
+        return nodes.size();
+    }
+
+    /**
+     * @brief Get the number of distinct names the nodes of the tree refer to
+     */
+    [[nodiscard]] size_t nameCount() const
+    {
+        return names.size();
+    }
+
+    /**
+     * @brief Get the number of nodes delegated to the expressions they were lowered from
+     */
+    [[nodiscard]] size_t delegated() const;
+
+private:
+    class Lowering;
+    class Body;
+
+    enum class Kind : uint8_t
+    {
+        BLOCK,
+        CONDITION,
+        LOOP,
+        FOR_LOOP,
+        IDENTIFIER,
+        LITERAL,
+        VARIABLE_DECLARATION,
+        ASSIGNMENT,
+        BINARY_OPERATION,
+        INCREMENT,
+        DECREMENT,
+        FUNCTION_DECLARATION,
+        LAMBDA,
+        CALL,
+        LIST,
+        INDEX_ACCESS,
+        EXPRESSION
+    };
+
+    static constexpr uint32_t noNode = std::numeric_limits<uint32_t>::max();
+
+    // BLOCK, and without the scope LIST
+    struct Sequence
+    {
+        uint32_t first;
+        uint32_t count;
+        BlockScope scope;
+    };
+
+    // CONDITION (condition, then, otherwise), LOOP (condition, then) and FOR_LOOP (init, condition, then)
+    struct Branch
+    {
+        uint32_t init;
+        uint32_t condition;
+        uint32_t then;
+        uint32_t otherwise;
+    };
+
+    // IDENTIFIER, INCREMENT, DECREMENT, and with a value VARIABLE_DECLARATION and ASSIGNMENT
+    struct Variable
+    {
+        uint32_t name;
+        uint32_t value;
+    };
+
+    // BINARY_OPERATION, and without the type INDEX_ACCESS
+    struct Operation
+    {
+        BinaryOperationType type;
+        uint32_t left;
+        uint32_t right;
+    };
+
+    // CALL, of the callee node or of the function with the name if there is no callee
+    struct Call
+    {
+        uint32_t callee;
+        uint32_t name;
+        uint32_t first;
+        uint32_t count;
+    };
+
+    struct Node
+    {
+        Kind kind;
+        union
+        {
+            Sequence sequence;
+            Branch branch;
+            Variable variable;
+            Operation operation;
+            Call call;
+            uint32_t literal;
+            uint32_t function;
+            const Expression *expression;
+        };
+    };
+
+    struct Function
+    {
+        std::string name;
+        std::vector<std::string> params;
+        std::unique_ptr<Body> body;
+    };
+
+    explicit TaggedTree(std::shared_ptr<const Expression> program);
+
+    [[nodiscard]] EvalResult evaluate(uint32_t index, const std::shared_ptr<Environment> &env) const;
+
+    [[nodiscard]] EvalResult operand(uint32_t index, const std::shared_ptr<Environment> &env) const;
+
+    [[nodiscard]] EvalResult sequence(const Sequence &sequence, const std::shared_ptr<Environment> &env) const;
+
+    [[nodiscard]] EvalResult call(const Call &call, const std::shared_ptr<Environment> &env) const;
+
+    [[nodiscard]] EvalResult define(const Function &function, const std::shared_ptr<Environment> &env) const;
+
+    std::shared_ptr<const Expression> program;
+    std::vector<Node> nodes;
+    std::vector<uint32_t> children;
+    std::vector<std::string> names;
+    std::vector<EvalResult> literals;
+    std::vector<Function> functions;
+    uint32_t root = noNode;
+};
+
+#endif // CPP_EVA_TAGGED_TREE_H
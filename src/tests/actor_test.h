@@ -0,0 +1,92 @@
+#ifndef CPP_EVA_ACTOR_TEST_H
+#define CPP_EVA_ACTOR_TEST_H
+
+#include <cassert>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include "test_utils.h"
+#include "expression_helpers.h"
+#include "../actor.h"
+#include "../eva.h"
+
+void runActorTest(Eva &eva)
+{
+    using namespace std;
+
+    // A full channel refuses values until one is received, capacities are rounded up to a power of two
+    auto queue = Channel::create(3);
+    assert(queue->getCapacity() == 4);
+    for (int i = 0; i < 4; ++i)
+    {
+        assert(queue->trySend(i));
+    }
+    assert(!queue->trySend(4));
+    EvalResult value;
+    assert(queue->tryReceive(value) && std::get<int>(value) == 0);
+    assert(queue->trySend(4));
+
+    // Receivers get what was sent before the channel was closed, then null
+    queue->close();
+    for (int i = 1; i <= 4; ++i)
+    {
+        assert(queue->receive(value) && std::get<int>(value) == i);
+    }
+    assert(!queue->receive(value));
+    try
+    {
+        queue->send(5);
+        assert(false);
+    }
+    catch (const runtime_error &)
+    {
+    }
+
+    // Each stage of a pipeline runs in an interpreter of its own, small channels hold the producer back
+    auto raw = Channel::create(4);
+    auto enriched = Channel::create(4);
+    shared_ptr<const Expression> enrich = beg(
+        forin("x", id("input"), call("send", id("output"), lst(id("x"), mul(id("x"), id("x"))))),
+        call("close", id("output")));
+    shared_ptr<const Expression> score = call("reduce", id("input"),
+                                              lambda(args("total", "pair"), add(id("total"), at(id("pair"), 1))), 0);
+    Actor enricher(enrich, {{"input", ChannelValue{raw}}, {"output", ChannelValue{enriched}}});
+    Actor scorer(score, {{"input", ChannelValue{enriched}}});
+    for (int i = 1; i <= 1000; ++i)
+    {
+        raw->send(i);
+    }
+    raw->close();
+    assert(std::get<int>(scorer.join()) == 333833500);
+    assert(std::get<Null>(enricher.join()) == Null{});
+
+    // Collections are copied when they are sent, values bound to one interpreter are not sent at all
+    IASSERT(beg(
+                var("mailbox", call("channel", 2)),
+                var("original", lst(1, 2)),
+                call("send", id("mailbox"), id("original")),
+                call("push", call("receive", id("mailbox")), 3),
+                call("len", id("original"))),
+            2);
+    NASSERT(call("send", call("channel", 1), lambda(args(), lit(1))));
+    NASSERT(call("channel", 0));
+    IASSERT(beg(
+                var("finished", call("channel", 1)),
+                call("close", id("finished")),
+                call("len", call("collect", id("finished")))),
+            0);
+
+    // Errors of a program are rethrown by join
+    Actor failing(shared_ptr<const Expression>(call("substr", "abc", 5, 1)), {});
+    try
+    {
+        void(failing.join());
+        assert(false);
+    }
+    catch (const runtime_error &error)
+    {
+        assert(string(error.what()) == "substr: range out of bounds");
+    }
+}
+
+#endif // CPP_EVA_ACTOR_TEST_H
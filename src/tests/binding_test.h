@@ -0,0 +1,112 @@
+#ifndef CPP_EVA_BINDING_TEST_H
+#define CPP_EVA_BINDING_TEST_H
+
+#include <memory>
+#include <string>
+#include "test_utils.h"
+#include "expression_helpers.h"
+#include "../eva.h"
+
+namespace binding_test
+{
+    int sum(int a, int b)
+    {
+        return a + b;
+    }
+
+    std::string greet(const std::string &name)
+    {
+        return "Hello, " + name;
+    }
+
+    bool isEven(long value) noexcept
+    {
+        return value % 2 == 0;
+    }
+
+    class Account
+    {
+    public:
+        void deposit(int amount)
+        {
+            balance += amount;
+        }
+
+        [[nodiscard]] int getBalance() const
+        {
+            return balance;
+        }
+
+    private:
+        int balance = 0;
+    };
+}
+
+void runBindingTest(Eva &)
+{
+    using namespace std;
+    using namespace binding_test;
+
+    Eva eva(make_shared<Environment>(EvalMap{{"null", Null{}}, {"true", true}, {"false", false}}));
+
+    eva.bind("sum", &sum);
+    eva.bind("greet", greet);
+    eva.bind<&isEven>("isEven");
+    IASSERT(call("sum", 2, 3), 5);
+    SASSERT(call("greet", "Eva"), "Hello, Eva");
+    BASSERT(call("isEven", 10), true);
+
+    // Long concatenated strings are ropes and convert to std::string too
+    const string name(Rope::leafSize, 'e');
+    SASSERT(call("greet", add(lit(name), "va")), "Hello, " + name + "va");
+
+    int counter = 0;
+    eva.bind("next", [counter]() mutable { return ++counter; });
+    eva.bind("scale", [factor = 3](int x) { return x * factor; });
+    IASSERT(call("next"), 1);
+    IASSERT(call("next"), 2);
+    IASSERT(call("scale", call("next")), 9);
+
+    // Copies of a bound functor share its state
+    IASSERT(beg(
+                var("nextCopy", id("next")),
+                call("nextCopy")),
+            4);
+    IASSERT(call("next"), 5);
+
+    // Names are not rebound silently
+    bool rejected = false;
+    try
+    {
+        eva.bind("sum", &sum);
+    }
+    catch (const runtime_error &)
+    {
+        rejected = true;
+    }
+    assert(rejected);
+
+    Account account;
+    auto shared = make_shared<Account>();
+    eva.bind("deposit", &Account::deposit, &account);
+    eva.bind("balance", &Account::getBalance, &account);
+    eva.bind("sharedBalance", &Account::getBalance, shared);
+    NASSERT(call("deposit", 40));
+    NASSERT(call("deposit", 2));
+    IASSERT(call("balance"), 42);
+    assert(account.getBalance() == 42);
+    IASSERT(call("sharedBalance"), 0);
+
+    // Bound functions are ordinary values in scripts
+    IASSERT(
+        beg(
+            def("twice", args("f", "x"), call("f", call("f", id("x")))),
+            call("twice", id("scale"), 2)),
+        18);
+
+    // Mismatched arguments are reported as evaluation errors
+    NASSERT(call("sum", "two", 3));
+    NASSERT(call("sum", 1));
+}
+
+#endif // CPP_EVA_BINDING_TEST_H
@@ -5,7 +5,8 @@
 #include "expression_helpers.h"
 #include "../eva.h"
 
-void runBlockTest(Eva &eva)
+template <typename Evaluator>
+void runBlockTest(Evaluator &eva)
 {
     IASSERT(
         beg(
@@ -1,10 +1,52 @@
 #ifndef CPP_EVA_BUILT_IN_FUNC_TEST_H
 #define CPP_EVA_BUILT_IN_FUNC_TEST_H
 
+#include <climits>
+#include "test_utils.h"
+#include "expression_helpers.h"
 #include "../eva.h"
 
-void runBuildInFunTest(Eva &eva)
+template <typename Evaluator>
+void runBuildInFunTest(Evaluator &eva)
 {
+    using namespace std;
+
+    IASSERT(call("abs", -5), 5);
+    IASSERT(call("min", 3, 7), 3);
+    IASSERT(call("max", 3, 7), 7);
+    IASSERT(call("pow", 2, 10), 1024);
+    IASSERT(call("pow", -3, 3), -27);
+
+    // Results wrap at 32 bits like the arithmetic operators
+    IASSERT(call("abs", INT_MIN), INT_MIN);
+    IASSERT(call("pow", 2, 31), INT_MIN);
+    IASSERT(call("pow", 3, 40), 689956897);
+
+    SASSERT(call("str", 42), "42");
+    SASSERT(call("str", TRUE), "true");
+    IASSERT(call("len", "hello"), 5);
+    SASSERT(call("substr", "hello world", 6, 5), "world");
+    SASSERT(call("concat", "x = ", add(1, 2)), "x = 3");
+
+    NASSERT(print("Hello", ", ", "builtins"));
+
+    // Builtins are values: they can be passed around and shadowed like user-defined functions.
+    IASSERT(
+        beg(
+            def("apply", args("f", "x"), call("f", id("x"))),
+            call("apply", id("abs"), -3)),
+        3);
+
+    IASSERT(
+        beg(
+            def("abs", args("x"), lit(0)),
+            call("abs", -3)),
+        0);
+
+    IASSERT(call("abs", -1), 1);
+
+    // Arity is checked before the native code runs.
+    NASSERT(call("abs", 1, 2));
 }
 
 #endif // CPP_EVA_BUILT_IN_FUNC_TEST_H
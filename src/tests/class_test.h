@@ -5,7 +5,8 @@
 #include "test_utils.h"
 #include "expression_helpers.h"
 
-void runClassTest(Eva &eva)
+template <typename Evaluator>
+void runClassTest(Evaluator &eva)
 {
     IASSERT(beg(
                 cls("Point", NONE,
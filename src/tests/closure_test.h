@@ -0,0 +1,55 @@
+#ifndef CPP_EVA_CLOSURE_TEST_H
+#define CPP_EVA_CLOSURE_TEST_H
+
+#include <memory>
+#include "test_utils.h"
+#include "expression_helpers.h"
+#include "../eva.h"
+
+void runClosureTest(Eva &)
+{
+    using namespace std;
+
+    Eva eva(make_shared<Environment>(EvalMap{{"null", Null{}}, {"true", true}, {"false", false}}));
+    auto global = eva.getGlobal();
+
+    // Closures only hold the variables they refer to and look up the rest in the global environment
+    auto large = make_shared<Environment>(EvalMap{});
+    global->define("large", InstanceDefinition{large});
+    eva.eval(def("makeGetter", args("unused", "kept"),
+                 beg(
+                     var("local", id("kept")),
+                     lambda(args(), id("local")))));
+    eva.eval(var("getter", call("makeGetter", id("large"), 7)));
+    global->define("large", Null{});
+    assert(large.use_count() == 1);
+
+    IASSERT(call("getter"), 7);
+    auto closureEnv = get<FunctionDefinition>(global->lookup("getter")).env;
+    assert(closureEnv->getParent() == global);
+    assert(closureEnv->getVariables().size() == 1);
+
+    // Captured variables are shared with the scope that defines them, in both directions
+    IASSERT(beg(
+                var("shared", lit(1)),
+                var("read", lambda(args(), id("shared"))),
+                set("shared", 5),
+                call("read")),
+            5);
+    IASSERT(beg(
+                var("count", lit(0)),
+                var("bump", lambda(args(), inc(id("count")))),
+                call("bump"),
+                call("bump"),
+                id("count")),
+            2);
+
+    // Local functions can call themselves
+    IASSERT(beg(
+                def("localFact", args("n"),
+                    iff(lte(id("n"), 1), lit(1), mul(id("n"), call("localFact", sub(id("n"), 1))))),
+                call("localFact", 5)),
+            120);
+}
+
+#endif // CPP_EVA_CLOSURE_TEST_H
@@ -0,0 +1,102 @@
+#ifndef CPP_EVA_COLLECTIONS_TEST_H
+#define CPP_EVA_COLLECTIONS_TEST_H
+
+#include <string>
+#include "test_utils.h"
+#include "expression_helpers.h"
+#include "governor_test.h"
+#include "../eva.h"
+#include "../collections.h"
+
+void runCollectionsTest(Eva &)
+{
+    using namespace std;
+
+    // The variables live in a scope of their own, so "table" does not hide the builtin from the other tests
+    Eva eva(make_shared<Environment>(EvalMap{}, globalEnv));
+
+    // Lists
+    eva.eval(var("items", lst(1, "two", lst(3))));
+    IASSERT(at(id("items"), 0), 1);
+    SASSERT(at(id("items"), 1), "two");
+    IASSERT(at(at(id("items"), 2), 0), 3);
+    IASSERT(setat(id("items"), 0, 10), 10);
+    IASSERT(at(id("items"), 0), 10);
+    IASSERT(call("push", id("items"), 4), 4);
+    IASSERT(call("len", id("items")), 4);
+    IASSERT(call("pop", id("items")), 4);
+    SASSERT(call("str", id("items")), "[10, \"two\", [3]]");
+    NASSERT(at(id("items"), 3));
+    NASSERT(at(id("items"), -1));
+
+    // Lists are shared by reference
+    IASSERT(beg(
+                var("alias", id("items")),
+                setat(id("alias"), 0, 11),
+                at(id("items"), 0)),
+            11);
+
+    // Maps with structural keys
+    eva.eval(var("table", dict(kv("a", 1), kv(2, "b"), kv(lst(1, 2), TRUE))));
+    IASSERT(at(id("table"), "a"), 1);
+    SASSERT(at(id("table"), 2), "b");
+    BASSERT(at(id("table"), lst(1, 2)), true);
+    BASSERT(call("has", id("table"), "missing"), false);
+    NASSERT(at(id("table"), "missing"));
+    IASSERT(setat(id("table"), "a", 5), 5);
+    IASSERT(call("len", id("table")), 3);
+    BASSERT(call("remove", id("table"), 2), true);
+    BASSERT(call("has", id("table"), 2), false);
+    IASSERT(call("len", call("keys", id("table"))), 2);
+
+    // Indexed loop over a list
+    IASSERT(beg(
+                var("numbers", lst(1, 2, 3, 4)),
+                var("sum", lit(0)),
+                floop(var("i", lit(0)), lt(id("i"), call("len", id("numbers"))), inc(id("i")),
+                      set("sum", add(id("sum"), at(id("numbers"), id("i"))))),
+                id("sum")),
+            10);
+
+    // Growing, overwriting and erasing through the table keeps every key reachable
+    auto map = HashMap::create();
+    for (int i = 0; i < 2000; ++i)
+    {
+        map.map->assign(i, i * 2);
+        map.map->assign("k" + to_string(i), i);
+    }
+    for (int i = 0; i < 2000; i += 2)
+    {
+        assert(map.map->erase(i));
+    }
+    for (int i = 0; i < 2000; ++i)
+    {
+        auto number = map.map->find(i);
+        assert((i % 2 == 0) == (number == nullptr));
+        assert(!number || get<int>(*number) == i * 2);
+        assert(get<int>(*map.map->find("k" + to_string(i))) == i);
+    }
+    assert(map.map->size() == 3000);
+
+    assert(equalValues(List::create({1, string("a")}), List::create({1, string("a")})));
+    assert(!equalValues(List::create({1}), List::create({true})));
+    assert(hashValue(List::create({1, 2})) == hashValue(List::create({1, 2})));
+
+    // Growing lists and maps is charged to the governor
+    EvalLimits heap;
+    heap.maxHeapBytes = 1024 * 1024;
+    assert(abortReason(eva,
+                       beg(
+                           var("growing", lst()),
+                           floop(var("i", lit(0)), lt(id("i"), 200000), inc(id("i")),
+                                 call("push", id("growing"), id("i")))),
+                       heap) == AbortReason::HEAP_LIMIT_EXCEEDED);
+    assert(abortReason(eva,
+                       beg(
+                           var("growing", dict()),
+                           floop(var("i", lit(0)), lt(id("i"), 200000), inc(id("i")),
+                                 setat(id("growing"), id("i"), id("i")))),
+                       heap) == AbortReason::HEAP_LIMIT_EXCEEDED);
+}
+
+#endif // CPP_EVA_COLLECTIONS_TEST_H
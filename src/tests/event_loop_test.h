@@ -0,0 +1,75 @@
+#ifndef CPP_EVA_EVENT_LOOP_TEST_H
+#define CPP_EVA_EVENT_LOOP_TEST_H
+
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+#include "test_utils.h"
+#include "expression_helpers.h"
+#include "../eva.h"
+
+void runEventLoopTest(Eva &eva)
+{
+    using namespace std;
+
+    // The async builtins need a running loop
+    NASSERT(call("sleep", 1));
+    NASSERT(call("readFile", "missing"));
+
+    char directoryTemplate[] = "/tmp/cpp_eva_io_XXXXXX";
+    string directory = mkdtemp(directoryTemplate);
+    auto path = [&directory](int i)
+    { return directory + "/file" + to_string(i) + ".txt"; };
+
+    // Hundreds of scripts write and read their own file, overlapping their operations
+    Eva scripts(make_shared<Environment>(EvalMap{}, globalEnv));
+    constexpr int count = 200;
+    for (int i = 0; i < count; ++i)
+    {
+        scripts.spawn(beg(
+            var("written", call("writeFile", path(i), add("content ", call("str", i)))),
+            call("await", id("written")),
+            call("await", call("sleep", 20)),
+            call("await", call("readFile", path(i)))));
+    }
+    auto start = chrono::steady_clock::now();
+    auto results = scripts.run();
+    auto elapsed = chrono::steady_clock::now() - start;
+    assert(results.size() == count);
+    for (int i = 0; i < count; ++i)
+    {
+        assert(get<string>(results[i]) == "content " + to_string(i));
+    }
+    // Sequential sleeps alone would take 4 seconds
+    assert(elapsed < chrono::seconds(2));
+
+    // A script can start several operations before waiting for them, and timers complete in deadline order
+    scripts.spawn(beg(
+        var("slow", call("sleep", 30)),
+        var("fast", call("sleep", 1)),
+        var("read", call("readFile", path(0))),
+        call("await", id("slow")),
+        call("await", id("fast")),
+        call("len", call("await", id("read")))));
+    scripts.spawn(beg(
+        call("await", call("sleep", 10)),
+        lit("second")));
+    results = scripts.run();
+    assert(get<int>(results[0]) == 9);
+    assert(get<string>(results[1]) == "second");
+
+    // Failed operations raise an error in the script that awaits them
+    scripts.spawn(call("await", call("readFile", directory + "/missing.txt")));
+    scripts.spawn(call("await", 12345));
+    results = scripts.run();
+    assert(holds_alternative<Null>(results[0]) && holds_alternative<Null>(results[1]));
+
+    for (int i = 0; i < count; ++i)
+    {
+        unlink(path(i).c_str());
+    }
+    rmdir(directory.c_str());
+}
+
+#endif // CPP_EVA_EVENT_LOOP_TEST_H
@@ -12,23 +12,6 @@
 #define NONE id("null")
 #define none NONE
 
-/**
- * @brief Print expression
- *
- * @param args Args&&...
- * @return ExpressionPtr
- *
- * @code
- * print("Hello, ", "world!");
- * @endcode
- */
-template <typename... Args>
-inline auto print(Args &&...args)
-{
-    (std::cout << ... << args) << std::endl;
-    return Expression::create();
-}
-
 /**
  * @brief Create new literal expression
  *
@@ -54,6 +37,11 @@ inline auto wrap(EvalResult value)
     return lit(std::move(value));
 }
 
+inline auto wrap(const char *value)
+{
+    return lit(std::string(value));
+}
+
 /**
  * @brief Create new block expression
  *
@@ -120,6 +108,23 @@ inline auto floop(ExpressionPtr init, ExpressionPtr condition, ExpressionPtr mod
     return ForLoop::create(std::move(init), std::move(condition), std::move(modifier), std::move(body));
 }
 
+/**
+ * @brief Create new loop over the items of a collection, generator or sequence
+ *
+ * @param name Variable name
+ * @param iterable ExpressionPtr
+ * @param body ExpressionPtr
+ * @return ForInPtr
+ *
+ * @code
+ * forin("x", call("range", 10), set("sum", add(id("sum"), id("x"))));
+ * @endcode
+ */
+inline auto forin(std::string name, ExpressionPtr iterable, ExpressionPtr body)
+{
+    return ForIn::create(std::move(name), std::move(iterable), std::move(body));
+}
+
 /**
  * @brief Create new identifier
  *
@@ -727,6 +732,22 @@ inline auto call(std::string name, Args &&...args)
     return call(std::move(name), vars(std::forward<Args>(args)...));
 }
 
+/**
+ * @brief Call the builtin print function
+ *
+ * @param args Args&&...
+ * @return FunctionCallPtr
+ *
+ * @code
+ * print("Hello, ", id("name"));
+ * @endcode
+ */
+template <typename... Args>
+inline auto print(Args &&...args)
+{
+    return call("print", std::forward<Args>(args)...);
+}
+
 /**
  * @brief Call lambda inplace - Immediately Invoked Lambda Expression (IILE)
  *
@@ -897,4 +918,123 @@ inline auto callm(MemberAccessPtr member, std::vector<ExpressionPtr> args)
     return MemberFunctionCall::create(std::move(member), std::move(args));
 }
 
+/**
+ * @brief Create new list literal
+ *
+ * @param args Args&&...
+ * @return ListExpressionPtr
+ *
+ * @code
+ * lst(1, "two", id("three"));
+ * @endcode
+ */
+template <typename... Args>
+inline auto lst(Args &&...args)
+{
+    return ListExpression::create(vars(std::forward<Args>(args)...));
+}
+
+/**
+ * @brief Create new entry of a map literal
+ *
+ * @param key Key
+ * @param value Value
+ * @return std::pair<ExpressionPtr, ExpressionPtr>
+ *
+ * @code
+ * kv("name", id("value"));
+ * @endcode
+ */
+template <typename Key, typename Value>
+inline auto kv(Key &&key, Value &&value)
+{
+    return std::pair<ExpressionPtr, ExpressionPtr>(wrap(std::forward<Key>(key)), wrap(std::forward<Value>(value)));
+}
+
+/**
+ * @brief Create new map literal
+ *
+ * @param entries Entries&&...
+ * @return MapExpressionPtr
+ *
+ * @code
+ * dict(kv("a", 1), kv("b", 2));
+ * @endcode
+ */
+template <typename... Entries>
+inline auto dict(Entries &&...entries)
+{
+    std::vector<std::pair<ExpressionPtr, ExpressionPtr>> items;
+    (items.push_back(std::forward<Entries>(entries)), ...);
+    return MapExpression::create(std::move(items));
+}
+
+/**
+ * @brief Access an item of a list or a map
+ *
+ * @param collection ExpressionPtr
+ * @param index Index
+ * @return IndexAccessPtr
+ *
+ * @code
+ * at(id("list"), 0);
+ * @endcode
+ */
+template <typename Index>
+inline auto at(ExpressionPtr collection, Index &&index)
+{
+    return IndexAccess::create(std::move(collection), wrap(std::forward<Index>(index)));
+}
+
+/**
+ * @brief Set an item of a list or a map
+ *
+ * @param collection ExpressionPtr
+ * @param index Index
+ * @param value Value
+ * @return IndexAssignmentPtr
+ *
+ * @code
+ * setat(id("map"), "key", 42);
+ * @endcode
+ */
+template <typename Index, typename Value>
+inline auto setat(ExpressionPtr collection, Index &&index, Value &&value)
+{
+    return IndexAssignment::create(std::move(collection), wrap(std::forward<Index>(index)), wrap(std::forward<Value>(value)));
+}
+
+/**
+ * @brief Create new import of a module
+ *
+ * @param path Path of the program image of the module
+ * @param names Names of the exports to define, all of them if none are given
+ * @return ImportPtr
+ *
+ * @code
+ * imp("math.evap", "square", "cube");
+ * @endcode
+ */
+template <typename... Names>
+inline auto imp(std::string path, Names &&...names)
+{
+    return Import::create(std::move(path), std::vector<std::string>{std::forward<Names>(names)...});
+}
+
+/**
+ * @brief Create new yield of a generator function
+ *
+ * @param value Value
+ * @return YieldPtr
+ *
+ * @code
+ * def("naturals", args(), beg(var("i", lit(0)), loop(lit(true), beg(yld(id("i")), inc(id("i"))))));
+ * @endcode
+ */
+template <typename Value>
+inline auto yld(Value &&value)
+{
+    return Yield::create(wrap(std::forward<Value>(value)));
+}
+
 #endif // CPP_EVA_EXPRESSION_HELPERS_H
@@ -5,7 +5,8 @@
 #include "expression_helpers.h"
 #include "../eva.h"
 
-void runForLoopTest(Eva &eva)
+template <typename Evaluator>
+void runForLoopTest(Evaluator &eva)
 {
     IASSERT(
         beg(
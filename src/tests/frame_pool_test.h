@@ -0,0 +1,79 @@
+#ifndef CPP_EVA_FRAME_POOL_TEST_H
+#define CPP_EVA_FRAME_POOL_TEST_H
+
+#include <memory>
+#include "test_utils.h"
+#include "expression_helpers.h"
+#include "../eva.h"
+#include "../jit.h"
+
+void runFramePoolTest(Eva &)
+{
+    using namespace std;
+
+    // Compiled functions do not use frames
+    Jit::setEnabled(false);
+
+    Eva eva(make_shared<Environment>(EvalMap{{"null", Null{}}, {"true", true}, {"false", false}}));
+    auto frames = [&eva](const string &name) -> const FramePool &
+    {
+        return get<FunctionDefinition>(eva.getGlobal()->lookup(name)).profile->frames;
+    };
+
+    eva.eval(def("fib", args("n"),
+                 iff(lt(id("n"), 2),
+                     id("n"),
+                     add(call("fib", sub(id("n"), 1)), call("fib", sub(id("n"), 2))))));
+    IASSERT(call("fib", 20), 6765);
+    IASSERT(call("fib", 20), 6765);
+    assert(frames("fib").size() > 0 && frames("fib").size() <= FramePool::capacity);
+
+    // Closures share the captured variables, not the frame, so the frame is still recycled
+    eva.eval(def("adder", args("x"), lambda(args("y"), add(id("x"), id("y")))));
+    eva.eval(var("addOne", call("adder", 1)));
+    IASSERT(call("fib", 10), 55);
+    IASSERT(call("addOne", 10), 11);
+    assert(frames("adder").size() == 1);
+
+    // A frame captured as a whole by a closure is not recycled
+    eva.eval(def("deferred", args("x"), lambda(args(), add(id("x"), id("definedLater")))));
+    eva.eval(var("addLater", call("deferred", 1)));
+    eva.eval(var("definedLater", lit(2)));
+    IASSERT(call("addLater"), 3);
+    assert(frames("deferred").size() == 0);
+
+    // Locals defined in the frame itself are not seen by the next call
+    eva.eval(var("x", lit(100)));
+    eva.eval(def("shadow", args("define"), iff(id("define"), var("x", lit(1)), id("x"))));
+    IASSERT(call("shadow", true), 1);
+    IASSERT(call("shadow", false), 100);
+    assert(frames("shadow").size() == 1);
+
+    // Values of pooled frames are released
+    eva.eval(def("identity", args("value"), id("value")));
+    auto instance = make_shared<Environment>(EvalMap{});
+    eva.getGlobal()->define("instance", InstanceDefinition{instance});
+    eva.eval(call("identity", id("instance")));
+    eva.getGlobal()->define("instance", Null{});
+    assert(instance.use_count() == 1);
+
+    // Constructors recycle their frames as well
+    eva.eval(cls("Point", NONE,
+                 beg(def("constructor", args("self", "x"), setm(prop("self", "x"), id("x"))))));
+    eva.eval(var("p", newi("Point", vars(lit(1)))));
+    eva.eval(var("q", newi("Point", vars(lit(2)))));
+    IASSERT(prop("p", "x"), 1);
+    IASSERT(prop("q", "x"), 2);
+
+    // Frames created under a resource governor are not pooled
+    auto before = frames("identity").size();
+    IASSERT(call("identity", 5), 5);
+    EvalLimits limits;
+    limits.fuel = 1000;
+    eva.eval(call("identity", 5), limits);
+    assert(frames("identity").size() == before);
+
+    Jit::setEnabled(true);
+}
+
+#endif // CPP_EVA_FRAME_POOL_TEST_H
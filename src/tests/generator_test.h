@@ -0,0 +1,103 @@
+#ifndef CPP_EVA_GENERATOR_TEST_H
+#define CPP_EVA_GENERATOR_TEST_H
+
+#include <string>
+#include "test_utils.h"
+#include "expression_helpers.h"
+#include "../eva.h"
+#include "../program_image.h"
+
+void runGeneratorTest(Eva &eva)
+{
+    using namespace std;
+
+    // Calling a generator function only binds the arguments, the body runs up to a yield on every next
+    eva.eval(def("countTo", args("n"),
+                 beg(
+                     var("i", lit(0)),
+                     loop(lt(id("i"), id("n")),
+                          beg(
+                              yld(id("i")),
+                              inc(id("i")))))));
+    eva.eval(var("counter", call("countTo", 3)));
+    BASSERT(call("done", id("counter")), false);
+    IASSERT(call("next", id("counter")), 0);
+    IASSERT(call("next", id("counter")), 1);
+    IASSERT(call("next", id("counter")), 2);
+    NASSERT(call("next", id("counter")));
+    BASSERT(call("done", id("counter")), true);
+    NASSERT(call("next", id("counter")));
+
+    // Yields in branches, for loops and switch cases, with the block variables kept across suspensions
+    eva.eval(def("labels", args("n"),
+                 floop(var("i", lit(0)), lt(id("i"), id("n")), inc(id("i")),
+                       beg(
+                           var("label", add("item ", call("str", id("i")))),
+                           select(when(eq(mod(id("i"), 2), 0), yld(id("label"))),
+                                  any(iff(gt(id("i"), 2),
+                                          beg(yld("big"), yld(id("label"))),
+                                          yld("odd"))))))));
+    eva.eval(var("names", call("labels", 5)));
+    SASSERT(call("next", id("names")), "item 0");
+    SASSERT(call("next", id("names")), "odd");
+    SASSERT(call("next", id("names")), "item 2");
+    SASSERT(call("next", id("names")), "big");
+    SASSERT(call("next", id("names")), "item 3");
+    SASSERT(call("next", id("names")), "item 4");
+    NASSERT(call("next", id("names")));
+
+    // Generators are independent, and lambdas and closures can be generators too
+    IASSERT(beg(
+                var("start", lit(10)),
+                var("up", lambda(args(), beg(yld(id("start")), set("start", add(id("start"), 1)), yld(id("start"))))),
+                var("first", call("up")),
+                var("second", call("up")),
+                add(mul(call("next", id("first")), 100), add(call("next", id("first")), call("next", id("second"))))),
+            1000 + 11 + 11);
+
+    // Stages of a pipeline pull one element at a time from an unbounded source
+    eva.eval(def("naturals", args(),
+                 beg(
+                     var("i", lit(0)),
+                     loop(lit(true), beg(yld(id("i")), inc(id("i")))))));
+    eva.eval(def("evenSquares", args("source"),
+                 loop(lit(true),
+                      beg(
+                          var("x", call("next", id("source"))),
+                          iff(eq(mod(id("x"), 2), 0), yld(mul(id("x"), id("x"))), lit(0))))));
+    IASSERT(beg(
+                var("squares", call("evenSquares", call("naturals"))),
+                var("sum", lit(0)),
+                floop(var("k", lit(0)), lt(id("k"), 20000), inc(id("k")),
+                      set("sum", mod(add(id("sum"), call("next", id("squares"))), 1000007))),
+                id("sum")),
+            [] {
+                long long sum = 0;
+                for (long long k = 0; k < 20000; ++k)
+                {
+                    sum = (sum + (2 * k) * (2 * k)) % 1000007;
+                }
+                return static_cast<int>(sum);
+            }());
+
+    // A yield in an expression, outside of a generator or from inside its own generator is an error
+    NASSERT(yld(1));
+    eva.eval(def("misplaced", args(), call("print", yld(1))));
+    NASSERT(call("misplaced"));
+    eva.eval(def("reentrant", args(), beg(yld(call("next", id("self"))))));
+    eva.eval(var("self", call("reentrant")));
+    NASSERT(call("next", id("self")));
+    BASSERT(call("done", id("self")), true);
+
+    // The generator flag survives a program image, without materializing the body
+    ProgramWriter writer;
+    writer.add(*def("pair", args("a", "b"), beg(yld(id("a")), yld(id("b")))));
+    auto image = ProgramImage::fromBytes(writer.serialize(0));
+    eva.eval(image->materialize());
+    IASSERT(beg(
+                var("both", call("pair", 4, 5)),
+                add(mul(call("next", id("both")), 10), call("next", id("both")))),
+            45);
+}
+
+#endif // CPP_EVA_GENERATOR_TEST_H
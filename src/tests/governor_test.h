@@ -0,0 +1,71 @@
+#ifndef CPP_EVA_GOVERNOR_TEST_H
+#define CPP_EVA_GOVERNOR_TEST_H
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "test_utils.h"
+#include "expression_helpers.h"
+#include "../eva.h"
+
+inline AbortReason abortReason(Eva &eva, ExpressionPtr exp, const EvalLimits &limits)
+{
+    try
+    {
+        eva.eval(std::move(exp), limits);
+    }
+    catch (const EvaluationAborted &e)
+    {
+        return e.getReason();
+    }
+    assert(false && "evaluation was expected to abort");
+    return AbortReason::CANCELLED;
+}
+
+void runGovernorTest(Eva &eva)
+{
+    EvalLimits fuel;
+    fuel.fuel = 100;
+
+    // Programs within the budget are not affected
+    assert(std::get<int>(eva.eval(
+               beg(
+                   var("i", lit(0)),
+                   loop(lt(id("i"), 10),
+                        set("i", add(id("i"), 1))),
+                   id("i")),
+               fuel)) == 10);
+
+    assert(abortReason(eva, loop(TRUE, lit(1)), fuel) == AbortReason::FUEL_EXHAUSTED);
+
+    EvalLimits heap;
+    heap.maxHeapBytes = 64 * 1024;
+
+    assert(abortReason(eva,
+                       beg(
+                           def("grow", args("n"),
+                               call("grow", add(id("n"), 1))),
+                           call("grow", 0)),
+                       heap) == AbortReason::HEAP_LIMIT_EXCEEDED);
+
+    // Growing a variable through assignment is charged like defining it
+    assert(abortReason(eva,
+                       beg(
+                           var("text", lit(std::string("ab"))),
+                           floop(var("i", lit(0)), lt(id("i"), 24), inc(id("i")),
+                                 set("text", call("concat", id("text"), id("text"))))),
+                       heap) == AbortReason::HEAP_LIMIT_EXCEEDED);
+
+    EvalLimits cancel;
+    cancel.cancel = std::make_shared<std::atomic<bool>>(false);
+
+    std::thread canceller([flag = cancel.cancel]
+                          {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        flag->store(true); });
+
+    assert(abortReason(eva, loop(TRUE, lit(1)), cancel) == AbortReason::CANCELLED);
+    canceller.join();
+}
+
+#endif // CPP_EVA_GOVERNOR_TEST_H
@@ -5,7 +5,8 @@
 #include "expression_helpers.h"
 #include "../eva.h"
 
-void runIfTests(Eva &eva)
+template <typename Evaluator>
+void runIfTests(Evaluator &eva)
 {
     IASSERT(
         beg(
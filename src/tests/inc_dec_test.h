@@ -5,7 +5,8 @@
 #include "test_utils.h"
 #include "expression_helpers.h"
 
-void runIncDecTest(Eva &eva)
+template <typename Evaluator>
+void runIncDecTest(Evaluator &eva)
 {
     IASSERT(
         beg(
@@ -0,0 +1,106 @@
+#ifndef CPP_EVA_JIT_TEST_H
+#define CPP_EVA_JIT_TEST_H
+
+#include <climits>
+#include <memory>
+#include "test_utils.h"
+#include "expression_helpers.h"
+#include "../eva.h"
+#include "../jit.h"
+
+void runJitTest(Eva &)
+{
+    using namespace std;
+
+    Eva eva(make_shared<Environment>(EvalMap{{"null", Null{}}, {"true", true}, {"false", false}}));
+    auto function = [&eva](const string &name)
+    {
+        return get<FunctionDefinition>(eva.getGlobal()->lookup(name));
+    };
+
+    eva.eval(def("fib", args("n"),
+                 iff(lt(id("n"), 2),
+                     id("n"),
+                     add(call("fib", sub(id("n"), 1)), call("fib", sub(id("n"), 2))))));
+
+    eva.eval(def("sumTo", args("n"),
+                 beg(
+                     var("sum", lit(0)),
+                     var("i", lit(0)),
+                     loop(lte(id("i"), id("n")),
+                          beg(
+                              set("sum", add(id("sum"), id("i"))),
+                              inc(id("i")))),
+                     id("sum"))));
+
+    eva.eval(def("bucket", args("score"),
+                 iff(gte(id("score"), 90), lit(3),
+                     iff(gte(id("score"), 50), lit(2), lit(1)))));
+
+    eva.eval(def("isPositive", args("x"), gt(id("x"), 0)));
+
+    eva.eval(def("describe", args("x"),
+                 iff(call("isPositive", id("x")), lit("positive"s), lit("negative"s))));
+
+    eva.eval(def("safeDiv", args("a", "b"), divv(id("a"), id("b"))));
+    eva.eval(def("safeMod", args("a", "b"), mod(id("a"), id("b"))));
+
+    // Results are the same before and after the functions become hot
+    for (uint32_t i = 0; i < Jit::hotCallThreshold + 2; ++i)
+    {
+        IASSERT(call("fib", 15), 610);
+        IASSERT(call("sumTo", 100), 5050);
+        IASSERT(call("bucket", 95), 3);
+        IASSERT(call("bucket", 60), 2);
+        IASSERT(call("bucket", 10), 1);
+        BASSERT(call("isPositive", -1), false);
+        SASSERT(call("describe", 4), "positive");
+        IASSERT(call("safeDiv", -7, 2), -3);
+        // Division by zero is reported and INT_MIN / -1 wraps whether or not the function is compiled
+        NASSERT(call("safeDiv", 1, 0));
+        IASSERT(call("safeDiv", INT_MIN, -1), INT_MIN);
+        IASSERT(call("safeMod", INT_MIN, -1), 0);
+        NASSERT(call("safeMod", 1, 0));
+    }
+
+    if (Jit::isSupported())
+    {
+        assert(Jit::isCompiled(function("fib")));
+        assert(Jit::isCompiled(function("sumTo")));
+        assert(Jit::isCompiled(function("bucket")));
+        assert(Jit::isCompiled(function("isPositive")));
+        assert(Jit::isCompiled(function("safeDiv")));
+        assert(Jit::isCompiled(function("safeMod")));
+        assert(Jit::isRejected(function("describe")));
+    }
+
+    // Arguments failing the type guard are interpreted
+    NASSERT(call("isPositive", lit("text"s)));
+    // Type errors of calls made from native code are reported like in the interpreter
+    NASSERT(call("fib", lit("text"s)));
+
+    // Arithmetic wraps at 32 bits in the interpreter and in native code
+    eva.eval(def("square", args("x"), mul(id("x"), id("x"))));
+    eva.eval(def("increment", args("x"), add(id("x"), 1)));
+    for (uint32_t i = 0; i < Jit::hotCallThreshold + 2; ++i)
+    {
+        IASSERT(call("square", 65536), 0);
+        IASSERT(call("increment", INT_MAX), INT_MIN);
+        IASSERT(call("square", -3), 9);
+    }
+
+    // Redefining a callee is observed by compiled callers
+    eva.eval(def("describeSign", args("x"), iff(call("isPositive", id("x")), lit(1), lit(-1))));
+    for (uint32_t i = 0; i < Jit::hotCallThreshold + 2; ++i)
+    {
+        IASSERT(call("describeSign", 5), 1);
+    }
+    eva.eval(set("isPositive", lambda(args("x"), lt(id("x"), 0))));
+    IASSERT(call("describeSign", 5), -1);
+
+    Jit::setEnabled(false);
+    IASSERT(call("fib", 15), 610);
+    Jit::setEnabled(true);
+}
+
+#endif // CPP_EVA_JIT_TEST_H
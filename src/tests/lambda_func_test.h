@@ -5,7 +5,8 @@
 #include "expression_helpers.h"
 #include "../eva.h"
 
-void runLambdaFuncTest(Eva &eva)
+template <typename Evaluator>
+void runLambdaFuncTest(Evaluator &eva)
 {
     IASSERT(
         beg(
@@ -20,6 +21,13 @@ void runLambdaFuncTest(Eva &eva)
     IASSERT(
         iile(lambda(args("x"), mul(id("x"), id("x"))), 2), 4);
 
+    // The lambda of an immediate call sees the variables of the calling scope
+    IASSERT(
+        beg(
+            var("offset", 5),
+            iile(lambda(args("x"), add(id("x"), id("offset"))), 2)),
+        7);
+
     IASSERT(
         beg(
             var("square", lambda(args("x"), mul(id("x"), id("x")))),
@@ -5,7 +5,8 @@
 #include "expression_helpers.h"
 #include "../eva.h"
 
-void runMathTests(Eva &eva)
+template <typename Evaluator>
+void runMathTests(Evaluator &eva)
 {
     IASSERT(add(2, 3), 5);
     IASSERT(sub(10, 3), 7);
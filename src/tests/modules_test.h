@@ -0,0 +1,105 @@
+#ifndef CPP_EVA_MODULES_TEST_H
+#define CPP_EVA_MODULES_TEST_H
+
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include "test_utils.h"
+#include "expression_helpers.h"
+#include "../eva.h"
+#include "../modules.h"
+#include "../program_image.h"
+
+void runModulesTest(Eva &eva)
+{
+    using namespace std;
+
+    // Roots of other interpreters start from the builtins, before this root instantiates any module
+    vector<pair<string, EvalResult>> builtins;
+    for (const auto &variable : globalEnv->getVariables())
+    {
+        builtins.emplace_back(variable.name, variable.get());
+    }
+
+    char directoryTemplate[] = "/tmp/cpp_eva_modules_XXXXXX";
+    string directory = mkdtemp(directoryTemplate);
+    vector<string> files;
+    auto write = [&](const string &name, ExpressionPtr program)
+    {
+        ProgramWriter writer;
+        writer.add(*program);
+        files.push_back(directory + "/" + name + ".evap");
+        writer.write(files.back());
+        return files.back();
+    };
+
+    // A diamond: app imports left and right, which both import base
+    auto base = write("base", beg(
+                                  var("log", lst()),
+                                  def("square", args("x"), mul(id("x"), id("x")))));
+    auto left = write("left", beg(
+                                  imp(base, "square"),
+                                  def("quad", args("x"), call("square", call("square", id("x"))))));
+    auto right = write("right", beg(
+                                    imp(base),
+                                    def("cube", args("x"), mul(id("x"), call("square", id("x"))))));
+    auto app = write("app", beg(
+                                imp(left, "quad"),
+                                imp(right, "cube"),
+                                var("answer", add(call("quad", 2), call("cube", 3)))));
+    auto first = write("first", imp(directory + "/second.evap"));
+    write("second", imp(first));
+
+    auto &cache = ModuleCache::process();
+    auto compiled = cache.compile(app);
+    assert(compiled->getDependencies().size() == 2);
+    assert(compiled->getDependencies()[0]->getDependencies()[0] == compiled->getDependencies()[1]->getDependencies()[0]);
+    assert(cache.compile(directory + "/./app.evap") == compiled);
+    auto modules = cache.size();
+
+    IASSERT(beg(imp(app, "answer"), id("answer")), 43);
+    IASSERT(call("len", imp(base)), 2);
+    NASSERT(imp(base, "missing"));
+    NASSERT(imp(directory + "/missing.evap"));
+    NASSERT(imp(first));
+
+    // A module is evaluated once per root environment, every import shares its variables
+    IASSERT(beg(
+                imp(base, "log"),
+                call("push", id("log"), 1),
+                iile(lambda(args(), beg(imp(base, "log"), call("len", id("log")))))),
+            1);
+
+    // Interpreters with roots of their own share the compiled modules but not their variables
+    vector<thread> interpreters;
+    vector<int> answers(8);
+    for (size_t i = 0; i < answers.size(); ++i)
+    {
+        interpreters.emplace_back([&app, &base, &answers, &builtins, i]
+                                  {
+            EvalMap variables(builtins.begin(), builtins.end());
+            Eva interpreter(make_shared<Environment>(std::move(variables)));
+            interpreter.eval(imp(base, "log"));
+            answers[i] = get<int>(interpreter.eval(beg(imp(app, "answer"), add(id("answer"), call("len", id("log")))))); });
+    }
+    for (auto &interpreter : interpreters)
+    {
+        interpreter.join();
+    }
+    for (auto answer : answers)
+    {
+        assert(answer == 43);
+    }
+    assert(cache.size() == modules);
+
+    for (const auto &file : files)
+    {
+        unlink(file.c_str());
+    }
+    rmdir(directory.c_str());
+}
+
+#endif // CPP_EVA_MODULES_TEST_H
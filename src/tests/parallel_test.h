@@ -0,0 +1,115 @@
+#ifndef CPP_EVA_PARALLEL_TEST_H
+#define CPP_EVA_PARALLEL_TEST_H
+
+#include <atomic>
+#include <cassert>
+#include <stdexcept>
+#include <string>
+#include "test_utils.h"
+#include "expression_helpers.h"
+#include "../eva.h"
+#include "../governor.h"
+#include "../worker_pool.h"
+
+void runParallelTest(Eva &eva)
+{
+    using namespace std;
+
+    // Tasks can run nested batches on the same pool, the error of the lowest failed task is rethrown
+    WorkerPool pool(3);
+    atomic<int> done{0};
+    pool.run(100, [&pool, &done](size_t)
+             { pool.run(10, [&done](size_t)
+                        { ++done; }); });
+    assert(done == 1000);
+    try
+    {
+        pool.run(50, [](size_t index)
+                 {
+                     if (index % 10 == 7)
+                     {
+                         throw runtime_error("task " + to_string(index));
+                     } });
+        assert(false);
+    }
+    catch (const runtime_error &error)
+    {
+        assert(string(error.what()) == "task 7");
+    }
+
+    // Isolated functions only write their own variables and call isolated functions
+    eva.eval(def("stepsOf", args("n"),
+                 beg(
+                     var("steps", lit(0)),
+                     loop(gt(id("n"), 1),
+                          beg(
+                              iff(eq(mod(id("n"), 2), 0),
+                                  set("n", divv(id("n"), 2)),
+                                  set("n", add(mul(id("n"), 3), 1))),
+                              inc(id("steps")))),
+                     id("steps"))));
+    BASSERT(call("isolated", id("stepsOf")), true);
+    BASSERT(call("isolated", lambda(args("x"), add(call("stepsOf", id("x")), call("len", "abc")))), true);
+    BASSERT(call("isolated", id("len")), true);
+    BASSERT(call("isolated", id("push")), false);
+    BASSERT(call("isolated", lambda(args("x"), call("print", id("x")))), false);
+    BASSERT(call("isolated", lambda(args("f"), call("f", 1))), false);
+    BASSERT(call("isolated", lambda(args("l"), setat(id("l"), 0, 1))), false);
+    BASSERT(call("isolated", lambda(args("x"), lambda(args(), id("x")))), false);
+    BASSERT(call("isolated", 5), false);
+
+    // A variable declared in a branch that is not taken is not local to the code after the branch
+    BASSERT(call("isolated",
+                 lambda(args("x"), beg(iff(FALSE, var("tally", lit(0)), 0), set("tally", add(id("tally"), 1))))),
+            false);
+    BASSERT(call("isolated", lambda(args("x"), beg(loop(FALSE, var("tally", lit(0))), inc(id("tally"))))), false);
+    BASSERT(call("isolated", lambda(args("x"), iff(TRUE, beg(var("local", lit(0)), inc(id("local"))), 0))), true);
+
+    // Results come back in the order of the items
+    eva.eval(var("allSteps", call("pmap", call("range", 1, 20001), id("stepsOf"))));
+    IASSERT(call("len", id("allSteps")), 20000);
+    IASSERT(at(id("allSteps"), 0), 0);
+    IASSERT(at(id("allSteps"), 26), 111);
+    IASSERT(at(id("allSteps"), 19999), 30);
+    SASSERT(call("str", call("pmap", dict(kv(1, "one")), lambda(args("k"), mul(id("k"), 2)))), "[2]");
+
+    // Chunks are combined in order, so any associative function folds like reduce
+    eva.eval(var("join", lambda(args("a", "b"), add(call("str", id("a")), call("str", id("b"))))));
+    SASSERT(call("str", call("preduce", call("range", 300), id("join"), "")),
+            [] {
+                string joined;
+                for (int i = 0; i < 300; ++i)
+                {
+                    joined += to_string(i);
+                }
+                return joined;
+            }());
+    eva.eval(var("plus", lambda(args("a", "b"), add(id("a"), id("b")))));
+    IASSERT(call("preduce", call("map", call("range", 1, 20001), id("stepsOf")), id("plus"), 0),
+            std::get<int>(eva.eval(call("reduce", id("allSteps"), id("plus"), 0))));
+    IASSERT(call("preduce", lst(), id("join"), 42), 42);
+
+    // A combining function joins the folds of the chunks when the accumulator is not an item
+    eva.eval(var("words", call("collect", call("map", call("range", 200), lambda(args("i"), call("str", id("i")))))));
+    eva.eval(var("addLength", lambda(args("total", "word"), add(id("total"), call("len", id("word"))))));
+    BASSERT(call("isolated", id("addLength")), true);
+    IASSERT(call("preduce", id("words"), id("addLength"), 0, id("plus")), 490);
+    IASSERT(call("preduce", id("words"), id("addLength"), 0, id("plus")),
+            std::get<int>(eva.eval(call("reduce", id("words"), id("addLength"), 0))));
+
+    // Functions that write captured variables are called one item after the other
+    eva.eval(var("tally", lit(0)));
+    eva.eval(var("countItem", lambda(args("x"), set("tally", add(id("tally"), 1)))));
+    BASSERT(call("isolated", id("countItem")), false);
+    IASSERT(call("len", call("pmap", call("range", 5000), id("countItem"))), 5000);
+    IASSERT(id("tally"), 5000);
+
+    // Under limits the items are mapped on the calling thread, errors stop the map
+    EvalLimits limits;
+    limits.fuel = 100000;
+    auto limited = eva.eval(call("pmap", call("range", 100), id("stepsOf")), limits);
+    assert(std::get<ListValue>(limited).list->size() == 100);
+    NASSERT(call("pmap", call("range", 100), lambda(args("x"), call("substr", "abc", id("x"), 1))));
+}
+
+#endif // CPP_EVA_PARALLEL_TEST_H
@@ -0,0 +1,75 @@
+#ifndef CPP_EVA_PERF_COUNTERS_TEST_H
+#define CPP_EVA_PERF_COUNTERS_TEST_H
+
+#include <cassert>
+#include <string>
+#include "test_utils.h"
+#include "expression_helpers.h"
+#include "../eva.h"
+#include "../perf_counters.h"
+
+void runPerfCountersTest(Eva &eva)
+{
+    using namespace std;
+
+    // Missing counts stay missing, so a counter the machine lacks is never reported as zero
+    PerfSample first;
+    first.counts[0] = 10;
+    PerfSample second;
+    second.counts[0] = 25;
+    second.counts[1] = 7;
+    assert(*(second - first)[PerfEvent::TASK_CLOCK] == 15);
+    assert(!(second - first)[PerfEvent::CYCLES]);
+    first += second;
+    assert(*first[PerfEvent::TASK_CLOCK] == 35 && *first[PerfEvent::CYCLES] == 7);
+    assert(string(perfEventName(PerfEvent::BRANCH_MISSES)) == "branchMisses");
+
+    // An evaluation is counted with every event the machine provides, and only with those
+    const auto &counters = PerfCounters::thread();
+    PerfProfile profile;
+    eva.eval(def("perfFib", args("n"),
+                 iff(lt(id("n"), 2), id("n"), add(call("perfFib", sub(id("n"), 1)), call("perfFib", sub(id("n"), 2))))));
+    assert(std::get<int>(eva.eval(call("perfFib", 15), profile)) == 610);
+    assert(!PerfProfiler::current());
+    for (size_t i = 0; i < perfEventCount; ++i)
+    {
+        auto event = static_cast<PerfEvent>(i);
+        assert(profile.total[event].has_value() == counters.isAvailable(event));
+    }
+    assert(profile.functions.empty());
+
+    // Functions are counted by every call, compiled functions included, with their self counts
+    profile = PerfProfile{};
+    profile.perFunction = true;
+    eva.eval(def("perfSquare", args("x"), mul(id("x"), id("x"))));
+    eva.eval(def("perfSumSquares", args("n"),
+                 beg(var("total", lit(0)),
+                     floop(var("i", lit(0)), lt(id("i"), id("n")), inc(id("i")),
+                           set("total", add(id("total"), call("perfSquare", id("i"))))),
+                     id("total"))));
+    assert(std::get<int>(eva.eval(call("perfFib", 15), profile)) == 610);
+    assert(std::get<int>(eva.eval(call("perfSumSquares", 10), profile)) == 285);
+    assert(std::get<int>(eva.eval(iile(lambda(args("x"), add(id("x"), 1)), 1), profile)) == 2);
+    assert(profile.functions["perfFib"].calls == 1973);
+    assert(profile.functions["perfSumSquares"].calls == 1);
+    assert(profile.functions["perfSquare"].calls == 10);
+    assert(profile.functions["<lambda>"].calls == 1);
+    if (counters.isAvailable(PerfEvent::TASK_CLOCK))
+    {
+        uint64_t self = 0;
+        for (const auto &[name, function] : profile.functions)
+        {
+            self += *function.self[PerfEvent::TASK_CLOCK];
+        }
+        assert(self <= *profile.total[PerfEvent::TASK_CLOCK]);
+    }
+
+    // A failed evaluation is still counted
+    profile = PerfProfile{};
+    profile.perFunction = true;
+    assert(std::get<Null>(eva.eval(call("perfSquare", "text"), profile)) == Null{});
+    assert(profile.functions["perfSquare"].calls == 1);
+    assert(!PerfProfiler::current());
+}
+
+#endif // CPP_EVA_PERF_COUNTERS_TEST_H
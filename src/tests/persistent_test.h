@@ -0,0 +1,116 @@
+#ifndef CPP_EVA_PERSISTENT_TEST_H
+#define CPP_EVA_PERSISTENT_TEST_H
+
+#include <string>
+#include <thread>
+#include <vector>
+#include "test_utils.h"
+#include "expression_helpers.h"
+#include "../eva.h"
+#include "../collections.h"
+#include "../persistent.h"
+
+void runPersistentTest(Eva &eva)
+{
+    using namespace std;
+
+    // Updates return new values and leave the original ones unchanged
+    eva.eval(var("config", call("table", "host", "localhost", "port", 80)));
+    eva.eval(var("updated", call("assoc", id("config"), "port", 8080)));
+    IASSERT(at(id("config"), "port"), 80);
+    IASSERT(at(id("updated"), "port"), 8080);
+    IASSERT(call("len", call("dissoc", id("updated"), "host")), 1);
+    SASSERT(at(id("updated"), "host"), "localhost");
+    BASSERT(call("has", id("config"), "missing"), false);
+    NASSERT(setat(id("config"), "port", 1));
+    NASSERT(at(id("config"), "missing"));
+
+    eva.eval(var("numbers", call("vector", 1, 2, 3)));
+    IASSERT(at(call("conj", id("numbers"), 4), 3), 4);
+    IASSERT(at(call("assoc", id("numbers"), 0, 10), 0), 10);
+    IASSERT(at(id("numbers"), 0), 1);
+    IASSERT(call("len", id("numbers")), 3);
+    NASSERT(at(id("numbers"), 3));
+    SASSERT(call("str", id("numbers")), "#[1, 2, 3]");
+
+    // Frozen collections no longer see updates of the originals
+    IASSERT(beg(
+                var("items", lst(1, lst(2))),
+                var("frozen", call("freeze", id("items"))),
+                setat(id("items"), 0, 5),
+                at(at(id("frozen"), 1), 0)),
+            2);
+    assert(equalValues(freeze(List::create({1, 2})), PersistentVector::create({1, 2})));
+
+    // Vectors deep enough to need several levels of the trie
+    auto numbers = PersistentVector::create();
+    vector<VectorValue> versions;
+    for (int i = 0; i < 5000; ++i)
+    {
+        numbers = numbers.vector->push(i);
+        if (i % 1000 == 0)
+        {
+            versions.push_back(numbers);
+        }
+    }
+    auto changed = numbers.vector->assoc(4321, -1);
+    assert(get<int>(numbers.vector->at(4321)) == 4321);
+    assert(get<int>(changed.vector->at(4321)) == -1);
+    for (size_t i = 0; i < versions.size(); ++i)
+    {
+        assert(versions[i].vector->size() == i * 1000 + 1);
+    }
+    for (int i = 0; i < 5000; ++i)
+    {
+        assert(get<int>(numbers.vector->at(i)) == i);
+    }
+
+    // Tables keep every key reachable through node splits, removals and hash collisions
+    auto table = PersistentMap::create();
+    for (int i = 0; i < 3000; ++i)
+    {
+        table = table.map->assoc(i, i * 3);
+    }
+    auto smaller = table;
+    for (int i = 0; i < 3000; i += 3)
+    {
+        smaller = smaller.map->dissoc(i);
+    }
+    assert(table.map->size() == 3000 && smaller.map->size() == 2000);
+    for (int i = 0; i < 3000; ++i)
+    {
+        assert(get<int>(*table.map->find(i)) == i * 3);
+        assert((smaller.map->find(i) == nullptr) == (i % 3 == 0));
+    }
+    assert(smaller.map->dissoc(0).map == smaller.map);
+    assert(!equalValues(table, smaller));
+    assert(hashValue(table.map->assoc(1, 3)) == hashValue(table));
+
+    // Readers on other threads need no locks while new versions are created
+    vector<thread> readers;
+    vector<int> sums(4);
+    for (size_t t = 0; t < sums.size(); ++t)
+    {
+        readers.emplace_back([&table, &sums, t]
+                             {
+            for (int i = 0; i < 3000; ++i)
+            {
+                sums[t] += get<int>(*table.map->find(i)) - i * 3;
+            } });
+    }
+    auto writer = table;
+    for (int i = 0; i < 1000; ++i)
+    {
+        writer = writer.map->assoc(i, -i);
+    }
+    for (auto &reader : readers)
+    {
+        reader.join();
+    }
+    for (auto sum : sums)
+    {
+        assert(sum == 0);
+    }
+}
+
+#endif // CPP_EVA_PERSISTENT_TEST_H
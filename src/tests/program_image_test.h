@@ -0,0 +1,97 @@
+#ifndef CPP_EVA_PROGRAM_IMAGE_TEST_H
+#define CPP_EVA_PROGRAM_IMAGE_TEST_H
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include "test_utils.h"
+#include "expression_helpers.h"
+#include "../eva.h"
+#include "../program_image.h"
+
+void runProgramImageTest(Eva &eva)
+{
+    using namespace std;
+
+    auto program = beg(
+        cls("Point", NONE,
+            beg(
+                def("constructor", args("self", "x", "y"),
+                    beg(
+                        setm(prop("self", "x"), id("x")),
+                        setm(prop("self", "y"), id("y")))),
+                def("calc", args("self"),
+                    add(prop("self", "x"), prop("self", "y"))))),
+        def("square", args("x"), mul(id("x"), id("x"))),
+        var("sum", lit(0)),
+        floop(var("i", lit(0)),
+              lt(id("i"), 4),
+              inc(id("i")),
+              set("sum", add(id("sum"), call("square", id("i"))))),
+        var("p", newi("Point", vars(10, 20))),
+        var("label", select(when(gt(id("sum"), 10), "big"s), any("small"s))),
+        iff(gt(id("sum"), 0),
+            add(id("sum"), callm(prop("p", "calc"), vars(id("p")))),
+            lit(0)));
+
+    ProgramWriter writer;
+    writer.add(*program);
+
+    auto path = string(P_tmpdir) + "/cpp_eva_program_image_test.evab";
+    std::remove(path.c_str());
+
+    assert(writer.write(path, 42));
+    assert(!writer.write(path, 42));
+    assert(ProgramImage::isUpToDate(path, 42));
+    assert(!ProgramImage::isUpToDate(path, 43));
+
+    auto image = ProgramImage::load(path);
+    assert(image->getHeader().sourceHash == 42);
+    assert(image->getNode(image->getRoot()).kind == NodeKind::BLOCK);
+    IASSERT(image->materialize(), 44);
+
+    // In-memory images and images produced from materialized trees are identical
+    auto bytes = writer.serialize(42);
+    ProgramWriter copy;
+    copy.add(*ProgramImage::fromBytes(bytes)->materialize());
+    assert(copy.serialize(42) == bytes);
+
+    bool rejected = false;
+    try
+    {
+        ProgramImage::fromBytes(bytes.substr(0, bytes.size() / 2));
+    }
+    catch (const runtime_error &)
+    {
+        rejected = true;
+    }
+    assert(rejected);
+
+    // A node that refers to itself would be materialized forever, the image is rejected when it is loaded
+    auto rejectsSelfReference = [](const Expression &program, size_t operand)
+    {
+        ProgramWriter writer;
+        writer.add(program);
+        auto cyclic = writer.serialize(0);
+        void(ProgramImage::fromBytes(cyclic));
+        const auto header = *reinterpret_cast<const ProgramHeader *>(cyclic.data());
+        memcpy(&cyclic[header.nodesOffset + header.root * sizeof(NodeRecord) + operand], &header.root,
+               sizeof(header.root));
+        try
+        {
+            ProgramImage::fromBytes(cyclic);
+        }
+        catch (const runtime_error &)
+        {
+            return true;
+        }
+        return false;
+    };
+    assert(rejectsSelfReference(*add(lit(1), lit(2)), offsetof(NodeRecord, a)));
+    assert(rejectsSelfReference(*setat(id("l"), 0, 1), offsetof(NodeRecord, c)));
+
+    std::remove(path.c_str());
+}
+
+#endif // CPP_EVA_PROGRAM_IMAGE_TEST_H
@@ -0,0 +1,97 @@
+#ifndef CPP_EVA_ROPE_TEST_H
+#define CPP_EVA_ROPE_TEST_H
+
+#include <string>
+#include "test_utils.h"
+#include "expression_helpers.h"
+#include "governor_test.h"
+#include "../eva.h"
+#include "../collections.h"
+#include "../rope.h"
+
+void runRopeTest(Eva &eva)
+{
+    using namespace std;
+
+    // Short concatenations stay strings
+    SASSERT(add("Hello, ", "World"), "Hello, World");
+    NASSERT(add("count: ", 1));
+
+    // Appending in a loop builds a rope that behaves like a string
+    auto result = eva.eval(beg(
+        var("report", lit("")),
+        floop(var("i", lit(0)), lt(id("i"), 20000), inc(id("i")),
+              set("report", add(id("report"), "line\n"))),
+        id("report")));
+    assert(holds_alternative<RopeValue>(result));
+    assert(get<RopeValue>(result).rope->size() == 100000);
+    assert(textOf(result)->substr(0, 10) == "line\nline\n");
+    string lines;
+    for (int i = 0; i < 20000; ++i)
+    {
+        lines += "line\n";
+    }
+    assert(equalValues(result, lines));
+
+    IASSERT(beg(
+                var("text", lit("")),
+                floop(var("i", lit(0)), lt(id("i"), 100), inc(id("i")),
+                      set("text", add(id("text"), "abcdef"))),
+                call("len", id("text"))),
+            600);
+    SASSERT(beg(
+                var("text", lit("")),
+                floop(var("i", lit(0)), lt(id("i"), 100), inc(id("i")),
+                      set("text", add(id("text"), "abcdef"))),
+                call("substr", id("text"), 594, 6)),
+            "abcdef");
+
+    // Ropes are equal to, and hash like, strings with the same characters
+    string expected;
+    EvalResult rope = string();
+    for (int i = 0; i < 1000; ++i)
+    {
+        auto piece = to_string(i);
+        expected += piece;
+        rope = Rope::concat(rope, piece);
+    }
+    assert(holds_alternative<RopeValue>(rope));
+    assert(equalValues(rope, expected) && equalValues(expected, rope));
+    assert(hashValue(rope) == hashValue(expected));
+    assert(*textOf(Rope::concat(rope, rope)) == expected + expected);
+
+    // Destroying a long rope must not recurse through the whole chain
+    EvalResult big = string();
+    for (int i = 0; i < 200000; ++i)
+    {
+        big = Rope::concat(big, "0123456789");
+    }
+    assert(textOf(big)->size() == 2000000);
+    big = Null{};
+
+    // The builder accumulates pieces and returns the string when called without arguments
+    SASSERT(beg(
+                var("out", call("builder")),
+                floop(var("i", lit(0)), lt(id("i"), 3), inc(id("i")),
+                      call("out", id("i"), ",")),
+                call("out")),
+            "0,1,2,");
+
+    // Ropes and builders are charged to the governor as they grow
+    EvalLimits heap;
+    heap.maxHeapBytes = 1024 * 1024;
+    assert(abortReason(eva,
+                       beg(
+                           var("text", lit(""s)),
+                           floop(var("i", lit(0)), lt(id("i"), 200000), inc(id("i")),
+                                 set("text", add(id("text"), "0123456789")))),
+                       heap) == AbortReason::HEAP_LIMIT_EXCEEDED);
+    assert(abortReason(eva,
+                       beg(
+                           var("out", call("builder")),
+                           floop(var("i", lit(0)), lt(id("i"), 200000), inc(id("i")),
+                                 call("out", "0123456789"))),
+                       heap) == AbortReason::HEAP_LIMIT_EXCEEDED);
+}
+
+#endif // CPP_EVA_ROPE_TEST_H
@@ -0,0 +1,49 @@
+#ifndef CPP_EVA_SCOPE_TEST_H
+#define CPP_EVA_SCOPE_TEST_H
+
+#include "test_utils.h"
+#include "expression_helpers.h"
+#include "../eva.h"
+
+void runScopeTest(Eva &eva)
+{
+    // Blocks are classified by what they declare and whether their environment can be captured
+    assert(beg(set("x", 1), inc(id("x")))->getScope() == BlockScope::ENCLOSING);
+    assert(beg(beg(var("x", lit(1))), id("x"))->getScope() == BlockScope::ENCLOSING);
+    assert(beg(iff(TRUE, var("x", lit(1)), lit(0)))->getScope() == BlockScope::STACK);
+    assert(beg(floop(var("i", lit(0)), lt(id("i"), 3), inc(id("i")), id("i")))->getScope() == BlockScope::STACK);
+    assert(beg(var("x", lit(1)), call("f", id("x")))->getScope() == BlockScope::STACK);
+    assert(beg(var("x", lit(1)), lambda(args("y"), id("x")))->getScope() == BlockScope::HEAP);
+    assert(beg(beg(def("f", args(), lit(1))))->getScope() == BlockScope::HEAP);
+
+    // Blocks without declarations see and update the enclosing variables
+    IASSERT(beg(
+                var("total", lit(0)),
+                var("i", lit(0)),
+                loop(lt(id("i"), 1000),
+                     beg(
+                         set("total", add(id("total"), id("i"))),
+                         inc(id("i")))),
+                id("total")),
+            499500);
+
+    // Locals of blocks on the stack are gone after the block
+    IASSERT(beg(
+                var("scopeOuter", lit(1)),
+                beg(
+                    var("scopeOuter", lit(2)),
+                    var("scopeInner", lit(3))),
+                id("scopeOuter")),
+            1);
+    NASSERT(id("scopeInner"));
+
+    // Closures keep the environment of their block alive
+    eva.eval(var("scopeCounter",
+                 beg(
+                     var("count", lit(0)),
+                     lambda(args(), inc(id("count"))))));
+    IASSERT(call("scopeCounter"), 1);
+    IASSERT(call("scopeCounter"), 2);
+}
+
+#endif // CPP_EVA_SCOPE_TEST_H
@@ -5,7 +5,8 @@
 #include "expression_helpers.h"
 #include "../eva.h"
 
-void runSelfEvalTests(Eva &eva)
+template <typename Evaluator>
+void runSelfEvalTests(Evaluator &eva)
 {
     using namespace std;
 
@@ -0,0 +1,114 @@
+#ifndef CPP_EVA_SEQUENCE_TEST_H
+#define CPP_EVA_SEQUENCE_TEST_H
+
+#include <cassert>
+#include <memory>
+#include <string>
+#include "test_utils.h"
+#include "expression_helpers.h"
+#include "../eva.h"
+#include "../program_image.h"
+#include "../transpiler.h"
+
+void runSequenceTest(Eva &eva)
+{
+    using namespace std;
+
+    // Stages run only when the sequence is iterated, one item at a time through all of them
+    eva.eval(var("pulled", lit(0)));
+    eva.eval(var("oddSquares",
+                 call("take",
+                      call("filter",
+                           call("map", call("range", 1000000),
+                                lambda(args("x"), beg(set("pulled", add(id("pulled"), 1)), mul(id("x"), id("x"))))),
+                           lambda(args("x"), eq(mod(id("x"), 2), 1))),
+                      3)));
+    IASSERT(id("pulled"), 0);
+    IASSERT(call("reduce", id("oddSquares"), lambda(args("total", "x"), add(id("total"), id("x"))), 0), 1 + 9 + 25);
+    IASSERT(id("pulled"), 6);
+
+    // Iterating again starts over from the source
+    IASSERT(call("len", call("collect", id("oddSquares"))), 3);
+    IASSERT(at(call("collect", id("oddSquares")), 2), 25);
+
+    // Ranges count down with a negative step
+    SASSERT(call("str", call("collect", call("range", 5, 0, -2))), "[5, 3, 1]");
+    IASSERT(call("len", call("collect", call("range", 3, 3))), 0);
+
+    // Ranges stop at their bound without stepping past the limits of integers
+    SASSERT(call("str", call("collect", call("range", 2147483645, 2147483647, 5))), "[2147483645]");
+    SASSERT(call("str", call("collect", call("range", -2147483647, sub(-2147483647, 1), -3))), "[-2147483647]");
+
+    // A take of no items pulls nothing from the source
+    eva.eval(set("pulled", lit(0)));
+    IASSERT(call("len", call("collect", call("take", call("map", call("range", 10),
+                                                           lambda(args("x"), beg(set("pulled", add(id("pulled"), 1)), id("x")))),
+                                                  0))),
+            0);
+    IASSERT(id("pulled"), 0);
+
+    // Lists, maps, vectors and tables are iterated in place, maps and tables by key
+    eva.eval(var("addAll", lambda(args("total", "x"), add(id("total"), id("x")))));
+    IASSERT(call("reduce", call("map", lst(1, 2, 3), lambda(args("x"), mul(id("x"), 10))), id("addAll"), 0), 60);
+    IASSERT(call("reduce", dict(kv(1, "one"), kv(2, "two"), kv(40, "forty")), id("addAll"), 0), 43);
+    IASSERT(call("reduce", call("filter", call("vector", 1, 2, 3, 4), lambda(args("x"), gt(id("x"), 2))), id("addAll"), 0), 7);
+    IASSERT(call("reduce", call("table", 5, "five", 6, "six"), id("addAll"), 0), 11);
+
+    // Take stops pulling from an unbounded generator
+    eva.eval(def("multiplesOf", args("n"),
+                 beg(
+                     var("m", lit(0)),
+                     loop(lit(true), beg(yld(id("m")), set("m", add(id("m"), id("n"))))))));
+    SASSERT(call("str", call("collect", call("take", call("multiplesOf", 7), 4))), "[0, 7, 14, 21]");
+
+    // For loops over items pull from the same cursors
+    IASSERT(beg(
+                var("sum", lit(0)),
+                forin("x", call("range", 0, 10, 3), set("sum", add(id("sum"), id("x")))),
+                id("sum")),
+            18);
+    SASSERT(beg(
+                var("joined", ""),
+                forin("word", lst("a", "b", "c"), set("joined", add(id("joined"), id("word")))),
+                id("joined")),
+            "abc");
+    IASSERT(forin("x", call("take", call("multiplesOf", 3), 5), id("x")), 12);
+
+    // A for loop inside a generator resumes with the item it yielded
+    eva.eval(def("doubled", args("items"), forin("x", id("items"), yld(mul(id("x"), 2)))));
+    eva.eval(var("doubles", call("doubled", call("range", 1, 4))));
+    IASSERT(call("next", id("doubles")), 2);
+    IASSERT(call("next", id("doubles")), 4);
+    IASSERT(call("next", id("doubles")), 6);
+    NASSERT(call("next", id("doubles")));
+
+    // Only collections, generators and sequences can be iterated
+    NASSERT(forin("x", lit(5), lit(0)));
+    NASSERT(call("map", "text", id("addAll")));
+    NASSERT(call("range", 0, 10, 0));
+    NASSERT(call("take", lst(1), -1));
+
+    // For loops over items survive a program image and the transpiler
+    ProgramWriter writer;
+    writer.add(*def("sumOf", args("items"),
+                    beg(
+                        var("s", lit(0)),
+                        forin("x", id("items"), set("s", add(id("s"), id("x")))),
+                        id("s"))));
+    auto image = ProgramImage::fromBytes(writer.serialize(0));
+    eva.eval(image->materialize());
+    IASSERT(call("sumOf", call("range", 5)), 10);
+
+    Transpiler transpiler;
+    transpiler.add(*def("sumOf", args("items"),
+                        beg(
+                            var("s", lit(0)),
+                            forin("x", id("items"), set("s", add(id("s"), id("x")))),
+                            id("s"))));
+    auto module = NativeModule::compile(transpiler.getSource());
+    Eva compiled(std::make_shared<Environment>(EvalMap{}, globalEnv));
+    compiled.eval(*module);
+    assert(std::get<int>(compiled.eval(call("sumOf", lst(4, 5, 6)))) == 15);
+}
+
+#endif // CPP_EVA_SEQUENCE_TEST_H
@@ -0,0 +1,76 @@
+#ifndef CPP_EVA_SHARED_PROGRAM_TEST_H
+#define CPP_EVA_SHARED_PROGRAM_TEST_H
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "test_utils.h"
+#include "expression_helpers.h"
+#include "../eva.h"
+
+void runSharedProgramTest(Eva &eva)
+{
+    using namespace std;
+
+    // Functions, closures, classes, loops and switches all keep their trees intact when they are evaluated
+    shared_ptr<const Expression> program = beg(
+        def("fib", args("n"),
+            iff(lt(id("n"), 2),
+                id("n"),
+                add(call("fib", sub(id("n"), 1)), call("fib", sub(id("n"), 2))))),
+        def("counter", args(),
+            beg(
+                var("count", lit(0)),
+                lambda(args(), beg(set("count", add(id("count"), 1)), id("count"))))),
+        cls("Point", NONE,
+            beg(
+                def("constructor", args("self", "x", "y"),
+                    beg(
+                        setm(prop("self", "x"), id("x")),
+                        setm(prop("self", "y"), id("y")))),
+                def("calc", args("self"), add(prop("self", "x"), prop("self", "y"))))),
+        var("next", call("counter")),
+        var("total", lit(0)),
+        floop(var("i", lit(0)), lt(id("i"), 15), set("i", add(id("i"), 1)),
+              set("total", add(id("total"),
+                               select(when(eq(mod(id("i"), 3), 0), call("fib", id("i"))),
+                                      any(call("next")))))),
+        var("p", newi("Point", vars(id("total"), 1))),
+        callm(prop("p", "calc"), vars(id("p"))));
+
+    // The same program can be evaluated again
+    assert(get<int>(eva.eval(*program)) == 244);
+    assert(get<int>(eva.eval(*program)) == 244);
+
+    // Interpreters on different threads evaluate the one tree at once, each with a root of its own
+    vector<pair<string, EvalResult>> builtins;
+    for (const auto &variable : globalEnv->getVariables())
+    {
+        builtins.emplace_back(variable.name, variable.get());
+    }
+
+    vector<thread> interpreters;
+    vector<int> results(8);
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        interpreters.emplace_back([&program, &builtins, &results, i]
+                                  {
+            Eva interpreter(make_shared<Environment>(EvalMap(builtins.begin(), builtins.end())));
+            for (int run = 0; run < 4; ++run)
+            {
+                results[i] += get<int>(interpreter.eval(*program));
+            } });
+    }
+    for (auto &interpreter : interpreters)
+    {
+        interpreter.join();
+    }
+    for (auto result : results)
+    {
+        assert(result == 4 * 244);
+    }
+}
+
+#endif // CPP_EVA_SHARED_PROGRAM_TEST_H
@@ -0,0 +1,75 @@
+#ifndef CPP_EVA_SNAPSHOT_TEST_H
+#define CPP_EVA_SNAPSHOT_TEST_H
+
+#include <cstdio>
+#include "test_utils.h"
+#include "expression_helpers.h"
+#include "../eva.h"
+#include "../snapshot.h"
+
+void runSnapshotTest(Eva &)
+{
+    using namespace std;
+
+    Eva prelude(make_shared<Environment>(EvalMap{{"null", Null{}}, {"true", true}, {"false", false}, {"abs", builtins().at("abs")}}));
+    prelude.eval(cls("Point", NONE,
+                     beg(
+                         def("constructor", args("self", "x", "y"),
+                             beg(
+                                 setm(prop("self", "x"), id("x")),
+                                 setm(prop("self", "y"), id("y")))),
+                         def("calc", args("self"),
+                             add(prop("self", "x"), prop("self", "y"))))));
+    prelude.eval(def("makeAdder", args("n"),
+                     lambda(args("x"), add(id("x"), id("n")))));
+    prelude.eval(def("fact", args("n"),
+                     iff(eq(id("n"), 0), lit(1), mul(id("n"), call("fact", sub(id("n"), 1))))));
+    prelude.eval(var("add5", call("makeAdder", 5)));
+    prelude.eval(var("origin", newi("Point", vars(1, 2))));
+    prelude.eval(var("greeting", "hello"s));
+    prelude.eval(var("banner", add(lit(string(Rope::leafSize, '=')), "!")));
+    prelude.eval(var("bumpCounter", NONE));
+    prelude.eval(var("readCounter", NONE));
+    prelude.eval(beg(
+        var("counter", lit(0)),
+        set("bumpCounter", lambda(args(), set("counter", add(id("counter"), 1)))),
+        set("readCounter", lambda(args(), id("counter")))));
+    prelude.eval(call("bumpCounter"));
+
+    auto path = string(P_tmpdir) + "/cpp_eva_snapshot_test.evas";
+    Snapshot::write(*prelude.getGlobal(), path);
+
+    Eva eva(Snapshot::load(path));
+    std::remove(path.c_str());
+
+    IASSERT(call("add5", 10), 15);
+    IASSERT(call("fact", 5), 120);
+    IASSERT(call("abs", -7), 7);
+    IASSERT(prop("origin", "x"), 1);
+    IASSERT(callm(prop("origin", "calc"), vars(id("origin"))), 3);
+    IASSERT(beg(
+                var("p", newi("Point", vars(10, 20))),
+                callm(prop("p", "calc"), vars(id("p")))),
+            30);
+    SASSERT(id("greeting"), "hello");
+    SASSERT(id("banner"), string(Rope::leafSize, '=') + "!");
+
+    // Closures sharing a captured variable still share it after restoring
+    IASSERT(call("readCounter"), 1);
+    IASSERT(call("bumpCounter"), 2);
+    IASSERT(call("readCounter"), 2);
+    BASSERT(id("true"), true);
+
+    // Restored state is independent from the original interpreter
+    IASSERT(set("greeting", 1), 1);
+    assert(get<string>(prelude.eval(id("greeting"))) == "hello");
+
+    // Restored interpreters can be snapshotted again
+    Eva copy(Snapshot::fromBytes(Snapshot::serialize(*eva.getGlobal())));
+    assert(get<int>(copy.eval(id("greeting"))) == 1);
+    assert(get<int>(copy.eval(call("fact", 6))) == 720);
+    copy.eval(call("bumpCounter"));
+    assert(get<int>(copy.eval(call("readCounter"))) == 3);
+}
+
+#endif // CPP_EVA_SNAPSHOT_TEST_H
@@ -0,0 +1,67 @@
+#ifndef CPP_EVA_STATIC_EVA_TEST_H
+#define CPP_EVA_STATIC_EVA_TEST_H
+
+#include <cassert>
+#include <climits>
+#include <stdexcept>
+#include <string>
+#include "test_utils.h"
+#include "../eva.h"
+#include "../static_eva.h"
+
+void runStaticEvaTest(Eva &eva)
+{
+    constexpr auto i = EVA_SYMBOL(i);
+    constexpr auto x = EVA_SYMBOL(x);
+    constexpr auto sum = EVA_SYMBOL(sum);
+
+    constexpr auto sumOfEvens = ct::beg(
+        ct::var(sum, 0),
+        ct::floop(ct::var(i, 0), ct::lt(ct::id(i), 10), ct::inc(i),
+                  ct::iff(ct::eq(ct::mod(ct::id(i), 2), 0),
+                          ct::set(sum, ct::add(ct::id(sum), ct::id(i))),
+                          ct::id(sum))),
+        ct::id(sum));
+
+    constexpr auto shadowing = ct::beg(
+        ct::var(x, 10),
+        ct::beg(
+            ct::var(x, 20),
+            ct::set(x, ct::mul(ct::id(x), 2))),
+        ct::add(ct::id(x), ct::id(i)));
+
+    constexpr auto countdown = ct::beg(
+        ct::var(x, 5),
+        ct::loop(ct::gt(ct::id(x), 0), ct::dec(x)),
+        ct::iff(ct::eq(ct::id(x), 0), true, false));
+
+    static_assert(ct::eval(sumOfEvens) == 20);
+    static_assert(ct::eval(countdown));
+
+    // The same programs lowered to expression trees give the same results in the interpreter
+    IASSERT(sumOfEvens.toExpression(), ct::eval(sumOfEvens));
+    BASSERT(countdown.toExpression(), ct::eval(countdown));
+    IASSERT(ct::beg(ct::var(i, 1), shadowing).toExpression(), ct::eval(ct::beg(ct::var(i, 1), shadowing)));
+    static_assert(ct::eval(ct::beg(ct::var(i, 1), shadowing)) == 11);
+
+    // Arithmetic wraps at 32 bits and a zero divisor throws, like in the interpreter
+    constexpr auto wrapped = ct::beg(ct::var(x, INT_MAX), ct::inc(x),
+                                     ct::add(ct::mul(ct::id(x), 2), ct::divv(INT_MIN, -1)));
+    static_assert(ct::eval(wrapped) == INT_MIN);
+    IASSERT(wrapped.toExpression(), ct::eval(wrapped));
+    static_assert(ct::eval(ct::mod(INT_MIN, -1)) == 0);
+    constexpr auto halved = ct::beg(ct::var(x, 0), ct::divv(10, ct::id(x)));
+    bool thrown = false;
+    try
+    {
+        ct::eval(halved);
+    }
+    catch (const std::runtime_error &error)
+    {
+        thrown = std::string(error.what()) == "Division by zero";
+    }
+    assert(thrown);
+    NASSERT(halved.toExpression());
+}
+
+#endif // CPP_EVA_STATIC_EVA_TEST_H
@@ -0,0 +1,75 @@
+#ifndef CPP_EVA_SUPERINSTRUCTIONS_TEST_H
+#define CPP_EVA_SUPERINSTRUCTIONS_TEST_H
+
+#include <cassert>
+#include <climits>
+#include <string>
+#include <typeinfo>
+#include "test_utils.h"
+#include "expression_helpers.h"
+#include "../eva.h"
+#include "../program_image.h"
+#include "../superinstructions.h"
+
+void runSuperinstructionsTest(Eva &eva)
+{
+    using namespace std;
+
+    // The frequent shapes are replaced, the fused nodes keep their kind and their children
+    auto summed = Superinstructions::fuse(floop(var("i", lit(0)), lt(id("i"), 10), inc(id("i")),
+                                              set("fusedSum", add(id("fusedSum"), at(id("fusedItems"), id("i"))))));
+    const auto &forLoop = static_cast<const ForLoop &>(*summed);
+    assert(typeid(*forLoop.getCondition()) != typeid(BinaryOperation));
+    assert(typeid(*forLoop.getModifier()) != typeid(Increment));
+    const auto &assignment = dynamic_cast<const Assignment &>(*forLoop.getBody());
+    assert(typeid(assignment) != typeid(Assignment));
+    assert(typeid(*static_cast<const BinaryOperation &>(*assignment.getValue()).getRight()) != typeid(IndexAccess));
+    assert(typeid(*Superinstructions::fuse(add(prop("self", "value"), 1))) == typeid(BinaryOperation));
+    assert(typeid(*Superinstructions::fuse(set("a", add(id("b"), id("a"))))) == typeid(Assignment));
+
+    // Fused nodes compute what the nodes they replace compute
+    eva.eval(var("fusedItems", lst(1, 2, 3, 4, 5, 6, 7, 8, 9, 10)));
+    eva.eval(var("fusedSum", lit(0)));
+    eva.eval(std::move(summed));
+    IASSERT(id("fusedSum"), 55);
+    IASSERT(beg(var("d", lit(3)), dec(id("d")), dec(id("d"))), 1);
+    IASSERT(beg(var("largest", lit(INT_MAX)), inc(id("largest"))), INT_MIN);
+    IASSERT(beg(var("smallest", lit(INT_MIN)), dec(id("smallest"))), INT_MAX);
+    IASSERT(beg(var("m", lit(7)), set("m", mod(id("m"), 4)), set("m", mul(id("m"), id("m")))), 9);
+    IASSERT(at(id("fusedItems"), 9), 10);
+    BASSERT(beg(var("p", lit(2)), var("q", lit(3)), lt(id("p"), id("q"))), true);
+
+    // Values that are not integers take the path of the original nodes
+    SASSERT(beg(var("s", lit("a")), set("s", add(id("s"), lit("b"))), call("str", id("s"))), "ab");
+    IASSERT(beg(var("lookup", dict(kv("one", 1))), at(id("lookup"), "one")), 1);
+    NASSERT(add(id("fusedNowhere"), 1));
+    NASSERT(inc(id("fusedNowhere")));
+    NASSERT(beg(var("t", lit("text")), dec(id("t"))));
+
+    // The variable is read before the operand is evaluated, like without fusion
+    eva.eval(var("bumped", lit(1)));
+    eva.eval(def("bump", args(), beg(set("bumped", lit(100)), lit(1))));
+    IASSERT(set("bumped", add(id("bumped"), call("bump"))), 2);
+
+    // Passes that walk the tree see the original shape
+    ProgramWriter writer;
+    writer.add(*Superinstructions::fuse(def("fusedCountdown", args("n"),
+                                            beg(var("steps", lit(0)),
+                                                loop(gt(id("n"), 0), beg(dec(id("n")), inc(id("steps")))),
+                                                id("steps")))));
+    eva.eval(ProgramImage::fromBytes(writer.serialize(0))->materialize());
+    IASSERT(call("fusedCountdown", 12), 12);
+
+    // Without the rewrite the same programs give the same results
+    eva.setFusing(false);
+    IASSERT(beg(var("n", lit(0)), floop(var("i", lit(0)), lt(id("i"), 5), inc(id("i")), set("n", add(id("n"), id("i")))), id("n")), 10);
+    eva.setFusing(true);
+
+    // The pair counts put the most frequent parent and child kinds first
+    auto pairs = Superinstructions::countPairs(*floop(var("i", lit(0)), lt(id("i"), 10), inc(id("i")),
+                                                      set("sum", add(id("sum"), id("i")))));
+    assert(pairs[0].parent == "BinaryOperation" && pairs[0].child == "Identifier" && pairs[0].count == 3);
+    assert(pairs.size() == 8);
+}
+
+#endif // CPP_EVA_SUPERINSTRUCTIONS_TEST_H
@@ -5,7 +5,8 @@
 #include "expression_helpers.h"
 #include "../eva.h"
 
-void runSwitchTest(Eva &eva)
+template <typename Evaluator>
+void runSwitchTest(Evaluator &eva)
 {
     IASSERT(
         beg(
@@ -0,0 +1,69 @@
+#ifndef CPP_EVA_TAGGED_TREE_TEST_H
+#define CPP_EVA_TAGGED_TREE_TEST_H
+
+#include <cassert>
+#include <climits>
+#include <string>
+#include "test_utils.h"
+#include "expression_helpers.h"
+#include "../eva.h"
+#include "../tagged_tree.h"
+
+void runTaggedTreeTest(Eva &eva)
+{
+    using namespace std;
+
+    // The tree computes what the expressions it was lowered from compute
+    auto countdown = []
+    {
+        return beg(var("n", lit(10)), var("steps", lit(0)),
+                   loop(gt(id("n"), 0), beg(dec(id("n")), inc(id("steps")))),
+                   floop(var("i", lit(0)), lt(id("i"), 5), inc(id("i")), set("steps", add(id("steps"), id("i")))),
+                   id("steps"));
+    };
+    auto tree = TaggedTree::compile(countdown());
+    assert(tree->delegated() == 0);
+    assert(tree->nameCount() == 3);
+    assert(holds_alternative<int>(eva.eval(*tree)) && get<int>(eva.eval(*tree)) == 20);
+    IASSERT(countdown(), 20);
+
+    auto text = TaggedTree::compile(beg(var("s", lit("a")), set("s", add(id("s"), lit("b"))),
+                                        iff(eq(lit(1), lit(2)), lit("no"), call("str", id("s")))));
+    assert(get<string>(eva.eval(*text)) == "ab");
+
+    auto items = TaggedTree::compile(beg(var("taggedItems", lst(1, 2, 3)), at(id("taggedItems"), 2)));
+    assert(get<int>(eva.eval(*items)) == 3);
+
+    // Increments and decrements wrap like the operations on integers
+    assert(get<int>(eva.eval(*TaggedTree::compile(beg(var("largest", lit(INT_MAX)), inc(id("largest")))))) == INT_MIN);
+    assert(get<int>(eva.eval(*TaggedTree::compile(beg(var("smallest", lit(INT_MIN)), dec(id("smallest")))))) == INT_MAX);
+
+    // Functions declared by the tree run from the tree, recursion and closures included
+    eva.eval(*TaggedTree::compile(def("taggedFib", args("n"),
+                                      iff(lt(id("n"), 2), id("n"),
+                                          add(call("taggedFib", sub(id("n"), 1)), call("taggedFib", sub(id("n"), 2)))))));
+    IASSERT(call("taggedFib", 15), 610);
+
+    // The definitions keep the tree alive
+    eva.eval(*TaggedTree::compile(def("taggedCounter", args(),
+                                      beg(var("count", lit(0)), lambda(args(), beg(inc(id("count")), id("count")))))));
+    eva.eval(*TaggedTree::compile(var("taggedNext", call("taggedCounter"))));
+    IASSERT(call("taggedNext"), 1);
+    IASSERT(call("taggedNext"), 2);
+
+    // The other kinds are delegated to the expressions they were lowered from
+    auto shapes = TaggedTree::compile(beg(
+        cls("TaggedPoint", NONE,
+            beg(def("constructor", args("self", "x"), setm(prop("self", "x"), id("x"))),
+                def("getX", args("self"), prop("self", "x")))),
+        var("p", newi("TaggedPoint", vars(7))),
+        add(callm(prop("p", "getX"), vars(id("p"))), at(dict(kv("one", 1)), "one"))));
+    assert(shapes->delegated() > 0);
+    assert(get<int>(eva.eval(*shapes)) == 8);
+
+    // Errors are the errors of the expressions
+    NASSERT(add(id("taggedNowhere"), 1));
+    assert(holds_alternative<Null>(eva.eval(*TaggedTree::compile(add(id("taggedNowhere"), 1)))));
+}
+
+#endif // CPP_EVA_TAGGED_TREE_TEST_H
@@ -15,6 +15,30 @@
 #include "switch_test.h"
 #include "inc_dec_test.h"
 #include "class_test.h"
+#include "governor_test.h"
+#include "program_image_test.h"
+#include "snapshot_test.h"
+#include "binding_test.h"
+#include "static_eva_test.h"
+#include "jit_test.h"
+#include "transpiler_test.h"
+#include "frame_pool_test.h"
+#include "variable_table_test.h"
+#include "scope_test.h"
+#include "closure_test.h"
+#include "collections_test.h"
+#include "persistent_test.h"
+#include "rope_test.h"
+#include "event_loop_test.h"
+#include "modules_test.h"
+#include "shared_program_test.h"
+#include "generator_test.h"
+#include "sequence_test.h"
+#include "parallel_test.h"
+#include "actor_test.h"
+#include "perf_counters_test.h"
+#include "superinstructions_test.h"
+#include "tagged_tree_test.h"
 
 void runTests(Eva &eva)
 {
@@ -31,6 +55,30 @@ void runTests(Eva &eva)
     runSwitchTest(eva);
     runIncDecTest(eva);
     runClassTest(eva);
+    runGovernorTest(eva);
+    runProgramImageTest(eva);
+    runSnapshotTest(eva);
+    runBindingTest(eva);
+    runStaticEvaTest(eva);
+    runJitTest(eva);
+    runTranspilerTest(eva);
+    runFramePoolTest(eva);
+    runVariableTableTest(eva);
+    runScopeTest(eva);
+    runClosureTest(eva);
+    runCollectionsTest(eva);
+    runPersistentTest(eva);
+    runRopeTest(eva);
+    runEventLoopTest(eva);
+    runModulesTest(eva);
+    runSharedProgramTest(eva);
+    runGeneratorTest(eva);
+    runSequenceTest(eva);
+    runParallelTest(eva);
+    runActorTest(eva);
+    runPerfCountersTest(eva);
+    runSuperinstructionsTest(eva);
+    runTaggedTreeTest(eva);
 
     eva.eval(print("Hello", " ", "World"));
 
@@ -0,0 +1,128 @@
+#ifndef CPP_EVA_TRANSPILER_TEST_H
+#define CPP_EVA_TRANSPILER_TEST_H
+
+#include <climits>
+#include <memory>
+#include <vector>
+#include "test_utils.h"
+#include "expression_helpers.h"
+#include "../eva.h"
+#include "../transpiler.h"
+#include "self_eval_test.h"
+#include "variables-test.h"
+#include "block_test.h"
+#include "math_test.h"
+#include "if_test.h"
+#include "while_test.h"
+#include "built_in_func_test.h"
+#include "user_defined_func_test.h"
+#include "lambda_func_test.h"
+#include "for_loop_test.h"
+#include "switch_test.h"
+#include "inc_dec_test.h"
+#include "class_test.h"
+
+/**
+ * This class is used to run the same programs with the interpreter and as a native module.
+ *
+ * Every program is translated before it is interpreted and the result of the interpreter is returned to
+ * the test. verify() compiles all programs into one module, runs them in order in an environment of
+ * their own and checks that they produce the same results.
+ */
+class DifferentialEva
+{
+public:
+    EvalResult eval(ExpressionPtr exp)
+    {
+        transpiler.add(*exp);
+        expected.push_back(interpreter.eval(std::move(exp)));
+        return expected.back();
+    }
+
+    void verify()
+    {
+        auto module = NativeModule::compile(transpiler.getSource(), "-O0");
+        assert(module->size() == expected.size());
+
+        for (size_t i = 0; i < expected.size(); ++i)
+        {
+            auto actual = compiled.eval(*module, i);
+            assert(actual.index() == expected[i].index());
+            std::visit([&actual](const auto &value)
+                       {
+                using T = std::decay_t<decltype(value)>;
+                if constexpr (std::is_same_v<T, int> || std::is_same_v<T, std::string> || std::is_same_v<T, bool>)
+                {
+                    assert(std::get<T>(actual) == value);
+                } },
+                       expected[i]);
+        }
+    }
+
+private:
+    static std::shared_ptr<Environment> fresh()
+    {
+        EvalMap variables;
+        for (const auto &variable : globalEnv->getVariables())
+        {
+            variables.emplace(variable.name, variable.get());
+        }
+        return std::make_shared<Environment>(std::move(variables));
+    }
+
+    Transpiler transpiler;
+    Eva interpreter{fresh()};
+    Eva compiled{fresh()};
+    std::vector<EvalResult> expected;
+};
+
+void runTranspilerTest(Eva &)
+{
+    DifferentialEva eva;
+    runSelfEvalTests(eva);
+    runVariablesTests(eva);
+    runBlockTest(eva);
+    runMathTests(eva);
+    runIfTests(eva);
+    runWhileTests(eva);
+    runBuildInFunTest(eva);
+    runUserDefinedFuncTest(eva);
+    runLambdaFuncTest(eva);
+    runForLoopTest(eva);
+    runSwitchTest(eva);
+    runIncDecTest(eva);
+    runClassTest(eva);
+
+    // Arithmetic wraps at 32 bits in native code too
+    IASSERT(add(INT_MAX, 1), INT_MIN);
+    IASSERT(sub(INT_MIN, 1), INT_MAX);
+    IASSERT(mul(65536, 65536), 0);
+    IASSERT(beg(var("largest", lit(INT_MAX)), inc(id("largest"))), INT_MIN);
+    IASSERT(beg(var("smallest", lit(INT_MIN)), dec(id("smallest"))), INT_MAX);
+    eva.verify();
+
+    // A native function can be called by interpreted code
+    Transpiler transpiler;
+    transpiler.add(*def("square", args("x"), mul(id("x"), id("x"))));
+    auto module = NativeModule::compile(transpiler.getSource());
+    Eva interpreter(std::make_shared<Environment>(EvalMap{}));
+    interpreter.eval(*module);
+    assert(std::get<int>(interpreter.eval(call("square", 12))) == 144);
+
+    // Collections and strings are shared with the interpreter
+    Transpiler collections;
+    collections.add(*var("inventory", dict(kv("items", lst(1, 2)))));
+    collections.add(*beg(call("push", at(id("inventory"), "items"), 3),
+                         setat(id("inventory"), lst(1), "key")));
+    collections.add(*var("greeting", add("Hello, ", "World")));
+    auto collectionModule = NativeModule::compile(collections.getSource());
+    Eva scripts(std::make_shared<Environment>(EvalMap{}, globalEnv));
+    scripts.eval(*collectionModule, 0);
+    scripts.eval(*collectionModule, 1);
+    scripts.eval(*collectionModule, 2);
+    assert(std::get<int>(scripts.eval(call("len", at(id("inventory"), "items")))) == 3);
+    assert(std::get<std::string>(scripts.eval(at(id("inventory"), lst(1)))) == "key");
+    assert(std::get<std::string>(scripts.eval(id("greeting"))) == "Hello, World");
+}
+
+#endif // CPP_EVA_TRANSPILER_TEST_H
@@ -5,7 +5,8 @@
 #include "expression_helpers.h"
 #include "../eva.h"
 
-void runUserDefinedFuncTest(Eva &eva)
+template <typename Evaluator>
+void runUserDefinedFuncTest(Evaluator &eva)
 {
     IASSERT(
         beg(
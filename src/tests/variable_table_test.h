@@ -0,0 +1,53 @@
+#ifndef CPP_EVA_VARIABLE_TABLE_TEST_H
+#define CPP_EVA_VARIABLE_TABLE_TEST_H
+
+#include <memory>
+#include <string>
+#include "test_utils.h"
+#include "expression_helpers.h"
+#include "../eva.h"
+#include "../variable_table.h"
+
+void runVariableTableTest(Eva &eva)
+{
+    using namespace std;
+
+    // Tables are searched linearly up to the threshold and hashed past it, in definition order
+    VariableTable table;
+    for (int i = 0; i < 100; ++i)
+    {
+        assert(!table.find("v" + to_string(i)));
+        table.insert("v" + to_string(i), i);
+        assert(table.size() == static_cast<size_t>(i) + 1);
+        for (int j = 0; j <= i; ++j)
+        {
+            assert(get<int>(*table.find("v" + to_string(j))) == j);
+        }
+    }
+    int expected = 0;
+    for (const auto &variable : table)
+    {
+        assert(variable.name == "v" + to_string(expected) && get<int>(variable.get()) == expected);
+        ++expected;
+    }
+
+    // Values survive the growth of the array and the promotion of the table
+    VariableTable strings;
+    for (size_t i = 0; i <= VariableTable::linearCapacity; ++i)
+    {
+        strings.insert(string(i, 'k'), string(64, static_cast<char>('a' + i)));
+    }
+    assert(get<string>(*strings.find("")) == string(64, 'a'));
+    assert(get<string>(*strings.find(string(VariableTable::linearCapacity, 'k'))) ==
+           string(64, static_cast<char>('a' + VariableTable::linearCapacity)));
+
+    // Scopes with many variables behave like small ones
+    eva.eval(def("manyLocals", args("a", "b", "c", "d", "e", "f", "g"),
+                 beg(
+                     set("g", add(id("a"), id("f"))),
+                     var("h", lit(8)),
+                     add(id("g"), id("h")))));
+    IASSERT(call("manyLocals", 1, 2, 3, 4, 5, 6, 7), 15);
+}
+
+#endif // CPP_EVA_VARIABLE_TABLE_TEST_H
@@ -5,7 +5,8 @@
 #include "expression_helpers.h"
 #include "../eva.h"
 
-void runVariablesTests(Eva &eva)
+template <typename Evaluator>
+void runVariablesTests(Evaluator &eva)
 {
     using namespace std;
 
@@ -5,7 +5,8 @@
 #include "expression_helpers.h"
 #include "../eva.h"
 
-void runWhileTests(Eva &eva)
+template <typename Evaluator>
+void runWhileTests(Evaluator &eva)
 {
     IASSERT(
         beg(
@@ -0,0 +1,728 @@
+#include "transpiler.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <typeinfo>
+#include <variant>
+#include <dlfcn.h>
+#include <unistd.h>
+
+#ifndef CPP_EVA_CXX_COMPILER
+#define CPP_EVA_CXX_COMPILER "c++"
+#endif
+
+#ifndef CPP_EVA_INCLUDE_DIR
+#define CPP_EVA_INCLUDE_DIR "."
+#endif
+
+using namespace std;
+
+namespace
+{
+    constexpr const char *entriesSymbol = "eva_module_entries";
+
+    using EntriesFunction = const CompiledExpression::Function *(*)(size_t *count);
+
+    string quote(const string &value)
+    {
+        string result = "std::string(\"";
+        for (unsigned char c : value)
+        {
+            if (c == '"' || c == '\\')
+            {
+                result += '\\';
+                result += static_cast<char>(c);
+            }
+            else if (c < 0x20 || c >= 0x7F)
+            {
+                char escaped[5];
+                snprintf(escaped, sizeof(escaped), "\\%03o", c);
+                result += escaped;
+            }
+            else
+            {
+                result += static_cast<char>(c);
+            }
+        }
+        return result + "\", " + to_string(value.size()) + ")";
+    }
+
+    string binaryOperator(BinaryOperationType type)
+    {
+        switch (type)
+        {
+        case ADDITION:
+            return "+";
+        case SUBTRACTION:
+            return "-";
+        case MULTIPLICATION:
+            return "*";
+        case DIVISION:
+            return "/";
+        case MOD:
+            return "%";
+        case GREATER:
+            return ">";
+        case LESS:
+            return "<";
+        case EQUAL:
+            return "==";
+        case NOT_EQUAL:
+            return "!=";
+        case GREATER_OR_EQUAL:
+            return ">=";
+        case LESS_OR_EQUAL:
+            return "<=";
+        default:
+            throw runtime_error("Cannot transpile binary operation " + to_string(type));
+        }
+    }
+
+    /**
+     * @brief Get the enumerator of an arithmetic operation, empty for comparisons
+     */
+    string arithmeticOperation(BinaryOperationType type)
+    {
+        switch (type)
+        {
+        case ADDITION:
+            return "ADDITION";
+        case SUBTRACTION:
+            return "SUBTRACTION";
+        case MULTIPLICATION:
+            return "MULTIPLICATION";
+        case DIVISION:
+            return "DIVISION";
+        case MOD:
+            return "MOD";
+        default:
+            return "";
+        }
+    }
+}
+
+/**
+ * This class is used to emit the C++ statements evaluating an expression.
+ *
+ * Every visited expression appends its statements to the current function and leaves the name of the
+ * variable holding its value in result. env is the name of the variable holding the current environment.
+ */
+class SourceEmitter : public ExpressionVisitor
+{
+public:
+    explicit SourceEmitter(Transpiler &module) : module(module) {}
+
+    /**
+     * Emit a function evaluating the expression in the environment it is called with.
+     */
+    string function(const Expression &body, const string &prefix)
+    {
+        auto savedOut = std::move(out);
+        auto savedEnv = env;
+        auto savedIndentation = indentation;
+
+        out.clear();
+        env = "env";
+        indentation = 1;
+        auto name = prefix + to_string(module.nextFunction++);
+        auto value = emit(body);
+
+        module.definitions += "static EvalResult " + name +
+                              "(const std::shared_ptr<Environment> &env, const std::shared_ptr<const void> &module)\n{\n" +
+                              out + "    return " + value + ";\n}\n\n";
+
+        out = std::move(savedOut);
+        env = savedEnv;
+        indentation = savedIndentation;
+        return name;
+    }
+
+    void visit(const Expression &exp) override
+    {
+        // Other subclasses, e.g. already compiled expressions, have no source to translate
+        if (typeid(exp) != typeid(Expression))
+        {
+            throw runtime_error("Cannot transpile expression of type " + string(typeid(exp).name()));
+        }
+        result = declare("Null{}");
+    }
+
+    void visit(const Block &exp) override
+    {
+        // Blocks without declarations are evaluated in the enclosing environment like in the interpreter
+        auto blockEnv = exp.getScope() == BlockScope::ENCLOSING ? env : environment(env);
+        result = statements(exp.getExpressions(), blockEnv);
+    }
+
+    void visit(const Condition &exp) override
+    {
+        auto condition = emit(*exp.getCondition());
+        auto value = declare("");
+        line("if (std::get<bool>(" + condition + "))");
+        open();
+        auto then = emit(*exp.getThen());
+        line(value + " = std::move(" + then + ");");
+        close();
+        line("else");
+        open();
+        if (exp.getOtherwise())
+        {
+            auto otherwise = emit(*exp.getOtherwise());
+            line(value + " = std::move(" + otherwise + ");");
+        }
+        else
+        {
+            line("throw std::runtime_error(\"Condition without otherwise branch is false\");");
+        }
+        close();
+        result = value;
+    }
+
+    void visit(const Loop &exp) override
+    {
+        auto value = declare("");
+        line("while (true)");
+        open();
+        auto condition = emit(*exp.getCondition());
+        line("if (!std::get<bool>(" + condition + ")) break;");
+        line("ResourceGovernor::safepoint();");
+        auto body = emit(*exp.getBody());
+        line(value + " = std::move(" + body + ");");
+        close();
+        result = value;
+    }
+
+    void visit(const Identifier &exp) override
+    {
+        result = declare(env + "->lookup(" + quote(exp.getName()) + ")");
+    }
+
+    void visit(const Literal &exp) override
+    {
+        const auto &value = exp.getValue();
+        if (auto number = get_if<int>(&value))
+        {
+            result = declare("static_cast<int>(" + to_string(*number) + "LL)");
+        }
+        else if (auto str = get_if<string>(&value))
+        {
+            result = declare(quote(*str));
+        }
+        else if (auto flag = get_if<bool>(&value))
+        {
+            result = declare(*flag ? "true" : "false");
+        }
+        else if (holds_alternative<Null>(value))
+        {
+            result = declare("Null{}");
+        }
+        else
+        {
+            throw runtime_error("Cannot transpile literal value");
+        }
+    }
+
+    void visit(const VariableDeclaration &exp) override
+    {
+        auto value = emit(*exp.getValue());
+        line(env + "->define(" + quote(exp.getName()) + ", " + value + ");");
+        result = value;
+    }
+
+    void visit(const Assignment &exp) override
+    {
+        if (const auto &memberAccess = exp.getMemberAccess())
+        {
+            auto instance = temp();
+            line("auto " + instance + " = std::get<InstanceDefinition>(" + env + "->lookup(" +
+                 quote(memberAccess->getInstance()) + "));");
+            auto value = emit(*exp.getValue());
+            line(instance + ".env->define(" + quote(memberAccess->getMember()) + ", " + value + ");");
+            result = value;
+            return;
+        }
+
+        auto value = emit(*exp.getValue());
+        result = declare(env + "->assign(" + quote(exp.getName()) + ", std::move(" + value + "))");
+    }
+
+    void visit(const BinaryOperation &exp) override
+    {
+        auto op = binaryOperator(exp.getType());
+        auto left = emit(*exp.getLeft());
+        if (exp.getType() == ADDITION)
+        {
+            auto right = emit(*exp.getRight());
+            result = declare("std::holds_alternative<int>(" + left + ") ? EvalResult(BinaryOperation::apply(ADDITION, " +
+                             "std::get<int>(" + left + "), std::get<int>(" + right + "))) : Rope::concat(" + left +
+                             ", " + right + ")");
+            return;
+        }
+        auto lhs = temp();
+        line("const int " + lhs + " = std::get<int>(" + left + ");");
+        auto right = emit(*exp.getRight());
+        auto rhs = temp();
+        line("const int " + rhs + " = std::get<int>(" + right + ");");
+        auto arithmetic = arithmeticOperation(exp.getType());
+        if (!arithmetic.empty())
+        {
+            // The interpreter wraps at 32 bits and reports division by zero, plain int arithmetic would overflow
+            result = declare("BinaryOperation::apply(" + arithmetic + ", " + lhs + ", " + rhs + ")");
+            return;
+        }
+        result = declare(lhs + " " + op + " " + rhs);
+    }
+
+    void visit(const FunctionDeclaration &exp) override
+    {
+        result = declare(definition(exp));
+        line(env + "->define(" + quote(exp.getName()) + ", " + result + ");");
+    }
+
+    void visit(const Lambda &exp) override
+    {
+        result = declare(definition(exp));
+    }
+
+    void visit(const AnonymousFunctionCall &exp) override
+    {
+        line("ResourceGovernor::safepoint();");
+        auto callee = emit(*exp.getFunction());
+        call(callee, exp.getArgs());
+    }
+
+    void visit(const FunctionCall &exp) override
+    {
+        line("ResourceGovernor::safepoint();");
+        auto callee = declare(env + "->lookup(" + quote(exp.getName()) + ")");
+        call(callee, exp.getArgs());
+    }
+
+    void visit(const ForLoop &exp) override
+    {
+        void(emit(*exp.getInit()));
+
+        auto value = declare("");
+        line("while (true)");
+        open();
+        auto condition = emit(*exp.getCondition());
+        line("if (!std::get<bool>(" + condition + ")) break;");
+        line("ResourceGovernor::safepoint();");
+
+        // Every iteration runs the body and the modifier in a new block
+        auto savedEnv = env;
+        env = environment(env);
+        void(emit(*exp.getBody()));
+        auto modifier = emit(*exp.getModifier());
+        env = savedEnv;
+
+        line(value + " = std::move(" + modifier + ");");
+        close();
+        result = value;
+    }
+
+    void visit(const ForIn &exp) override
+    {
+        auto iterable = emit(*exp.getIterable());
+        auto cursor = temp();
+        line("auto " + cursor + " = Sequence::of(" + iterable + ")->cursor();");
+
+        // The variable is defined once, in an environment of its own, and assigned for every item
+        auto savedEnv = env;
+        env = environment(env);
+        line(env + "->define(" + quote(exp.getName()) + ", Null{});");
+        auto value = declare("");
+        auto item = declare("");
+        line("while (" + cursor + "->next(" + item + "))");
+        open();
+        line("ResourceGovernor::safepoint();");
+        line("void(" + env + "->assign(" + quote(exp.getName()) + ", std::move(" + item + ")));");
+        auto body = emit(*exp.getBody());
+        line(value + " = std::move(" + body + ");");
+        close();
+        env = savedEnv;
+        result = value;
+    }
+
+    void visit(const Switch &exp) override
+    {
+        const auto &cases = exp.getCases();
+        auto value = declare("Null{}");
+        for (const auto &[condition, body] : cases)
+        {
+            auto test = emit(*condition);
+            line("if (std::get<bool>(" + test + "))");
+            open();
+            auto branch = emit(*body);
+            line(value + " = std::move(" + branch + ");");
+            close();
+            line("else");
+            open();
+        }
+        if (!cases.empty())
+        {
+            line("throw std::runtime_error(\"No case of the switch matches\");");
+        }
+        for (size_t i = 0; i < cases.size(); ++i)
+        {
+            close();
+        }
+        result = value;
+    }
+
+    void visit(const Increment &exp) override
+    {
+        step(exp.getIdentifier()->getName(), ADDITION);
+    }
+
+    void visit(const Decrement &exp) override
+    {
+        step(exp.getIdentifier()->getName(), SUBTRACTION);
+    }
+
+    void visit(const ClassDeclaration &exp) override
+    {
+        auto parent = exp.getParent() ? emit(*exp.getParent()) : declare("Null{}");
+        auto parentEnv = temp();
+        line("auto " + parentEnv + " = " + env + ";");
+        line("if (auto parentClass = std::get_if<ClassDefinition>(&" + parent + ")) " + parentEnv + " = parentClass->env;");
+
+        // The body of a class is evaluated directly in the class environment
+        auto classEnv = temp();
+        line("auto " + classEnv + " = std::make_shared<Environment>(EvalMap{}, " + parentEnv + ");");
+        auto savedEnv = env;
+        env = classEnv;
+        for (const auto &statement : exp.getExpressions())
+        {
+            void(emit(*statement));
+        }
+        env = savedEnv;
+
+        line(env + "->define(" + quote(exp.getName()) + ", ClassDefinition{" + quote(exp.getName()) + ", " + classEnv + "});");
+        result = declare("Null{}");
+    }
+
+    void visit(const NewInstance &exp) override
+    {
+        line("ResourceGovernor::safepoint();");
+        auto classDefinition = temp();
+        auto instance = temp();
+        auto constructor = temp();
+        auto constructorEnv = temp();
+        line("auto " + classDefinition + " = std::get<ClassDefinition>(" + env + "->lookup(" + quote(exp.getName()) + "));");
+        line("auto " + instance + " = InstanceDefinition{std::make_shared<Environment>(EvalMap{}, " + classDefinition + ".env)};");
+        line("auto " + constructor + " = std::get<FunctionDefinition>(" + classDefinition + ".env->lookup(\"constructor\"));");
+        line("auto " + constructorEnv + " = std::make_shared<Environment>(EvalMap{}, " + constructor + ".env);");
+        line(constructorEnv + "->define(\"self\", " + instance + ");");
+
+        // Only the arguments matching a parameter of the constructor are evaluated
+        const auto &args = exp.getArgs();
+        for (size_t i = 0; i < args.size(); ++i)
+        {
+            line("if (" + constructor + ".params.size() > " + to_string(i + 1) + ")");
+            open();
+            auto value = emit(*args[i]);
+            line(constructorEnv + "->define(" + constructor + ".params[" + to_string(i + 1) + "], " + value + ");");
+            close();
+        }
+
+        line("void(" + constructor + ".body->eval(" + constructorEnv + "));");
+        result = declare(instance);
+    }
+
+    void visit(const MemberAccess &exp) override
+    {
+        result = declare("std::get<InstanceDefinition>(" + env + "->lookup(" + quote(exp.getInstance()) + ")).env->lookup(" +
+                         quote(exp.getMember()) + ")");
+    }
+
+    void visit(const MemberFunctionCall &exp) override
+    {
+        line("ResourceGovernor::safepoint();");
+        auto callee = emit(*exp.getFunction());
+        call(callee, exp.getArgs());
+    }
+
+    void visit(const ListExpression &exp) override
+    {
+        string values;
+        for (const auto &item : exp.getItems())
+        {
+            auto value = emit(*item);
+            values += (values.empty() ? "std::move(" : ", std::move(") + value + ")";
+        }
+        result = declare("List::create(std::vector<EvalResult>{" + values + "})");
+    }
+
+    void visit(const MapExpression &exp) override
+    {
+        auto map = temp();
+        line("auto " + map + " = HashMap::create();");
+        for (const auto &[key, value] : exp.getEntries())
+        {
+            auto keyValue = emit(*key);
+            auto valueValue = emit(*value);
+            line(map + ".map->assign(" + keyValue + ", std::move(" + valueValue + "));");
+        }
+        result = declare(map);
+    }
+
+    void visit(const IndexAccess &exp) override
+    {
+        auto collection = emit(*exp.getCollection());
+        auto index = emit(*exp.getIndex());
+        result = declare("IndexAccess::access(" + collection + ", " + index + ")");
+    }
+
+    void visit(const IndexAssignment &exp) override
+    {
+        auto collection = emit(*exp.getCollection());
+        auto index = emit(*exp.getIndex());
+        auto value = emit(*exp.getValue());
+        result = declare("IndexAssignment::assign(" + collection + ", " + index + ", std::move(" + value + "))");
+    }
+
+    void visit(const Import &exp) override
+    {
+        string names;
+        for (const auto &name : exp.getNames())
+        {
+            names += (names.empty() ? "" : ", ") + quote(name);
+        }
+        result = declare("Import::bind(" + quote(exp.getPath()) + ", std::vector<std::string>{" + names + "}, " + env + ")");
+    }
+
+    void visit(const Yield &) override
+    {
+        throw runtime_error("Cannot transpile yield outside of a generator function");
+    }
+
+private:
+    string emit(const Expression &exp)
+    {
+        exp.accept(*this);
+        return result;
+    }
+
+    string statements(const vector<ExpressionPtr> &expressions, const string &blockEnv)
+    {
+        if (expressions.empty())
+        {
+            return declare("");
+        }
+
+        auto savedEnv = env;
+        env = blockEnv;
+        string value;
+        for (const auto &statement : expressions)
+        {
+            value = emit(*statement);
+        }
+        env = savedEnv;
+        return value;
+    }
+
+    string definition(const FunctionDeclaration &exp)
+    {
+        if (!exp.getBody())
+        {
+            throw runtime_error("Cannot transpile a function declaration without a body");
+        }
+        if (exp.isGenerator())
+        {
+            // Generators are resumed by the interpreter, which walks their body
+            throw runtime_error("Cannot transpile generator function");
+        }
+
+        auto name = function(*exp.getBody(), "function");
+        string params;
+        for (const auto &param : exp.getParams())
+        {
+            params += (params.empty() ? "" : ", ") + quote(param);
+        }
+        return "FunctionDefinition{\"\", {" + params + "}, std::make_shared<CompiledExpression>(&" + name + ", module), " +
+               env + ", std::make_shared<CallProfile>()}";
+    }
+
+    void call(const string &callee, const vector<ExpressionPtr> &args)
+    {
+        if (args.empty())
+        {
+            result = declare("AnonymousFunctionCall::invoke(" + callee + ", nullptr, 0)");
+            return;
+        }
+
+        string values;
+        for (const auto &arg : args)
+        {
+            auto value = emit(*arg);
+            values += (values.empty() ? "std::move(" : ", std::move(") + value + ")";
+        }
+        auto array = temp();
+        line("EvalResult " + array + "[] = {" + values + "};");
+        result = declare("AnonymousFunctionCall::invoke(" + callee + ", " + array + ", " + to_string(args.size()) + ")");
+    }
+
+    void step(const string &name, BinaryOperationType type)
+    {
+        result = declare(env + "->assign(" + quote(name) + ", BinaryOperation::apply(" + arithmeticOperation(type) +
+                         ", std::get<int>(" + env + "->lookup(" + quote(name) + ")), 1))");
+    }
+
+    string environment(const string &parent)
+    {
+        auto name = temp();
+        line("auto " + name + " = std::make_shared<Environment>(EvalMap{}, " + parent + ");");
+        return name;
+    }
+
+    string declare(const string &value)
+    {
+        auto name = temp();
+        line("EvalResult " + name + (value.empty() ? "" : " = " + value) + ";");
+        return name;
+    }
+
+    string temp()
+    {
+        return "v" + to_string(nextTemp++);
+    }
+
+    void line(const string &text)
+    {
+        out.append(indentation * 4, ' ');
+        out += text;
+        out += '\n';
+    }
+
+    void open()
+    {
+        line("{");
+        ++indentation;
+    }
+
+    void close()
+    {
+        --indentation;
+        line("}");
+    }
+
+    Transpiler &module;
+    string out;
+    string env = "env";
+    string result;
+    size_t indentation = 1;
+    size_t nextTemp = 0;
+};
+
+size_t Transpiler::add(const Expression &program)
+{
+    SourceEmitter emitter(*this);
+    entries.push_back(emitter.function(program, "entry"));
+    return entries.size() - 1;
+}
+
+std::string Transpiler::getSource() const
+{
+    string source = "// Generated by the Eva transpiler\n#include \"aot_runtime.h\"\n\n";
+    source += definitions;
+
+    source += "extern \"C\" const CompiledExpression::Function *eva_module_entries(size_t *count)\n{\n";
+    source += "    *count = " + to_string(entries.size()) + ";\n";
+    if (entries.empty())
+    {
+        source += "    return nullptr;\n}\n";
+        return source;
+    }
+
+    source += "    static const CompiledExpression::Function entries[] = {\n";
+    for (const auto &entry : entries)
+    {
+        source += "        &" + entry + ",\n";
+    }
+    source += "    };\n    return entries;\n}\n";
+    return source;
+}
+
+std::shared_ptr<NativeModule> NativeModule::compile(const std::string &source, const std::string &flags)
+{
+    char directory[] = P_tmpdir "/cpp_eva_aot_XXXXXX";
+    if (!mkdtemp(directory))
+    {
+        throw runtime_error("Cannot create a directory for the native module");
+    }
+
+    auto sourcePath = string(directory) + "/module.cpp";
+    auto libraryPath = string(directory) + "/module.so";
+    auto logPath = string(directory) + "/compile.log";
+    auto cleanup = [&]
+    {
+        std::remove(sourcePath.c_str());
+        std::remove(libraryPath.c_str());
+        std::remove(logPath.c_str());
+        rmdir(directory);
+    };
+
+    ofstream(sourcePath, ios::binary) << source;
+
+    auto compiler = getenv("EVA_CXX") ? string(getenv("EVA_CXX")) : string(CPP_EVA_CXX_COMPILER);
+    auto command = "\"" + compiler + "\" -std=c++17 -fPIC -shared " + flags + " -I\"" CPP_EVA_INCLUDE_DIR "\" -o \"" +
+                   libraryPath + "\" \"" + sourcePath + "\" > \"" + logPath + "\" 2>&1";
+    if (std::system(command.c_str()) != 0)
+    {
+        stringstream log;
+        log << ifstream(logPath).rdbuf();
+        cleanup();
+        throw runtime_error("Cannot compile native module:\n" + log.str());
+    }
+
+    try
+    {
+        auto module = load(libraryPath);
+        cleanup();
+        return module;
+    }
+    catch (...)
+    {
+        cleanup();
+        throw;
+    }
+}
+
+std::shared_ptr<NativeModule> NativeModule::load(const std::string &path)
+{
+    // The code stays mapped after the module is released: values created by it may outlive the module
+    auto handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL | RTLD_NODELETE);
+    if (!handle)
+    {
+        throw runtime_error("Cannot load native module: " + string(dlerror()));
+    }
+
+    shared_ptr<NativeModule> module(new NativeModule(handle));
+    auto entries = reinterpret_cast<EntriesFunction>(dlsym(handle, entriesSymbol));
+    if (!entries)
+    {
+        throw runtime_error("Cannot load native module: " + path + " has no entry points");
+    }
+    module->entries = entries(&module->count);
+    return module;
+}
+
+NativeModule::NativeModule(void *handle) : handle(handle) {}
+
+NativeModule::~NativeModule()
+{
+    dlclose(handle);
+}
+
+EvalResult NativeModule::run(size_t entry, const std::shared_ptr<Environment> &env) const
+{
+    if (entry >= count)
+    {
+        throw out_of_range("Native module has no entry " + to_string(entry));
+    }
+    return entries[entry](env, shared_from_this());
+}
@@ -0,0 +1,117 @@
+#ifndef CPP_EVA_TRANSPILER_H
+#define CPP_EVA_TRANSPILER_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+#include "aot_runtime.h"
+
+/**
+ * This class is used to translate expression trees to C++ source code.
+ *
+ * Every added program becomes an entry point of the generated module, lambdas become static functions.
+ * The generated code is written against aot_runtime.h and evaluates expressions in the same order
+ * and with the same environments as the interpreter.
+ */
+class Transpiler
+{
+public:
+    /**
+     * @brief Add a program to the module
+     *
+     * The tree is only read, it can be translated before or after it is evaluated.
+     *
+     * @param program The program to translate
+     *
+     * @return The index of the entry point of the program
+     *
+     * @throw std::runtime_error if the program contains a construct that cannot be translated
+     */
+    size_t add(const Expression &program);
+
+    /**
+     * @brief Get the C++ source of the module
+     *
+     * @return The source code, exporting the entry points through eva_module_entries
+     */
+    [[nodiscard]] std::string getSource() const;
+
+    [[nodiscard]] size_t size() const
+    {
+        return entries.size();
+    }
+
+private:
+    friend class SourceEmitter;
+
+    std::string definitions;
+    std::vector<std::string> entries;
+    size_t nextFunction = 0;
+};
+
+/**
+ * This class is used to represent a module of native code produced by the Transpiler.
+ *
+ * The module is unloaded when the last function definition created by its code is destroyed.
+ */
+class NativeModule : public std::enable_shared_from_this<NativeModule>
+{
+public:
+    /**
+     * @brief Compile generated source code with the system C++ compiler and load it
+     *
+     * The compiler defaults to the one used to build the interpreter and can be overridden with the
+     * EVA_CXX environment variable.
+     *
+     * @param source The source code generated by a Transpiler
+     * @param flags Additional compiler flags, e.g. the optimization level
+     *
+     * @return The loaded module
+     *
+     * @throw std::runtime_error if the code cannot be compiled or loaded
+     */
+    static std::shared_ptr<NativeModule> compile(const std::string &source, const std::string &flags = "-O2");
+
+    /**
+     * @brief Load a module compiled earlier
+     *
+     * @param path The path of the shared object
+     *
+     * @return The loaded module
+     *
+     * @throw std::runtime_error if the shared object cannot be loaded or is not a module
+     */
+    static std::shared_ptr<NativeModule> load(const std::string &path);
+
+    NativeModule(const NativeModule &) = delete;
+    NativeModule &operator=(const NativeModule &) = delete;
+
+    ~NativeModule();
+
+    /**
+     * @brief Run an entry point of the module
+     *
+     * @param entry The index returned by Transpiler::add
+     * @param env The environment to run the program in
+     *
+     * @return The result of the program
+     *
+     * @throw std::out_of_range if the entry does not exist
+     */
+    EvalResult run(size_t entry, const std::shared_ptr<Environment> &env) const;
+
+    [[nodiscard]] size_t size() const
+    {
+        return count;
+    }
+
+private:
+    explicit NativeModule(void *handle);
+
+    void *handle;
+    const CompiledExpression::Function *entries = nullptr;
+    size_t count = 0;
+};
+
+#endif // CPP_EVA_TRANSPILER_H
@@ -0,0 +1,96 @@
+#include "variable_table.h"
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+using namespace std;
+
+namespace
+{
+    constexpr size_t initialBuckets = 16;
+
+    size_t hashName(const string &name)
+    {
+        return hash<string>{}(name);
+    }
+}
+
+VariableTable::VariableTable(EvalMap variables)
+{
+    for (auto &[name, value] : variables)
+    {
+        insert(name, std::move(value));
+    }
+}
+
+Variable *VariableTable::findHashed(const std::string &name)
+{
+    const size_t mask = slots.size() - 1;
+    for (size_t bucket = hashName(name) & mask;; bucket = (bucket + 1) & mask)
+    {
+        auto slot = slots[bucket];
+        if (slot == 0)
+        {
+            return nullptr;
+        }
+        if (sameName(variables[slot - 1].name, name))
+        {
+            return &variables[slot - 1];
+        }
+    }
+}
+
+EvalResult &VariableTable::insert(std::string name, EvalResult value)
+{
+    return append(Variable{std::move(name), std::move(value)}).value;
+}
+
+void VariableTable::insertCell(std::string name, std::shared_ptr<EvalResult> cell)
+{
+    void(append(Variable{std::move(name), Null{}, std::move(cell)}));
+}
+
+Variable &VariableTable::append(Variable variable)
+{
+    // Small scopes grow one or two variables at a time to keep the array tight, larger ones double
+    const auto capacity = variables.capacity();
+    if (variables.size() == capacity)
+    {
+        variables.reserve(capacity < 2 ? capacity + 1 : capacity < linearCapacity ? capacity + 2 : capacity * 2);
+    }
+    variables.push_back(std::move(variable));
+
+    if (isHashed())
+    {
+        if (variables.size() * 4 > slots.size() * 3)
+        {
+            rehash(max(initialBuckets, slots.size() * 2));
+        }
+        else
+        {
+            index(static_cast<uint32_t>(variables.size() - 1));
+        }
+    }
+    return variables.back();
+}
+
+void VariableTable::rehash(size_t buckets)
+{
+    slots.assign(buckets, 0);
+    for (uint32_t position = 0; position < variables.size(); ++position)
+    {
+        index(position);
+    }
+}
+
+void VariableTable::index(uint32_t position)
+{
+    const size_t mask = slots.size() - 1;
+    auto bucket = hashName(variables[position].name) & mask;
+    while (slots[bucket] != 0)
+    {
+        bucket = (bucket + 1) & mask;
+    }
+    slots[bucket] = position + 1;
+}
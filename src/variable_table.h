@@ -0,0 +1,174 @@
+#ifndef CPP_EVA_VARIABLE_TABLE_H
+#define CPP_EVA_VARIABLE_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include "eval_types.h"
+
+/**
+ * This struct is used to represent a variable stored in an environment.
+ *
+ * A variable captured by a closure keeps its value in a cell shared with the environment of the closure.
+ */
+struct Variable
+{
+    std::string name;
+    EvalResult value;
+    std::shared_ptr<EvalResult> cell = nullptr;
+
+    EvalResult &get()
+    {
+        return cell ? *cell : value;
+    }
+
+    [[nodiscard]] const EvalResult &get() const
+    {
+        return cell ? *cell : value;
+    }
+};
+
+/**
+ * This class is used to store the variables of an environment.
+ *
+ * Variables are stored in one flat array, so a scope holds a single block of variables and an empty scope
+ * none. Most scopes hold a handful of variables: the array grows one or two variables at a time and tables
+ * of up to linearCapacity variables are found by linear search, without hashing. Larger tables index the
+ * array with an open addressing hash table using linear probing. Variables are never removed and are
+ * iterated in the order they were defined.
+ *
+ * Pointers returned by find() are invalidated by insert().
+ */
+class VariableTable
+{
+public:
+    static constexpr size_t linearCapacity = 8;
+
+    VariableTable() = default;
+
+    explicit VariableTable(EvalMap variables);
+
+    VariableTable(const VariableTable &) = delete;
+    VariableTable &operator=(const VariableTable &) = delete;
+
+    /**
+     * @brief Find the value of a variable
+     *
+     * @param name The name of the variable
+     *
+     * @return A pointer to the value, nullptr if the variable is not defined
+     */
+    EvalResult *find(const std::string &name)
+    {
+        auto variable = findVariable(name);
+        return variable ? &variable->get() : nullptr;
+    }
+
+    const EvalResult *find(const std::string &name) const
+    {
+        return const_cast<VariableTable *>(this)->find(name);
+    }
+
+    /**
+     * @brief Find a variable
+     *
+     * @param name The name of the variable
+     *
+     * @return A pointer to the variable, nullptr if it is not defined
+     */
+    Variable *findVariable(const std::string &name)
+    {
+        if (isHashed())
+        {
+            return findHashed(name);
+        }
+
+        for (auto &variable : variables)
+        {
+            if (sameName(variable.name, name))
+            {
+                return &variable;
+            }
+        }
+        return nullptr;
+    }
+
+    /**
+     * @brief Add a variable that is not defined yet
+     *
+     * @param name The name of the variable
+     * @param value The value of the variable
+     *
+     * @return The stored value
+     */
+    EvalResult &insert(std::string name, EvalResult value);
+
+    /**
+     * @brief Add a variable that is not defined yet and stores its value in a shared cell
+     *
+     * @param name The name of the variable
+     * @param cell The cell holding the value
+     */
+    void insertCell(std::string name, std::shared_ptr<EvalResult> cell);
+
+    [[nodiscard]] size_t size() const
+    {
+        return variables.size();
+    }
+
+    [[nodiscard]] bool empty() const
+    {
+        return variables.empty();
+    }
+
+    Variable *begin()
+    {
+        return variables.data();
+    }
+
+    Variable *end()
+    {
+        return variables.data() + variables.size();
+    }
+
+    [[nodiscard]] const Variable *begin() const
+    {
+        return variables.data();
+    }
+
+    [[nodiscard]] const Variable *end() const
+    {
+        return variables.data() + variables.size();
+    }
+
+private:
+    // Names of the same scope usually differ in length or in their last character, which is checked before memcmp
+    static bool sameName(const std::string &a, const std::string &b)
+    {
+        const auto size = a.size();
+        return size == b.size() && (size == 0 || (a[size - 1] == b[size - 1] && std::memcmp(a.data(), b.data(), size - 1) == 0));
+    }
+
+    [[nodiscard]] bool isHashed() const
+    {
+        return variables.size() > linearCapacity;
+    }
+
+    Variable *findHashed(const std::string &name);
+
+    Variable &append(Variable variable);
+
+    void rehash(size_t buckets);
+
+    void index(uint32_t position);
+
+    std::vector<Variable> variables;
+
+    // Used once the table holds more than linearCapacity variables: slots store positions in variables plus one
+    std::vector<uint32_t> slots;
+};
+
+#endif // CPP_EVA_VARIABLE_TABLE_H
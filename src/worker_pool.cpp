@@ -0,0 +1,154 @@
+#include "worker_pool.h"
+
+#include <algorithm>
+
+using namespace std;
+
+WorkerPool &WorkerPool::process()
+{
+    static WorkerPool pool(max(1u, thread::hardware_concurrency()));
+    return pool;
+}
+
+WorkerPool::WorkerPool(size_t workers)
+{
+    for (size_t i = 0; i < workers; ++i)
+    {
+        queues.push_back(make_unique<Queue>());
+    }
+    for (size_t i = 0; i < workers; ++i)
+    {
+        this->workers.emplace_back(&WorkerPool::work, this, i);
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+}
+
+void WorkerPool::run(size_t count, const function<void(size_t)> &task)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    Batch batch;
+    batch.task = &task;
+    batch.remaining = count;
+    {
+        // Workers only look at the queues once the whole batch is dealt
+        lock_guard<mutex> guard(lock);
+        queued += count;
+        for (size_t i = 0; i < queues.size(); ++i)
+        {
+            lock_guard<mutex> queueGuard(queues[i]->lock);
+            for (size_t index = i; index < count; index += queues.size())
+            {
+                queues[i]->tasks.push_back({&batch, index});
+            }
+        }
+    }
+    wake.notify_all();
+
+    // The caller has no queue of its own, it steals until there is nothing left to take
+    Task stolen{};
+    while (batch.remaining > 0 && take(queues.size(), stolen))
+    {
+        execute(stolen);
+    }
+
+    unique_lock<mutex> guard(batch.lock);
+    batch.finished.wait(guard, [&batch]
+                        { return batch.remaining == 0; });
+    if (batch.error)
+    {
+        rethrow_exception(batch.error);
+    }
+}
+
+void WorkerPool::work(size_t worker)
+{
+    while (true)
+    {
+        Task task{};
+        if (take(worker, task))
+        {
+            execute(task);
+            continue;
+        }
+
+        unique_lock<mutex> guard(lock);
+        wake.wait(guard, [this]
+                  { return stopping || queued > 0; });
+        if (stopping && queued == 0)
+        {
+            return;
+        }
+    }
+}
+
+bool WorkerPool::take(size_t worker, Task &task)
+{
+    if (worker < queues.size())
+    {
+        auto &own = *queues[worker];
+        lock_guard<mutex> guard(own.lock);
+        if (!own.tasks.empty())
+        {
+            task = own.tasks.back();
+            own.tasks.pop_back();
+            --queued;
+            return true;
+        }
+    }
+
+    for (size_t i = 1; i <= queues.size(); ++i)
+    {
+        auto &victim = *queues[(worker + i) % queues.size()];
+        lock_guard<mutex> guard(victim.lock);
+        if (!victim.tasks.empty())
+        {
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+            --queued;
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkerPool::execute(const Task &task)
+{
+    auto &batch = *task.batch;
+    exception_ptr error;
+    try
+    {
+        (*batch.task)(task.index);
+    }
+    catch (...)
+    {
+        error = current_exception();
+    }
+
+    // The batch is released by run as soon as the last task is counted, so it is counted under the lock
+    lock_guard<mutex> guard(batch.lock);
+    if (error && (!batch.error || task.index < batch.errorIndex))
+    {
+        batch.error = error;
+        batch.errorIndex = task.index;
+    }
+    if (--batch.remaining == 0)
+    {
+        batch.finished.notify_all();
+    }
+}
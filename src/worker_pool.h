@@ -0,0 +1,90 @@
+#ifndef CPP_EVA_WORKER_POOL_H
+#define CPP_EVA_WORKER_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * This class is used to run batches of independent tasks on a fixed set of threads.
+ *
+ * Every worker has a queue of its own: a batch is dealt round-robin over the queues, a worker takes the
+ * newest task of its own queue and steals the oldest task of another queue once its own is empty, so an
+ * uneven batch is balanced without a shared queue that every task goes through. The thread that runs a
+ * batch steals tasks too while it waits, so a task may run a nested batch on the same pool without
+ * blocking a worker.
+ */
+class WorkerPool
+{
+public:
+    /**
+     * @brief Get the pool shared by the whole process, with one worker per hardware thread
+     */
+    static WorkerPool &process();
+
+    explicit WorkerPool(size_t workers);
+
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    /**
+     * @brief Run tasks 0 to count - 1 and wait until all of them have finished
+     *
+     * @param count The number of tasks
+     * @param task The function run for each task index, on any thread
+     *
+     * @throw The exception of the failed task with the lowest index, after every task has finished
+     */
+    void run(size_t count, const std::function<void(size_t)> &task);
+
+    [[nodiscard]] size_t size() const
+    {
+        return queues.size();
+    }
+
+private:
+    struct Batch
+    {
+        const std::function<void(size_t)> *task;
+        std::atomic<size_t> remaining;
+        std::mutex lock;
+        std::condition_variable finished;
+        std::exception_ptr error;
+        size_t errorIndex = 0;
+    };
+
+    struct Task
+    {
+        Batch *batch;
+        size_t index;
+    };
+
+    struct Queue
+    {
+        std::mutex lock;
+        std::deque<Task> tasks;
+    };
+
+    void work(size_t worker);
+
+    bool take(size_t worker, Task &task);
+
+    void execute(const Task &task);
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::atomic<size_t> queued{0};
+    std::mutex lock;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::vector<std::thread> workers;
+};
+
+#endif // CPP_EVA_WORKER_POOL_H